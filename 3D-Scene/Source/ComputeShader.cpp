@@ -0,0 +1,211 @@
+///////////////////////////////////////////////////////////////////////////////
+// computeshader.cpp
+// ============
+// load a compute shader program from an external GLSL file and set its
+// uniform values
+///////////////////////////////////////////////////////////////////////////////
+
+#include "ComputeShader.h"
+#include "GLStateCache.h"
+
+#include <glm/gtc/type_ptr.hpp>
+
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+
+/***********************************************************
+ *  ComputeShader()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+ComputeShader::ComputeShader()
+{
+	m_programID = 0;
+}
+
+/***********************************************************
+ *  ~ComputeShader()
+ *
+ *  The destructor for the class
+ ***********************************************************/
+ComputeShader::~ComputeShader()
+{
+	if (m_programID != 0)
+	{
+		GLStateCache::ForgetProgram(m_programID);
+		glDeleteProgram(m_programID);
+		m_programID = 0;
+	}
+}
+
+/***********************************************************
+ *  LoadShader()
+ *
+ *  This method is used for reading the compute shader code
+ *  from the passed in file, then compiling and linking it.
+ *  The compile and link errors are written to the console.
+ ***********************************************************/
+bool ComputeShader::LoadShader(const char* computeShaderPath)
+{
+	std::ifstream shaderFile(computeShaderPath);
+	if (!shaderFile.is_open())
+	{
+		std::cout << "Could not open compute shader: " << computeShaderPath << std::endl;
+		return(false);
+	}
+
+	std::stringstream shaderStream;
+	shaderStream << shaderFile.rdbuf();
+	std::string shaderCode = shaderStream.str();
+	const char* shaderSource = shaderCode.c_str();
+
+	GLint success = 0;
+	GLchar infoLog[1024];
+
+	GLuint shaderID = glCreateShader(GL_COMPUTE_SHADER);
+	glShaderSource(shaderID, 1, &shaderSource, NULL);
+	glCompileShader(shaderID);
+	glGetShaderiv(shaderID, GL_COMPILE_STATUS, &success);
+	if (!success)
+	{
+		glGetShaderInfoLog(shaderID, sizeof(infoLog), NULL, infoLog);
+		std::cout << "Compute shader compile error in " << computeShaderPath << ":\n" << infoLog << std::endl;
+		glDeleteShader(shaderID);
+		return(false);
+	}
+
+	GLuint programID = glCreateProgram();
+	glAttachShader(programID, shaderID);
+	glLinkProgram(programID);
+	glDeleteShader(shaderID);
+	glGetProgramiv(programID, GL_LINK_STATUS, &success);
+	if (!success)
+	{
+		glGetProgramInfoLog(programID, sizeof(infoLog), NULL, infoLog);
+		std::cout << "Compute shader link error in " << computeShaderPath << ":\n" << infoLog << std::endl;
+		glDeleteProgram(programID);
+		return(false);
+	}
+
+	if (m_programID != 0)
+	{
+		GLStateCache::ForgetProgram(m_programID);
+		glDeleteProgram(m_programID);
+	}
+	m_programID = programID;
+
+	return(true);
+}
+
+/***********************************************************
+ *  use()
+ *
+ *  This method is used for making the compute program the
+ *  current program before it is dispatched.
+ ***********************************************************/
+void ComputeShader::use()
+{
+	GLStateCache::UseProgram(m_programID);
+}
+
+/***********************************************************
+ *  setBoolValue()
+ *
+ *  This method is used for setting a bool uniform value.
+ ***********************************************************/
+void ComputeShader::setBoolValue(const char* name, bool value) const
+{
+	glProgramUniform1i(m_programID, glGetUniformLocation(m_programID, name), (int)value);
+}
+
+/***********************************************************
+ *  setIntValue()
+ *
+ *  This method is used for setting an int uniform value.
+ ***********************************************************/
+void ComputeShader::setIntValue(const char* name, int value) const
+{
+	glProgramUniform1i(m_programID, glGetUniformLocation(m_programID, name), value);
+}
+
+/***********************************************************
+ *  setUIntValue()
+ *
+ *  This method is used for setting a uint uniform value.
+ ***********************************************************/
+void ComputeShader::setUIntValue(const char* name, GLuint value) const
+{
+	glProgramUniform1ui(m_programID, glGetUniformLocation(m_programID, name), value);
+}
+
+/***********************************************************
+ *  setFloatValue()
+ *
+ *  This method is used for setting a float uniform value.
+ ***********************************************************/
+void ComputeShader::setFloatValue(const char* name, float value) const
+{
+	glProgramUniform1f(m_programID, glGetUniformLocation(m_programID, name), value);
+}
+
+/***********************************************************
+ *  setVec2Value()
+ *
+ *  This method is used for setting a vec2 uniform value.
+ ***********************************************************/
+void ComputeShader::setVec2Value(const char* name, const glm::vec2& value) const
+{
+	glProgramUniform2fv(m_programID, glGetUniformLocation(m_programID, name), 1, glm::value_ptr(value));
+}
+
+/***********************************************************
+ *  setIVec2Value()
+ *
+ *  This method is used for setting an ivec2 uniform value.
+ ***********************************************************/
+void ComputeShader::setIVec2Value(const char* name, const glm::ivec2& value) const
+{
+	glProgramUniform2iv(m_programID, glGetUniformLocation(m_programID, name), 1, glm::value_ptr(value));
+}
+
+/***********************************************************
+ *  setVec3Value()
+ *
+ *  This method is used for setting a vec3 uniform value.
+ ***********************************************************/
+void ComputeShader::setVec3Value(const char* name, const glm::vec3& value) const
+{
+	glProgramUniform3fv(m_programID, glGetUniformLocation(m_programID, name), 1, glm::value_ptr(value));
+}
+
+/***********************************************************
+ *  setVec4Value()
+ *
+ *  This method is used for setting a vec4 uniform value.
+ ***********************************************************/
+void ComputeShader::setVec4Value(const char* name, const glm::vec4& value) const
+{
+	glProgramUniform4fv(m_programID, glGetUniformLocation(m_programID, name), 1, glm::value_ptr(value));
+}
+
+/***********************************************************
+ *  setVec4ArrayValue()
+ *
+ *  This method is used for setting a vec4 uniform array.
+ ***********************************************************/
+void ComputeShader::setVec4ArrayValue(const char* name, const glm::vec4* values, int count) const
+{
+	glProgramUniform4fv(m_programID, glGetUniformLocation(m_programID, name), count, glm::value_ptr(values[0]));
+}
+
+/***********************************************************
+ *  setMat4Value()
+ *
+ *  This method is used for setting a mat4 uniform value.
+ ***********************************************************/
+void ComputeShader::setMat4Value(const char* name, const glm::mat4& value) const
+{
+	glProgramUniformMatrix4fv(m_programID, glGetUniformLocation(m_programID, name), 1, GL_FALSE, glm::value_ptr(value));
+}
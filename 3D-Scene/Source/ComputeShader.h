@@ -0,0 +1,51 @@
+///////////////////////////////////////////////////////////////////////////////
+// computeshader.h
+// ============
+// load a compute shader program from an external GLSL file and set its
+// uniform values
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+
+/***********************************************************
+ *  ComputeShader
+ *
+ *  This class compiles and links a single compute shader,
+ *  since the shader manager only loads vertex and fragment
+ *  shader pairs. The uniform setters write straight into the
+ *  program, so it does not need to be in use.
+ ***********************************************************/
+class ComputeShader
+{
+public:
+	// constructor
+	ComputeShader();
+	// destructor
+	~ComputeShader();
+
+	// load, compile and link the compute shader code
+	bool LoadShader(const char* computeShaderPath);
+	// make the compute program the current program
+	void use();
+	// get the OpenGL program object
+	GLuint GetProgramID() const { return m_programID; }
+
+	// set the uniform values of the compute program
+	void setBoolValue(const char* name, bool value) const;
+	void setIntValue(const char* name, int value) const;
+	void setUIntValue(const char* name, GLuint value) const;
+	void setFloatValue(const char* name, float value) const;
+	void setVec2Value(const char* name, const glm::vec2& value) const;
+	void setIVec2Value(const char* name, const glm::ivec2& value) const;
+	void setVec3Value(const char* name, const glm::vec3& value) const;
+	void setVec4Value(const char* name, const glm::vec4& value) const;
+	void setVec4ArrayValue(const char* name, const glm::vec4* values, int count) const;
+	void setMat4Value(const char* name, const glm::mat4& value) const;
+
+private:
+	// OpenGL program object of the compute shader
+	GLuint m_programID;
+};
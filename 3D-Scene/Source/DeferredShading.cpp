@@ -0,0 +1,279 @@
+///////////////////////////////////////////////////////////////////////////////
+// deferredshading.cpp
+// ============
+// light the opaque part of the frame from a G-buffer with a tiled compute
+// pass, so every light is only evaluated once per visible pixel it reaches
+///////////////////////////////////////////////////////////////////////////////
+
+#include "DeferredShading.h"
+#include "GLStateCache.h"
+
+#include <iostream>
+
+// declaration of the global variables and defines
+namespace
+{
+	// pixels along each side of a tile, matching the local size in
+	// the light shader
+	const int g_TileSize = 16;
+	// image unit the color of the frame is written through
+	const GLuint g_FrameImageUnit = 0;
+}
+
+/***********************************************************
+ *  DeferredShading()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+DeferredShading::DeferredShading(RenderTargetManager* pRenderTargets)
+{
+	m_pRenderTargets = pRenderTargets;
+	m_albedoTarget = -1;
+	m_normalTarget = -1;
+	m_framebuffer = 0;
+	m_targetGeneration = 0;
+	m_attachedDepthTexture = 0;
+	m_attachedObjectIDTexture = 0;
+	m_pComputeShader = NULL;
+	m_lightBuffer = 0;
+	m_lightCount = 0;
+	m_globalAmbientColor = glm::vec3(0.0f);
+}
+
+/***********************************************************
+ *  ~DeferredShading()
+ *
+ *  The destructor for the class
+ ***********************************************************/
+DeferredShading::~DeferredShading()
+{
+	Destroy();
+}
+
+/***********************************************************
+ *  Initialize()
+ *
+ *  This method is used for loading the light shader and
+ *  adding the G-buffer to the render targets. The light pass
+ *  needs compute shaders and image stores from OpenGL 4.3,
+ *  so on older drivers the frames stay forward shaded.
+ ***********************************************************/
+bool DeferredShading::Initialize(const char* lightComputeShaderPath)
+{
+	if (!GLEW_VERSION_4_3)
+	{
+		std::cout << "Deferred shading disabled: OpenGL 4.3 is not available" << std::endl;
+		return(false);
+	}
+
+	m_pComputeShader = new ComputeShader();
+	if (!m_pComputeShader->LoadShader(lightComputeShaderPath))
+	{
+		delete m_pComputeShader;
+		m_pComputeShader = NULL;
+		return(false);
+	}
+
+	// the G-buffer follows the framebuffer like the frame does,
+	// and is only read with texelFetch
+	RenderTargetManager::RENDER_TARGET_DESC desc;
+	desc.internalFormat = GL_RGBA8;
+	desc.bTexture = true;
+	desc.bMipmapped = false;
+	desc.sizeScale = 1.0f;
+	desc.fixedWidth = 0;
+	desc.fixedHeight = 0;
+	m_albedoTarget = m_pRenderTargets->AddTarget(desc);
+
+	desc.internalFormat = GL_RG16;
+	m_normalTarget = m_pRenderTargets->AddTarget(desc);
+
+	glGenBuffers(1, &m_lightBuffer);
+
+	return(true);
+}
+
+/***********************************************************
+ *  Destroy()
+ *
+ *  This method is used for freeing the light shader, the
+ *  framebuffer and the light buffer, and giving the G-buffer
+ *  back to the render target manager.
+ ***********************************************************/
+void DeferredShading::Destroy()
+{
+	if (NULL != m_pComputeShader)
+	{
+		delete m_pComputeShader;
+		m_pComputeShader = NULL;
+	}
+	if (m_framebuffer != 0)
+	{
+		glDeleteFramebuffers(1, &m_framebuffer);
+		m_framebuffer = 0;
+	}
+	if (m_lightBuffer != 0)
+	{
+		glDeleteBuffers(1, &m_lightBuffer);
+		m_lightBuffer = 0;
+	}
+	if (NULL != m_pRenderTargets)
+	{
+		if (m_albedoTarget >= 0)
+		{
+			m_pRenderTargets->RemoveTarget(m_albedoTarget);
+			m_pRenderTargets->RemoveTarget(m_normalTarget);
+		}
+		m_pRenderTargets = NULL;
+	}
+	m_albedoTarget = -1;
+	m_normalTarget = -1;
+	m_attachedDepthTexture = 0;
+	m_attachedObjectIDTexture = 0;
+	m_lightCount = 0;
+}
+
+/***********************************************************
+ *  SetLights()
+ *
+ *  This method is used for uploading the lights of the
+ *  scene. Every light adds the ambient color where it
+ *  reaches, the same as in the forward shaders.
+ ***********************************************************/
+void DeferredShading::SetLights(const std::vector<LIGHT_DATA>& lights, const glm::vec3& globalAmbientColor)
+{
+	m_globalAmbientColor = globalAmbientColor;
+	m_lightCount = (int)lights.size();
+	if ((m_lightBuffer == 0) || (m_lightCount == 0))
+	{
+		return;
+	}
+
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, m_lightBuffer);
+	glBufferData(GL_SHADER_STORAGE_BUFFER, lights.size() * sizeof(LIGHT_DATA), lights.data(), GL_STATIC_DRAW);
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+}
+
+/***********************************************************
+ *  BeginGeometryPass()
+ *
+ *  This method is used for binding the G-buffer framebuffer.
+ *  The textures are attached again whenever the render
+ *  target manager allocated them again or the frame has a
+ *  new depth texture. The G-buffer is not cleared, since
+ *  the pixels no opaque draw covers keep the far depth and
+ *  are never read. The object IDs of the frame are written
+ *  by the opaque draws here, like the forward ones would.
+ ***********************************************************/
+bool DeferredShading::BeginGeometryPass(GLuint depthTexture, GLuint objectIDTexture)
+{
+	if ((NULL == m_pComputeShader) || (NULL == m_pRenderTargets) || (depthTexture == 0))
+	{
+		return(false);
+	}
+
+	GLuint albedoTexture = m_pRenderTargets->GetTargetName(m_albedoTarget);
+	GLuint normalTexture = m_pRenderTargets->GetTargetName(m_normalTarget);
+	if ((albedoTexture == 0) || (normalTexture == 0))
+	{
+		return(false);
+	}
+
+	if (m_framebuffer == 0)
+	{
+		glGenFramebuffers(1, &m_framebuffer);
+		m_targetGeneration = m_pRenderTargets->GetGeneration() - 1;
+	}
+	glBindFramebuffer(GL_FRAMEBUFFER, m_framebuffer);
+
+	if ((m_targetGeneration != m_pRenderTargets->GetGeneration()) ||
+		(m_attachedDepthTexture != depthTexture) ||
+		(m_attachedObjectIDTexture != objectIDTexture))
+	{
+		m_targetGeneration = m_pRenderTargets->GetGeneration();
+		m_attachedDepthTexture = depthTexture;
+		m_attachedObjectIDTexture = objectIDTexture;
+
+		glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, albedoTexture, 0);
+		glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT1, GL_TEXTURE_2D, normalTexture, 0);
+		glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT2, GL_TEXTURE_2D, objectIDTexture, 0);
+		glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_TEXTURE_2D, depthTexture, 0);
+		// the object IDs are the third output of the batch shaders
+		const GLenum drawBuffers[3] = { GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1, GL_COLOR_ATTACHMENT2 };
+		glDrawBuffers((objectIDTexture != 0) ? 3 : 2, drawBuffers);
+		if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+		{
+			std::cout << "G-buffer framebuffer is not complete" << std::endl;
+		}
+	}
+
+	return(true);
+}
+
+/***********************************************************
+ *  ShadeLights()
+ *
+ *  This method is used for lighting the G-buffer with one
+ *  workgroup per tile. The framebuffer of the frame must be
+ *  bound again before the call, so the transparent draws
+ *  that follow land on the lit frame. The G-buffer was
+ *  drawn at the render size, in the lower left part of the
+ *  textures. The image writes skip the scissor test, so on
+ *  a partial redraw only the tiles overlapping the redrawn
+ *  rectangle are dispatched and the pixels outside of it
+ *  keep the frame they held, transparent draws included.
+ ***********************************************************/
+void DeferredShading::ShadeLights(
+	GLuint colorTexture,
+	GLuint depthTexture,
+	const glm::ivec2& renderSize,
+	const glm::ivec4& shadeRect,
+	const glm::mat4& view,
+	const glm::mat4& projection,
+	const glm::vec3& viewPosition,
+	GLuint materialBuffer)
+{
+	if ((NULL == m_pComputeShader) || (colorTexture == 0) || (renderSize.x <= 0) || (renderSize.y <= 0))
+	{
+		return;
+	}
+
+	// the tiles stay on the grid of the whole frame, so a tile
+	// finds the same lights whatever part is redrawn
+	glm::ivec2 rectMin = glm::max(glm::ivec2(shadeRect.x, shadeRect.y), glm::ivec2(0));
+	glm::ivec2 rectMax = glm::min(glm::ivec2(shadeRect.z, shadeRect.w), renderSize);
+	if ((rectMin.x >= rectMax.x) || (rectMin.y >= rectMax.y))
+	{
+		return;
+	}
+	glm::ivec2 firstTile = rectMin / g_TileSize;
+	glm::ivec2 tileCount = (rectMax + g_TileSize - 1) / g_TileSize - firstTile;
+
+	GLStateCache::BindTexture(DEPTH_TEXTURE_UNIT, GL_TEXTURE_2D, depthTexture);
+	GLStateCache::BindTexture(ALBEDO_TEXTURE_UNIT, GL_TEXTURE_2D, m_pRenderTargets->GetTargetName(m_albedoTarget));
+	GLStateCache::BindTexture(NORMAL_TEXTURE_UNIT, GL_TEXTURE_2D, m_pRenderTargets->GetTargetName(m_normalTarget));
+
+	m_pComputeShader->use();
+	m_pComputeShader->setIntValue("depthTexture", DEPTH_TEXTURE_UNIT);
+	m_pComputeShader->setIntValue("albedoTexture", ALBEDO_TEXTURE_UNIT);
+	m_pComputeShader->setIntValue("normalTexture", NORMAL_TEXTURE_UNIT);
+	m_pComputeShader->setIVec2Value("renderSize", renderSize);
+	m_pComputeShader->setIVec2Value("firstTile", firstTile);
+	m_pComputeShader->setIVec2Value("shadeMin", rectMin);
+	m_pComputeShader->setIVec2Value("shadeMax", rectMax);
+	m_pComputeShader->setMat4Value("inverseViewProjection", glm::inverse(projection * view));
+	m_pComputeShader->setVec3Value("viewPosition", viewPosition);
+	m_pComputeShader->setVec3Value("globalAmbientColor", m_globalAmbientColor);
+	m_pComputeShader->setIntValue("lightCount", m_lightCount);
+
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, MATERIAL_BINDING, materialBuffer);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, LIGHT_BINDING, m_lightBuffer);
+	glBindImageTexture(g_FrameImageUnit, colorTexture, 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_RGBA8);
+
+	glDispatchCompute(tileCount.x, tileCount.y, 1);
+
+	// the transparent draws blend onto the written color, and the
+	// frame is sampled when it is presented
+	glMemoryBarrier(GL_FRAMEBUFFER_BARRIER_BIT | GL_TEXTURE_FETCH_BARRIER_BIT);
+	glBindImageTexture(g_FrameImageUnit, 0, 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_RGBA8);
+}
@@ -0,0 +1,107 @@
+///////////////////////////////////////////////////////////////////////////////
+// deferredshading.h
+// ============
+// light the opaque part of the frame from a G-buffer with a tiled compute
+// pass, so every light is only evaluated once per visible pixel it reaches
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "ComputeShader.h"
+#include "RenderTargetManager.h"
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+
+#include <vector>
+
+/***********************************************************
+ *  DeferredShading
+ *
+ *  This class owns a compact G-buffer, with the albedo and
+ *  the material index in one RGBA8 texture and the normal
+ *  folded onto an octahedron in one RG16 texture, sharing
+ *  the depth buffer of the frame. Once the opaque draws have
+ *  been drawn into it, a compute shader splits the frame into
+ *  16x16 pixel tiles, finds the lights whose range reaches
+ *  the depth range of each tile, and lights the pixels of the
+ *  tile with only those lights, writing the result straight
+ *  into the color of the frame. The transparent draws are
+ *  drawn forward on top afterwards.
+ ***********************************************************/
+class DeferredShading
+{
+public:
+	// constructor
+	DeferredShading(RenderTargetManager* pRenderTargets);
+	// destructor
+	~DeferredShading();
+
+	// storage buffer binding points used by the light shader, the
+	// materials are the ones of the static batch
+	static const GLuint MATERIAL_BINDING = 1;
+	static const GLuint LIGHT_BINDING = 2;
+	// texture units the G-buffer is bound to while it is lit, past
+	// the units used by the other passes
+	static const GLuint DEPTH_TEXTURE_UNIT = 20;
+	static const GLuint ALBEDO_TEXTURE_UNIT = 21;
+	static const GLuint NORMAL_TEXTURE_UNIT = 22;
+	// the material index is stored in 8 bits
+	static const int MAX_MATERIALS = 256;
+
+	// one light, laid out to match the std430 Light struct in the
+	// light shader
+	struct LIGHT_DATA
+	{
+		// w holds the range, 0 when the light reaches everything
+		glm::vec4 positionRange;
+		// w holds the focal strength
+		glm::vec4 diffuseColor;
+		// w holds the specular intensity
+		glm::vec4 specularColor;
+	};
+
+	// load the light compute shader and add the G-buffer targets
+	bool Initialize(const char* lightComputeShaderPath);
+	// free the shader, the buffers and give the G-buffer back
+	void Destroy();
+	// true when the light shader was loaded
+	bool IsInitialized() const { return m_pComputeShader != NULL; }
+
+	// upload the lights and the ambient color every light adds
+	void SetLights(const std::vector<LIGHT_DATA>& lights, const glm::vec3& globalAmbientColor);
+
+	// bind the G-buffer, sharing the depth texture of the frame
+	// and its object IDs when it has them, false when it cannot
+	// be drawn into
+	bool BeginGeometryPass(GLuint depthTexture, GLuint objectIDTexture = 0);
+	// light the G-buffer into the color texture of the frame,
+	// only inside the rectangle being redrawn, given as its min
+	// corner and the max corner past the last pixel
+	void ShadeLights(
+		GLuint colorTexture,
+		GLuint depthTexture,
+		const glm::ivec2& renderSize,
+		const glm::ivec4& shadeRect,
+		const glm::mat4& view,
+		const glm::mat4& projection,
+		const glm::vec3& viewPosition,
+		GLuint materialBuffer);
+
+private:
+	// pointer to the owner of the G-buffer textures
+	RenderTargetManager* m_pRenderTargets;
+	int m_albedoTarget;
+	int m_normalTarget;
+	// framebuffer of the G-buffer, and what is attached to it
+	GLuint m_framebuffer;
+	unsigned int m_targetGeneration;
+	GLuint m_attachedDepthTexture;
+	GLuint m_attachedObjectIDTexture;
+	// the compiled light compute shader
+	ComputeShader* m_pComputeShader;
+	// lights read by the light shader
+	GLuint m_lightBuffer;
+	int m_lightCount;
+	glm::vec3 m_globalAmbientColor;
+};
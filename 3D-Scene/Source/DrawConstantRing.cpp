@@ -0,0 +1,247 @@
+///////////////////////////////////////////////////////////////////////////////
+// drawconstantring.cpp
+// ============
+// stream the per-draw constants of the forward shaders through a persistently
+// mapped uniform buffer, split into one region per frame in flight
+///////////////////////////////////////////////////////////////////////////////
+
+#include "DrawConstantRing.h"
+
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+
+// declaration of the global variables and defines
+namespace
+{
+	// nanoseconds a fence wait lasts before it is tried again
+	const GLuint64 g_FenceWaitTimeout = 1000000;
+}
+
+/***********************************************************
+ *  DrawConstantRing()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+DrawConstantRing::DrawConstantRing()
+{
+	m_buffer = 0;
+	m_pMappedData = NULL;
+	m_slotSize = 0;
+	m_drawsPerRegion = 0;
+	m_region = 0;
+	m_drawIndex = 0;
+	for (int i = 0; i < REGION_COUNT; i++)
+	{
+		m_fences[i] = 0;
+	}
+}
+
+/***********************************************************
+ *  ~DrawConstantRing()
+ *
+ *  The destructor for the class
+ ***********************************************************/
+DrawConstantRing::~DrawConstantRing()
+{
+	Destroy();
+}
+
+/***********************************************************
+ *  Initialize()
+ *
+ *  This method is used for creating the buffer with a
+ *  region of the passed in number of draws for each frame
+ *  in flight.
+ ***********************************************************/
+void DrawConstantRing::Initialize(int drawsPerFrame)
+{
+	Destroy();
+
+	GLint alignment = 256;
+	glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment);
+	alignment = std::max(alignment, 1);
+	m_slotSize = ((GLsizeiptr)sizeof(DRAW_CONSTANTS) + alignment - 1) / alignment * alignment;
+
+	CreateBuffer(std::max(drawsPerFrame, 1));
+	if (!IsPersistent())
+	{
+		std::cout << "Buffer storage is not available, uploading the draw constants per draw" << std::endl;
+	}
+}
+
+/***********************************************************
+ *  Destroy()
+ *
+ *  This method is used for unmapping and freeing the buffer
+ *  and the fences.
+ ***********************************************************/
+void DrawConstantRing::Destroy()
+{
+	for (int i = 0; i < REGION_COUNT; i++)
+	{
+		if (m_fences[i] != 0)
+		{
+			glDeleteSync(m_fences[i]);
+			m_fences[i] = 0;
+		}
+	}
+
+	if (m_buffer != 0)
+	{
+		if (NULL != m_pMappedData)
+		{
+			glBindBuffer(GL_UNIFORM_BUFFER, m_buffer);
+			glUnmapBuffer(GL_UNIFORM_BUFFER);
+			glBindBuffer(GL_UNIFORM_BUFFER, 0);
+			m_pMappedData = NULL;
+		}
+		glDeleteBuffers(1, &m_buffer);
+		m_buffer = 0;
+	}
+	m_drawsPerRegion = 0;
+	m_drawIndex = 0;
+}
+
+/***********************************************************
+ *  CreateBuffer()
+ *
+ *  This method is used for creating the buffer. With buffer
+ *  storage it holds every region and is mapped once, write
+ *  only and coherent, so the writes reach the GPU without
+ *  any flush. Without it the buffer holds a single slot.
+ ***********************************************************/
+void DrawConstantRing::CreateBuffer(int drawsPerRegion)
+{
+	glGenBuffers(1, &m_buffer);
+	glBindBuffer(GL_UNIFORM_BUFFER, m_buffer);
+
+	if (GLEW_VERSION_4_4 || GLEW_ARB_buffer_storage)
+	{
+		GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+		GLsizeiptr size = m_slotSize * drawsPerRegion * REGION_COUNT;
+		glBufferStorage(GL_UNIFORM_BUFFER, size, NULL, flags);
+		m_pMappedData = (unsigned char*)glMapBufferRange(GL_UNIFORM_BUFFER, 0, size, flags);
+	}
+	if (NULL == m_pMappedData)
+	{
+		glBufferData(GL_UNIFORM_BUFFER, m_slotSize, NULL, GL_STREAM_DRAW);
+	}
+
+	glBindBuffer(GL_UNIFORM_BUFFER, 0);
+	m_drawsPerRegion = drawsPerRegion;
+}
+
+/***********************************************************
+ *  WaitForRegion()
+ *
+ *  This method is used for waiting until the GPU has read
+ *  every draw of the last frame written into a region. The
+ *  first wait flushes the commands, so the fence is sure to
+ *  be reached.
+ ***********************************************************/
+void DrawConstantRing::WaitForRegion(int region)
+{
+	if (m_fences[region] == 0)
+	{
+		return;
+	}
+
+	GLbitfield flags = GL_SYNC_FLUSH_COMMANDS_BIT;
+	while (true)
+	{
+		GLenum result = glClientWaitSync(m_fences[region], flags, g_FenceWaitTimeout);
+		if ((result == GL_ALREADY_SIGNALED) || (result == GL_CONDITION_SATISFIED) || (result == GL_WAIT_FAILED))
+		{
+			break;
+		}
+		flags = 0;
+	}
+
+	glDeleteSync(m_fences[region]);
+	m_fences[region] = 0;
+}
+
+/***********************************************************
+ *  BeginFrame()
+ *
+ *  This method is used for moving on to the next region,
+ *  once the GPU has read the frame written into it three
+ *  frames ago.
+ ***********************************************************/
+void DrawConstantRing::BeginFrame()
+{
+	m_region = (m_region + 1) % REGION_COUNT;
+	m_drawIndex = 0;
+	if (IsPersistent())
+	{
+		WaitForRegion(m_region);
+	}
+}
+
+/***********************************************************
+ *  EndFrame()
+ *
+ *  This method is used for placing the fence that tells
+ *  when the GPU is done with the draws of the frame.
+ ***********************************************************/
+void DrawConstantRing::EndFrame()
+{
+	if (!IsPersistent())
+	{
+		return;
+	}
+
+	if (m_fences[m_region] != 0)
+	{
+		glDeleteSync(m_fences[m_region]);
+	}
+	m_fences[m_region] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+}
+
+/***********************************************************
+ *  Submit()
+ *
+ *  This method is used for writing the values of the next
+ *  draw into its slot and binding the slot to the block.
+ *  When the region is full, the buffer is replaced by one
+ *  twice the size. The old buffer is deleted right away,
+ *  OpenGL keeps it alive until the draws using it are done,
+ *  and the new one is not read by any of them, so nothing
+ *  has to wait.
+ ***********************************************************/
+void DrawConstantRing::Submit(const DRAW_CONSTANTS& constants)
+{
+	if (m_buffer == 0)
+	{
+		return;
+	}
+
+	if (!IsPersistent())
+	{
+		glBindBuffer(GL_UNIFORM_BUFFER, m_buffer);
+		glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(DRAW_CONSTANTS), &constants);
+		glBindBuffer(GL_UNIFORM_BUFFER, 0);
+		glBindBufferBase(GL_UNIFORM_BUFFER, DRAW_CONSTANTS_BINDING, m_buffer);
+		return;
+	}
+
+	if (m_drawIndex >= m_drawsPerRegion)
+	{
+		int drawsPerRegion = m_drawsPerRegion * 2;
+		Destroy();
+		CreateBuffer(drawsPerRegion);
+		m_region = 0;
+		std::cout << "Draw constant ring grown to " << drawsPerRegion << " draws per frame" << std::endl;
+		if (!IsPersistent())
+		{
+			Submit(constants);
+			return;
+		}
+	}
+
+	GLintptr offset = m_slotSize * (m_region * m_drawsPerRegion + m_drawIndex);
+	memcpy(m_pMappedData + offset, &constants, sizeof(DRAW_CONSTANTS));
+	glBindBufferRange(GL_UNIFORM_BUFFER, DRAW_CONSTANTS_BINDING, m_buffer, offset, sizeof(DRAW_CONSTANTS));
+	m_drawIndex++;
+}
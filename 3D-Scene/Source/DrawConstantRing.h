@@ -0,0 +1,98 @@
+///////////////////////////////////////////////////////////////////////////////
+// drawconstantring.h
+// ============
+// stream the per-draw constants of the forward shaders through a persistently
+// mapped uniform buffer, split into one region per frame in flight
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+
+/***********************************************************
+ *  DrawConstantRing
+ *
+ *  This class holds the model matrix, color, material and
+ *  texture values of every draw of a frame in one uniform
+ *  buffer that stays mapped for as long as it exists. The
+ *  buffer is split into three regions, one for the frame
+ *  being written and two for the frames the GPU may still
+ *  be reading. Every draw writes its values to the next
+ *  aligned slot of the region and binds that slot, so a
+ *  draw costs a memory copy and one binding instead of a
+ *  uniform call per value. A fence placed after each frame
+ *  tells when the GPU is done with its region, and the CPU
+ *  only waits on it when it has run three frames ahead.
+ *  A region that fills up is replaced with a larger buffer
+ *  on the spot. Without buffer storage every draw uploads
+ *  its values into a single slot instead.
+ ***********************************************************/
+class DrawConstantRing
+{
+public:
+	// constructor
+	DrawConstantRing();
+	// destructor
+	~DrawConstantRing();
+
+	// uniform block binding of the DrawConstants block in the
+	// forward shaders
+	static const GLuint DRAW_CONSTANTS_BINDING = 2;
+
+	// per-draw values, laid out to match the std140 DrawConstants
+	// block in the forward shaders
+	struct DRAW_CONSTANTS
+	{
+		glm::mat4 model;
+		glm::vec4 color;
+		// the shininess is stored in the w component
+		glm::vec4 diffuseColor;
+		glm::vec4 specularColor;
+		glm::vec2 uvScale;
+		GLint bUseTexture;
+		GLint textureSlot;
+		// scene object written into the object ID buffer, 0 when
+		// the draw belongs to none
+		GLint objectID;
+		GLint padding[3];
+	};
+
+	// create the buffer with room for the passed in number of
+	// draws in every frame
+	void Initialize(int drawsPerFrame);
+	// unmap and free the buffer
+	void Destroy();
+
+	// start writing the draws of a new frame into the next region
+	void BeginFrame();
+	// fence the region of the frame once its draws are submitted
+	void EndFrame();
+	// write the values of the next draw and bind them
+	void Submit(const DRAW_CONSTANTS& constants);
+
+	// true when the buffer is persistently mapped
+	bool IsPersistent() const { return m_pMappedData != NULL; }
+
+private:
+	// number of frames written or read at the same time
+	static const int REGION_COUNT = 3;
+
+	GLuint m_buffer;
+	// pointer to the whole mapped buffer
+	unsigned char* m_pMappedData;
+	// bytes between two draws, the constants rounded up to the
+	// uniform buffer offset alignment
+	GLsizeiptr m_slotSize;
+	int m_drawsPerRegion;
+	// region being written and the next draw within it
+	int m_region;
+	int m_drawIndex;
+	// fence after the last frame written into each region
+	GLsync m_fences[REGION_COUNT];
+
+	// create the buffer and map it when buffer storage is there
+	void CreateBuffer(int drawsPerRegion);
+	// wait until the GPU is done reading a region
+	void WaitForRegion(int region);
+};
@@ -0,0 +1,348 @@
+///////////////////////////////////////////////////////////////////////////////
+// dynamicresolution.cpp
+// ============
+// scale the resolution the frames are drawn at from the measured GPU time,
+// and scale the frames back up to the window with a sharpening pass
+///////////////////////////////////////////////////////////////////////////////
+
+#include "DynamicResolution.h"
+#include "GLStateCache.h"
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+
+// declaration of the global variables and defines
+namespace
+{
+	// the scale changes in steps of this size, down to the
+	// minimum number of steps
+	const float g_ScaleStep = 0.05f;
+	const int g_MinScaleSteps = 10;
+	const int g_MaxScaleSteps = 20;
+	// GPU time the frames should fit in when none is given
+	const double g_DefaultTargetFrameTime = 0.014;
+	// frames averaged before the scale can change again
+	const int g_SamplesPerChange = 8;
+	// weight of a new frame in the averaged time
+	const double g_AverageWeight = 0.2;
+	// the scale is only raised when the frames take less than
+	// this fraction of the target, and then aims a bit below it
+	const double g_RaiseThreshold = 0.7;
+	const double g_RaiseTarget = 0.85;
+	// strength of the sharpening at the lowest scale
+	const float g_MaxSharpness = 0.25f;
+}
+
+/***********************************************************
+ *  DynamicResolution()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+DynamicResolution::DynamicResolution()
+{
+	m_bEnabled = true;
+	m_targetFrameTime = g_DefaultTargetFrameTime;
+	m_scaleSteps = g_MaxScaleSteps;
+	m_averageFrameTime = 0.0;
+	m_sampleCount = 0;
+	for (int i = 0; i < QUERY_COUNT; i++)
+	{
+		m_queries[i] = 0;
+		m_queryScaleSteps[i] = 0;
+		m_bQueryPending[i] = false;
+	}
+	m_nextQuery = 0;
+	m_bTiming = false;
+	m_pUpscaleShaderManager = NULL;
+	m_vao = 0;
+}
+
+/***********************************************************
+ *  ~DynamicResolution()
+ *
+ *  The destructor for the class
+ ***********************************************************/
+DynamicResolution::~DynamicResolution()
+{
+	Destroy();
+}
+
+/***********************************************************
+ *  Initialize()
+ *
+ *  This method is used for creating the timer queries and
+ *  loading the shaders of the upscaling pass. Without the
+ *  shaders the frames are still scaled up, with a plain
+ *  bilinear copy.
+ ***********************************************************/
+bool DynamicResolution::Initialize(const char* vertexShaderPath, const char* fragmentShaderPath)
+{
+	glGenQueries(QUERY_COUNT, m_queries);
+
+	m_pUpscaleShaderManager = new ShaderManager();
+	if (m_pUpscaleShaderManager->LoadShaders(vertexShaderPath, fragmentShaderPath) == 0)
+	{
+		std::cout << "Upscaling shaders did not load, using a bilinear copy" << std::endl;
+		delete m_pUpscaleShaderManager;
+		m_pUpscaleShaderManager = NULL;
+		return(false);
+	}
+
+	// the pass makes its triangle from the vertex index alone,
+	// but a core profile still needs a vertex array bound
+	glGenVertexArrays(1, &m_vao);
+
+	return(true);
+}
+
+/***********************************************************
+ *  Destroy()
+ *
+ *  This method is used for freeing the queries and the
+ *  upscaling shaders.
+ ***********************************************************/
+void DynamicResolution::Destroy()
+{
+	if (m_queries[0] != 0)
+	{
+		glDeleteQueries(QUERY_COUNT, m_queries);
+		for (int i = 0; i < QUERY_COUNT; i++)
+		{
+			m_queries[i] = 0;
+			m_bQueryPending[i] = false;
+		}
+	}
+	if (m_vao != 0)
+	{
+		GLStateCache::BindVertexArray(0);
+		glDeleteVertexArrays(1, &m_vao);
+		m_vao = 0;
+	}
+	if (NULL != m_pUpscaleShaderManager)
+	{
+		GLStateCache::ForgetProgram(m_pUpscaleShaderManager->m_programID);
+		delete m_pUpscaleShaderManager;
+		m_pUpscaleShaderManager = NULL;
+	}
+}
+
+/***********************************************************
+ *  SetEnabled()
+ *
+ *  This method is used for turning the resolution scaling
+ *  on or off.
+ ***********************************************************/
+void DynamicResolution::SetEnabled(bool bEnabled)
+{
+	m_bEnabled = bEnabled;
+	m_scaleSteps = g_MaxScaleSteps;
+	m_sampleCount = 0;
+}
+
+/***********************************************************
+ *  SetTargetFrameTime()
+ *
+ *  This method is used for setting the GPU time in
+ *  milliseconds each frame should fit in.
+ ***********************************************************/
+void DynamicResolution::SetTargetFrameTime(double milliseconds)
+{
+	if (milliseconds > 0.0)
+	{
+		m_targetFrameTime = milliseconds / 1000.0;
+	}
+}
+
+/***********************************************************
+ *  GetScale()
+ *
+ *  This method is used for getting the fraction of the
+ *  window size the frames are drawn at.
+ ***********************************************************/
+float DynamicResolution::GetScale() const
+{
+	return(m_bEnabled ? m_scaleSteps * g_ScaleStep : 1.0f);
+}
+
+/***********************************************************
+ *  BeginTiming()
+ *
+ *  This method is used for starting to measure a frame.
+ *  When every query is still waiting for its result the
+ *  frame is not measured.
+ ***********************************************************/
+void DynamicResolution::BeginTiming()
+{
+	if (!m_bEnabled || (m_queries[0] == 0))
+	{
+		return;
+	}
+
+	ReadTimings();
+	if (m_bQueryPending[m_nextQuery])
+	{
+		return;
+	}
+
+	glBeginQuery(GL_TIME_ELAPSED, m_queries[m_nextQuery]);
+	m_queryScaleSteps[m_nextQuery] = m_scaleSteps;
+	m_bTiming = true;
+}
+
+/***********************************************************
+ *  EndTiming()
+ *
+ *  This method is used for ending the measured frame. Its
+ *  result is read in a later frame, once the GPU is done.
+ ***********************************************************/
+void DynamicResolution::EndTiming()
+{
+	if (!m_bTiming)
+	{
+		return;
+	}
+
+	glEndQuery(GL_TIME_ELAPSED);
+	m_bQueryPending[m_nextQuery] = true;
+	m_nextQuery = (m_nextQuery + 1) % QUERY_COUNT;
+	m_bTiming = false;
+}
+
+/***********************************************************
+ *  ReadTimings()
+ *
+ *  This method is used for reading the queries whose result
+ *  is ready, oldest first, without waiting on the others.
+ ***********************************************************/
+void DynamicResolution::ReadTimings()
+{
+	for (int i = 0; i < QUERY_COUNT; i++)
+	{
+		int query = (m_nextQuery + i) % QUERY_COUNT;
+		if (!m_bQueryPending[query])
+		{
+			continue;
+		}
+
+		GLint bAvailable = GL_FALSE;
+		glGetQueryObjectiv(m_queries[query], GL_QUERY_RESULT_AVAILABLE, &bAvailable);
+		if (bAvailable == GL_FALSE)
+		{
+			break;
+		}
+
+		GLuint64 elapsed = 0;
+		glGetQueryObjectui64v(m_queries[query], GL_QUERY_RESULT, &elapsed);
+		m_bQueryPending[query] = false;
+
+		// a frame drawn before the last change says nothing about
+		// the current scale
+		if (m_queryScaleSteps[query] == m_scaleSteps)
+		{
+			AddFrameTime((double)elapsed * 1.0e-9);
+		}
+	}
+}
+
+/***********************************************************
+ *  AddFrameTime()
+ *
+ *  This method is used for averaging the measured GPU time
+ *  and changing the scale once enough frames were measured.
+ *  The number of pixels goes with the square of the scale,
+ *  so the scale moves by the square root of the ratio
+ *  between the target and the measured time.
+ ***********************************************************/
+void DynamicResolution::AddFrameTime(double frameTime)
+{
+	if (m_sampleCount == 0)
+	{
+		m_averageFrameTime = frameTime;
+	}
+	else
+	{
+		m_averageFrameTime += (frameTime - m_averageFrameTime) * g_AverageWeight;
+	}
+	m_sampleCount++;
+
+	if ((m_sampleCount < g_SamplesPerChange) || (m_averageFrameTime <= 0.0))
+	{
+		return;
+	}
+
+	// the scale is kept while the frames fit the budget
+	double stepRatio = 1.0;
+	if (m_averageFrameTime > m_targetFrameTime)
+	{
+		stepRatio = std::sqrt(m_targetFrameTime / m_averageFrameTime);
+	}
+	else if (m_averageFrameTime < m_targetFrameTime * g_RaiseThreshold)
+	{
+		stepRatio = std::sqrt(m_targetFrameTime * g_RaiseTarget / m_averageFrameTime);
+	}
+	else
+	{
+		return;
+	}
+
+	// the steps are scaled in whole numbers, the small bias
+	// keeps a ratio that lands on a step from rounding under it
+	double desiredSteps = m_scaleSteps * stepRatio;
+	int scaleSteps = std::max(g_MinScaleSteps, std::min(g_MaxScaleSteps, (int)std::floor(desiredSteps + 1.0e-6)));
+	if (scaleSteps != m_scaleSteps)
+	{
+		m_scaleSteps = scaleSteps;
+		m_sampleCount = 0;
+	}
+}
+
+/***********************************************************
+ *  Present()
+ *
+ *  This method is used for scaling the frame up into the
+ *  back buffer. A full size frame, or one without the
+ *  upscaling shaders, is copied by the frame cache. The
+ *  sharpening gets stronger the lower the scale is.
+ ***********************************************************/
+void DynamicResolution::Present(FrameCache* pFrameCache)
+{
+	glm::ivec2 size = pFrameCache->GetSize();
+	glm::ivec2 renderSize = pFrameCache->GetRenderSize();
+	if ((NULL == m_pUpscaleShaderManager) || (renderSize == size))
+	{
+		pFrameCache->Present();
+		return;
+	}
+
+	// the pass draws over the whole window and must leave the
+	// state the scene relies on as it found it, which the state
+	// cache knows without asking the driver
+	GLuint previousProgram = GLStateCache::GetProgram();
+	bool bBlend = GLStateCache::IsEnabled(GL_BLEND);
+
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	glViewport(0, 0, size.x, size.y);
+	GLStateCache::Disable(GL_DEPTH_TEST);
+	GLStateCache::Disable(GL_BLEND);
+
+	// the unit is only used by this pass, so the frame can stay
+	// bound to it
+	GLStateCache::BindTexture(FRAME_TEXTURE_UNIT, GL_TEXTURE_2D, pFrameCache->GetColorTexture());
+
+	float scale = (float)renderSize.x / (float)size.x;
+	GLStateCache::UseProgram(m_pUpscaleShaderManager);
+	GLStateCache::SetInt(m_pUpscaleShaderManager, "frameTexture", FRAME_TEXTURE_UNIT);
+	GLStateCache::SetVec2(m_pUpscaleShaderManager, "renderScale", glm::vec2(renderSize) / glm::vec2(size));
+	GLStateCache::SetVec2(m_pUpscaleShaderManager, "texelSize", glm::vec2(1.0f) / glm::vec2(size));
+	GLStateCache::SetFloat(m_pUpscaleShaderManager, "sharpness", g_MaxSharpness * (1.0f - scale) / (1.0f - g_MinScaleSteps * g_ScaleStep));
+
+	GLStateCache::BindVertexArray(m_vao);
+	glDrawArrays(GL_TRIANGLES, 0, 3);
+
+	GLStateCache::SetEnabled(GL_BLEND, bBlend);
+	if (previousProgram != 0)
+	{
+		GLStateCache::UseProgram(previousProgram);
+	}
+}
@@ -0,0 +1,90 @@
+///////////////////////////////////////////////////////////////////////////////
+// dynamicresolution.h
+// ============
+// scale the resolution the frames are drawn at from the measured GPU time,
+// and scale the frames back up to the window with a sharpening pass
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "FrameCache.h"
+#include "ShaderManager.h"
+
+#include <GL/glew.h>
+
+/***********************************************************
+ *  DynamicResolution
+ *
+ *  This class measures how long the GPU takes to draw each
+ *  full frame with timer queries, which are read a few frames
+ *  later so the CPU never waits on them. When the frames take
+ *  longer than the target the resolution is lowered, and when
+ *  there is room again it is raised, in steps and only after
+ *  the measured time has settled, so the scale does not keep
+ *  changing around the target. A frame drawn at a lower
+ *  resolution is scaled up to the window with a sharpening
+ *  pass that restores some of the lost detail.
+ ***********************************************************/
+class DynamicResolution
+{
+public:
+	// constructor
+	DynamicResolution();
+	// destructor
+	~DynamicResolution();
+
+	// texture unit the frame is bound to while it is scaled up,
+	// past the units used by the scene textures and the Hi-Z pyramid
+	static const GLuint FRAME_TEXTURE_UNIT = 17;
+
+	// create the timer queries and load the upscaling shaders
+	bool Initialize(const char* vertexShaderPath, const char* fragmentShaderPath);
+	// free the queries and the upscaling shaders
+	void Destroy();
+
+	// turn the scaling on or off, the scale is 1 while it is off
+	void SetEnabled(bool bEnabled);
+	// GPU time in milliseconds each frame should fit in
+	void SetTargetFrameTime(double milliseconds);
+
+	// measure the GPU time of the draws between these calls
+	void BeginTiming();
+	void EndTiming();
+
+	// get the fraction of the window size to draw at
+	float GetScale() const;
+
+	// scale the frame up into the back buffer of the window
+	void Present(FrameCache* pFrameCache);
+
+private:
+	// number of frames that can be measured at once
+	static const int QUERY_COUNT = 4;
+
+	bool m_bEnabled;
+	// seconds each frame should fit in
+	double m_targetFrameTime;
+	// current scale, in steps of the scale step
+	int m_scaleSteps;
+	// averaged GPU time at the current scale, and how many
+	// frames it is averaged over
+	double m_averageFrameTime;
+	int m_sampleCount;
+
+	// timer queries, the scale each was measured at, and which
+	// ones still wait for their result
+	GLuint m_queries[QUERY_COUNT];
+	int m_queryScaleSteps[QUERY_COUNT];
+	bool m_bQueryPending[QUERY_COUNT];
+	int m_nextQuery;
+	bool m_bTiming;
+
+	// shaders and the empty vertex array of the upscaling pass
+	ShaderManager* m_pUpscaleShaderManager;
+	GLuint m_vao;
+
+	// read the results of the finished queries
+	void ReadTimings();
+	// add a measured GPU time and change the scale when due
+	void AddFrameTime(double frameTime);
+};
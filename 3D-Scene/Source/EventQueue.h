@@ -0,0 +1,69 @@
+///////////////////////////////////////////////////////////////////////////////
+// eventqueue.h
+// ============
+// pass events from one thread to another through a fixed size ring without
+// locks
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+
+/***********************************************************
+ *  EventQueue
+ *
+ *  This class is a ring of events with one thread pushing
+ *  and one thread popping. Each side only writes its own
+ *  index, and the other side reads it with acquire ordering,
+ *  so an event is complete before it can be popped. The
+ *  capacity must be a power of two.
+ ***********************************************************/
+template <typename T, size_t CAPACITY>
+class EventQueue
+{
+public:
+	// constructor
+	EventQueue()
+	{
+		m_head = 0;
+		m_tail = 0;
+	}
+
+	// add an event, false when the ring is full
+	bool Push(const T& event)
+	{
+		size_t tail = m_tail.load(std::memory_order_relaxed);
+		if (tail - m_head.load(std::memory_order_acquire) == CAPACITY)
+		{
+			return(false);
+		}
+
+		m_events[tail & (CAPACITY - 1)] = event;
+		m_tail.store(tail + 1, std::memory_order_release);
+		return(true);
+	}
+
+	// take the oldest event, false when the ring is empty
+	bool Pop(T& event)
+	{
+		size_t head = m_head.load(std::memory_order_relaxed);
+		if (head == m_tail.load(std::memory_order_acquire))
+		{
+			return(false);
+		}
+
+		event = m_events[head & (CAPACITY - 1)];
+		m_head.store(head + 1, std::memory_order_release);
+		return(true);
+	}
+
+private:
+	static_assert((CAPACITY & (CAPACITY - 1)) == 0, "the capacity must be a power of two");
+
+	T m_events[CAPACITY];
+	// count of popped and pushed events, kept on their own
+	// cache lines since each is written by another thread
+	alignas(64) std::atomic<size_t> m_head;
+	alignas(64) std::atomic<size_t> m_tail;
+};
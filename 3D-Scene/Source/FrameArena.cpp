@@ -0,0 +1,363 @@
+///////////////////////////////////////////////////////////////////////////////
+// framearena.cpp
+// ============
+// hand out the short lived memory of a frame from one block that is reset
+// at the start of every frame, and count the allocations reaching the heap
+///////////////////////////////////////////////////////////////////////////////
+
+#include "FrameArena.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <new>
+
+// declaration of the global variables and defines
+namespace
+{
+	// seconds between two printed reports
+	const double g_ReportInterval = 5.0;
+
+	// allocations made through operator new by every thread, the
+	// count is constant initialized so it is ready for the
+	// allocations made before main
+	std::atomic<long long> g_TotalAllocations(0);
+
+	// count when the frame started and counts of the last frame
+	// and since the last report
+	long long g_FrameStartAllocations = 0;
+	long long g_LastFrameAllocations = 0;
+	long long g_ReportAllocations = 0;
+	long long g_ReportMostAllocations = 0;
+	int g_ReportFrames = 0;
+	bool g_bReportStats = false;
+	std::chrono::steady_clock::time_point g_LastReportTime = std::chrono::steady_clock::now();
+
+	// round an address up to a power of two alignment
+	unsigned char* AlignPointer(unsigned char* pMemory, size_t alignment)
+	{
+		uintptr_t address = (uintptr_t)pMemory;
+		address = (address + alignment - 1) & ~(uintptr_t)(alignment - 1);
+		return((unsigned char*)address);
+	}
+
+#if COUNT_ALLOCATIONS
+	// take memory from the heap and count it
+	void* CountedAllocate(size_t size)
+	{
+		g_TotalAllocations.fetch_add(1, std::memory_order_relaxed);
+		return(malloc((size > 0) ? size : 1));
+	}
+
+	// take memory with a larger alignment than the heap gives
+	// from the heap and count it, it is freed with AlignedFree
+	void* CountedAlignedAllocate(size_t size, std::align_val_t alignment)
+	{
+		g_TotalAllocations.fetch_add(1, std::memory_order_relaxed);
+		size_t alignBytes = (size_t)alignment;
+		// the size has to be a multiple of the alignment
+		size = ((std::max(size, (size_t)1) + alignBytes - 1) / alignBytes) * alignBytes;
+#if defined(_MSC_VER)
+		return(_aligned_malloc(size, alignBytes));
+#else
+		return(aligned_alloc(alignBytes, size));
+#endif
+	}
+
+	void AlignedFree(void* pMemory)
+	{
+#if defined(_MSC_VER)
+		_aligned_free(pMemory);
+#else
+		free(pMemory);
+#endif
+	}
+#endif
+}
+
+#if COUNT_ALLOCATIONS
+/***********************************************************
+ *  operator new()
+ *
+ *  The global allocation functions are replaced so every
+ *  allocation of the program is counted on its way to the
+ *  heap, including the ones made inside the standard
+ *  containers and strings. The over-aligned allocations have
+ *  their own functions, which are counted the same.
+ ***********************************************************/
+void* operator new(size_t size)
+{
+	void* pMemory = CountedAllocate(size);
+	if (NULL == pMemory)
+	{
+		throw std::bad_alloc();
+	}
+	return(pMemory);
+}
+
+void* operator new[](size_t size)
+{
+	return(operator new(size));
+}
+
+void* operator new(size_t size, const std::nothrow_t&) noexcept
+{
+	return(CountedAllocate(size));
+}
+
+void* operator new[](size_t size, const std::nothrow_t&) noexcept
+{
+	return(CountedAllocate(size));
+}
+
+void operator delete(void* pMemory) noexcept
+{
+	free(pMemory);
+}
+
+void operator delete[](void* pMemory) noexcept
+{
+	free(pMemory);
+}
+
+void operator delete(void* pMemory, size_t) noexcept
+{
+	free(pMemory);
+}
+
+void operator delete[](void* pMemory, size_t) noexcept
+{
+	free(pMemory);
+}
+
+void operator delete(void* pMemory, const std::nothrow_t&) noexcept
+{
+	free(pMemory);
+}
+
+void operator delete[](void* pMemory, const std::nothrow_t&) noexcept
+{
+	free(pMemory);
+}
+
+void* operator new(size_t size, std::align_val_t alignment)
+{
+	void* pMemory = CountedAlignedAllocate(size, alignment);
+	if (NULL == pMemory)
+	{
+		throw std::bad_alloc();
+	}
+	return(pMemory);
+}
+
+void* operator new[](size_t size, std::align_val_t alignment)
+{
+	return(operator new(size, alignment));
+}
+
+void* operator new(size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept
+{
+	return(CountedAlignedAllocate(size, alignment));
+}
+
+void* operator new[](size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept
+{
+	return(CountedAlignedAllocate(size, alignment));
+}
+
+void operator delete(void* pMemory, std::align_val_t) noexcept
+{
+	AlignedFree(pMemory);
+}
+
+void operator delete[](void* pMemory, std::align_val_t) noexcept
+{
+	AlignedFree(pMemory);
+}
+
+void operator delete(void* pMemory, size_t, std::align_val_t) noexcept
+{
+	AlignedFree(pMemory);
+}
+
+void operator delete[](void* pMemory, size_t, std::align_val_t) noexcept
+{
+	AlignedFree(pMemory);
+}
+
+void operator delete(void* pMemory, std::align_val_t, const std::nothrow_t&) noexcept
+{
+	AlignedFree(pMemory);
+}
+
+void operator delete[](void* pMemory, std::align_val_t, const std::nothrow_t&) noexcept
+{
+	AlignedFree(pMemory);
+}
+#endif
+
+/***********************************************************
+ *  FrameArena()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+FrameArena::FrameArena(size_t capacity)
+{
+	m_capacity = std::max(capacity, (size_t)1);
+	m_pBlock = new unsigned char[m_capacity];
+	m_offset = 0;
+	m_usedBytes = 0;
+}
+
+/***********************************************************
+ *  ~FrameArena()
+ *
+ *  The destructor for the class
+ ***********************************************************/
+FrameArena::~FrameArena()
+{
+	for (size_t i = 0; i < m_overflowBlocks.size(); i++)
+	{
+		delete[] m_overflowBlocks[i];
+	}
+	m_overflowBlocks.clear();
+
+	delete[] m_pBlock;
+	m_pBlock = NULL;
+}
+
+/***********************************************************
+ *  Allocate()
+ *
+ *  This method is used for handing out the next aligned
+ *  piece of the block. The alignment must be a power of two.
+ *  When the block is full the memory comes from the heap
+ *  instead, and is counted towards the size of the block
+ *  the arena grows to at the next reset.
+ ***********************************************************/
+void* FrameArena::Allocate(size_t size, size_t alignment)
+{
+	unsigned char* pFree = m_pBlock + m_offset;
+	unsigned char* pMemory = AlignPointer(pFree, alignment);
+	size_t padding = (size_t)(pMemory - pFree);
+
+	if (m_offset + padding + size <= m_capacity)
+	{
+		m_offset += padding + size;
+		m_usedBytes += padding + size;
+		return(pMemory);
+	}
+
+	unsigned char* pOverflow = new unsigned char[size + alignment];
+	m_overflowBlocks.push_back(pOverflow);
+	m_usedBytes += size + alignment;
+	return(AlignPointer(pOverflow, alignment));
+}
+
+/***********************************************************
+ *  Reset()
+ *
+ *  This method is used for taking back all of the memory
+ *  handed out in the frame. When the frame did not fit into
+ *  the block, the block is replaced with one at least twice
+ *  as large until the whole frame fits.
+ ***********************************************************/
+void FrameArena::Reset()
+{
+	if (!m_overflowBlocks.empty())
+	{
+		for (size_t i = 0; i < m_overflowBlocks.size(); i++)
+		{
+			delete[] m_overflowBlocks[i];
+		}
+		m_overflowBlocks.clear();
+
+		size_t capacity = m_capacity;
+		while (capacity < m_usedBytes)
+		{
+			capacity *= 2;
+		}
+
+		delete[] m_pBlock;
+		m_pBlock = new unsigned char[capacity];
+		m_capacity = capacity;
+	}
+
+	m_offset = 0;
+	m_usedBytes = 0;
+}
+
+/***********************************************************
+ *  GetTotalAllocations()
+ *
+ *  This method is used for getting the number of heap
+ *  allocations made since the program started.
+ ***********************************************************/
+long long AllocationCounter::GetTotalAllocations()
+{
+	return(g_TotalAllocations.load(std::memory_order_relaxed));
+}
+
+/***********************************************************
+ *  EndFrame()
+ *
+ *  This method is used for closing the count of the frame,
+ *  and printing the average and the largest count per frame
+ *  since the last report when one is due. The printing
+ *  itself is not counted against the next frame.
+ ***********************************************************/
+void AllocationCounter::EndFrame()
+{
+	long long totalAllocations = GetTotalAllocations();
+	g_LastFrameAllocations = totalAllocations - g_FrameStartAllocations;
+	g_FrameStartAllocations = totalAllocations;
+	g_ReportAllocations += g_LastFrameAllocations;
+	g_ReportMostAllocations = std::max(g_ReportMostAllocations, g_LastFrameAllocations);
+	g_ReportFrames++;
+
+	std::chrono::steady_clock::time_point currentTime = std::chrono::steady_clock::now();
+	if (!g_bReportStats || (std::chrono::duration<double>(currentTime - g_LastReportTime).count() < g_ReportInterval))
+	{
+		return;
+	}
+
+	std::cout << "Heap allocations per frame over " << g_ReportFrames << " frames: "
+		<< "average " << (double)g_ReportAllocations / g_ReportFrames << ", "
+		<< "most " << g_ReportMostAllocations << std::endl;
+
+	g_LastReportTime = currentTime;
+	g_ReportAllocations = 0;
+	g_ReportMostAllocations = 0;
+	g_ReportFrames = 0;
+	g_FrameStartAllocations = GetTotalAllocations();
+}
+
+/***********************************************************
+ *  SetReportStats()
+ *
+ *  This method is used for turning the printed counts on
+ *  or off. A build without the counting has none to print.
+ ***********************************************************/
+void AllocationCounter::SetReportStats(bool bReportStats)
+{
+	if (bReportStats && !IsCounting())
+	{
+		std::cout << "Heap allocations are not counted in this build" << std::endl;
+		bReportStats = false;
+	}
+	g_bReportStats = bReportStats;
+}
+
+/***********************************************************
+ *  GetFrameAllocations()
+ *
+ *  This method is used for getting the number of heap
+ *  allocations made in the last finished frame.
+ ***********************************************************/
+long long AllocationCounter::GetFrameAllocations()
+{
+	return(g_LastFrameAllocations);
+}
@@ -0,0 +1,133 @@
+///////////////////////////////////////////////////////////////////////////////
+// framearena.h
+// ============
+// hand out the short lived memory of a frame from one block that is reset
+// at the start of every frame, and count the allocations reaching the heap
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+// the global allocation functions are only replaced, and the
+// heap allocations only counted, in a build defining this as 1
+#ifndef COUNT_ALLOCATIONS
+#define COUNT_ALLOCATIONS 0
+#endif
+
+/***********************************************************
+ *  FrameArena
+ *
+ *  This class hands out memory by moving an offset through
+ *  one block, and takes all of it back at once when it is
+ *  reset at the start of the next frame, so the draw lists
+ *  and scratch buffers of a frame cost no heap allocation.
+ *  A frame that needs more than the block holds gets the
+ *  rest from the heap, and the block is replaced with one
+ *  large enough for it at the next reset, so the arena
+ *  settles on the size the frames need. An arena is used
+ *  by one thread at a time, so every job thread gets its
+ *  own one.
+ ***********************************************************/
+class FrameArena
+{
+public:
+	// constructor
+	FrameArena(size_t capacity = DEFAULT_CAPACITY);
+	// destructor
+	~FrameArena();
+
+	// size of the block until a frame needs more
+	static const size_t DEFAULT_CAPACITY = 256 * 1024;
+
+	// get memory that stays valid until the next reset
+	void* Allocate(size_t size, size_t alignment);
+	template<typename T>
+	T* AllocateArray(size_t count) { return static_cast<T*>(Allocate(count * sizeof(T), alignof(T))); }
+	// take back everything handed out since the last reset
+	void Reset();
+
+	// bytes handed out since the last reset
+	size_t GetUsedBytes() const { return m_usedBytes; }
+	size_t GetCapacity() const { return m_capacity; }
+
+private:
+	unsigned char* m_pBlock;
+	size_t m_capacity;
+	// offset of the free part of the block
+	size_t m_offset;
+	// bytes handed out since the last reset, in the block or not
+	size_t m_usedBytes;
+	// memory taken from the heap because the block was full
+	std::vector<unsigned char*> m_overflowBlocks;
+};
+
+/***********************************************************
+ *  FrameAllocator
+ *
+ *  This class lets the standard containers take their
+ *  memory from a frame arena. Freeing does nothing, since
+ *  the arena takes everything back when it is reset, so a
+ *  container using it must not outlive the frame.
+ ***********************************************************/
+template<typename T>
+class FrameAllocator
+{
+public:
+	typedef T value_type;
+
+	FrameAllocator(FrameArena* pArena) : m_pArena(pArena) {}
+	template<typename U>
+	FrameAllocator(const FrameAllocator<U>& other) : m_pArena(other.GetArena()) {}
+
+	T* allocate(size_t count) { return m_pArena->AllocateArray<T>(count); }
+	void deallocate(T*, size_t) {}
+
+	FrameArena* GetArena() const { return m_pArena; }
+
+private:
+	FrameArena* m_pArena;
+};
+
+template<typename T, typename U>
+bool operator==(const FrameAllocator<T>& first, const FrameAllocator<U>& second)
+{
+	return(first.GetArena() == second.GetArena());
+}
+
+template<typename T, typename U>
+bool operator!=(const FrameAllocator<T>& first, const FrameAllocator<U>& second)
+{
+	return(first.GetArena() != second.GetArena());
+}
+
+// a vector of values living until the end of the frame
+template<typename T>
+using FrameVector = std::vector<T, FrameAllocator<T>>;
+
+/***********************************************************
+ *  AllocationCounter
+ *
+ *  This class counts every allocation made through the
+ *  global operator new, by any thread, and the ones made
+ *  in each frame. Once the scene is loaded and the arenas
+ *  and buffers have grown to their size, a frame should
+ *  make none at all. The counting replaces the allocation
+ *  functions of the whole program, so it is only built in
+ *  when COUNT_ALLOCATIONS is set, which the debug build does.
+ ***********************************************************/
+class AllocationCounter
+{
+public:
+	// true when the build counts the allocations
+	static bool IsCounting() { return COUNT_ALLOCATIONS != 0; }
+	// allocations made since the program started
+	static long long GetTotalAllocations();
+	// close the count of the frame and print the counts when due
+	static void EndFrame();
+	// print the counts every few seconds
+	static void SetReportStats(bool bReportStats);
+	// allocations made in the last finished frame
+	static long long GetFrameAllocations();
+};
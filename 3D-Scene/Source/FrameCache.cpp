@@ -0,0 +1,389 @@
+///////////////////////////////////////////////////////////////////////////////
+// framecache.cpp
+// ============
+// keep the last drawn frame offscreen so an unchanged scene can be shown
+// again without drawing it, and track the parts of it that have to be redrawn
+///////////////////////////////////////////////////////////////////////////////
+
+#include "FrameCache.h"
+#include "GLStateCache.h"
+
+#include <algorithm>
+#include <iostream>
+
+// declaration of the global variables and defines
+namespace
+{
+	// pixels added around a damaged rectangle, for the edges the
+	// rasterizer and the texture filtering reach past the bounds
+	const int g_DamagePadding = 2;
+}
+
+/***********************************************************
+ *  FrameCache()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+FrameCache::FrameCache(RenderTargetManager* pRenderTargets)
+{
+	m_pRenderTargets = pRenderTargets;
+	m_framebuffer = 0;
+	m_colorTexture = 0;
+	m_depthTexture = 0;
+	m_objectIDTexture = 0;
+	m_objectIDTarget = -1;
+	m_width = 0;
+	m_height = 0;
+	m_resolutionScale = 1.0f;
+	m_renderWidth = 0;
+	m_renderHeight = 0;
+	m_bFullDamage = true;
+	m_damageMin = glm::ivec2(0);
+	m_damageMax = glm::ivec2(0);
+
+	// the color is a texture so the upscaling can filter it, and
+	// the depth so the depth pyramid can be built from it
+	RenderTargetManager::RENDER_TARGET_DESC desc;
+	desc.internalFormat = GL_RGBA8;
+	desc.bTexture = true;
+	desc.bMipmapped = false;
+	desc.sizeScale = 1.0f;
+	desc.fixedWidth = 0;
+	desc.fixedHeight = 0;
+	m_colorTarget = m_pRenderTargets->AddTarget(desc);
+
+	desc.internalFormat = GL_DEPTH24_STENCIL8;
+	m_depthTarget = m_pRenderTargets->AddTarget(desc);
+
+	// nothing is attached yet
+	m_targetGeneration = m_pRenderTargets->GetGeneration() - 1;
+}
+
+/***********************************************************
+ *  ~FrameCache()
+ *
+ *  The destructor for the class
+ ***********************************************************/
+FrameCache::~FrameCache()
+{
+	Destroy();
+}
+
+/***********************************************************
+ *  UpdateTargets()
+ *
+ *  This method is used for attaching the color and depth
+ *  buffers to the offscreen framebuffer, the first time and
+ *  whenever the render target manager allocated them again
+ *  for a new window size. The buffers always have the full
+ *  size, so a change of the resolution scale only draws
+ *  into a different part of them.
+ ***********************************************************/
+void FrameCache::UpdateTargets()
+{
+	if (NULL == m_pRenderTargets)
+	{
+		return;
+	}
+	if ((m_targetGeneration == m_pRenderTargets->GetGeneration()) && (m_framebuffer != 0))
+	{
+		return;
+	}
+
+	// a minimized window has no buffers yet
+	GLuint colorTexture = m_pRenderTargets->GetTargetName(m_colorTarget);
+	GLuint depthTexture = m_pRenderTargets->GetTargetName(m_depthTarget);
+	if ((colorTexture == 0) || (depthTexture == 0))
+	{
+		return;
+	}
+
+	GLuint objectIDTexture = (m_objectIDTarget >= 0) ? m_pRenderTargets->GetTargetName(m_objectIDTarget) : 0;
+
+	m_targetGeneration = m_pRenderTargets->GetGeneration();
+	m_colorTexture = colorTexture;
+	m_depthTexture = depthTexture;
+	m_objectIDTexture = objectIDTexture;
+	glm::ivec2 size = m_pRenderTargets->GetTargetSize(m_colorTarget);
+	m_width = size.x;
+	m_height = size.y;
+	SetResolutionScale(m_resolutionScale);
+	Invalidate();
+
+	if (m_framebuffer == 0)
+	{
+		glGenFramebuffers(1, &m_framebuffer);
+	}
+	glBindFramebuffer(GL_FRAMEBUFFER, m_framebuffer);
+	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, colorTexture, 0);
+	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_TEXTURE_2D, depthTexture, 0);
+	if (objectIDTexture != 0)
+	{
+		// the shaders write the object IDs to their third output
+		glFramebufferTexture2D(GL_FRAMEBUFFER, OBJECT_ID_ATTACHMENT, GL_TEXTURE_2D, objectIDTexture, 0);
+		const GLenum drawBuffers[3] = { GL_COLOR_ATTACHMENT0, GL_NONE, OBJECT_ID_ATTACHMENT };
+		glDrawBuffers(3, drawBuffers);
+	}
+	if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+	{
+		std::cout << "Frame cache framebuffer is not complete" << std::endl;
+	}
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+}
+
+/***********************************************************
+ *  Destroy()
+ *
+ *  This method is used for freeing the offscreen framebuffer
+ *  and giving its buffers back to the render target manager.
+ ***********************************************************/
+void FrameCache::Destroy()
+{
+	if (m_framebuffer != 0)
+	{
+		glDeleteFramebuffers(1, &m_framebuffer);
+		m_framebuffer = 0;
+	}
+	if (NULL != m_pRenderTargets)
+	{
+		m_pRenderTargets->RemoveTarget(m_colorTarget);
+		m_pRenderTargets->RemoveTarget(m_depthTarget);
+		if (m_objectIDTarget >= 0)
+		{
+			m_pRenderTargets->RemoveTarget(m_objectIDTarget);
+			m_objectIDTarget = -1;
+		}
+		m_pRenderTargets = NULL;
+	}
+	m_colorTexture = 0;
+	m_depthTexture = 0;
+	m_objectIDTexture = 0;
+	m_width = 0;
+	m_height = 0;
+	m_renderWidth = 0;
+	m_renderHeight = 0;
+}
+
+/***********************************************************
+ *  SetResolutionScale()
+ *
+ *  This method is used for choosing the fraction of the
+ *  window size the frames are drawn at.
+ ***********************************************************/
+void FrameCache::SetResolutionScale(float scale)
+{
+	m_resolutionScale = glm::clamp(scale, 0.1f, 1.0f);
+
+	int renderWidth = std::max(1, (int)(m_width * m_resolutionScale + 0.5f));
+	int renderHeight = std::max(1, (int)(m_height * m_resolutionScale + 0.5f));
+	if ((renderWidth != m_renderWidth) || (renderHeight != m_renderHeight))
+	{
+		m_renderWidth = renderWidth;
+		m_renderHeight = renderHeight;
+		Invalidate();
+	}
+}
+
+/***********************************************************
+ *  Invalidate()
+ *
+ *  This method is used for marking the whole frame for
+ *  redrawing, for changes that move every pixel such as the
+ *  camera moving.
+ ***********************************************************/
+void FrameCache::Invalidate()
+{
+	m_bFullDamage = true;
+}
+
+/***********************************************************
+ *  AddDamage()
+ *
+ *  This method is used for growing the damaged rectangle by
+ *  the screen rectangle of a bounding sphere, found from the
+ *  corners of the box around it. A sphere reaching behind
+ *  the camera can cover any part of the screen, so it
+ *  damages the whole frame.
+ ***********************************************************/
+void FrameCache::AddDamage(const glm::vec4& bounds, const glm::mat4& viewProjection)
+{
+	if (m_bFullDamage)
+	{
+		return;
+	}
+
+	glm::vec2 screenMin(1.0f);
+	glm::vec2 screenMax(-1.0f);
+	for (int corner = 0; corner < 8; corner++)
+	{
+		glm::vec3 offset(
+			(corner & 1) ? bounds.w : -bounds.w,
+			(corner & 2) ? bounds.w : -bounds.w,
+			(corner & 4) ? bounds.w : -bounds.w);
+		glm::vec4 clip = viewProjection * glm::vec4(glm::vec3(bounds) + offset, 1.0f);
+		if (clip.w <= 0.0f)
+		{
+			Invalidate();
+			return;
+		}
+
+		glm::vec2 ndc = glm::vec2(clip.x, clip.y) / clip.w;
+		screenMin = glm::min(screenMin, ndc);
+		screenMax = glm::max(screenMax, ndc);
+	}
+
+	// off screen damage leaves the frame as it is
+	screenMin = glm::max(screenMin, glm::vec2(-1.0f));
+	screenMax = glm::min(screenMax, glm::vec2(1.0f));
+	if ((screenMin.x >= screenMax.x) || (screenMin.y >= screenMax.y))
+	{
+		return;
+	}
+
+	glm::vec2 size((float)m_renderWidth, (float)m_renderHeight);
+	glm::ivec2 pixelMin = glm::ivec2((screenMin * 0.5f + 0.5f) * size) - glm::ivec2(g_DamagePadding);
+	glm::ivec2 pixelMax = glm::ivec2((screenMax * 0.5f + 0.5f) * size) + glm::ivec2(g_DamagePadding + 1);
+	pixelMin = glm::max(pixelMin, glm::ivec2(0));
+	pixelMax = glm::min(pixelMax, glm::ivec2(m_renderWidth, m_renderHeight));
+
+	if (m_damageMax.x > m_damageMin.x)
+	{
+		m_damageMin = glm::min(m_damageMin, pixelMin);
+		m_damageMax = glm::max(m_damageMax, pixelMax);
+	}
+	else
+	{
+		m_damageMin = pixelMin;
+		m_damageMax = pixelMax;
+	}
+}
+
+/***********************************************************
+ *  BeginRedraw()
+ *
+ *  This method is used for drawing into the offscreen
+ *  buffers. Only the damaged rectangle is cleared, and the
+ *  scissor test keeps the draws that follow inside of it.
+ ***********************************************************/
+void FrameCache::BeginRedraw()
+{
+	glBindFramebuffer(GL_FRAMEBUFFER, m_framebuffer);
+	glViewport(0, 0, m_renderWidth, m_renderHeight);
+	if (!m_bFullDamage)
+	{
+		GLStateCache::Enable(GL_SCISSOR_TEST);
+		glScissor(m_damageMin.x, m_damageMin.y, m_damageMax.x - m_damageMin.x, m_damageMax.y - m_damageMin.y);
+	}
+
+	// Clear the frame and z buffers
+	ClearBuffers();
+}
+
+/***********************************************************
+ *  GetRedrawRect()
+ *
+ *  This method is used for getting the part of the frame
+ *  the scissor test keeps the redraw in, for the passes
+ *  that write the frame without going through it.
+ ***********************************************************/
+glm::ivec4 FrameCache::GetRedrawRect() const
+{
+	if (m_bFullDamage)
+	{
+		return(glm::ivec4(0, 0, m_renderWidth, m_renderHeight));
+	}
+
+	return(glm::ivec4(m_damageMin.x, m_damageMin.y, m_damageMax.x, m_damageMax.y));
+}
+
+/***********************************************************
+ *  ClearBuffers()
+ *
+ *  This method is used for clearing the buffers of the
+ *  frame inside the scissor rectangle, or all of them when
+ *  the scissor test is off. The object IDs are integers,
+ *  which glClear leaves undefined, so they are cleared to
+ *  no object on their own.
+ ***********************************************************/
+void FrameCache::ClearBuffers()
+{
+	if (m_objectIDTexture == 0)
+	{
+		GLStateCache::ClearColor(0.0f, 0.0f, 0.0f, 1.0f);
+		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+		return;
+	}
+
+	const GLfloat clearColor[4] = { 0.0f, 0.0f, 0.0f, 1.0f };
+	const GLuint clearObjectID[4] = { 0, 0, 0, 0 };
+	glClearBufferfv(GL_COLOR, 0, clearColor);
+	glClearBufferuiv(GL_COLOR, OBJECT_ID_DRAW_BUFFER, clearObjectID);
+	glClear(GL_DEPTH_BUFFER_BIT);
+}
+
+/***********************************************************
+ *  EnableObjectIDs()
+ *
+ *  This method is used for adding a buffer that the scene
+ *  shaders write the scene object of every pixel into. It
+ *  is attached with the other buffers before the next frame,
+ *  which is drawn whole.
+ ***********************************************************/
+void FrameCache::EnableObjectIDs()
+{
+	if ((NULL == m_pRenderTargets) || (m_objectIDTarget >= 0))
+	{
+		return;
+	}
+
+	// only read back a pixel at a time, never sampled
+	RenderTargetManager::RENDER_TARGET_DESC desc;
+	desc.internalFormat = GL_R32UI;
+	desc.bTexture = true;
+	desc.bMipmapped = false;
+	desc.sizeScale = 1.0f;
+	desc.fixedWidth = 0;
+	desc.fixedHeight = 0;
+	m_objectIDTarget = m_pRenderTargets->AddTarget(desc);
+
+	// attach it with the next update of the targets
+	m_targetGeneration = m_pRenderTargets->GetGeneration() - 1;
+}
+
+/***********************************************************
+ *  EndRedraw()
+ *
+ *  This method is used for ending the redraw and clearing
+ *  the damage.
+ ***********************************************************/
+void FrameCache::EndRedraw()
+{
+	GLStateCache::Disable(GL_SCISSOR_TEST);
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	glViewport(0, 0, m_width, m_height);
+
+	m_bFullDamage = false;
+	m_damageMin = glm::ivec2(0);
+	m_damageMax = glm::ivec2(0);
+}
+
+/***********************************************************
+ *  Present()
+ *
+ *  This method is used for copying the offscreen frame into
+ *  the back buffer of the window. A frame drawn at a lower
+ *  resolution is scaled up with bilinear filtering.
+ ***********************************************************/
+void FrameCache::Present()
+{
+	bool bScaled = (m_renderWidth != m_width) || (m_renderHeight != m_height);
+
+	glBindFramebuffer(GL_READ_FRAMEBUFFER, m_framebuffer);
+	glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
+	glBlitFramebuffer(
+		0, 0, m_renderWidth, m_renderHeight,
+		0, 0, m_width, m_height,
+		GL_COLOR_BUFFER_BIT,
+		bScaled ? GL_LINEAR : GL_NEAREST);
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+}
@@ -0,0 +1,117 @@
+///////////////////////////////////////////////////////////////////////////////
+// framecache.h
+// ============
+// keep the last drawn frame offscreen so an unchanged scene can be shown
+// again without drawing it, and track the parts of it that have to be redrawn
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "RenderTargetManager.h"
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+
+/***********************************************************
+ *  FrameCache
+ *
+ *  This class draws the frames into an offscreen color and
+ *  depth buffer and copies them to the window, so the last
+ *  frame is still there when the next one starts. While the
+ *  scene stays the same nothing is drawn at all, and the
+ *  copy is only presented again when the window has to be
+ *  repainted. A change to part of the scene marks the screen
+ *  rectangle it covers, and only that rectangle is cleared
+ *  and drawn again, with the scissor test. The frame can be
+ *  drawn into a smaller part of the buffers than the window
+ *  and scaled up when it is presented. The buffers belong to
+ *  the render target manager, which allocates them again
+ *  when the size of the window changes. For picking, an
+ *  object ID buffer can be drawn alongside the color, with
+ *  the scene object of every pixel.
+ ***********************************************************/
+class FrameCache
+{
+public:
+	// constructor
+	FrameCache(RenderTargetManager* pRenderTargets);
+	// destructor
+	~FrameCache();
+
+	// color attachment and draw buffer of the object IDs,
+	// matching the location of outObjectID in the shaders
+	static const GLenum OBJECT_ID_ATTACHMENT = GL_COLOR_ATTACHMENT2;
+	static const GLint OBJECT_ID_DRAW_BUFFER = 2;
+
+	// attach the buffers again after the render target manager
+	// allocated them for a new size, which redraws the whole frame
+	void UpdateTargets();
+	// free the offscreen framebuffer and give the buffers back
+	void Destroy();
+	// add the object ID buffer, drawn from the next frame on
+	void EnableObjectIDs();
+	// draw the frames at a fraction of the window size, which
+	// redraws the whole frame when it changed
+	void SetResolutionScale(float scale);
+
+	// mark the whole frame for redrawing
+	void Invalidate();
+	// mark the screen rectangle covered by a world space bounding
+	// sphere, w is its radius
+	void AddDamage(const glm::vec4& bounds, const glm::mat4& viewProjection);
+	// true when part of the frame has to be drawn again
+	bool IsDamaged() const { return m_bFullDamage || (m_damageMax.x > m_damageMin.x); }
+	// true when the whole frame has to be drawn again
+	bool IsFullyDamaged() const { return m_bFullDamage; }
+	// get the pixel rectangle being redrawn, as the min corner
+	// and the max corner past the last pixel
+	glm::ivec4 GetRedrawRect() const;
+
+	// start drawing the damaged part into the offscreen buffers
+	void BeginRedraw();
+	// clear the color, the depth and the object IDs inside the
+	// scissor rectangle
+	void ClearBuffers();
+	// stop drawing and forget the damage
+	void EndRedraw();
+	// copy the offscreen frame to the window, scaling it up
+	void Present();
+
+	// get the offscreen framebuffer, for binding it again after
+	// drawing into another one in the middle of the frame
+	GLuint GetFramebuffer() const { return m_framebuffer; }
+	// get the textures holding the frame and its depth, the size
+	// of the whole texture and of the part the frame is drawn into
+	GLuint GetColorTexture() const { return m_colorTexture; }
+	GLuint GetDepthTexture() const { return m_depthTexture; }
+	// get the texture holding the object IDs, 0 when there is none
+	GLuint GetObjectIDTexture() const { return m_objectIDTexture; }
+	glm::ivec2 GetSize() const { return glm::ivec2(m_width, m_height); }
+	glm::ivec2 GetRenderSize() const { return glm::ivec2(m_renderWidth, m_renderHeight); }
+
+private:
+	// manager owning the color and depth buffers, and the
+	// generation of its buffers the framebuffer has attached
+	RenderTargetManager* m_pRenderTargets;
+	int m_colorTarget;
+	int m_depthTarget;
+	int m_objectIDTarget;
+	unsigned int m_targetGeneration;
+	// offscreen framebuffer and its color and depth buffers
+	GLuint m_framebuffer;
+	GLuint m_colorTexture;
+	GLuint m_depthTexture;
+	GLuint m_objectIDTexture;
+	int m_width;
+	int m_height;
+	// fraction of the window size the frame is drawn at, and
+	// the size of the part of the buffers it covers
+	float m_resolutionScale;
+	int m_renderWidth;
+	int m_renderHeight;
+	// damaged rectangle in pixels, empty when the max is not
+	// past the min
+	bool m_bFullDamage;
+	glm::ivec2 m_damageMin;
+	glm::ivec2 m_damageMax;
+};
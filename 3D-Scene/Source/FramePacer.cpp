@@ -0,0 +1,324 @@
+///////////////////////////////////////////////////////////////////////////////
+// framepacer.cpp
+// ============
+// pace the presented frames to a target rate, with vsync or a frame limiter,
+// and measure how evenly the frames are spaced
+///////////////////////////////////////////////////////////////////////////////
+
+#include <GL/glew.h>
+
+#include "FramePacer.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iostream>
+#include <thread>
+
+// declaration of the global variables and defines
+namespace
+{
+	// frame rate the limiter aims for when none is given
+	const double g_DefaultTargetRate = 60.0;
+	// number of recent frames the statistics are taken over
+	const int g_FrameTimeCount = 240;
+	// seconds between two printed reports
+	const double g_ReportInterval = 5.0;
+	// the limiter starts spinning at least this long before the
+	// next frame is due
+	const double g_MinimumSpinTime = 0.0005;
+	// a frame later than this many periods starts a new schedule
+	// instead of rushing the following frames to catch up
+	const double g_MaxLimiterLag = 2.0;
+	// longest idle wait for events, so the changes that do not
+	// come with an event, such as a saved material library,
+	// are still picked up
+	const double g_IdleWaitTimeout = 0.25;
+}
+
+/***********************************************************
+ *  FramePacer()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+FramePacer::FramePacer()
+{
+	m_pWindow = NULL;
+	m_mode = PACING_VSYNC;
+	m_bLowLatency = false;
+	m_bReportStats = false;
+	m_targetPeriod = 1.0 / g_DefaultTargetRate;
+	m_nextFrameTime = 0.0;
+	m_sleepOvershoot = 0.001;
+	m_lastPresentTime = 0.0;
+	m_lastReportTime = 0.0;
+	m_frameTimes.resize(g_FrameTimeCount, 0.0);
+	m_frameTimeIndex = 0;
+	m_frameTimeCount = 0;
+}
+
+/***********************************************************
+ *  SetMode()
+ *
+ *  This method is used for choosing how the frames are paced.
+ ***********************************************************/
+void FramePacer::SetMode(PACING_MODE mode)
+{
+	m_mode = mode;
+}
+
+/***********************************************************
+ *  SetTargetRate()
+ *
+ *  This method is used for setting the frame rate the limiter
+ *  aims for.
+ ***********************************************************/
+void FramePacer::SetTargetRate(double framesPerSecond)
+{
+	if (framesPerSecond > 0.0)
+	{
+		m_targetPeriod = 1.0 / framesPerSecond;
+	}
+}
+
+/***********************************************************
+ *  SetLowLatency()
+ *
+ *  This method is used for turning the low latency mode on
+ *  or off.
+ ***********************************************************/
+void FramePacer::SetLowLatency(bool bLowLatency)
+{
+	m_bLowLatency = bLowLatency;
+}
+
+/***********************************************************
+ *  SetReportStats()
+ *
+ *  This method is used for turning the printed frame time
+ *  reports on or off.
+ ***********************************************************/
+void FramePacer::SetReportStats(bool bReportStats)
+{
+	m_bReportStats = bReportStats;
+}
+
+/***********************************************************
+ *  Start()
+ *
+ *  This method is used for setting the swap interval of the
+ *  chosen mode. Adaptive vsync needs the swap control tear
+ *  extension and falls back to plain vsync without it.
+ ***********************************************************/
+void FramePacer::Start(GLFWwindow* window)
+{
+	m_pWindow = window;
+
+	int swapInterval = 0;
+	if (m_mode == PACING_VSYNC)
+	{
+		swapInterval = 1;
+	}
+	else if (m_mode == PACING_ADAPTIVE_VSYNC)
+	{
+		if (glfwExtensionSupported("WGL_EXT_swap_control_tear") ||
+			glfwExtensionSupported("GLX_EXT_swap_control_tear"))
+		{
+			swapInterval = -1;
+		}
+		else
+		{
+			std::cout << "Adaptive vsync is not supported, using vsync" << std::endl;
+			swapInterval = 1;
+		}
+	}
+	glfwSwapInterval(swapInterval);
+
+	m_lastPresentTime = glfwGetTime();
+	m_lastReportTime = m_lastPresentTime;
+	m_nextFrameTime = m_lastPresentTime;
+}
+
+/***********************************************************
+ *  BeginFrame()
+ *
+ *  This method is used for starting a frame. In the low
+ *  latency mode the limiter waits here and the events are
+ *  polled right after, just before the frame reads them.
+ ***********************************************************/
+void FramePacer::BeginFrame()
+{
+	if (m_bLowLatency)
+	{
+		WaitForNextFrame();
+		glfwPollEvents();
+	}
+}
+
+/***********************************************************
+ *  EndFrame()
+ *
+ *  This method is used for presenting the frame. In the low
+ *  latency mode the frame is finished on the GPU before the
+ *  next one starts, so no frames queue up in the driver.
+ *  Otherwise the limiter waits here and the events are
+ *  polled for the next frame.
+ ***********************************************************/
+void FramePacer::EndFrame()
+{
+	// Flips the the back buffer with the front buffer every frame.
+	glfwSwapBuffers(m_pWindow);
+
+	if (m_bLowLatency)
+	{
+		glFinish();
+	}
+
+	// the time spent idle is not part of any frame
+	double presentTime = glfwGetTime();
+	if (m_lastPresentTime >= 0.0)
+	{
+		RecordFrameTime(presentTime - m_lastPresentTime);
+	}
+	m_lastPresentTime = presentTime;
+
+	if (!m_bLowLatency)
+	{
+		WaitForNextFrame();
+
+		// query the latest GLFW events
+		glfwPollEvents();
+	}
+}
+
+/***********************************************************
+ *  WaitForEvents()
+ *
+ *  This method is used for skipping a frame when nothing in
+ *  it changed. Nothing is presented, the window keeps showing
+ *  the last frame, and the thread blocks until an event or
+ *  the timeout wakes it.
+ ***********************************************************/
+void FramePacer::WaitForEvents()
+{
+	glfwWaitEventsTimeout(g_IdleWaitTimeout);
+	m_lastPresentTime = -1.0;
+}
+
+/***********************************************************
+ *  WaitForNextFrame()
+ *
+ *  This method is used for holding the frame until the next
+ *  one is due, in the limiter mode only. The thread sleeps
+ *  until shortly before the deadline and spins the rest of
+ *  the way, since a sleep can wake up late. How late it
+ *  wakes up is measured, so the spin stays as short as the
+ *  system allows.
+ ***********************************************************/
+void FramePacer::WaitForNextFrame()
+{
+	if (m_mode != PACING_LIMITER)
+	{
+		return;
+	}
+
+	m_nextFrameTime += m_targetPeriod;
+	double currentTime = glfwGetTime();
+	if (currentTime - m_nextFrameTime > g_MaxLimiterLag * m_targetPeriod)
+	{
+		m_nextFrameTime = currentTime;
+		return;
+	}
+
+	double sleepTime = m_nextFrameTime - currentTime - std::max(m_sleepOvershoot, g_MinimumSpinTime);
+	if (sleepTime > 0.0)
+	{
+		std::this_thread::sleep_for(std::chrono::duration<double>(sleepTime));
+
+		// follow the overshoot up at once and back down slowly
+		double overshoot = glfwGetTime() - currentTime - sleepTime;
+		m_sleepOvershoot = std::max(overshoot, m_sleepOvershoot * 0.95 + overshoot * 0.05);
+	}
+
+	while (glfwGetTime() < m_nextFrameTime)
+	{
+		std::this_thread::yield();
+	}
+}
+
+/***********************************************************
+ *  RecordFrameTime()
+ *
+ *  This method is used for adding the time between two
+ *  presents to the recent frame times, and printing their
+ *  statistics when a report is due.
+ ***********************************************************/
+void FramePacer::RecordFrameTime(double frameTime)
+{
+	m_frameTimes[m_frameTimeIndex] = frameTime;
+	m_frameTimeIndex = (m_frameTimeIndex + 1) % g_FrameTimeCount;
+	m_frameTimeCount = std::min(m_frameTimeCount + 1, g_FrameTimeCount);
+
+	if (!m_bReportStats || (m_lastPresentTime - m_lastReportTime < g_ReportInterval))
+	{
+		return;
+	}
+	m_lastReportTime = m_lastPresentTime;
+
+	FRAME_STATS stats = GetFrameStats();
+	std::cout << "Frame time over " << stats.frameCount << " frames: "
+		<< "average " << stats.averageTime << " ms, "
+		<< "jitter " << stats.jitter << " ms, "
+		<< "min " << stats.minimumTime << " ms, "
+		<< "max " << stats.maximumTime << " ms, "
+		<< "99th percentile " << stats.percentile99Time << " ms" << std::endl;
+}
+
+/***********************************************************
+ *  GetFrameStats()
+ *
+ *  This method is used for getting the statistics of the
+ *  recent frame times. The jitter is their standard
+ *  deviation, how far a frame typically lands from the
+ *  average.
+ ***********************************************************/
+FramePacer::FRAME_STATS FramePacer::GetFrameStats() const
+{
+	FRAME_STATS stats;
+	stats.frameCount = m_frameTimeCount;
+	stats.averageTime = 0.0;
+	stats.jitter = 0.0;
+	stats.minimumTime = 0.0;
+	stats.maximumTime = 0.0;
+	stats.percentile99Time = 0.0;
+	if (m_frameTimeCount == 0)
+	{
+		return(stats);
+	}
+
+	std::vector<double> frameTimes(m_frameTimes.begin(), m_frameTimes.begin() + m_frameTimeCount);
+	std::sort(frameTimes.begin(), frameTimes.end());
+
+	double sum = 0.0;
+	for (size_t i = 0; i < frameTimes.size(); i++)
+	{
+		sum += frameTimes[i];
+	}
+	double average = sum / frameTimes.size();
+
+	double variance = 0.0;
+	for (size_t i = 0; i < frameTimes.size(); i++)
+	{
+		variance += (frameTimes[i] - average) * (frameTimes[i] - average);
+	}
+	variance /= frameTimes.size();
+
+	size_t percentileIndex = std::min(frameTimes.size() - 1, (size_t)(frameTimes.size() * 0.99));
+	stats.averageTime = average * 1000.0;
+	stats.jitter = std::sqrt(variance) * 1000.0;
+	stats.minimumTime = frameTimes.front() * 1000.0;
+	stats.maximumTime = frameTimes.back() * 1000.0;
+	stats.percentile99Time = frameTimes[percentileIndex] * 1000.0;
+
+	return(stats);
+}
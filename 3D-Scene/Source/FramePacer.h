@@ -0,0 +1,101 @@
+///////////////////////////////////////////////////////////////////////////////
+// framepacer.h
+// ============
+// pace the presented frames to a target rate, with vsync or a frame limiter,
+// and measure how evenly the frames are spaced
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+// GLFW library
+#include "GLFW/glfw3.h"
+
+#include <vector>
+
+/***********************************************************
+ *  FramePacer
+ *
+ *  This class owns the end of every frame: the buffer swap,
+ *  the wait until the next frame should start and the event
+ *  polling. Vsync lets the display pace the frames, adaptive
+ *  vsync lets a late frame tear instead of waiting for the
+ *  next refresh, and the limiter sleeps most of the time to
+ *  the target and spins for the rest, so the frames land on
+ *  time without keeping a core busy. In the low latency mode
+ *  the wait happens before the events are polled instead of
+ *  after, so the input a frame is drawn from is as fresh as
+ *  possible, and the driver is not allowed to queue frames.
+ ***********************************************************/
+class FramePacer
+{
+public:
+	// constructor
+	FramePacer();
+
+	// how the presented frames are paced
+	enum PACING_MODE
+	{
+		PACING_VSYNC = 0,
+		PACING_ADAPTIVE_VSYNC,
+		PACING_LIMITER,
+		PACING_UNLIMITED
+	};
+
+	// frame time statistics over the recent frames, in milliseconds
+	struct FRAME_STATS
+	{
+		int frameCount;
+		double averageTime;
+		double jitter;
+		double minimumTime;
+		double maximumTime;
+		double percentile99Time;
+	};
+
+	// choose the pacing, must be called before Start
+	void SetMode(PACING_MODE mode);
+	// frames per second the limiter aims for
+	void SetTargetRate(double framesPerSecond);
+	// wait for the next frame before polling the events
+	void SetLowLatency(bool bLowLatency);
+	// print the frame time statistics every few seconds
+	void SetReportStats(bool bReportStats);
+
+	// apply the swap interval of the mode to the window
+	void Start(GLFWwindow* window);
+	// wait and poll the events before a frame in the low latency mode
+	void BeginFrame();
+	// present the frame, then wait and poll the events
+	void EndFrame();
+	// skip a frame, sleeping until an event arrives
+	void WaitForEvents();
+
+	// get the statistics of the recent frames
+	FRAME_STATS GetFrameStats() const;
+
+private:
+	GLFWwindow* m_pWindow;
+	PACING_MODE m_mode;
+	bool m_bLowLatency;
+	bool m_bReportStats;
+	// seconds between frames the limiter aims for
+	double m_targetPeriod;
+	// time the limiter lets the next frame start
+	double m_nextFrameTime;
+	// how much longer than asked a sleep has been taking, the
+	// limiter spins for this long at the end of its wait
+	double m_sleepOvershoot;
+	// time of the last present and of the last report, the
+	// present time is negative after an idle wait
+	double m_lastPresentTime;
+	double m_lastReportTime;
+	// ring of the recent frame times, in seconds
+	std::vector<double> m_frameTimes;
+	int m_frameTimeIndex;
+	int m_frameTimeCount;
+
+	// hold the frame until the limiter lets it start
+	void WaitForNextFrame();
+	// add a frame time and report the statistics when due
+	void RecordFrameTime(double frameTime);
+};
@@ -0,0 +1,622 @@
+///////////////////////////////////////////////////////////////////////////////
+// glstatecache.cpp
+// ============
+// keep a shadow copy of the OpenGL state so the calls that would not change
+// anything never reach the driver
+///////////////////////////////////////////////////////////////////////////////
+
+#include "GLStateCache.h"
+
+#include <glm/gtc/type_ptr.hpp>
+
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <unordered_map>
+
+// declaration of the global variables and defines
+namespace
+{
+	// capabilities whose state is tracked, any other one is
+	// passed straight to the driver
+	const GLenum g_TrackedCapabilities[] = { GL_BLEND, GL_DEPTH_TEST, GL_SCISSOR_TEST, GL_CULL_FACE, GL_STENCIL_TEST };
+	const int g_CapabilityCount = sizeof(g_TrackedCapabilities) / sizeof(g_TrackedCapabilities[0]);
+	// texture units whose 2D texture binding is tracked
+	const int g_TrackedTextureUnits = 32;
+	// seconds between two printed reports
+	const double g_ReportInterval = 5.0;
+
+	// a tracked value is unknown, off or on
+	enum STATE_VALUE
+	{
+		STATE_UNKNOWN = -1,
+		STATE_OFF = 0,
+		STATE_ON = 1
+	};
+
+	// last value set for a uniform, compared byte for byte
+	struct UNIFORM_VALUE
+	{
+		size_t size;
+		unsigned char data[sizeof(glm::mat4)];
+	};
+	// the uniforms of one program. The location of a name is
+	// looked up in the driver once and then found by the address
+	// of the name, and the values are kept by location, so two
+	// names of the same uniform share its value
+	struct PROGRAM_UNIFORMS
+	{
+		std::unordered_map<const char*, GLint> locations;
+		std::unordered_map<GLint, UNIFORM_VALUE> values;
+	};
+
+	// shadow copy of the state of the one OpenGL context
+	STATE_VALUE g_Capabilities[g_CapabilityCount] = { STATE_UNKNOWN, STATE_UNKNOWN, STATE_UNKNOWN, STATE_UNKNOWN, STATE_UNKNOWN };
+	bool g_bBlendFuncKnown = false;
+	GLenum g_BlendFunc[2] = { 0, 0 };
+	bool g_bDepthFuncKnown = false;
+	GLenum g_DepthFunc = 0;
+	STATE_VALUE g_DepthMask = STATE_UNKNOWN;
+	bool g_bClearColorKnown = false;
+	glm::vec4 g_ClearColor(0.0f);
+	bool g_bProgramKnown = false;
+	GLuint g_Program = 0;
+	bool g_bVertexArrayKnown = false;
+	GLuint g_VertexArray = 0;
+	bool g_bActiveUnitKnown = false;
+	GLuint g_ActiveUnit = 0;
+	bool g_bTextureKnown[g_TrackedTextureUnits] = { false };
+	GLuint g_Textures[g_TrackedTextureUnits] = { 0 };
+	bool g_bSamplerKnown[g_TrackedTextureUnits] = { false };
+	GLuint g_Samplers[g_TrackedTextureUnits] = { 0 };
+	std::unordered_map<GLuint, PROGRAM_UNIFORMS> g_ProgramUniforms;
+
+	// counts of the frame being drawn and of the last one, and
+	// the totals since the last report
+	GLStateCache::STATE_STATS g_CurrentStats = { 0, 0 };
+	GLStateCache::STATE_STATS g_LastFrameStats = { 0, 0 };
+	GLStateCache::STATE_STATS g_ReportStats = { 0, 0 };
+	int g_ReportFrames = 0;
+	bool g_bReportStats = false;
+	std::chrono::steady_clock::time_point g_LastReportTime = std::chrono::steady_clock::now();
+
+	// get the slot of a tracked capability, -1 when it is not
+	int FindCapability(GLenum capability)
+	{
+		for (int i = 0; i < g_CapabilityCount; i++)
+		{
+			if (g_TrackedCapabilities[i] == capability)
+			{
+				return(i);
+			}
+		}
+		return(-1);
+	}
+
+	// find the location of a uniform of the current program, and
+	// count a call as filtered and return true when the value is
+	// already set or the uniform is not used by the program, else
+	// count it as issued and remember the value. Only the first
+	// call with a name asks the driver for its location
+	bool FilterUniform(ShaderManager* pShaderManager, const char* name, const void* pValue, size_t size, GLint& location)
+	{
+		PROGRAM_UNIFORMS& uniforms = g_ProgramUniforms[pShaderManager->m_programID];
+		std::unordered_map<const char*, GLint>::iterator match = uniforms.locations.find(name);
+		if (match == uniforms.locations.end())
+		{
+			match = uniforms.locations.insert(std::make_pair(name, glGetUniformLocation(pShaderManager->m_programID, name))).first;
+		}
+		location = match->second;
+		if (location < 0)
+		{
+			g_CurrentStats.filteredCalls++;
+			return(true);
+		}
+
+		UNIFORM_VALUE& value = uniforms.values[location];
+		if ((value.size == size) && (memcmp(value.data, pValue, size) == 0))
+		{
+			g_CurrentStats.filteredCalls++;
+			return(true);
+		}
+
+		value.size = size;
+		memcpy(value.data, pValue, size);
+		g_CurrentStats.issuedCalls++;
+		return(false);
+	}
+
+	// count a call to a tracked state as filtered or issued
+	bool CountCall(bool bRedundant)
+	{
+		if (bRedundant)
+		{
+			g_CurrentStats.filteredCalls++;
+		}
+		else
+		{
+			g_CurrentStats.issuedCalls++;
+		}
+		return(bRedundant);
+	}
+}
+
+/***********************************************************
+ *  Enable()
+ *
+ *  This method is used for turning a capability on.
+ ***********************************************************/
+void GLStateCache::Enable(GLenum capability)
+{
+	SetEnabled(capability, true);
+}
+
+/***********************************************************
+ *  Disable()
+ *
+ *  This method is used for turning a capability off.
+ ***********************************************************/
+void GLStateCache::Disable(GLenum capability)
+{
+	SetEnabled(capability, false);
+}
+
+/***********************************************************
+ *  SetEnabled()
+ *
+ *  This method is used for turning a capability on or off,
+ *  unless it already is.
+ ***********************************************************/
+void GLStateCache::SetEnabled(GLenum capability, bool bEnabled)
+{
+	STATE_VALUE state = bEnabled ? STATE_ON : STATE_OFF;
+	int slot = FindCapability(capability);
+	if (slot >= 0)
+	{
+		if (CountCall(g_Capabilities[slot] == state))
+		{
+			return;
+		}
+		g_Capabilities[slot] = state;
+	}
+
+	if (bEnabled)
+	{
+		glEnable(capability);
+	}
+	else
+	{
+		glDisable(capability);
+	}
+}
+
+/***********************************************************
+ *  IsEnabled()
+ *
+ *  This method is used for checking if a capability is on
+ *  without asking the driver, which would wait for it. A
+ *  capability that is not known is asked for once.
+ ***********************************************************/
+bool GLStateCache::IsEnabled(GLenum capability)
+{
+	int slot = FindCapability(capability);
+	if (slot < 0)
+	{
+		return(glIsEnabled(capability) == GL_TRUE);
+	}
+	if (g_Capabilities[slot] == STATE_UNKNOWN)
+	{
+		g_Capabilities[slot] = (glIsEnabled(capability) == GL_TRUE) ? STATE_ON : STATE_OFF;
+	}
+	return(g_Capabilities[slot] == STATE_ON);
+}
+
+/***********************************************************
+ *  BlendFunc()
+ *
+ *  This method is used for setting the blend factors.
+ ***********************************************************/
+void GLStateCache::BlendFunc(GLenum sourceFactor, GLenum destinationFactor)
+{
+	if (CountCall(g_bBlendFuncKnown && (g_BlendFunc[0] == sourceFactor) && (g_BlendFunc[1] == destinationFactor)))
+	{
+		return;
+	}
+	g_bBlendFuncKnown = true;
+	g_BlendFunc[0] = sourceFactor;
+	g_BlendFunc[1] = destinationFactor;
+	glBlendFunc(sourceFactor, destinationFactor);
+}
+
+/***********************************************************
+ *  DepthFunc()
+ *
+ *  This method is used for setting the depth comparison.
+ ***********************************************************/
+void GLStateCache::DepthFunc(GLenum function)
+{
+	if (CountCall(g_bDepthFuncKnown && (g_DepthFunc == function)))
+	{
+		return;
+	}
+	g_bDepthFuncKnown = true;
+	g_DepthFunc = function;
+	glDepthFunc(function);
+}
+
+/***********************************************************
+ *  DepthMask()
+ *
+ *  This method is used for turning the depth writes on or
+ *  off.
+ ***********************************************************/
+void GLStateCache::DepthMask(bool bWrite)
+{
+	STATE_VALUE state = bWrite ? STATE_ON : STATE_OFF;
+	if (CountCall(g_DepthMask == state))
+	{
+		return;
+	}
+	g_DepthMask = state;
+	glDepthMask(bWrite ? GL_TRUE : GL_FALSE);
+}
+
+/***********************************************************
+ *  ClearColor()
+ *
+ *  This method is used for setting the color the color
+ *  buffer is cleared to.
+ ***********************************************************/
+void GLStateCache::ClearColor(float red, float green, float blue, float alpha)
+{
+	glm::vec4 color(red, green, blue, alpha);
+	if (CountCall(g_bClearColorKnown && (g_ClearColor == color)))
+	{
+		return;
+	}
+	g_bClearColorKnown = true;
+	g_ClearColor = color;
+	glClearColor(red, green, blue, alpha);
+}
+
+/***********************************************************
+ *  UseProgram()
+ *
+ *  This method is used for making a program current.
+ ***********************************************************/
+void GLStateCache::UseProgram(GLuint program)
+{
+	if (CountCall(g_bProgramKnown && (g_Program == program)))
+	{
+		return;
+	}
+	g_bProgramKnown = true;
+	g_Program = program;
+	glUseProgram(program);
+}
+
+/***********************************************************
+ *  UseProgram()
+ *
+ *  This method is used for making the program of a shader
+ *  manager current.
+ ***********************************************************/
+void GLStateCache::UseProgram(ShaderManager* pShaderManager)
+{
+	UseProgram(pShaderManager->m_programID);
+}
+
+/***********************************************************
+ *  GetProgram()
+ *
+ *  This method is used for getting the current program
+ *  without asking the driver.
+ ***********************************************************/
+GLuint GLStateCache::GetProgram()
+{
+	return(g_bProgramKnown ? g_Program : 0);
+}
+
+/***********************************************************
+ *  BindVertexArray()
+ *
+ *  This method is used for binding a vertex array. Since
+ *  the draws no longer unbind their vertex array, the
+ *  draws of the same mesh buffers after each other bind it
+ *  only once.
+ ***********************************************************/
+void GLStateCache::BindVertexArray(GLuint vertexArray)
+{
+	if (CountCall(g_bVertexArrayKnown && (g_VertexArray == vertexArray)))
+	{
+		return;
+	}
+	g_bVertexArrayKnown = true;
+	g_VertexArray = vertexArray;
+	glBindVertexArray(vertexArray);
+}
+
+/***********************************************************
+ *  BindTexture()
+ *
+ *  This method is used for binding a texture to a unit. The
+ *  active unit is only changed when the binding changes.
+ *  Only the 2D bindings are tracked.
+ ***********************************************************/
+void GLStateCache::BindTexture(GLuint unit, GLenum target, GLuint texture)
+{
+	bool bTracked = (target == GL_TEXTURE_2D) && (unit < (GLuint)g_TrackedTextureUnits);
+	if (bTracked && CountCall(g_bTextureKnown[unit] && (g_Textures[unit] == texture)))
+	{
+		return;
+	}
+
+	if (!g_bActiveUnitKnown || (g_ActiveUnit != unit))
+	{
+		glActiveTexture(GL_TEXTURE0 + unit);
+		g_bActiveUnitKnown = true;
+		g_ActiveUnit = unit;
+	}
+	glBindTexture(target, texture);
+
+	if (bTracked)
+	{
+		g_bTextureKnown[unit] = true;
+		g_Textures[unit] = texture;
+	}
+}
+
+/***********************************************************
+ *  BindSampler()
+ *
+ *  This method is used for binding a sampler to a unit. The
+ *  sampler is bound to the unit directly, so the active unit
+ *  stays as it is.
+ ***********************************************************/
+void GLStateCache::BindSampler(GLuint unit, GLuint sampler)
+{
+	bool bTracked = (unit < (GLuint)g_TrackedTextureUnits);
+	if (bTracked && CountCall(g_bSamplerKnown[unit] && (g_Samplers[unit] == sampler)))
+	{
+		return;
+	}
+
+	glBindSampler(unit, sampler);
+
+	if (bTracked)
+	{
+		g_bSamplerKnown[unit] = true;
+		g_Samplers[unit] = sampler;
+	}
+}
+
+/***********************************************************
+ *  SetBool()
+ *
+ *  This method is used for setting a bool uniform.
+ ***********************************************************/
+void GLStateCache::SetBool(ShaderManager* pShaderManager, const char* name, bool value)
+{
+	GLint location;
+	if (!FilterUniform(pShaderManager, name, &value, sizeof(value), location))
+	{
+		glUniform1i(location, value ? 1 : 0);
+	}
+}
+
+/***********************************************************
+ *  SetInt()
+ *
+ *  This method is used for setting an int uniform.
+ ***********************************************************/
+void GLStateCache::SetInt(ShaderManager* pShaderManager, const char* name, int value)
+{
+	GLint location;
+	if (!FilterUniform(pShaderManager, name, &value, sizeof(value), location))
+	{
+		glUniform1i(location, value);
+	}
+}
+
+/***********************************************************
+ *  SetFloat()
+ *
+ *  This method is used for setting a float uniform.
+ ***********************************************************/
+void GLStateCache::SetFloat(ShaderManager* pShaderManager, const char* name, float value)
+{
+	GLint location;
+	if (!FilterUniform(pShaderManager, name, &value, sizeof(value), location))
+	{
+		glUniform1f(location, value);
+	}
+}
+
+/***********************************************************
+ *  SetVec2()
+ *
+ *  This method is used for setting a vec2 uniform.
+ ***********************************************************/
+void GLStateCache::SetVec2(ShaderManager* pShaderManager, const char* name, const glm::vec2& value)
+{
+	GLint location;
+	if (!FilterUniform(pShaderManager, name, &value, sizeof(value), location))
+	{
+		glUniform2fv(location, 1, glm::value_ptr(value));
+	}
+}
+
+/***********************************************************
+ *  SetVec3()
+ *
+ *  This method is used for setting a vec3 uniform.
+ ***********************************************************/
+void GLStateCache::SetVec3(ShaderManager* pShaderManager, const char* name, const glm::vec3& value)
+{
+	GLint location;
+	if (!FilterUniform(pShaderManager, name, &value, sizeof(value), location))
+	{
+		glUniform3fv(location, 1, glm::value_ptr(value));
+	}
+}
+
+/***********************************************************
+ *  SetVec4()
+ *
+ *  This method is used for setting a vec4 uniform.
+ ***********************************************************/
+void GLStateCache::SetVec4(ShaderManager* pShaderManager, const char* name, const glm::vec4& value)
+{
+	GLint location;
+	if (!FilterUniform(pShaderManager, name, &value, sizeof(value), location))
+	{
+		glUniform4fv(location, 1, glm::value_ptr(value));
+	}
+}
+
+/***********************************************************
+ *  SetMat4()
+ *
+ *  This method is used for setting a mat4 uniform.
+ ***********************************************************/
+void GLStateCache::SetMat4(ShaderManager* pShaderManager, const char* name, const glm::mat4& value)
+{
+	GLint location;
+	if (!FilterUniform(pShaderManager, name, &value, sizeof(value), location))
+	{
+		glUniformMatrix4fv(location, 1, GL_FALSE, glm::value_ptr(value));
+	}
+}
+
+/***********************************************************
+ *  Invalidate()
+ *
+ *  This method is used for forgetting the whole shadow
+ *  state, so every value is set again the next time.
+ ***********************************************************/
+void GLStateCache::Invalidate()
+{
+	for (int i = 0; i < g_CapabilityCount; i++)
+	{
+		g_Capabilities[i] = STATE_UNKNOWN;
+	}
+	g_bBlendFuncKnown = false;
+	g_bDepthFuncKnown = false;
+	g_DepthMask = STATE_UNKNOWN;
+	g_bClearColorKnown = false;
+	g_bProgramKnown = false;
+	g_bVertexArrayKnown = false;
+	g_bActiveUnitKnown = false;
+	for (int i = 0; i < g_TrackedTextureUnits; i++)
+	{
+		g_bTextureKnown[i] = false;
+		g_bSamplerKnown[i] = false;
+	}
+	g_ProgramUniforms.clear();
+}
+
+/***********************************************************
+ *  ForgetProgram()
+ *
+ *  This method is used for forgetting the uniform values of
+ *  a program, before it is deleted and its name can be
+ *  handed out again.
+ ***********************************************************/
+void GLStateCache::ForgetProgram(GLuint program)
+{
+	g_ProgramUniforms.erase(program);
+	if (g_bProgramKnown && (g_Program == program))
+	{
+		g_bProgramKnown = false;
+	}
+}
+
+/***********************************************************
+ *  ForgetSampler()
+ *
+ *  This method is used for forgetting a sampler that is
+ *  deleted. Deleting it unbinds it from every unit, and its
+ *  name can be handed out again.
+ ***********************************************************/
+void GLStateCache::ForgetSampler(GLuint sampler)
+{
+	for (int i = 0; i < g_TrackedTextureUnits; i++)
+	{
+		if (g_bSamplerKnown[i] && (g_Samplers[i] == sampler))
+		{
+			g_Samplers[i] = 0;
+		}
+	}
+}
+
+/***********************************************************
+ *  ForgetTexture()
+ *
+ *  This method is used for forgetting a texture that is
+ *  deleted. Deleting it binds 0 to every unit it was bound
+ *  to, and a new texture given its name must still be bound.
+ ***********************************************************/
+void GLStateCache::ForgetTexture(GLuint texture)
+{
+	for (int i = 0; i < g_TrackedTextureUnits; i++)
+	{
+		if (g_bTextureKnown[i] && (g_Textures[i] == texture))
+		{
+			g_Textures[i] = 0;
+		}
+	}
+}
+
+/***********************************************************
+ *  EndFrame()
+ *
+ *  This method is used for closing the counts of the frame,
+ *  and printing the average counts per frame since the last
+ *  report when one is due.
+ ***********************************************************/
+void GLStateCache::EndFrame()
+{
+	g_LastFrameStats = g_CurrentStats;
+	g_ReportStats.issuedCalls += g_CurrentStats.issuedCalls;
+	g_ReportStats.filteredCalls += g_CurrentStats.filteredCalls;
+	g_ReportFrames++;
+	g_CurrentStats.issuedCalls = 0;
+	g_CurrentStats.filteredCalls = 0;
+
+	std::chrono::steady_clock::time_point currentTime = std::chrono::steady_clock::now();
+	if (!g_bReportStats || (std::chrono::duration<double>(currentTime - g_LastReportTime).count() < g_ReportInterval))
+	{
+		return;
+	}
+
+	std::cout << "GL state calls per frame over " << g_ReportFrames << " frames: "
+		<< "issued " << (double)g_ReportStats.issuedCalls / g_ReportFrames << ", "
+		<< "filtered " << (double)g_ReportStats.filteredCalls / g_ReportFrames << std::endl;
+
+	g_LastReportTime = currentTime;
+	g_ReportStats.issuedCalls = 0;
+	g_ReportStats.filteredCalls = 0;
+	g_ReportFrames = 0;
+}
+
+/***********************************************************
+ *  SetReportStats()
+ *
+ *  This method is used for turning the printed counts on
+ *  or off.
+ ***********************************************************/
+void GLStateCache::SetReportStats(bool bReportStats)
+{
+	g_bReportStats = bReportStats;
+}
+
+/***********************************************************
+ *  GetFrameStats()
+ *
+ *  This method is used for getting the counts of the last
+ *  finished frame.
+ ***********************************************************/
+GLStateCache::STATE_STATS GLStateCache::GetFrameStats()
+{
+	return(g_LastFrameStats);
+}
@@ -0,0 +1,101 @@
+///////////////////////////////////////////////////////////////////////////////
+// glstatecache.h
+// ============
+// keep a shadow copy of the OpenGL state so the calls that would not change
+// anything never reach the driver
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "ShaderManager.h"
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+
+/***********************************************************
+ *  GLStateCache
+ *
+ *  This class stands between the rendering code and the
+ *  OpenGL calls that set state: the capabilities, the blend
+ *  and depth state, the clear color, the bound program,
+ *  vertex array, textures and samplers, and the uniform values set
+ *  through a shader manager. It remembers the last value of
+ *  each, and a call asking for the value that is already
+ *  set returns without calling the driver. A value is not
+ *  known until it has been set once, so the first call
+ *  always goes through. There is one OpenGL context, so the
+ *  shadow state is shared by the whole program, and every
+ *  change to the tracked state has to go through here or be
+ *  followed by a call to Invalidate. The calls that went
+ *  through and the ones filtered out are counted per frame.
+ ***********************************************************/
+class GLStateCache
+{
+public:
+	// texture unit used for binding textures while they are
+	// created or filled, so the units the shaders sample from
+	// keep their textures
+	static const GLuint SCRATCH_TEXTURE_UNIT = 18;
+
+	// number of state calls in a frame
+	struct STATE_STATS
+	{
+		int issuedCalls;
+		int filteredCalls;
+	};
+
+	// turn a capability on or off
+	static void Enable(GLenum capability);
+	static void Disable(GLenum capability);
+	static void SetEnabled(GLenum capability, bool bEnabled);
+	// true when a tracked capability is on, as far as it is known
+	static bool IsEnabled(GLenum capability);
+
+	// set the blend and depth state and the clear color
+	static void BlendFunc(GLenum sourceFactor, GLenum destinationFactor);
+	static void DepthFunc(GLenum function);
+	static void DepthMask(bool bWrite);
+	static void ClearColor(float red, float green, float blue, float alpha);
+
+	// make a program current, by its name or its shader manager
+	static void UseProgram(GLuint program);
+	static void UseProgram(ShaderManager* pShaderManager);
+	// get the current program, 0 when it is not known
+	static GLuint GetProgram();
+	// bind a vertex array
+	static void BindVertexArray(GLuint vertexArray);
+	// bind a texture to a texture unit
+	static void BindTexture(GLuint unit, GLenum target, GLuint texture);
+	// bind a sampler object to a texture unit, 0 for the
+	// filtering of the texture itself
+	static void BindSampler(GLuint unit, GLuint sampler);
+
+	// set a uniform of the program of the shader manager, which
+	// must be the current program. The location of a name is
+	// remembered by its address, so the name must be a string
+	// literal or live as long as the program
+	static void SetBool(ShaderManager* pShaderManager, const char* name, bool value);
+	static void SetInt(ShaderManager* pShaderManager, const char* name, int value);
+	static void SetFloat(ShaderManager* pShaderManager, const char* name, float value);
+	static void SetVec2(ShaderManager* pShaderManager, const char* name, const glm::vec2& value);
+	static void SetVec3(ShaderManager* pShaderManager, const char* name, const glm::vec3& value);
+	static void SetVec4(ShaderManager* pShaderManager, const char* name, const glm::vec4& value);
+	static void SetMat4(ShaderManager* pShaderManager, const char* name, const glm::mat4& value);
+
+	// forget the whole shadow state, after code outside of the
+	// cache changed it
+	static void Invalidate();
+	// forget the uniform values of a program that is deleted
+	static void ForgetProgram(GLuint program);
+	// forget the bindings of a sampler that is deleted
+	static void ForgetSampler(GLuint sampler);
+	// forget the bindings of a texture that is deleted
+	static void ForgetTexture(GLuint texture);
+
+	// close the counts of the frame and print them when due
+	static void EndFrame();
+	// print the counts every few seconds
+	static void SetReportStats(bool bReportStats);
+	// get the counts of the last finished frame
+	static STATE_STATS GetFrameStats();
+};
@@ -0,0 +1,428 @@
+///////////////////////////////////////////////////////////////////////////////
+// gpuculling.cpp
+// ============
+// cull the draws of an indirect command buffer against the view frustums,
+// and optionally a Hi-Z depth pyramid, with a compute shader
+///////////////////////////////////////////////////////////////////////////////
+
+#include "GPUCulling.h"
+#include "GLStateCache.h"
+
+#include <algorithm>
+#include <iostream>
+
+// declaration of global variables
+namespace
+{
+	// invocations per workgroup, matching local_size_x in the shader
+	const int g_CullGroupSize = 256;
+	// the cull shader runs as three passes with a barrier between
+	const int g_PassCull = 0;
+	const int g_PassScanGroups = 1;
+	const int g_PassCompact = 2;
+	// size of one glMultiDrawElementsIndirect command
+	const int g_CommandSize = 5 * sizeof(GLuint);
+	// the draw count buffer holds for every view the visible draw
+	// count, then the occluded draw count and their summed screen
+	// area
+	const int g_DrawCountValues = 3;
+	// the summed area is stored in units of 1/65536 screen
+	const float g_OccludedAreaScale = 65536.0f;
+}
+
+/***********************************************************
+ *  GPUCulling()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+GPUCulling::GPUCulling()
+{
+	m_pComputeShader = NULL;
+	m_commandBuffer = 0;
+	m_localOffsetBuffer = 0;
+	m_groupOffsetBuffer = 0;
+	m_drawCountBuffer = 0;
+	m_drawCapacity = 0;
+	m_viewCapacity = 0;
+	m_viewDrawStride = 0;
+	m_hiZTexture = 0;
+	m_hiZSize = glm::vec2(0.0f);
+	m_hiZLevels = 0;
+	m_lodLevelBuffer = 0;
+	m_lodCommandBuffer = 0;
+	m_lodLevelCount = 1;
+	m_lodPixelThresholds = glm::vec4(0.0f);
+	m_lodHysteresis = 0.0f;
+}
+
+/***********************************************************
+ *  ~GPUCulling()
+ *
+ *  The destructor for the class
+ ***********************************************************/
+GPUCulling::~GPUCulling()
+{
+	Destroy();
+}
+
+/***********************************************************
+ *  Initialize()
+ *
+ *  This method is used for loading the cull compute shader.
+ *  Compute shaders need OpenGL 4.3, so nothing is loaded on
+ *  older drivers and the draws are simply not culled.
+ ***********************************************************/
+bool GPUCulling::Initialize(const char* computeShaderPath)
+{
+	if (!GLEW_VERSION_4_3)
+	{
+		std::cout << "GPU culling disabled: OpenGL 4.3 is not available" << std::endl;
+		return(false);
+	}
+
+	m_pComputeShader = new ComputeShader();
+	if (!m_pComputeShader->LoadShader(computeShaderPath))
+	{
+		delete m_pComputeShader;
+		m_pComputeShader = NULL;
+		return(false);
+	}
+
+	glGenBuffers(1, &m_drawCountBuffer);
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, m_drawCountBuffer);
+	glBufferData(GL_SHADER_STORAGE_BUFFER, MAX_VIEWS * g_DrawCountValues * sizeof(GLuint), NULL, GL_DYNAMIC_COPY);
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+	return(true);
+}
+
+/***********************************************************
+ *  Destroy()
+ *
+ *  This method is used for freeing the compute program and
+ *  the OpenGL buffers.
+ ***********************************************************/
+void GPUCulling::Destroy()
+{
+	if (NULL != m_pComputeShader)
+	{
+		delete m_pComputeShader;
+		m_pComputeShader = NULL;
+	}
+
+	if (m_drawCountBuffer != 0)
+	{
+		GLuint buffers[5] = { m_commandBuffer, m_localOffsetBuffer, m_groupOffsetBuffer, m_drawCountBuffer, m_lodLevelBuffer };
+		glDeleteBuffers(5, buffers);
+	}
+
+	m_lodLevelBuffer = 0;
+	m_commandBuffer = 0;
+	m_localOffsetBuffer = 0;
+	m_groupOffsetBuffer = 0;
+	m_drawCountBuffer = 0;
+	m_drawCapacity = 0;
+	m_viewCapacity = 0;
+	m_viewDrawStride = 0;
+}
+
+/***********************************************************
+ *  SetHiZTexture()
+ *
+ *  This method is used for setting the depth pyramid that
+ *  the draws are tested against after the frustum test. Each
+ *  texel of the pyramid must hold the farthest depth of the
+ *  area it covers. Passing texture 0 turns the test off.
+ ***********************************************************/
+void GPUCulling::SetHiZTexture(GLuint texture, int width, int height, int levels)
+{
+	m_hiZTexture = texture;
+	m_hiZSize = glm::vec2((float)width, (float)height);
+	m_hiZLevels = levels;
+}
+
+/***********************************************************
+ *  SetLODSelection()
+ *
+ *  This method is used for letting the cull choose the
+ *  detail level of every visible draw from the projected
+ *  size of its bounds, the same way the draws of the scene
+ *  choose theirs on the CPU. The compacted command of a
+ *  draw is copied from its level in the passed in buffer.
+ *  The levels each draw was drawn at are forgotten.
+ ***********************************************************/
+void GPUCulling::SetLODSelection(GLuint lodCommandBuffer, int levelCount, const float* pixelThresholds, float hysteresis)
+{
+	m_lodCommandBuffer = lodCommandBuffer;
+	m_lodLevelCount = std::max(1, std::min(levelCount, MAX_LOD_LEVELS));
+	m_lodPixelThresholds = glm::vec4(0.0f);
+	for (int i = 0; i < m_lodLevelCount - 1; i++)
+	{
+		m_lodPixelThresholds[i] = pixelThresholds[i];
+	}
+	m_lodHysteresis = hysteresis;
+
+	ClearLODLevels();
+}
+
+/***********************************************************
+ *  ClearLODLevels()
+ *
+ *  This method is used for marking every draw as not drawn
+ *  at any level yet, so its first level has no hysteresis.
+ ***********************************************************/
+void GPUCulling::ClearLODLevels()
+{
+	if (m_lodLevelBuffer == 0)
+	{
+		return;
+	}
+
+	const GLint noLevel = -1;
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, m_lodLevelBuffer);
+	glClearBufferData(GL_SHADER_STORAGE_BUFFER, GL_R32I, GL_RED_INTEGER, GL_INT, &noLevel);
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+}
+
+/***********************************************************
+ *  ReserveDraws()
+ *
+ *  This method is used for growing the compacted command
+ *  buffer and the scratch buffers so they have room for the
+ *  passed in number of draws in every view.
+ ***********************************************************/
+void GPUCulling::ReserveDraws(int drawCount, int viewCount)
+{
+	if ((drawCount <= m_drawCapacity) && (viewCount <= m_viewCapacity))
+	{
+		return;
+	}
+	drawCount = std::max(drawCount, m_drawCapacity);
+	viewCount = std::max(viewCount, m_viewCapacity);
+
+	if (m_commandBuffer == 0)
+	{
+		glGenBuffers(1, &m_commandBuffer);
+		glGenBuffers(1, &m_localOffsetBuffer);
+		glGenBuffers(1, &m_groupOffsetBuffer);
+		glGenBuffers(1, &m_lodLevelBuffer);
+	}
+
+	int groupCount = (drawCount + g_CullGroupSize - 1) / g_CullGroupSize;
+
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, m_commandBuffer);
+	glBufferData(GL_SHADER_STORAGE_BUFFER, viewCount * drawCount * g_CommandSize, NULL, GL_DYNAMIC_COPY);
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, m_localOffsetBuffer);
+	glBufferData(GL_SHADER_STORAGE_BUFFER, viewCount * drawCount * sizeof(GLuint), NULL, GL_DYNAMIC_COPY);
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, m_groupOffsetBuffer);
+	glBufferData(GL_SHADER_STORAGE_BUFFER, viewCount * groupCount * sizeof(GLuint), NULL, GL_DYNAMIC_COPY);
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, m_lodLevelBuffer);
+	glBufferData(GL_SHADER_STORAGE_BUFFER, viewCount * drawCount * sizeof(GLint), NULL, GL_DYNAMIC_COPY);
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+	m_drawCapacity = drawCount;
+	m_viewCapacity = viewCount;
+	ClearLODLevels();
+}
+
+/***********************************************************
+ *  ExtractFrustumPlanes()
+ *
+ *  This method is used for getting the six planes of the
+ *  view frustum from the rows of the view projection matrix.
+ *  The planes point inwards and are normalized so the plane
+ *  distance can be compared against a sphere radius.
+ ***********************************************************/
+void GPUCulling::ExtractFrustumPlanes(const glm::mat4& viewProjection, glm::vec4 planes[6])
+{
+	glm::vec4 rows[4];
+	for (int i = 0; i < 4; i++)
+	{
+		rows[i] = glm::vec4(viewProjection[0][i], viewProjection[1][i], viewProjection[2][i], viewProjection[3][i]);
+	}
+
+	planes[0] = rows[3] + rows[0];	// left
+	planes[1] = rows[3] - rows[0];	// right
+	planes[2] = rows[3] + rows[1];	// bottom
+	planes[3] = rows[3] - rows[1];	// top
+	planes[4] = rows[3] + rows[2];	// near
+	planes[5] = rows[3] - rows[2];	// far
+
+	for (int i = 0; i < 6; i++)
+	{
+		planes[i] /= glm::length(glm::vec3(planes[i]));
+	}
+}
+
+/***********************************************************
+ *  Cull()
+ *
+ *  This method is used for dispatching the three passes of
+ *  the cull shader. The first pass tests every draw and finds
+ *  its place among the visible draws of its workgroup, the
+ *  second pass turns the workgroup totals into offsets and
+ *  writes the visible draw count, and the last pass copies
+ *  the visible commands into the compacted buffer. The draws
+ *  found hidden in the pyramid are counted on the way.
+ *
+ *  Every view is a row of workgroups in the same dispatches,
+ *  so the cost of setting up the passes is paid once however
+ *  many views are culled, and the bounds each row reads are
+ *  shared in the caches.
+ *
+ *  When the detail levels are selected, the first pass also
+ *  picks the level of every visible draw from the size of
+ *  its bounds in the first frustum of the view, and the last
+ *  pass copies the command of that level instead.
+ ***********************************************************/
+void GPUCulling::Cull(
+	GLuint sourceCommandBuffer,
+	GLuint drawBoundsBuffer,
+	int drawCount,
+	const glm::mat4* viewProjections,
+	int viewCount,
+	int frustumsPerView,
+	const int* viewportHeights)
+{
+	if ((NULL == m_pComputeShader) || (drawCount <= 0) || (viewCount <= 0) || (frustumsPerView <= 0))
+	{
+		return;
+	}
+	frustumsPerView = std::min(frustumsPerView, MAX_VIEWS);
+	viewCount = std::min(viewCount, MAX_VIEWS / frustumsPerView);
+	int frustumCount = viewCount * frustumsPerView;
+
+	ReserveDraws(drawCount, viewCount);
+	m_viewDrawStride = drawCount;
+
+	int groupCount = (drawCount + g_CullGroupSize - 1) / g_CullGroupSize;
+	glm::vec4 frustumPlanes[MAX_VIEWS * 6];
+	for (int i = 0; i < frustumCount; i++)
+	{
+		ExtractFrustumPlanes(viewProjections[i], &frustumPlanes[i * 6]);
+	}
+
+	m_pComputeShader->use();
+	m_pComputeShader->setUIntValue("drawCount", (GLuint)drawCount);
+	m_pComputeShader->setUIntValue("groupCount", (GLuint)groupCount);
+	m_pComputeShader->setUIntValue("viewFrustums", (GLuint)frustumsPerView);
+	m_pComputeShader->setVec4ArrayValue("frustumPlanes", frustumPlanes, frustumCount * 6);
+	m_pComputeShader->setMat4Value("viewProjection", viewProjections[0]);
+
+	// the depth of a point is its dot product with the last row
+	// of the view projection, and the vertical scale of the
+	// projection is the length of the second row, as the view
+	// only rotates. A perspective projection takes the depth
+	// from the view direction, an orthographic one keeps it 1.
+	bool bSelectLOD = (m_lodCommandBuffer != 0) && (NULL != viewportHeights);
+	m_pComputeShader->setBoolValue("bSelectLOD", bSelectLOD);
+	if (bSelectLOD)
+	{
+		glm::vec4 lodViews[MAX_VIEWS * 2];
+		for (int i = 0; i < viewCount; i++)
+		{
+			const glm::mat4& viewProjection = viewProjections[i * frustumsPerView];
+			glm::vec4 depthRow(viewProjection[0][3], viewProjection[1][3], viewProjection[2][3], viewProjection[3][3]);
+			glm::vec3 heightRow(viewProjection[0][1], viewProjection[1][1], viewProjection[2][1]);
+			bool bPerspective = (glm::length(glm::vec3(depthRow)) > 0.5f);
+			lodViews[i * 2] = depthRow;
+			lodViews[i * 2 + 1] = glm::vec4(glm::length(heightRow) * (float)viewportHeights[i], bPerspective ? 1.0f : 0.0f, 0.0f, 0.0f);
+		}
+		m_pComputeShader->setVec4ArrayValue("lodViews", lodViews, viewCount * 2);
+		m_pComputeShader->setIntValue("lodLevelCount", m_lodLevelCount);
+		m_pComputeShader->setVec4Value("lodPixelThresholds", m_lodPixelThresholds);
+		m_pComputeShader->setFloatValue("lodHysteresis", m_lodHysteresis);
+		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, LOD_COMMAND_BINDING, m_lodCommandBuffer);
+		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, LOD_LEVEL_BINDING, m_lodLevelBuffer);
+	}
+
+	bool bUseHiZ = (m_hiZTexture != 0);
+	m_pComputeShader->setBoolValue("bUseHiZ", bUseHiZ);
+	if (bUseHiZ)
+	{
+		GLStateCache::BindTexture(HIZ_TEXTURE_UNIT, GL_TEXTURE_2D, m_hiZTexture);
+		m_pComputeShader->setIntValue("hiZTexture", HIZ_TEXTURE_UNIT);
+		m_pComputeShader->setVec2Value("hiZSize", m_hiZSize);
+		m_pComputeShader->setIntValue("hiZLevels", m_hiZLevels);
+	}
+
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, SOURCE_COMMAND_BINDING, sourceCommandBuffer);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, DRAW_BOUNDS_BINDING, drawBoundsBuffer);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, CULLED_COMMAND_BINDING, m_commandBuffer);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, LOCAL_OFFSET_BINDING, m_localOffsetBuffer);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, GROUP_OFFSET_BINDING, m_groupOffsetBuffer);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, DRAW_COUNT_BINDING, m_drawCountBuffer);
+
+	// the occlusion counters are added to by the first pass
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, m_drawCountBuffer);
+	glClearBufferData(GL_SHADER_STORAGE_BUFFER, GL_R32UI, GL_RED_INTEGER, GL_UNSIGNED_INT, NULL);
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+	m_pComputeShader->setIntValue("cullPass", g_PassCull);
+	glDispatchCompute(groupCount, viewCount, 1);
+	glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+
+	m_pComputeShader->setIntValue("cullPass", g_PassScanGroups);
+	glDispatchCompute(1, viewCount, 1);
+	glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+
+	m_pComputeShader->setIntValue("cullPass", g_PassCompact);
+	glDispatchCompute(groupCount, viewCount, 1);
+
+	// the compacted commands and the count are read by the
+	// following indirect draw
+	glMemoryBarrier(GL_COMMAND_BARRIER_BIT | GL_SHADER_STORAGE_BARRIER_BIT);
+}
+
+/***********************************************************
+ *  GetCommandOffset()
+ *
+ *  This method is used for getting the byte offset of the
+ *  first compacted command of a view, which is where its
+ *  indirect draw reads from.
+ ***********************************************************/
+GLintptr GPUCulling::GetCommandOffset(int view) const
+{
+	return((GLintptr)view * m_viewDrawStride * g_CommandSize);
+}
+
+/***********************************************************
+ *  GetDrawCountOffset()
+ *
+ *  This method is used for getting the byte offset of the
+ *  visible draw count of a view in the draw count buffer.
+ ***********************************************************/
+GLintptr GPUCulling::GetDrawCountOffset(int view) const
+{
+	return((GLintptr)view * g_DrawCountValues * sizeof(GLuint));
+}
+
+/***********************************************************
+ *  ReadCullStats()
+ *
+ *  This method is used for reading back how many draws were
+ *  visible in a view and how many were hidden behind the
+ *  occluders in the last cull. It waits for the GPU to
+ *  finish.
+ ***********************************************************/
+GPUCulling::CULL_STATS GPUCulling::ReadCullStats(int view) const
+{
+	CULL_STATS stats;
+	stats.visibleDrawCount = 0;
+	stats.occludedDrawCount = 0;
+	stats.occludedArea = 0.0f;
+	if (m_drawCountBuffer == 0)
+	{
+		return(stats);
+	}
+
+	GLuint values[g_DrawCountValues] = { 0, 0, 0 };
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, m_drawCountBuffer);
+	glGetBufferSubData(GL_SHADER_STORAGE_BUFFER, GetDrawCountOffset(view), sizeof(values), values);
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+	stats.visibleDrawCount = (int)values[0];
+	stats.occludedDrawCount = (int)values[1];
+	stats.occludedArea = (float)values[2] / g_OccludedAreaScale;
+	return(stats);
+}
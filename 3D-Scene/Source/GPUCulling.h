@@ -0,0 +1,144 @@
+///////////////////////////////////////////////////////////////////////////////
+// gpuculling.h
+// ============
+// cull the draws of an indirect command buffer against the view frustums,
+// and optionally a Hi-Z depth pyramid, with a compute shader
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "ComputeShader.h"
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+
+/***********************************************************
+ *  GPUCulling
+ *
+ *  This class tests the world space bounding sphere of every
+ *  draw on the GPU and writes the visible draw commands, in
+ *  their original order, to a compacted indirect buffer. The
+ *  number of visible draws is written to a parameter buffer,
+ *  so the CPU never reads back the result and the work it
+ *  does per frame does not grow with the number of draws.
+ *  Several views are culled by the same dispatches, each
+ *  into its own range of the compacted buffer.
+ ***********************************************************/
+class GPUCulling
+{
+public:
+	// constructor
+	GPUCulling();
+	// destructor
+	~GPUCulling();
+
+	// storage buffer binding points used by the cull shader
+	static const GLuint SOURCE_COMMAND_BINDING = 0;
+	static const GLuint DRAW_BOUNDS_BINDING = 1;
+	static const GLuint CULLED_COMMAND_BINDING = 2;
+	static const GLuint LOCAL_OFFSET_BINDING = 3;
+	static const GLuint GROUP_OFFSET_BINDING = 4;
+	static const GLuint DRAW_COUNT_BINDING = 5;
+	static const GLuint LOD_COMMAND_BINDING = 6;
+	static const GLuint LOD_LEVEL_BINDING = 7;
+	// texture unit the Hi-Z pyramid is bound to while culling, past
+	// the units used by the scene textures
+	static const GLuint HIZ_TEXTURE_UNIT = 16;
+	// most frustums culled against at once, matching MAX_VIEWS
+	// in the shader
+	static const int MAX_VIEWS = 4;
+	// most detail levels a draw can be drawn at, matching
+	// MAX_LOD_LEVELS in the shader
+	static const int MAX_LOD_LEVELS = 4;
+
+	// results of the last cull, read back for statistics
+	struct CULL_STATS
+	{
+		int visibleDrawCount;
+		// draws inside the frustum but hidden in the pyramid
+		int occludedDrawCount;
+		// fraction of the screen covered by the bounds of the
+		// occluded draws, summed over the draws
+		float occludedArea;
+	};
+
+	// load the cull compute shader
+	bool Initialize(const char* computeShaderPath);
+	// free the compute program and the buffers
+	void Destroy();
+	// true when the cull shader was loaded
+	bool IsInitialized() const { return m_pComputeShader != NULL; }
+
+	// set the depth pyramid used for occlusion culling, the
+	// texture 0 turns occlusion culling off
+	void SetHiZTexture(GLuint texture, int width, int height, int levels);
+	// set the commands of every detail level of every draw, in
+	// groups of levelCount, and the projected sizes in pixels
+	// below which the next coarser level is drawn. The buffer
+	// 0 turns the level selection off
+	void SetLODSelection(GLuint lodCommandBuffer, int levelCount, const float* pixelThresholds, float hysteresis);
+
+	// cull the draws of the source command buffer with the
+	// bounding spheres in the bounds buffer, against the view
+	// projection of every view, the pyramid only hides draws
+	// from the first view. A view with several frustums, like
+	// the two eyes of a stereo view, keeps the draws inside
+	// any of them. With the viewport height of every view the
+	// visible draws get the detail level of their size in it
+	void Cull(
+		GLuint sourceCommandBuffer,
+		GLuint drawBoundsBuffer,
+		int drawCount,
+		const glm::mat4* viewProjections,
+		int viewCount,
+		int frustumsPerView = 1,
+		const int* viewportHeights = NULL);
+
+	// get the compacted commands and the visible draw counts
+	GLuint GetCommandBuffer() const { return m_commandBuffer; }
+	GLuint GetDrawCountBuffer() const { return m_drawCountBuffer; }
+	// get the byte offsets of the commands and the draw count
+	// of a view in the buffers above
+	GLintptr GetCommandOffset(int view) const;
+	GLintptr GetDrawCountOffset(int view) const;
+	// read back the results of a view in the last cull, which
+	// waits for the GPU so it is only meant for statistics
+	CULL_STATS ReadCullStats(int view = 0) const;
+
+	// get the normalized frustum planes of a view projection,
+	// also used for culling on the CPU
+	static void ExtractFrustumPlanes(const glm::mat4& viewProjection, glm::vec4 planes[6]);
+
+private:
+	// the compiled cull compute shader
+	ComputeShader* m_pComputeShader;
+	// compacted commands and the scratch buffers of the passes
+	GLuint m_commandBuffer;
+	GLuint m_localOffsetBuffer;
+	GLuint m_groupOffsetBuffer;
+	GLuint m_drawCountBuffer;
+	// level each draw was drawn at in each view, kept for the
+	// hysteresis of the next cull
+	GLuint m_lodLevelBuffer;
+	// number of draws and views the buffers have room for
+	int m_drawCapacity;
+	int m_viewCapacity;
+	// draws of the last cull, which is the number of commands
+	// between the ranges of two views
+	int m_viewDrawStride;
+	// depth pyramid used for occlusion culling
+	GLuint m_hiZTexture;
+	glm::vec2 m_hiZSize;
+	int m_hiZLevels;
+	// commands of the detail levels and the level thresholds
+	GLuint m_lodCommandBuffer;
+	int m_lodLevelCount;
+	glm::vec4 m_lodPixelThresholds;
+	float m_lodHysteresis;
+
+	// grow the buffers to hold the passed in number of draws
+	// for every view
+	void ReserveDraws(int drawCount, int viewCount);
+	// forget the levels the draws were drawn at
+	void ClearLODLevels();
+};
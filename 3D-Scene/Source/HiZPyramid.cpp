@@ -0,0 +1,291 @@
+///////////////////////////////////////////////////////////////////////////////
+// hizpyramid.cpp
+// ============
+// reduce the depth buffer of the frame into a chain of smaller levels that
+// each hold the farthest depth they cover, for culling hidden draws
+///////////////////////////////////////////////////////////////////////////////
+
+#include "HiZPyramid.h"
+#include "GLStateCache.h"
+
+#include <algorithm>
+#include <iostream>
+
+// declaration of the global variables and defines
+namespace
+{
+	// invocations per workgroup along each axis, matching the
+	// local size in the reduction shader
+	const int g_ReduceGroupSize = 8;
+	// image unit each level is written through
+	const GLuint g_DestinationImageUnit = 0;
+	// fraction of the window the debug view covers
+	const float g_DebugViewScale = 0.35f;
+}
+
+/***********************************************************
+ *  HiZPyramid()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+HiZPyramid::HiZPyramid(RenderTargetManager* pRenderTargets)
+{
+	m_pRenderTargets = pRenderTargets;
+	m_pyramidTarget = -1;
+	m_pComputeShader = NULL;
+	m_pDebugShaderManager = NULL;
+	m_vao = 0;
+	m_bBuilt = false;
+}
+
+/***********************************************************
+ *  ~HiZPyramid()
+ *
+ *  The destructor for the class
+ ***********************************************************/
+HiZPyramid::~HiZPyramid()
+{
+	Destroy();
+}
+
+/***********************************************************
+ *  Initialize()
+ *
+ *  This method is used for loading the reduction shader and
+ *  adding the pyramid to the render targets. Compute shaders
+ *  and image stores need OpenGL 4.3, so nothing is created on
+ *  older drivers and no draw is ever found to be hidden.
+ *  The debug view is optional.
+ ***********************************************************/
+bool HiZPyramid::Initialize(
+	const char* computeShaderPath,
+	const char* debugVertexShaderPath,
+	const char* debugFragmentShaderPath)
+{
+	if (!GLEW_VERSION_4_3)
+	{
+		std::cout << "Occlusion culling disabled: OpenGL 4.3 is not available" << std::endl;
+		return(false);
+	}
+
+	m_pComputeShader = new ComputeShader();
+	if (!m_pComputeShader->LoadShader(computeShaderPath))
+	{
+		delete m_pComputeShader;
+		m_pComputeShader = NULL;
+		return(false);
+	}
+
+	// the levels are only ever read with texelFetch and with
+	// textureLod at whole levels, so no filtering is wanted
+	RenderTargetManager::RENDER_TARGET_DESC desc;
+	desc.internalFormat = GL_R32F;
+	desc.bTexture = true;
+	desc.bMipmapped = true;
+	desc.sizeScale = 0.5f;
+	desc.fixedWidth = 0;
+	desc.fixedHeight = 0;
+	m_pyramidTarget = m_pRenderTargets->AddTarget(desc);
+
+	m_pDebugShaderManager = new ShaderManager();
+	if (m_pDebugShaderManager->LoadShaders(debugVertexShaderPath, debugFragmentShaderPath) == 0)
+	{
+		std::cout << "Hi-Z debug view shaders did not load" << std::endl;
+		delete m_pDebugShaderManager;
+		m_pDebugShaderManager = NULL;
+	}
+	else
+	{
+		// the view makes its triangle from the vertex index alone,
+		// but a core profile still needs a vertex array bound
+		glGenVertexArrays(1, &m_vao);
+	}
+
+	return(true);
+}
+
+/***********************************************************
+ *  Destroy()
+ *
+ *  This method is used for freeing the shaders and giving
+ *  the pyramid back to the render target manager.
+ ***********************************************************/
+void HiZPyramid::Destroy()
+{
+	if (NULL != m_pComputeShader)
+	{
+		delete m_pComputeShader;
+		m_pComputeShader = NULL;
+	}
+	if (m_vao != 0)
+	{
+		GLStateCache::BindVertexArray(0);
+		glDeleteVertexArrays(1, &m_vao);
+		m_vao = 0;
+	}
+	if (NULL != m_pDebugShaderManager)
+	{
+		GLStateCache::ForgetProgram(m_pDebugShaderManager->m_programID);
+		delete m_pDebugShaderManager;
+		m_pDebugShaderManager = NULL;
+	}
+	if ((NULL != m_pRenderTargets) && (m_pyramidTarget >= 0))
+	{
+		m_pRenderTargets->RemoveTarget(m_pyramidTarget);
+	}
+	m_pRenderTargets = NULL;
+	m_pyramidTarget = -1;
+	m_bBuilt = false;
+}
+
+/***********************************************************
+ *  GetTexture()
+ *
+ *  This method is used for getting the pyramid texture, 0
+ *  while it is not allocated.
+ ***********************************************************/
+GLuint HiZPyramid::GetTexture() const
+{
+	if ((NULL == m_pRenderTargets) || (m_pyramidTarget < 0))
+	{
+		return(0);
+	}
+	return(m_pRenderTargets->GetTargetName(m_pyramidTarget));
+}
+
+/***********************************************************
+ *  GetSize()
+ *
+ *  This method is used for getting the size of the first
+ *  level of the pyramid in texels.
+ ***********************************************************/
+glm::ivec2 HiZPyramid::GetSize() const
+{
+	if ((NULL == m_pRenderTargets) || (m_pyramidTarget < 0))
+	{
+		return(glm::ivec2(0));
+	}
+	return(m_pRenderTargets->GetTargetSize(m_pyramidTarget));
+}
+
+/***********************************************************
+ *  GetLevels()
+ *
+ *  This method is used for getting the number of levels of
+ *  the pyramid, down to 1x1.
+ ***********************************************************/
+int HiZPyramid::GetLevels() const
+{
+	if ((NULL == m_pRenderTargets) || (m_pyramidTarget < 0))
+	{
+		return(0);
+	}
+	return(m_pRenderTargets->GetTargetLevels(m_pyramidTarget));
+}
+
+/***********************************************************
+ *  Build()
+ *
+ *  This method is used for reducing the depth texture into
+ *  the pyramid, one dispatch per level. The first level is
+ *  read from the part of the depth texture the frame was
+ *  drawn into, which is smaller than the texture while the
+ *  resolution is scaled down, and every other level from
+ *  the level above it. Each texel takes the farthest depth
+ *  of every source texel it covers, so the odd sizes of
+ *  the levels never drop a depth.
+ ***********************************************************/
+void HiZPyramid::Build(GLuint depthTexture, const glm::ivec2& renderSize)
+{
+	m_bBuilt = false;
+
+	GLuint pyramidTexture = GetTexture();
+	if ((NULL == m_pComputeShader) || (pyramidTexture == 0) || (depthTexture == 0) ||
+		(renderSize.x <= 0) || (renderSize.y <= 0))
+	{
+		return;
+	}
+
+	m_pComputeShader->use();
+	m_pComputeShader->setIntValue("sourceTexture", PYRAMID_TEXTURE_UNIT);
+
+	glm::ivec2 sourceSize = renderSize;
+	glm::ivec2 levelSize = GetSize();
+	int levels = GetLevels();
+	for (int level = 0; level < levels; level++)
+	{
+		// the level being written is never the one being read
+		if (level == 0)
+		{
+			GLStateCache::BindTexture(PYRAMID_TEXTURE_UNIT, GL_TEXTURE_2D, depthTexture);
+			m_pComputeShader->setIntValue("sourceLevel", 0);
+		}
+		else
+		{
+			GLStateCache::BindTexture(PYRAMID_TEXTURE_UNIT, GL_TEXTURE_2D, pyramidTexture);
+			m_pComputeShader->setIntValue("sourceLevel", level - 1);
+		}
+		m_pComputeShader->setVec2Value("sourceSize", glm::vec2(sourceSize));
+		glBindImageTexture(g_DestinationImageUnit, pyramidTexture, level, GL_FALSE, 0, GL_WRITE_ONLY, GL_R32F);
+
+		glDispatchCompute(
+			(levelSize.x + g_ReduceGroupSize - 1) / g_ReduceGroupSize,
+			(levelSize.y + g_ReduceGroupSize - 1) / g_ReduceGroupSize,
+			1);
+		// the next level and the cull shader read this one
+		glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT | GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
+
+		sourceSize = levelSize;
+		levelSize = glm::max(levelSize / 2, glm::ivec2(1));
+	}
+
+	glBindImageTexture(g_DestinationImageUnit, 0, 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_R32F);
+	GLStateCache::BindTexture(PYRAMID_TEXTURE_UNIT, GL_TEXTURE_2D, 0);
+
+	m_bBuilt = true;
+}
+
+/***********************************************************
+ *  DrawDebugView()
+ *
+ *  This method is used for drawing one level of the pyramid
+ *  into the lower left corner of the window, after the frame
+ *  was presented. The nearer a part of the frame is, the
+ *  darker it shows.
+ ***********************************************************/
+void HiZPyramid::DrawDebugView(int level, const glm::ivec2& windowSize)
+{
+	if ((NULL == m_pDebugShaderManager) || !m_bBuilt)
+	{
+		return;
+	}
+
+	// the view must leave the state the scene relies on as it
+	// found it, which the state cache knows without asking
+	GLuint previousProgram = GLStateCache::GetProgram();
+	bool bBlend = GLStateCache::IsEnabled(GL_BLEND);
+	bool bDepthTest = GLStateCache::IsEnabled(GL_DEPTH_TEST);
+
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	glm::ivec2 viewSize = glm::ivec2(glm::vec2(windowSize) * g_DebugViewScale);
+	glViewport(0, 0, viewSize.x, viewSize.y);
+	GLStateCache::Disable(GL_DEPTH_TEST);
+	GLStateCache::Disable(GL_BLEND);
+
+	GLStateCache::BindTexture(PYRAMID_TEXTURE_UNIT, GL_TEXTURE_2D, GetTexture());
+	GLStateCache::UseProgram(m_pDebugShaderManager);
+	GLStateCache::SetInt(m_pDebugShaderManager, "hiZTexture", PYRAMID_TEXTURE_UNIT);
+	GLStateCache::SetInt(m_pDebugShaderManager, "hiZLevel", std::max(0, std::min(level, GetLevels() - 1)));
+
+	GLStateCache::BindVertexArray(m_vao);
+	glDrawArrays(GL_TRIANGLES, 0, 3);
+
+	GLStateCache::BindTexture(PYRAMID_TEXTURE_UNIT, GL_TEXTURE_2D, 0);
+	glViewport(0, 0, windowSize.x, windowSize.y);
+	GLStateCache::SetEnabled(GL_DEPTH_TEST, bDepthTest);
+	GLStateCache::SetEnabled(GL_BLEND, bBlend);
+	if (previousProgram != 0)
+	{
+		GLStateCache::UseProgram(previousProgram);
+	}
+}
@@ -0,0 +1,80 @@
+///////////////////////////////////////////////////////////////////////////////
+// hizpyramid.h
+// ============
+// reduce the depth buffer of the frame into a chain of smaller levels that
+// each hold the farthest depth they cover, for culling hidden draws
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "ComputeShader.h"
+#include "RenderTargetManager.h"
+#include "ShaderManager.h"
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+
+/***********************************************************
+ *  HiZPyramid
+ *
+ *  This class builds a Hi-Z pyramid from a depth buffer with
+ *  a compute shader. The first level is half the size of the
+ *  framebuffer and every texel of a level holds the farthest
+ *  depth of the texels under it in the level above, so a
+ *  bounding box is known to be hidden when its nearest depth
+ *  is behind the farthest depth of the few texels covering
+ *  it. The pyramid is a mipmapped render target, so it is
+ *  allocated again when the size of the window changes, and
+ *  it can be drawn into a corner of the window for checking
+ *  which parts of the frame hide the others.
+ ***********************************************************/
+class HiZPyramid
+{
+public:
+	// constructor
+	HiZPyramid(RenderTargetManager* pRenderTargets);
+	// destructor
+	~HiZPyramid();
+
+	// texture unit the level being read is bound to, past the
+	// units used by the scene, the culling, the upscaling and
+	// the state cache
+	static const GLuint PYRAMID_TEXTURE_UNIT = 19;
+
+	// load the reduction compute shader and the debug view shaders
+	bool Initialize(
+		const char* computeShaderPath,
+		const char* debugVertexShaderPath,
+		const char* debugFragmentShaderPath);
+	// free the shaders and give the pyramid back
+	void Destroy();
+	// true when the reduction shader was loaded
+	bool IsInitialized() const { return m_pComputeShader != NULL; }
+
+	// build every level from the part of the depth texture the
+	// frame was drawn into
+	void Build(GLuint depthTexture, const glm::ivec2& renderSize);
+	// true when the pyramid holds the depth of a drawn frame
+	bool IsBuilt() const { return m_bBuilt; }
+
+	// get the pyramid texture, its first level size and the
+	// number of levels
+	GLuint GetTexture() const;
+	glm::ivec2 GetSize() const;
+	int GetLevels() const;
+
+	// draw one level of the pyramid into the lower left corner
+	// of the window
+	void DrawDebugView(int level, const glm::ivec2& windowSize);
+
+private:
+	// pointer to the owner of the pyramid texture
+	RenderTargetManager* m_pRenderTargets;
+	int m_pyramidTarget;
+	// the compiled reduction compute shader
+	ComputeShader* m_pComputeShader;
+	// shaders and the empty vertex array of the debug view
+	ShaderManager* m_pDebugShaderManager;
+	GLuint m_vao;
+	bool m_bBuilt;
+};
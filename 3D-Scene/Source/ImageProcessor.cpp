@@ -0,0 +1,869 @@
+///////////////////////////////////////////////////////////////////////////////
+// imageprocessor.cpp
+// ============
+// convert the decoded texture images to RGBA8 and scale them down to the
+// maximum texture size, with scalar, SSE and AVX2 versions of each kernel
+///////////////////////////////////////////////////////////////////////////////
+
+#include "ImageProcessor.h"
+
+#include "stb_image.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+
+#if defined(_M_IX86) || defined(_M_X64) || defined(__i386__) || defined(__x86_64__)
+#define IMAGE_SIMD 1
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+#else
+#define IMAGE_SIMD 0
+#endif
+
+// the SSE and AVX2 kernels are compiled for their instruction
+// sets on their own, so the rest of the program still runs on
+// processors without them
+#if IMAGE_SIMD && (defined(__GNUC__) || defined(__clang__))
+#define TARGET_SSE __attribute__((target("ssse3,sse4.1")))
+#define TARGET_AVX2 __attribute__((target("avx2")))
+#else
+#define TARGET_SSE
+#define TARGET_AVX2
+#endif
+
+// declaration of the global variables and defines
+namespace
+{
+	// lobes of the Lanczos filter on each side
+	const float g_LanczosRadius = 3.0f;
+	// entries of the table encoding linear values into sRGB
+	const int g_EncodeTableSize = 4096;
+	// times each kernel is run by the benchmark
+	const int g_BenchmarkRuns = 10;
+
+	const char* g_PathNames[] = { "scalar", "SSE", "AVX2" };
+
+	// version of the kernels, chosen on first use
+	bool g_bPathChosen = false;
+	ImageProcessor::KERNEL_PATH g_KernelPath = ImageProcessor::PATH_SCALAR;
+
+	// conversion tables between sRGB and linear values
+	struct CONVERSION_TABLES
+	{
+		// the first 256 entries decode an sRGB color byte, the
+		// next 256 an alpha byte, so one lookup handles a pixel
+		float decode[512];
+		// sRGB byte of a linear value scaled to the table size
+		int encode[g_EncodeTableSize];
+	};
+
+	// get the conversion tables, built on first use
+	const CONVERSION_TABLES& GetTables()
+	{
+		static CONVERSION_TABLES tables;
+		static bool bBuilt = false;
+		if (!bBuilt)
+		{
+			for (int i = 0; i < 256; i++)
+			{
+				float value = i / 255.0f;
+				tables.decode[i] = (value <= 0.04045f) ? value / 12.92f : powf((value + 0.055f) / 1.055f, 2.4f);
+				tables.decode[256 + i] = value;
+			}
+			for (int i = 0; i < g_EncodeTableSize; i++)
+			{
+				float value = (float)i / (g_EncodeTableSize - 1);
+				float encoded = (value <= 0.0031308f) ? value * 12.92f : 1.055f * powf(value, 1.0f / 2.4f) - 0.055f;
+				tables.encode[i] = std::min(255, std::max(0, (int)(encoded * 255.0f + 0.5f)));
+			}
+			bBuilt = true;
+		}
+		return(tables);
+	}
+
+	// weights of the source texels each destination texel is
+	// filtered from, along one axis
+	struct FILTER_TAPS
+	{
+		std::vector<int> first;
+		std::vector<int> count;
+		// count weights of each destination texel, stride apart
+		std::vector<float> weights;
+		int stride;
+	};
+
+	// get the weight of a filter for a source texel at a distance
+	// in destination texels, and as wide as the passed in part of
+	// a destination texel
+	float FilterWeight(ImageProcessor::RESIZE_FILTER filter, float distance, float texelWidth)
+	{
+		if (filter == ImageProcessor::FILTER_BOX)
+		{
+			// the part of the source texel the destination texel
+			// covers, so the texels on the edges of a footprint
+			// that is not a whole number of texels count partly
+			float covered = std::min(distance + texelWidth * 0.5f, 0.5f) - std::max(distance - texelWidth * 0.5f, -0.5f);
+			// rounding leaves a trace of the neighbors of a texel
+			// lying exactly on the edge
+			return((covered > texelWidth * 1e-4f) ? covered : 0.0f);
+		}
+
+		if (fabsf(distance) >= g_LanczosRadius)
+		{
+			return(0.0f);
+		}
+		if (fabsf(distance) < 1e-5f)
+		{
+			return(1.0f);
+		}
+		const float pi = 3.14159265f;
+		float x = pi * distance;
+		return(g_LanczosRadius * sinf(x) * sinf(x / g_LanczosRadius) / (x * x));
+	}
+
+	// find the weights scaling an axis down from the source to
+	// the destination size. The taps past the edges are left
+	// out and the rest normalized, so the edges stay as bright
+	void BuildFilterTaps(int sourceSize, int destSize, ImageProcessor::RESIZE_FILTER filter, FILTER_TAPS& taps)
+	{
+		float scale = (float)sourceSize / destSize;
+		float support = ((filter == ImageProcessor::FILTER_LANCZOS) ? g_LanczosRadius : 0.5f) * scale;
+		taps.stride = (int)ceilf(support * 2.0f) + 2;
+		taps.first.resize(destSize);
+		taps.count.resize(destSize);
+		taps.weights.assign((size_t)destSize * taps.stride, 0.0f);
+
+		for (int d = 0; d < destSize; d++)
+		{
+			float center = (d + 0.5f) * scale;
+			int first = std::max(0, (int)floorf(center - support));
+			int last = std::min(sourceSize - 1, (int)ceilf(center + support));
+			float* weights = &taps.weights[(size_t)d * taps.stride];
+
+			int count = 0;
+			float sum = 0.0f;
+			for (int s = first; (s <= last) && (count < taps.stride); s++)
+			{
+				float weight = FilterWeight(filter, (s + 0.5f - center) / scale, 1.0f / scale);
+				// skip the empty taps in front
+				if ((count == 0) && (weight == 0.0f))
+				{
+					first++;
+					continue;
+				}
+				weights[count++] = weight;
+				sum += weight;
+			}
+			// and the empty taps at the back
+			while ((count > 1) && (weights[count - 1] == 0.0f))
+			{
+				count--;
+			}
+			if (count == 0)
+			{
+				// a destination texel always takes its nearest texel
+				first = std::min(sourceSize - 1, (int)center);
+				weights[0] = 1.0f;
+				count = 1;
+				sum = 1.0f;
+			}
+			for (int i = 0; i < count; i++)
+			{
+				weights[i] /= sum;
+			}
+			taps.first[d] = first;
+			taps.count[d] = count;
+		}
+	}
+
+	/***********************************************************
+	 *  scalar kernels
+	 ***********************************************************/
+
+	// source channel of each RGBA channel, 4 for an opaque alpha
+	const int g_ChannelSources[4][4] =
+	{
+		{ 0, 0, 0, 4 },
+		{ 0, 0, 0, 1 },
+		{ 0, 1, 2, 4 },
+		{ 0, 1, 2, 3 }
+	};
+
+	void ExpandScalar(const unsigned char* source, int channels, int first, int pixelCount, unsigned char* rgba)
+	{
+		const int* sources = g_ChannelSources[channels - 1];
+		for (int i = first; i < pixelCount; i++)
+		{
+			const unsigned char* pixel = source + (size_t)i * channels;
+			for (int c = 0; c < 4; c++)
+			{
+				rgba[(size_t)i * 4 + c] = (sources[c] < 4) ? pixel[sources[c]] : 255;
+			}
+		}
+	}
+
+	void DecodeScalar(const unsigned char* rgba, int first, int pixelCount, float* linear)
+	{
+		const float* decode = GetTables().decode;
+		for (int i = first; i < pixelCount; i++)
+		{
+			const unsigned char* pixel = rgba + (size_t)i * 4;
+			float alpha = decode[256 + pixel[3]];
+			linear[i * 4 + 0] = decode[pixel[0]] * alpha;
+			linear[i * 4 + 1] = decode[pixel[1]] * alpha;
+			linear[i * 4 + 2] = decode[pixel[2]] * alpha;
+			linear[i * 4 + 3] = alpha;
+		}
+	}
+
+	void EncodeScalar(const float* linear, int first, int pixelCount, unsigned char* rgba)
+	{
+		const int* encode = GetTables().encode;
+		for (int i = first; i < pixelCount; i++)
+		{
+			const float* pixel = linear + (size_t)i * 4;
+			float alpha = std::min(1.0f, std::max(0.0f, pixel[3]));
+			float inverseAlpha = (alpha > 0.0f) ? 1.0f / alpha : 0.0f;
+			for (int c = 0; c < 3; c++)
+			{
+				float value = std::min(1.0f, std::max(0.0f, pixel[c] * inverseAlpha));
+				rgba[(size_t)i * 4 + c] = (unsigned char)encode[(int)(value * (g_EncodeTableSize - 1) + 0.5f)];
+			}
+			rgba[(size_t)i * 4 + 3] = (unsigned char)(int)(alpha * 255.0f + 0.5f);
+		}
+	}
+
+	void FilterRowScalar(const float* source, const FILTER_TAPS& taps, int destWidth, float* dest)
+	{
+		for (int d = 0; d < destWidth; d++)
+		{
+			const float* weights = &taps.weights[(size_t)d * taps.stride];
+			const float* texel = source + (size_t)taps.first[d] * 4;
+			float sum[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+			for (int k = 0; k < taps.count[d]; k++)
+			{
+				for (int c = 0; c < 4; c++)
+				{
+					sum[c] += weights[k] * texel[k * 4 + c];
+				}
+			}
+			memcpy(dest + (size_t)d * 4, sum, sizeof(sum));
+		}
+	}
+
+	void BlendRowsScalar(const float* const* rows, const float* weights, int rowCount, int first, int floatCount, float* dest)
+	{
+		for (int i = first; i < floatCount; i++)
+		{
+			float sum = 0.0f;
+			for (int k = 0; k < rowCount; k++)
+			{
+				sum += weights[k] * rows[k][i];
+			}
+			dest[i] = sum;
+		}
+	}
+
+#if IMAGE_SIMD
+	/***********************************************************
+	 *  SSE kernels
+	 ***********************************************************/
+
+	// byte shuffles expanding four pixels of one to three
+	// channels into RGBA, 0x80 clears the byte for the alpha
+	const char g_ExpandShuffles[3][16] =
+	{
+		{ 0, 0, 0, -128, 1, 1, 1, -128, 2, 2, 2, -128, 3, 3, 3, -128 },
+		{ 0, 0, 0, 1, 2, 2, 2, 3, 4, 4, 4, 5, 6, 6, 6, 7 },
+		{ 0, 1, 2, -128, 3, 4, 5, -128, 6, 7, 8, -128, 9, 10, 11, -128 }
+	};
+
+	// the number of pixels a vector kernel can expand without
+	// its 16 byte loads reading past the end of the source
+	int GetExpandLimit(int channels, int pixelCount, int step)
+	{
+		int limit = 0;
+		while ((limit + step <= pixelCount) && ((size_t)(limit + step - 4) * channels + 16 <= (size_t)pixelCount * channels))
+		{
+			limit += step;
+		}
+		return(limit);
+	}
+
+	TARGET_SSE int ExpandSSE(const unsigned char* source, int channels, int pixelCount, unsigned char* rgba)
+	{
+		__m128i shuffle = _mm_loadu_si128((const __m128i*)g_ExpandShuffles[channels - 1]);
+		__m128i alpha = _mm_set1_epi32((channels == 2) ? 0 : (int)0xFF000000);
+		int limit = GetExpandLimit(channels, pixelCount, 4);
+		for (int i = 0; i < limit; i += 4)
+		{
+			__m128i pixels = _mm_loadu_si128((const __m128i*)(source + (size_t)i * channels));
+			pixels = _mm_or_si128(_mm_shuffle_epi8(pixels, shuffle), alpha);
+			_mm_storeu_si128((__m128i*)(rgba + (size_t)i * 4), pixels);
+		}
+		return(limit);
+	}
+
+	TARGET_SSE void DecodeSSE(const unsigned char* rgba, int pixelCount, float* linear)
+	{
+		// the table lookups are scalar, the premultiply is not
+		const float* decode = GetTables().decode;
+		for (int i = 0; i < pixelCount; i++)
+		{
+			const unsigned char* pixel = rgba + (size_t)i * 4;
+			__m128 color = _mm_setr_ps(decode[pixel[0]], decode[pixel[1]], decode[pixel[2]], 1.0f);
+			__m128 alpha = _mm_set1_ps(decode[256 + pixel[3]]);
+			_mm_storeu_ps(linear + (size_t)i * 4, _mm_mul_ps(color, alpha));
+		}
+	}
+
+	TARGET_SSE void EncodeSSE(const float* linear, int pixelCount, unsigned char* rgba)
+	{
+		const int* encode = GetTables().encode;
+		const __m128 zero = _mm_setzero_ps();
+		const __m128 one = _mm_set1_ps(1.0f);
+		const __m128 half = _mm_set1_ps(0.5f);
+		const __m128 tableScale = _mm_set1_ps((float)(g_EncodeTableSize - 1));
+		alignas(16) int indices[4];
+		for (int i = 0; i < pixelCount; i++)
+		{
+			__m128 pixel = _mm_loadu_ps(linear + (size_t)i * 4);
+			__m128 alpha = _mm_shuffle_ps(pixel, pixel, _MM_SHUFFLE(3, 3, 3, 3));
+			alpha = _mm_min_ps(_mm_max_ps(alpha, zero), one);
+			// a fully transparent texel divides by zero, the mask
+			// turns its color black
+			__m128 inverseAlpha = _mm_and_ps(_mm_div_ps(one, alpha), _mm_cmpgt_ps(alpha, zero));
+			__m128 color = _mm_min_ps(_mm_max_ps(_mm_mul_ps(pixel, inverseAlpha), zero), one);
+			_mm_store_si128((__m128i*)indices, _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(color, tableScale), half)));
+
+			unsigned char* out = rgba + (size_t)i * 4;
+			out[0] = (unsigned char)encode[indices[0]];
+			out[1] = (unsigned char)encode[indices[1]];
+			out[2] = (unsigned char)encode[indices[2]];
+			out[3] = (unsigned char)_mm_cvttss_si32(_mm_add_ss(_mm_mul_ss(alpha, _mm_set_ss(255.0f)), half));
+		}
+	}
+
+	TARGET_SSE void FilterRowSSE(const float* source, const FILTER_TAPS& taps, int destWidth, float* dest)
+	{
+		// a pixel fills one vector, so each tap is one multiply
+		for (int d = 0; d < destWidth; d++)
+		{
+			const float* weights = &taps.weights[(size_t)d * taps.stride];
+			const float* texel = source + (size_t)taps.first[d] * 4;
+			__m128 sum = _mm_setzero_ps();
+			for (int k = 0; k < taps.count[d]; k++)
+			{
+				sum = _mm_add_ps(sum, _mm_mul_ps(_mm_set1_ps(weights[k]), _mm_loadu_ps(texel + k * 4)));
+			}
+			_mm_storeu_ps(dest + (size_t)d * 4, sum);
+		}
+	}
+
+	TARGET_SSE int BlendRowsSSE(const float* const* rows, const float* weights, int rowCount, int floatCount, float* dest)
+	{
+		int limit = floatCount & ~3;
+		for (int i = 0; i < limit; i += 4)
+		{
+			__m128 sum = _mm_setzero_ps();
+			for (int k = 0; k < rowCount; k++)
+			{
+				sum = _mm_add_ps(sum, _mm_mul_ps(_mm_set1_ps(weights[k]), _mm_loadu_ps(rows[k] + i)));
+			}
+			_mm_storeu_ps(dest + i, sum);
+		}
+		return(limit);
+	}
+
+	/***********************************************************
+	 *  AVX2 kernels
+	 ***********************************************************/
+
+	TARGET_AVX2 int ExpandAVX2(const unsigned char* source, int channels, int pixelCount, unsigned char* rgba)
+	{
+		// the shuffle stays within each half, so each half
+		// expands four pixels loaded on their own
+		__m128i shuffle128 = _mm_loadu_si128((const __m128i*)g_ExpandShuffles[channels - 1]);
+		__m256i shuffle = _mm256_broadcastsi128_si256(shuffle128);
+		__m256i alpha = _mm256_set1_epi32((channels == 2) ? 0 : (int)0xFF000000);
+		int limit = GetExpandLimit(channels, pixelCount, 8);
+		for (int i = 0; i < limit; i += 8)
+		{
+			const unsigned char* pixel = source + (size_t)i * channels;
+			__m256i pixels = _mm256_inserti128_si256(
+				_mm256_castsi128_si256(_mm_loadu_si128((const __m128i*)pixel)),
+				_mm_loadu_si128((const __m128i*)(pixel + 4 * channels)), 1);
+			pixels = _mm256_or_si256(_mm256_shuffle_epi8(pixels, shuffle), alpha);
+			_mm256_storeu_si256((__m256i*)(rgba + (size_t)i * 4), pixels);
+		}
+		return(limit);
+	}
+
+	TARGET_AVX2 int DecodeAVX2(const unsigned char* rgba, int pixelCount, float* linear)
+	{
+		// the alpha bytes look up the second half of the table
+		const float* decode = GetTables().decode;
+		const __m256i alphaOffset = _mm256_setr_epi32(0, 0, 0, 256, 0, 0, 0, 256);
+		const __m256 one = _mm256_set1_ps(1.0f);
+		int limit = pixelCount & ~3;
+		for (int i = 0; i < limit; i += 4)
+		{
+			__m128i bytes = _mm_loadu_si128((const __m128i*)(rgba + (size_t)i * 4));
+			for (int half = 0; half < 2; half++)
+			{
+				__m256i indices = _mm256_add_epi32(_mm256_cvtepu8_epi32(bytes), alphaOffset);
+				__m256 values = _mm256_i32gather_ps(decode, indices, 4);
+				__m256 alpha = _mm256_shuffle_ps(values, values, _MM_SHUFFLE(3, 3, 3, 3));
+				values = _mm256_mul_ps(values, _mm256_blend_ps(alpha, one, 0x88));
+				_mm256_storeu_ps(linear + (size_t)(i + half * 2) * 4, values);
+				bytes = _mm_srli_si128(bytes, 8);
+			}
+		}
+		return(limit);
+	}
+
+	TARGET_AVX2 int EncodeAVX2(const float* linear, int pixelCount, unsigned char* rgba)
+	{
+		const int* encode = GetTables().encode;
+		const __m256 zero = _mm256_setzero_ps();
+		const __m256 one = _mm256_set1_ps(1.0f);
+		const __m256 half = _mm256_set1_ps(0.5f);
+		const __m256 tableScale = _mm256_set1_ps((float)(g_EncodeTableSize - 1));
+		const __m256 alphaScale = _mm256_set1_ps(255.0f);
+		int limit = pixelCount & ~1;
+		for (int i = 0; i < limit; i += 2)
+		{
+			__m256 pixels = _mm256_loadu_ps(linear + (size_t)i * 4);
+			__m256 alpha = _mm256_shuffle_ps(pixels, pixels, _MM_SHUFFLE(3, 3, 3, 3));
+			alpha = _mm256_min_ps(_mm256_max_ps(alpha, zero), one);
+			__m256 inverseAlpha = _mm256_and_ps(_mm256_div_ps(one, alpha), _mm256_cmp_ps(alpha, zero, _CMP_GT_OQ));
+			__m256 color = _mm256_min_ps(_mm256_max_ps(_mm256_mul_ps(pixels, inverseAlpha), zero), one);
+			__m256i indices = _mm256_cvttps_epi32(_mm256_add_ps(_mm256_mul_ps(color, tableScale), half));
+			__m256i values = _mm256_i32gather_epi32(encode, indices, 4);
+			__m256i alphaBytes = _mm256_cvttps_epi32(_mm256_add_ps(_mm256_mul_ps(alpha, alphaScale), half));
+			values = _mm256_blend_epi32(values, alphaBytes, 0x88);
+
+			// narrow each half to the four bytes of its pixel
+			values = _mm256_packus_epi32(values, values);
+			values = _mm256_packus_epi16(values, values);
+			int first = _mm_cvtsi128_si32(_mm256_castsi256_si128(values));
+			int second = _mm_cvtsi128_si32(_mm256_extracti128_si256(values, 1));
+			memcpy(rgba + (size_t)i * 4, &first, 4);
+			memcpy(rgba + (size_t)i * 4 + 4, &second, 4);
+		}
+		return(limit);
+	}
+
+	TARGET_AVX2 int BlendRowsAVX2(const float* const* rows, const float* weights, int rowCount, int floatCount, float* dest)
+	{
+		int limit = floatCount & ~7;
+		for (int i = 0; i < limit; i += 8)
+		{
+			__m256 sum = _mm256_setzero_ps();
+			for (int k = 0; k < rowCount; k++)
+			{
+				sum = _mm256_add_ps(sum, _mm256_mul_ps(_mm256_set1_ps(weights[k]), _mm256_loadu_ps(rows[k] + i)));
+			}
+			_mm256_storeu_ps(dest + i, sum);
+		}
+		return(limit);
+	}
+#endif
+
+	// filter a row of linear pixels along the row
+	void FilterRow(const float* source, const FILTER_TAPS& taps, int destWidth, float* dest)
+	{
+#if IMAGE_SIMD
+		// a pixel is four floats, so the AVX2 version would only
+		// fill half of its vectors and runs the SSE one instead
+		if (ImageProcessor::GetKernelPath() >= ImageProcessor::PATH_SSE)
+		{
+			FilterRowSSE(source, taps, destWidth, dest);
+			return;
+		}
+#endif
+		FilterRowScalar(source, taps, destWidth, dest);
+	}
+
+	// add up weighted rows of floats
+	void BlendRows(const float* const* rows, const float* weights, int rowCount, int floatCount, float* dest)
+	{
+		int done = 0;
+#if IMAGE_SIMD
+		switch (ImageProcessor::GetKernelPath())
+		{
+		case ImageProcessor::PATH_AVX2:
+			done = BlendRowsAVX2(rows, weights, rowCount, floatCount, dest);
+			break;
+		case ImageProcessor::PATH_SSE:
+			done = BlendRowsSSE(rows, weights, rowCount, floatCount, dest);
+			break;
+		default:
+			break;
+		}
+#endif
+		BlendRowsScalar(rows, weights, rowCount, done, floatCount, dest);
+	}
+
+	// get the time in milliseconds of one run of a kernel,
+	// averaged over the benchmark runs
+	template<typename KERNEL>
+	double TimeKernel(KERNEL kernel)
+	{
+		std::chrono::steady_clock::time_point startTime = std::chrono::steady_clock::now();
+		for (int run = 0; run < g_BenchmarkRuns; run++)
+		{
+			kernel();
+		}
+		std::chrono::duration<double, std::milli> duration = std::chrono::steady_clock::now() - startTime;
+		return(duration.count() / g_BenchmarkRuns);
+	}
+
+	// get the largest difference between two byte images
+	int GetMaxDifference(const std::vector<unsigned char>& first, const std::vector<unsigned char>& second)
+	{
+		int maxDifference = 0;
+		for (size_t i = 0; (i < first.size()) && (i < second.size()); i++)
+		{
+			maxDifference = std::max(maxDifference, std::abs((int)first[i] - (int)second[i]));
+		}
+		return(maxDifference);
+	}
+}
+
+/***********************************************************
+ *  GetSupportedPath()
+ *
+ *  This method is used for finding the fastest version of
+ *  the kernels the processor and the operating system
+ *  support.
+ ***********************************************************/
+ImageProcessor::KERNEL_PATH ImageProcessor::GetSupportedPath()
+{
+#if IMAGE_SIMD && defined(_MSC_VER)
+	int info[4];
+	__cpuid(info, 0);
+	int maxLeaf = info[0];
+	__cpuid(info, 1);
+	bool bSSE = ((info[2] & (1 << 9)) != 0) && ((info[2] & (1 << 19)) != 0);
+	// AVX needs the operating system to save the wide registers
+	bool bOSAVX = ((info[2] & (1 << 27)) != 0) && ((info[2] & (1 << 28)) != 0) &&
+		((_xgetbv(0) & 6) == 6);
+	bool bAVX2 = false;
+	if (bOSAVX && (maxLeaf >= 7))
+	{
+		__cpuidex(info, 7, 0);
+		bAVX2 = (info[1] & (1 << 5)) != 0;
+	}
+	if (bAVX2)
+	{
+		return(PATH_AVX2);
+	}
+	if (bSSE)
+	{
+		return(PATH_SSE);
+	}
+#elif IMAGE_SIMD
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("avx2"))
+	{
+		return(PATH_AVX2);
+	}
+	if (__builtin_cpu_supports("ssse3") && __builtin_cpu_supports("sse4.1"))
+	{
+		return(PATH_SSE);
+	}
+#endif
+	return(PATH_SCALAR);
+}
+
+/***********************************************************
+ *  SetKernelPath()
+ *
+ *  This method is used for choosing the version of the
+ *  kernels, which is lowered to the fastest supported one.
+ ***********************************************************/
+void ImageProcessor::SetKernelPath(KERNEL_PATH path)
+{
+	g_KernelPath = std::min(path, GetSupportedPath());
+	g_bPathChosen = true;
+}
+
+/***********************************************************
+ *  GetKernelPath()
+ *
+ *  This method is used for getting the version of the
+ *  kernels that runs, the fastest supported one until
+ *  another is chosen.
+ ***********************************************************/
+ImageProcessor::KERNEL_PATH ImageProcessor::GetKernelPath()
+{
+	if (!g_bPathChosen)
+	{
+		g_KernelPath = GetSupportedPath();
+		g_bPathChosen = true;
+	}
+	return(g_KernelPath);
+}
+
+/***********************************************************
+ *  GetPathName()
+ *
+ *  This method is used for getting the name of a version of
+ *  the kernels.
+ ***********************************************************/
+const char* ImageProcessor::GetPathName(KERNEL_PATH path)
+{
+	return(g_PathNames[path]);
+}
+
+/***********************************************************
+ *  ExpandToRGBA()
+ *
+ *  This method is used for converting pixels with one to
+ *  four channels into RGBA8. A grey value is copied into the
+ *  three colors, and an image without alpha is opaque.
+ ***********************************************************/
+bool ImageProcessor::ExpandToRGBA(const unsigned char* source, int channels, int pixelCount, unsigned char* rgba)
+{
+	if ((channels < 1) || (channels > 4))
+	{
+		return(false);
+	}
+	if (channels == 4)
+	{
+		memcpy(rgba, source, (size_t)pixelCount * 4);
+		return(true);
+	}
+
+	int done = 0;
+#if IMAGE_SIMD
+	switch (GetKernelPath())
+	{
+	case PATH_AVX2:
+		done = ExpandAVX2(source, channels, pixelCount, rgba);
+		break;
+	case PATH_SSE:
+		done = ExpandSSE(source, channels, pixelCount, rgba);
+		break;
+	default:
+		break;
+	}
+#endif
+	ExpandScalar(source, channels, done, pixelCount, rgba);
+	return(true);
+}
+
+/***********************************************************
+ *  DecodeSRGB()
+ *
+ *  This method is used for converting sRGB RGBA8 pixels into
+ *  linear floats, with the colors multiplied by the alpha.
+ ***********************************************************/
+void ImageProcessor::DecodeSRGB(const unsigned char* rgba, int pixelCount, float* linear)
+{
+#if IMAGE_SIMD
+	switch (GetKernelPath())
+	{
+	case PATH_AVX2:
+		DecodeScalar(rgba, DecodeAVX2(rgba, pixelCount, linear), pixelCount, linear);
+		return;
+	case PATH_SSE:
+		DecodeSSE(rgba, pixelCount, linear);
+		return;
+	default:
+		break;
+	}
+#endif
+	DecodeScalar(rgba, 0, pixelCount, linear);
+}
+
+/***********************************************************
+ *  EncodeSRGB()
+ *
+ *  This method is used for converting linear premultiplied
+ *  floats back into sRGB RGBA8 pixels with straight alpha.
+ *  The values a sharp filter pushed out of range are
+ *  clamped.
+ ***********************************************************/
+void ImageProcessor::EncodeSRGB(const float* linear, int pixelCount, unsigned char* rgba)
+{
+#if IMAGE_SIMD
+	switch (GetKernelPath())
+	{
+	case PATH_AVX2:
+		EncodeScalar(linear, EncodeAVX2(linear, pixelCount, rgba), pixelCount, rgba);
+		return;
+	case PATH_SSE:
+		EncodeSSE(linear, pixelCount, rgba);
+		return;
+	default:
+		break;
+	}
+#endif
+	EncodeScalar(linear, 0, pixelCount, rgba);
+}
+
+/***********************************************************
+ *  ProcessImage()
+ *
+ *  This method is used for converting a decoded image into
+ *  RGBA8 of at most the maximum size. An image that fits is
+ *  only expanded. A larger one is scaled down keeping its
+ *  aspect ratio: each source row is expanded, decoded and
+ *  filtered along the row into a ring of rows, and each
+ *  destination row is blended from the ring and encoded.
+ ***********************************************************/
+bool ImageProcessor::ProcessImage(
+	const unsigned char* image,
+	int width,
+	int height,
+	int channels,
+	const PROCESS_OPTIONS& options,
+	std::vector<unsigned char>& rgba,
+	int& processedWidth,
+	int& processedHeight)
+{
+	if ((channels < 1) || (channels > 4) || (width <= 0) || (height <= 0))
+	{
+		return(false);
+	}
+
+	processedWidth = width;
+	processedHeight = height;
+	int largestSide = std::max(width, height);
+	if ((options.maxSize > 0) && (largestSide > options.maxSize))
+	{
+		float scale = (float)options.maxSize / largestSide;
+		processedWidth = std::max(1, (int)(width * scale + 0.5f));
+		processedHeight = std::max(1, (int)(height * scale + 0.5f));
+	}
+	rgba.resize((size_t)processedWidth * processedHeight * 4);
+
+	if ((processedWidth == width) && (processedHeight == height))
+	{
+		return(ExpandToRGBA(image, channels, width * height, rgba.data()));
+	}
+
+	FILTER_TAPS horizontalTaps;
+	FILTER_TAPS verticalTaps;
+	BuildFilterTaps(width, processedWidth, options.filter, horizontalTaps);
+	BuildFilterTaps(height, processedHeight, options.filter, verticalTaps);
+
+	// a destination row needs at most stride source rows, and
+	// the rows it needs only move down the image
+	int ringSize = verticalTaps.stride;
+	int rowFloats = processedWidth * 4;
+	std::vector<unsigned char> sourceRow((size_t)width * 4);
+	std::vector<float> linearRow((size_t)width * 4);
+	std::vector<float> ring((size_t)ringSize * rowFloats);
+	std::vector<int> ringRows(ringSize, -1);
+	std::vector<const float*> rows(ringSize);
+	std::vector<float> destRow(rowFloats);
+
+	for (int y = 0; y < processedHeight; y++)
+	{
+		int first = verticalTaps.first[y];
+		int count = verticalTaps.count[y];
+		for (int k = 0; k < count; k++)
+		{
+			int sourceY = first + k;
+			int slot = sourceY % ringSize;
+			float* ringRow = &ring[(size_t)slot * rowFloats];
+			if (ringRows[slot] != sourceY)
+			{
+				ExpandToRGBA(image + (size_t)sourceY * width * channels, channels, width, sourceRow.data());
+				DecodeSRGB(sourceRow.data(), width, linearRow.data());
+				FilterRow(linearRow.data(), horizontalTaps, processedWidth, ringRow);
+				ringRows[slot] = sourceY;
+			}
+			rows[k] = ringRow;
+		}
+
+		BlendRows(rows.data(), &verticalTaps.weights[(size_t)y * verticalTaps.stride], count, rowFloats, destRow.data());
+		EncodeSRGB(destRow.data(), processedWidth, rgba.data() + (size_t)y * rowFloats);
+	}
+
+	return(true);
+}
+
+/***********************************************************
+ *  RunBenchmark()
+ *
+ *  This method is used for timing each kernel of each
+ *  supported version on an image file, and printing how
+ *  far the results of the vector versions are from the
+ *  scalar ones.
+ ***********************************************************/
+bool ImageProcessor::RunBenchmark(const char* imagePath)
+{
+	int width = 0;
+	int height = 0;
+	int channels = 0;
+	unsigned char* image = stbi_load(imagePath, &width, &height, &channels, 0);
+	if (NULL == image)
+	{
+		std::cout << "Could not load image:" << imagePath << std::endl;
+		return(false);
+	}
+
+	int pixelCount = width * height;
+	std::cout << "Benchmarking " << imagePath << ", " << width << "x" << height << ", "
+		<< channels << " channels, " << g_BenchmarkRuns << " runs" << std::endl;
+
+	std::vector<unsigned char> rgba((size_t)pixelCount * 4);
+	std::vector<float> linear((size_t)pixelCount * 4);
+	std::vector<unsigned char> encoded((size_t)pixelCount * 4);
+	std::vector<unsigned char> boxScaled;
+	std::vector<unsigned char> lanczosScaled;
+	std::vector<unsigned char> scalarResults[3];
+	int scaledWidth = 0;
+	int scaledHeight = 0;
+
+	PROCESS_OPTIONS boxOptions;
+	boxOptions.maxSize = std::max(1, std::max(width, height) / 2);
+	boxOptions.filter = FILTER_BOX;
+	PROCESS_OPTIONS lanczosOptions = boxOptions;
+	lanczosOptions.filter = FILTER_LANCZOS;
+
+	KERNEL_PATH previousPath = GetKernelPath();
+	for (int path = PATH_SCALAR; path <= GetSupportedPath(); path++)
+	{
+		SetKernelPath((KERNEL_PATH)path);
+
+		double expandTime = TimeKernel([&]() { ExpandToRGBA(image, channels, pixelCount, rgba.data()); });
+		double decodeTime = TimeKernel([&]() { DecodeSRGB(rgba.data(), pixelCount, linear.data()); });
+		double encodeTime = TimeKernel([&]() { EncodeSRGB(linear.data(), pixelCount, encoded.data()); });
+		double boxTime = TimeKernel([&]() {
+			ProcessImage(image, width, height, channels, boxOptions, boxScaled, scaledWidth, scaledHeight); });
+		double lanczosTime = TimeKernel([&]() {
+			ProcessImage(image, width, height, channels, lanczosOptions, lanczosScaled, scaledWidth, scaledHeight); });
+
+		std::cout << GetPathName((KERNEL_PATH)path) << ": expand " << expandTime << " ms, decode " << decodeTime
+			<< " ms, encode " << encodeTime << " ms, box half size " << boxTime
+			<< " ms, Lanczos half size " << lanczosTime << " ms";
+		if (path == PATH_SCALAR)
+		{
+			scalarResults[0] = encoded;
+			scalarResults[1] = boxScaled;
+			scalarResults[2] = lanczosScaled;
+		}
+		else
+		{
+			int maxDifference = std::max(GetMaxDifference(scalarResults[0], encoded),
+				std::max(GetMaxDifference(scalarResults[1], boxScaled), GetMaxDifference(scalarResults[2], lanczosScaled)));
+			std::cout << ", largest difference to scalar " << maxDifference;
+		}
+		std::cout << std::endl;
+	}
+	SetKernelPath(previousPath);
+
+	stbi_image_free(image);
+	return(true);
+}
@@ -0,0 +1,90 @@
+///////////////////////////////////////////////////////////////////////////////
+// imageprocessor.h
+// ============
+// convert the decoded texture images to RGBA8 and scale them down to the
+// maximum texture size, with scalar, SSE and AVX2 versions of each kernel
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <vector>
+
+/***********************************************************
+ *  ImageProcessor
+ *
+ *  This class holds the stage that runs on the images between
+ *  decoding and uploading them. Images with one to four
+ *  channels are expanded to RGBA8, grey values spread over
+ *  the three colors. An image larger than the maximum size is
+ *  scaled down in linear light with premultiplied alpha, so
+ *  dark and transparent texels do not bleed into their
+ *  neighbors, through a box or Lanczos filter applied to the
+ *  rows and then the columns, and encoded back to sRGB with
+ *  straight alpha. The scaling streams through the image a
+ *  row at a time, so it never holds a float copy of it.
+ *  Each kernel has a scalar, an SSE and an AVX2 version, and
+ *  the fastest one the processor supports is picked at run
+ *  time.
+ ***********************************************************/
+class ImageProcessor
+{
+public:
+	// versions of the kernels, slowest first
+	enum KERNEL_PATH
+	{
+		PATH_SCALAR = 0,
+		PATH_SSE,
+		PATH_AVX2,
+		PATH_COUNT
+	};
+
+	// filters used for scaling an image down
+	enum RESIZE_FILTER
+	{
+		// average of the covered texels, weighted by the part
+		// of each one covered, the fastest
+		FILTER_BOX = 0,
+		// windowed sinc over three lobes, the sharpest
+		FILTER_LANCZOS
+	};
+
+	// how the images are processed before they are uploaded
+	struct PROCESS_OPTIONS
+	{
+		// largest width or height, 0 to keep the source size
+		int maxSize;
+		RESIZE_FILTER filter;
+	};
+
+	// get the fastest version the processor supports
+	static KERNEL_PATH GetSupportedPath();
+	// choose the version of the kernels, limited to the
+	// supported ones, and get the current one
+	static void SetKernelPath(KERNEL_PATH path);
+	static KERNEL_PATH GetKernelPath();
+	static const char* GetPathName(KERNEL_PATH path);
+
+	// convert pixels with one to four channels into RGBA8
+	static bool ExpandToRGBA(const unsigned char* source, int channels, int pixelCount, unsigned char* rgba);
+	// convert sRGB RGBA8 pixels into linear premultiplied floats
+	static void DecodeSRGB(const unsigned char* rgba, int pixelCount, float* linear);
+	// convert linear premultiplied floats into sRGB RGBA8 pixels
+	// with straight alpha
+	static void EncodeSRGB(const float* linear, int pixelCount, unsigned char* rgba);
+
+	// run the whole stage on a decoded image, false when it has
+	// a channel count that is not handled
+	static bool ProcessImage(
+		const unsigned char* image,
+		int width,
+		int height,
+		int channels,
+		const PROCESS_OPTIONS& options,
+		std::vector<unsigned char>& rgba,
+		int& processedWidth,
+		int& processedHeight);
+
+	// time every kernel of every supported version on an image
+	// file and print the results
+	static bool RunBenchmark(const char* imagePath);
+};
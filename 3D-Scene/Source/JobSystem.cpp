@@ -0,0 +1,291 @@
+///////////////////////////////////////////////////////////////////////////////
+// jobsystem.cpp
+// ============
+// run small jobs of the frame on a pool of worker threads, with the idle
+// threads stealing queued jobs from the busy ones
+///////////////////////////////////////////////////////////////////////////////
+
+#include "JobSystem.h"
+
+#include <algorithm>
+#include <iostream>
+
+// declaration of the global variables and defines
+namespace
+{
+	// the system a worker thread belongs to and its deque, any
+	// other thread uses the deque of the caller
+	thread_local const JobSystem* g_pWorkerSystem = NULL;
+	thread_local int g_WorkerDequeIndex = -1;
+}
+
+/***********************************************************
+ *  JobSystem()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+JobSystem::JobSystem()
+{
+	m_queuedJobs = 0;
+	m_bRunning = false;
+	m_deques.push_back(std::unique_ptr<JOB_DEQUE>(new JOB_DEQUE()));
+	m_deques.back()->first = 0;
+	m_deques.back()->count = 0;
+}
+
+/***********************************************************
+ *  ~JobSystem()
+ *
+ *  The destructor for the class
+ ***********************************************************/
+JobSystem::~JobSystem()
+{
+	Stop();
+}
+
+/***********************************************************
+ *  Start()
+ *
+ *  This method is used for starting the worker threads. With
+ *  a negative count one thread is started for every core but
+ *  the one of the calling thread.
+ ***********************************************************/
+void JobSystem::Start(int threadCount)
+{
+	Stop();
+
+	if (threadCount < 0)
+	{
+		threadCount = (int)std::max(1u, std::thread::hardware_concurrency()) - 1;
+	}
+
+	m_deques.clear();
+	for (int i = 0; i <= threadCount; i++)
+	{
+		m_deques.push_back(std::unique_ptr<JOB_DEQUE>(new JOB_DEQUE()));
+		m_deques.back()->first = 0;
+		m_deques.back()->count = 0;
+	}
+
+	m_bRunning = true;
+	for (int i = 0; i < threadCount; i++)
+	{
+		m_threads.push_back(std::thread(&JobSystem::WorkerLoop, this, i));
+	}
+
+	std::cout << "Job system running on " << GetThreadCount() << " threads" << std::endl;
+}
+
+/***********************************************************
+ *  Stop()
+ *
+ *  This method is used for letting the workers finish the
+ *  queued jobs and joining them.
+ ***********************************************************/
+void JobSystem::Stop()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_sleepLock);
+		m_bRunning = false;
+	}
+	m_wakeUp.notify_all();
+
+	for (size_t i = 0; i < m_threads.size(); i++)
+	{
+		m_threads[i].join();
+	}
+	m_threads.clear();
+
+	// anything still queued by the caller runs here
+	while (RunOneJob(GetDequeIndex()))
+	{
+	}
+}
+
+/***********************************************************
+ *  Run()
+ *
+ *  This method is used for queueing a job on the deque of
+ *  the calling thread and waking a sleeping worker to take
+ *  it.
+ ***********************************************************/
+void JobSystem::Run(const JOB_FUNCTION& job, JOB_COUNTER* pCounter)
+{
+	if (NULL != pCounter)
+	{
+		pCounter->fetch_add(1);
+	}
+
+	JOB_DEQUE& deque = *m_deques[GetDequeIndex()];
+	{
+		std::lock_guard<std::mutex> lock(deque.lock);
+		JOB queued;
+		queued.function = job;
+		queued.pCounter = pCounter;
+		PushJob(deque, queued);
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(m_sleepLock);
+		m_queuedJobs++;
+	}
+	m_wakeUp.notify_one();
+}
+
+/***********************************************************
+ *  Wait()
+ *
+ *  This method is used for waiting on a counter. The caller
+ *  keeps running queued jobs, its own ones first, so waiting
+ *  never leaves a core idle while there is work.
+ ***********************************************************/
+void JobSystem::Wait(JOB_COUNTER* pCounter)
+{
+	int dequeIndex = GetDequeIndex();
+	while (pCounter->load() > 0)
+	{
+		if (!RunOneJob(dequeIndex))
+		{
+			std::this_thread::yield();
+		}
+	}
+}
+
+/***********************************************************
+ *  GetDequeIndex()
+ *
+ *  This method is used for getting the deque of the calling
+ *  thread. Every thread that is not a worker of this system
+ *  shares the last deque.
+ ***********************************************************/
+int JobSystem::GetDequeIndex() const
+{
+	if (g_pWorkerSystem == this)
+	{
+		return(g_WorkerDequeIndex);
+	}
+	return((int)m_deques.size() - 1);
+}
+
+/***********************************************************
+ *  PushJob()
+ *
+ *  This method is used for adding a job behind the newest
+ *  one of a deque. A full ring is doubled, with its jobs
+ *  moved to the start of the new ring in their order.
+ ***********************************************************/
+void JobSystem::PushJob(JOB_DEQUE& deque, const JOB& job)
+{
+	int capacity = (int)deque.jobs.size();
+	if (deque.count == capacity)
+	{
+		std::vector<JOB> jobs(std::max(16, capacity * 2));
+		for (int i = 0; i < deque.count; i++)
+		{
+			jobs[i] = deque.jobs[(deque.first + i) % capacity];
+		}
+		deque.jobs.swap(jobs);
+		deque.first = 0;
+		capacity = (int)deque.jobs.size();
+	}
+
+	deque.jobs[(deque.first + deque.count) % capacity] = job;
+	deque.count++;
+}
+
+/***********************************************************
+ *  TakeJob()
+ *
+ *  This method is used for taking the newest job of the own
+ *  deque, which is the most likely to still be in the cache,
+ *  or else stealing the oldest job of another deque, which
+ *  tends to be the largest piece of work left there.
+ ***********************************************************/
+bool JobSystem::TakeJob(int dequeIndex, JOB& job)
+{
+	int dequeCount = (int)m_deques.size();
+	for (int i = 0; i < dequeCount; i++)
+	{
+		int victim = (dequeIndex + i) % dequeCount;
+		JOB_DEQUE& deque = *m_deques[victim];
+
+		std::lock_guard<std::mutex> lock(deque.lock);
+		if (deque.count == 0)
+		{
+			continue;
+		}
+
+		int slot = deque.first;
+		if (victim == dequeIndex)
+		{
+			slot = (deque.first + deque.count - 1) % (int)deque.jobs.size();
+		}
+		else
+		{
+			deque.first = (deque.first + 1) % (int)deque.jobs.size();
+		}
+		deque.count--;
+
+		// the slot lets go of the function so what it holds does
+		// not live on until the slot is used again
+		job = deque.jobs[slot];
+		deque.jobs[slot].function = nullptr;
+		m_queuedJobs--;
+		return(true);
+	}
+
+	return(false);
+}
+
+/***********************************************************
+ *  RunOneJob()
+ *
+ *  This method is used for taking one job, running it and
+ *  counting down its counter.
+ ***********************************************************/
+bool JobSystem::RunOneJob(int dequeIndex)
+{
+	JOB job;
+	if (!TakeJob(dequeIndex, job))
+	{
+		return(false);
+	}
+
+	job.function();
+	if (NULL != job.pCounter)
+	{
+		job.pCounter->fetch_sub(1);
+	}
+	return(true);
+}
+
+/***********************************************************
+ *  WorkerLoop()
+ *
+ *  This method is used for running the jobs of a worker
+ *  thread. The worker sleeps while nothing is queued and
+ *  leaves once the system stops and every job is taken.
+ ***********************************************************/
+void JobSystem::WorkerLoop(int dequeIndex)
+{
+	g_pWorkerSystem = this;
+	g_WorkerDequeIndex = dequeIndex;
+
+	while (true)
+	{
+		if (RunOneJob(dequeIndex))
+		{
+			continue;
+		}
+
+		std::unique_lock<std::mutex> lock(m_sleepLock);
+		m_wakeUp.wait(lock, [this]() { return (m_queuedJobs.load() > 0) || !m_bRunning; });
+		if (!m_bRunning && (m_queuedJobs.load() == 0))
+		{
+			break;
+		}
+	}
+
+	g_pWorkerSystem = NULL;
+	g_WorkerDequeIndex = -1;
+}
@@ -0,0 +1,145 @@
+///////////////////////////////////////////////////////////////////////////////
+// jobsystem.h
+// ============
+// run small jobs of the frame on a pool of worker threads, with the idle
+// threads stealing queued jobs from the busy ones
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/***********************************************************
+ *  JobSystem
+ *
+ *  This class runs jobs on one worker thread per spare core.
+ *  Every thread has its own job deque: the owner pushes and
+ *  pops at the back, and a thread that runs out of jobs
+ *  steals from the front of another deque, so the work
+ *  spreads out without one shared queue every thread waits
+ *  on. Each job counts down a counter when it finishes, and
+ *  a thread waiting on a counter runs queued jobs until it
+ *  reaches zero instead of sleeping. The thread that created
+ *  the system, the OpenGL thread, uses its own deque too.
+ *  The deques only grow, so queueing the jobs of a frame
+ *  stops taking memory from the heap once they are large
+ *  enough.
+ ***********************************************************/
+class JobSystem
+{
+public:
+	// constructor
+	JobSystem();
+	// destructor
+	~JobSystem();
+
+	// work done by one job
+	typedef std::function<void()> JOB_FUNCTION;
+	// number of jobs that still have to finish
+	typedef std::atomic<int> JOB_COUNTER;
+
+	// start the worker threads, by default one less than the
+	// number of cores since the calling thread runs jobs too
+	void Start(int threadCount = -1);
+	// finish the queued jobs and join the worker threads
+	void Stop();
+
+	// queue a job, the counter goes up now and down again when
+	// the job has finished
+	void Run(const JOB_FUNCTION& job, JOB_COUNTER* pCounter);
+	// run queued jobs until the counter reaches zero
+	void Wait(JOB_COUNTER* pCounter);
+	// split the indices into batches, run them as jobs and wait
+	// for all of them, the batch is called with the indices from
+	// first up to but not including last
+	template<typename BATCH_FUNCTION>
+	void ParallelFor(int count, int batchSize, const BATCH_FUNCTION& batch);
+
+	// number of threads running jobs, including the caller
+	int GetThreadCount() const { return (int)m_threads.size() + 1; }
+	// index of the calling thread, below the thread count, with
+	// every thread that is not a worker getting the last one
+	int GetThreadIndex() const { return GetDequeIndex(); }
+
+private:
+	// a queued job and the counter it finishes
+	struct JOB
+	{
+		JOB_FUNCTION function;
+		JOB_COUNTER* pCounter;
+	};
+
+	// the jobs queued by one thread, in a ring of slots starting
+	// at the oldest job
+	struct JOB_DEQUE
+	{
+		std::mutex lock;
+		std::vector<JOB> jobs;
+		int first;
+		int count;
+	};
+
+	// one deque per worker, the last one belongs to the caller
+	std::vector<std::unique_ptr<JOB_DEQUE>> m_deques;
+	std::vector<std::thread> m_threads;
+	// queued jobs not yet taken, the workers sleep while it is zero
+	std::atomic<int> m_queuedJobs;
+	std::atomic<bool> m_bRunning;
+	std::mutex m_sleepLock;
+	std::condition_variable m_wakeUp;
+
+	// deque of the calling thread
+	int GetDequeIndex() const;
+	// add a job to the back of a deque, doubling its ring when
+	// it is full
+	static void PushJob(JOB_DEQUE& deque, const JOB& job);
+	// take a job from the back of the own deque, or else from
+	// the front of another one
+	bool TakeJob(int dequeIndex, JOB& job);
+	// take and run one job, false when there was none
+	bool RunOneJob(int dequeIndex);
+	// the loop of each worker thread
+	void WorkerLoop(int dequeIndex);
+};
+
+/***********************************************************
+ *  ParallelFor()
+ *
+ *  This method is used for running a loop over the passed in
+ *  number of indices as jobs of batchSize indices each, and
+ *  waiting until every batch has finished. The loop body is
+ *  a template so it is not copied into a job function, and
+ *  every job only holds the body by reference with its
+ *  range, which fits into the job function without taking
+ *  memory from the heap.
+ ***********************************************************/
+template<typename BATCH_FUNCTION>
+void JobSystem::ParallelFor(int count, int batchSize, const BATCH_FUNCTION& batch)
+{
+	batchSize = std::max(1, batchSize);
+
+	// a loop that fits in one batch is not worth the queueing
+	if (count <= batchSize)
+	{
+		if (count > 0)
+		{
+			batch(0, count);
+		}
+		return;
+	}
+
+	JOB_COUNTER counter(0);
+	for (int first = 0; first < count; first += batchSize)
+	{
+		int last = std::min(count, first + batchSize);
+		Run([&batch, first, last]() { batch(first, last); }, &counter);
+	}
+	Wait(&counter);
+}
@@ -9,6 +9,7 @@
 
 #include <iostream>         // error handling and output
 #include <cstdlib>          // EXIT_FAILURE
+#include <cstring>          // strcmp
 
 #include <GL/glew.h>        // GLEW library
 #include "GLFW/glfw3.h"     // GLFW library
@@ -19,7 +20,18 @@
 #include <glm/gtc/type_ptr.hpp>
 
 #include "SceneManager.h"
+#include "SceneFile.h"
 #include "ViewManager.h"
+#include "FramePacer.h"
+#include "RenderTargetManager.h"
+#include "FrameCache.h"
+#include "DynamicResolution.h"
+#include "HiZPyramid.h"
+#include "DeferredShading.h"
+#include "ObjectPicker.h"
+#include "ImageProcessor.h"
+#include "GLStateCache.h"
+#include "FrameArena.h"
 #include "ShapeMeshes.h"
 #include "ShaderManager.h"
 
@@ -38,6 +50,27 @@ namespace
 	ShaderManager* g_ShaderManager = nullptr;
 	// view manager object for managing the 3D view setup and projection to 2D
 	ViewManager* g_ViewManager = nullptr;
+	// frame pacer object for presenting the frames at an even rate
+	FramePacer* g_FramePacer = nullptr;
+	// render target manager object sizing the offscreen buffers
+	RenderTargetManager* g_RenderTargets = nullptr;
+	// frame cache object keeping the last frame for the idle frames
+	FrameCache* g_FrameCache = nullptr;
+	// false when every frame is drawn again, changed or not
+	bool g_bSkipIdleFrames = true;
+	// dynamic resolution object scaling the frames to the GPU time
+	DynamicResolution* g_DynamicResolution = nullptr;
+	// depth pyramid object the static batch is occlusion culled with
+	HiZPyramid* g_HiZPyramid = nullptr;
+	// level of the depth pyramid shown in the corner, -1 for none
+	int g_HiZDebugLevel = -1;
+	// G-buffer and light pass of the deferred static batch
+	DeferredShading* g_DeferredShading = nullptr;
+	// true when the frame keeps the object of every pixel so the
+	// object in sight can be picked with the mouse
+	bool g_bObjectPicking = false;
+	// object picker reading the object IDs back from the frame
+	ObjectPicker* g_ObjectPicker = nullptr;
 }
 
 // Function declarations - all functions that are called manually
@@ -54,6 +87,18 @@ bool InitializeGLEW();
  ***********************************************************/
 int main(int argc, char* argv[])
 {
+	// converting a text scene into a binary scene file does
+	// not need a window
+	if ((argc == 4) && (strcmp(argv[1], "--convert-scene") == 0))
+	{
+		return(SceneFile::ConvertTextScene(argv[2], argv[3]) ? EXIT_SUCCESS : EXIT_FAILURE);
+	}
+	// neither does timing the texture image kernels
+	if ((argc == 3) && (strcmp(argv[1], "--benchmark-image") == 0))
+	{
+		return(ImageProcessor::RunBenchmark(argv[2]) ? EXIT_SUCCESS : EXIT_FAILURE);
+	}
+
 	// if GLFW fails initialization, then terminate the application
 	if (InitializeGLFW() == false)
 	{
@@ -79,12 +124,166 @@ int main(int argc, char* argv[])
 	g_ShaderManager->LoadShaders(
 		"shaders/vertexShader.glsl",
 		"shaders/fragmentShader.glsl");
-	g_ShaderManager->use();
+	GLStateCache::UseProgram(g_ShaderManager);
 
 	// try to create a new scene manager object and prepare the 3D scene
 	g_SceneManager = new SceneManager(g_ShaderManager);
+	g_SceneManager->SetViewManager(g_ViewManager);
+	g_FramePacer = new FramePacer();
+	g_DynamicResolution = new DynamicResolution();
+	// the command line options turn the rendering features off
+	// so they can be compared against the plain path
+	for (int i = 1; i < argc; i++)
+	{
+		// draw each object separately instead of the static batch
+		if (strcmp(argv[i], "--immediate") == 0)
+		{
+			g_SceneManager->SetStaticBatching(false);
+		}
+		// draw the whole static batch without culling it first
+		else if (strcmp(argv[i], "--no-gpu-culling") == 0)
+		{
+			g_SceneManager->SetGPUCulling(false);
+		}
+		// cull only the draws outside the view, not the hidden ones
+		else if (strcmp(argv[i], "--no-occlusion-culling") == 0)
+		{
+			g_SceneManager->SetOcclusionCulling(false);
+		}
+		// shade the static batch in a light pass after its G-buffer
+		else if (strcmp(argv[i], "--deferred") == 0)
+		{
+			g_SceneManager->SetDeferred(true);
+		}
+		// draw more cameras into the frame, split, inset, in a grid
+		// or as the two eyes of a stereo pair side by side
+		else if ((strcmp(argv[i], "--views") == 0) && (i + 1 < argc))
+		{
+			ViewManager::VIEW_LAYOUT layout;
+			if (ViewManager::ParseViewLayout(argv[++i], layout))
+			{
+				g_ViewManager->SetViewLayout(layout);
+			}
+			else
+			{
+				std::cout << "Unknown view layout: " << argv[i] << std::endl;
+			}
+		}
+		// show a level of the depth pyramid in the window corner
+		else if ((strcmp(argv[i], "--show-hiz") == 0) && (i + 1 < argc))
+		{
+			g_HiZDebugLevel = atoi(argv[++i]);
+		}
+		// upload the vertices as floats instead of packed values
+		else if (strcmp(argv[i], "--float-vertices") == 0)
+		{
+			g_SceneManager->SetVertexPacking(false);
+		}
+		// keep the index order the shape generators emit
+		else if (strcmp(argv[i], "--no-mesh-optimization") == 0)
+		{
+			g_SceneManager->SetMeshOptimization(false);
+		}
+		// pick the texture filtering of the low, medium or high preset
+		else if ((strcmp(argv[i], "--texture-quality") == 0) && (i + 1 < argc))
+		{
+			SamplerManager::TEXTURE_QUALITY quality;
+			if (SamplerManager::ParseQuality(argv[++i], quality))
+			{
+				g_SceneManager->SetTextureQuality(quality);
+			}
+			else
+			{
+				std::cout << "Unknown texture quality: " << argv[i] << std::endl;
+			}
+		}
+		// scale the texture images down to at most this size, 0
+		// for the largest size the driver takes
+		else if ((strcmp(argv[i], "--max-texture-size") == 0) && (i + 1 < argc))
+		{
+			g_SceneManager->SetMaxTextureSize(atoi(argv[++i]));
+		}
+		// scale them down with the box filter instead of Lanczos
+		else if (strcmp(argv[i], "--box-downscale") == 0)
+		{
+			g_SceneManager->SetTextureResizeFilter(ImageProcessor::FILTER_BOX);
+		}
+		// draw the beer bottle from a mesh file
+		else if ((strcmp(argv[i], "--bottle-mesh") == 0) && (i + 1 < argc))
+		{
+			g_SceneManager->SetBottleMeshPath(argv[++i]);
+		}
+		// draw the scene of a binary scene file
+		else if ((strcmp(argv[i], "--scene") == 0) && (i + 1 < argc))
+		{
+			g_SceneManager->SetSceneFilePath(argv[++i]);
+		}
+		// read the materials from another material library
+		else if ((strcmp(argv[i], "--materials") == 0) && (i + 1 < argc))
+		{
+			g_SceneManager->SetMaterialLibraryPath(argv[++i]);
+		}
+		// tick the camera from the render loop instead of its own thread
+		else if (strcmp(argv[i], "--no-simulation-thread") == 0)
+		{
+			g_ViewManager->SetSimulationThread(false);
+		}
+		// let a late frame tear instead of waiting a whole refresh
+		else if (strcmp(argv[i], "--adaptive-vsync") == 0)
+		{
+			g_FramePacer->SetMode(FramePacer::PACING_ADAPTIVE_VSYNC);
+		}
+		// limit the frame rate without vsync
+		else if ((strcmp(argv[i], "--fps") == 0) && (i + 1 < argc))
+		{
+			g_FramePacer->SetMode(FramePacer::PACING_LIMITER);
+			g_FramePacer->SetTargetRate(atof(argv[++i]));
+		}
+		// draw as fast as possible
+		else if (strcmp(argv[i], "--no-vsync") == 0)
+		{
+			g_FramePacer->SetMode(FramePacer::PACING_UNLIMITED);
+		}
+		// poll the input right before each frame
+		else if (strcmp(argv[i], "--low-latency") == 0)
+		{
+			g_FramePacer->SetLowLatency(true);
+		}
+		// print the frame time jitter every few seconds
+		else if (strcmp(argv[i], "--frame-stats") == 0)
+		{
+			g_FramePacer->SetReportStats(true);
+			GLStateCache::SetReportStats(true);
+			AllocationCounter::SetReportStats(true);
+			g_SceneManager->SetReportStats(true);
+		}
+		// write the object of every pixel into the frame and
+		// print the object in sight on a left click
+		else if (strcmp(argv[i], "--picking") == 0)
+		{
+			g_bObjectPicking = true;
+		}
+		// draw every frame even when nothing changed
+		else if (strcmp(argv[i], "--no-idle-skip") == 0)
+		{
+			g_bSkipIdleFrames = false;
+		}
+		// always draw at the full window resolution
+		else if (strcmp(argv[i], "--no-dynamic-resolution") == 0)
+		{
+			g_DynamicResolution->SetEnabled(false);
+		}
+		// GPU time in milliseconds the frames should fit in
+		else if ((strcmp(argv[i], "--gpu-budget") == 0) && (i + 1 < argc))
+		{
+			g_DynamicResolution->SetTargetFrameTime(atof(argv[++i]));
+		}
+	}
 	g_SceneManager->PrepareScene();
 
+	// the camera is simulated at a fixed rate from here on
+	g_ViewManager->StartSimulation();
+
 	// Print the control instructions to the console
 	std::cout << "\n*** KEY FUNCTIONS: ***\n";
 
@@ -106,39 +305,190 @@ int main(int argc, char* argv[])
 	// P key to switch to the perspective view
 	std::cout << "P - perspective view\n";
 
+	// L key to switch between forward and deferred shading
+	std::cout << "L - switch between forward and deferred shading\n";
+
 	// Mouse movement to look around (change camera orientation)
 	std::cout << "Mouse Movement - look around\n";
 
 	// Mouse scroll wheel to adjust the movement speed of the camera
 	std::cout << "Mouse Scroll - adjust movement speed\n";
 
+	// Left mouse button to print the object in the middle of the window
+	if (g_bObjectPicking)
+	{
+		std::cout << "Left Click - print the object in the middle of the window\n";
+	}
+
+
+	// the frames are paced from here on
+	g_FramePacer->Start(g_Window);
+	g_RenderTargets = new RenderTargetManager();
+	g_FrameCache = new FrameCache(g_RenderTargets);
+	g_DynamicResolution->Initialize(
+		"shaders/upscaleVertexShader.glsl",
+		"shaders/upscaleFragmentShader.glsl");
+	g_HiZPyramid = new HiZPyramid(g_RenderTargets);
+	g_HiZPyramid->Initialize(
+		"shaders/hiZComputeShader.glsl",
+		"shaders/upscaleVertexShader.glsl",
+		"shaders/hiZDebugFragmentShader.glsl");
+	g_DeferredShading = new DeferredShading(g_RenderTargets);
+	g_DeferredShading->Initialize("shaders/deferredLightComputeShader.glsl");
+	g_SceneManager->SetFrameCache(g_FrameCache);
+	g_SceneManager->SetHiZPyramid(g_HiZPyramid);
+	g_SceneManager->SetDeferredShading(g_DeferredShading);
+	if (g_bObjectPicking)
+	{
+		g_FrameCache->EnableObjectIDs();
+		g_ObjectPicker = new ObjectPicker();
+		g_ObjectPicker->Initialize();
+	}
+
+	// the shader managers load their programs outside of the
+	// state cache, so it starts over from what the driver holds
+	GLStateCache::Invalidate();
+	GLStateCache::UseProgram(g_ShaderManager);
 
 	// loop will keep running until the application is closed 
 	// or until an error has occurred
 	while (!glfwWindowShouldClose(g_Window))
 	{
-		// Enable z-depth
-		glEnable(GL_DEPTH_TEST);
+		// wait for the frame and read the input when it is late bound
+		g_FramePacer->BeginFrame();
 
-		// Clear the frame and z buffers
-		glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
-		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+		// a minimized window has nothing to draw into
+		glm::ivec2 framebufferSize = g_ViewManager->GetFramebufferSize();
+		if ((framebufferSize.x <= 0) || (framebufferSize.y <= 0))
+		{
+			g_FramePacer->WaitForEvents();
+			continue;
+		}
 
 		// convert from 3D object space to 2D view
 		g_ViewManager->PrepareSceneView();
 
-		// refresh the 3D scene
-		g_SceneManager->RenderScene();
-
-
-		// Flips the the back buffer with the front buffer every frame.
-		glfwSwapBuffers(g_Window);
-
+		// keep the offscreen buffers at the size of the framebuffer
+		// and mark the parts of the frame that changed since the
+		// last frame
+		g_RenderTargets->Resize(framebufferSize.x, framebufferSize.y);
+		g_FrameCache->UpdateTargets();
+		g_FrameCache->SetResolutionScale(g_DynamicResolution->GetScale());
+		if (!g_bSkipIdleFrames || g_ViewManager->HasViewChanged())
+		{
+			g_FrameCache->Invalidate();
+		}
+		if (g_ViewManager->TakeShadingSwitch())
+		{
+			g_SceneManager->SetDeferred(!g_SceneManager->IsDeferred());
+			g_FrameCache->Invalidate();
+			std::cout << (g_SceneManager->IsDeferred() ? "Deferred" : "Forward") << " shading" << std::endl;
+		}
+		g_SceneManager->UpdateScene(g_FrameCache);
+
+		// pick from the frame in the window, and print the picks
+		// the GPU has finished copying out since the last frame
+		if (NULL != g_ObjectPicker)
+		{
+			glm::vec2 pickPosition;
+			if (g_ViewManager->TakePickRequest(pickPosition))
+			{
+				g_ObjectPicker->RequestPick(g_FrameCache, pickPosition);
+			}
+			g_ObjectPicker->Update();
+			ObjectPicker::PICK_RESULT pick;
+			while (g_ObjectPicker->TakePickResult(pick))
+			{
+				std::string objectName = g_SceneManager->GetSceneObjectName(pick.objectID);
+				std::cout << "Picked " << (objectName.empty() ? "nothing" : objectName) << std::endl;
+			}
+		}
+
+		if (g_FrameCache->IsDamaged())
+		{
+			// only whole frames tell how long the GPU takes
+			bool bFullFrame = g_FrameCache->IsFullyDamaged();
+			if (bFullFrame)
+			{
+				g_DynamicResolution->BeginTiming();
+			}
+
+			// Clear the changed part of the frame and z buffers
+			g_FrameCache->BeginRedraw();
+
+			// Enable z-depth
+			GLStateCache::Enable(GL_DEPTH_TEST);
+
+			// refresh the 3D scene
+			g_SceneManager->RenderScene();
+
+			g_FrameCache->EndRedraw();
+
+			if (bFullFrame)
+			{
+				g_DynamicResolution->EndTiming();
+			}
+		}
+		else if (!g_ViewManager->TakeWindowRefresh() &&
+			((NULL == g_ObjectPicker) || !g_ObjectPicker->HasPendingPicks()))
+		{
+			// nothing changed and the window still shows the last
+			// frame, so nothing is drawn until an event arrives
+			g_FramePacer->WaitForEvents();
+			continue;
+		}
+
+		// show the kept frame in the window, scaled up to its size
+		g_DynamicResolution->Present(g_FrameCache);
+		if (g_HiZDebugLevel >= 0)
+		{
+			g_HiZPyramid->DrawDebugView(g_HiZDebugLevel, framebufferSize);
+		}
+
+
+		// present the frame, then wait for the next one and
 		// query the latest GLFW events
-		glfwPollEvents();
+		g_FramePacer->EndFrame();
+		GLStateCache::EndFrame();
+		AllocationCounter::EndFrame();
 	}
 
 	// clear the allocated manager objects from memory
+	if (NULL != g_ObjectPicker)
+	{
+		delete g_ObjectPicker;
+		g_ObjectPicker = NULL;
+	}
+	if (NULL != g_DynamicResolution)
+	{
+		delete g_DynamicResolution;
+		g_DynamicResolution = NULL;
+	}
+	if (NULL != g_HiZPyramid)
+	{
+		delete g_HiZPyramid;
+		g_HiZPyramid = NULL;
+	}
+	if (NULL != g_DeferredShading)
+	{
+		delete g_DeferredShading;
+		g_DeferredShading = NULL;
+	}
+	if (NULL != g_FrameCache)
+	{
+		delete g_FrameCache;
+		g_FrameCache = NULL;
+	}
+	if (NULL != g_RenderTargets)
+	{
+		delete g_RenderTargets;
+		g_RenderTargets = NULL;
+	}
+	if (NULL != g_FramePacer)
+	{
+		delete g_FramePacer;
+		g_FramePacer = NULL;
+	}
 	if (NULL != g_SceneManager)
 	{
 		delete g_SceneManager;
@@ -0,0 +1,150 @@
+///////////////////////////////////////////////////////////////////////////////
+// mappedfile.cpp
+// ============
+// map a whole file read-only into memory
+///////////////////////////////////////////////////////////////////////////////
+
+#include "MappedFile.h"
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+/***********************************************************
+ *  MappedFile()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+MappedFile::MappedFile()
+{
+	m_pData = NULL;
+	m_size = 0;
+	m_fileHandle = NULL;
+	m_mappingHandle = NULL;
+}
+
+/***********************************************************
+ *  ~MappedFile()
+ *
+ *  The destructor for the class
+ ***********************************************************/
+MappedFile::~MappedFile()
+{
+	Close();
+}
+
+/***********************************************************
+ *  Open()
+ *
+ *  This method is used for mapping the whole passed in file
+ *  read-only into memory. Empty files cannot be mapped, so
+ *  they fail to open like missing ones.
+ ***********************************************************/
+bool MappedFile::Open(const char* filePath)
+{
+	Close();
+
+#ifdef _WIN32
+	HANDLE file = CreateFileA(
+		filePath,
+		GENERIC_READ,
+		FILE_SHARE_READ,
+		NULL,
+		OPEN_EXISTING,
+		FILE_FLAG_SEQUENTIAL_SCAN,
+		NULL);
+	if (file == INVALID_HANDLE_VALUE)
+	{
+		return(false);
+	}
+
+	LARGE_INTEGER fileSize;
+	if (!GetFileSizeEx(file, &fileSize) || (fileSize.QuadPart == 0))
+	{
+		CloseHandle(file);
+		return(false);
+	}
+
+	HANDLE mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+	if (mapping == NULL)
+	{
+		CloseHandle(file);
+		return(false);
+	}
+
+	void* pView = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+	if (pView == NULL)
+	{
+		CloseHandle(mapping);
+		CloseHandle(file);
+		return(false);
+	}
+
+	m_fileHandle = file;
+	m_mappingHandle = mapping;
+	m_pData = (const char*)pView;
+	m_size = (size_t)fileSize.QuadPart;
+#else
+	int file = open(filePath, O_RDONLY);
+	if (file < 0)
+	{
+		return(false);
+	}
+
+	struct stat fileStatus;
+	if ((fstat(file, &fileStatus) != 0) || (fileStatus.st_size == 0))
+	{
+		close(file);
+		return(false);
+	}
+
+	void* pView = mmap(NULL, (size_t)fileStatus.st_size, PROT_READ, MAP_PRIVATE, file, 0);
+	// the mapping keeps its own reference to the file
+	close(file);
+	if (pView == MAP_FAILED)
+	{
+		return(false);
+	}
+
+	// the file is parsed from front to back
+	madvise(pView, (size_t)fileStatus.st_size, MADV_SEQUENTIAL);
+
+	m_pData = (const char*)pView;
+	m_size = (size_t)fileStatus.st_size;
+#endif
+
+	return(true);
+}
+
+/***********************************************************
+ *  Close()
+ *
+ *  This method is used for unmapping the file.
+ ***********************************************************/
+void MappedFile::Close()
+{
+	if (m_pData == NULL)
+	{
+		return;
+	}
+
+#ifdef _WIN32
+	UnmapViewOfFile(m_pData);
+	CloseHandle((HANDLE)m_mappingHandle);
+	CloseHandle((HANDLE)m_fileHandle);
+#else
+	munmap((void*)m_pData, m_size);
+#endif
+
+	m_pData = NULL;
+	m_size = 0;
+	m_fileHandle = NULL;
+	m_mappingHandle = NULL;
+}
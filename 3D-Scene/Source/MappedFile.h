@@ -0,0 +1,48 @@
+///////////////////////////////////////////////////////////////////////////////
+// mappedfile.h
+// ============
+// map a whole file read-only into memory
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <cstddef>
+
+/***********************************************************
+ *  MappedFile
+ *
+ *  This class maps a file read-only into the address space,
+ *  so large files can be parsed in place without copying
+ *  them into memory first. The pages are only read from disk
+ *  when they are touched.
+ ***********************************************************/
+class MappedFile
+{
+public:
+	// constructor
+	MappedFile();
+	// destructor
+	~MappedFile();
+
+	// map the whole file, the previous file is unmapped first
+	bool Open(const char* filePath);
+	// unmap the file
+	void Close();
+
+	// get the mapped bytes and their count
+	const char* GetData() const { return m_pData; }
+	size_t GetSize() const { return m_size; }
+	bool IsOpen() const { return m_pData != NULL; }
+
+private:
+	// the mapped view of the file
+	const char* m_pData;
+	size_t m_size;
+	// operating system handles of the file and the mapping
+	void* m_fileHandle;
+	void* m_mappingHandle;
+
+	// the mapping cannot be shared between two objects
+	MappedFile(const MappedFile&);
+	MappedFile& operator=(const MappedFile&);
+};
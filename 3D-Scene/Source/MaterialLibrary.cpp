@@ -0,0 +1,319 @@
+///////////////////////////////////////////////////////////////////////////////
+// materiallibrary.cpp
+// ============
+// load the object materials from a text library file and reload them while
+// the application runs whenever the file is saved
+///////////////////////////////////////////////////////////////////////////////
+
+#include "MaterialLibrary.h"
+
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#elif defined(__linux__)
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+/***********************************************************
+ *  MaterialLibrary()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+MaterialLibrary::MaterialLibrary()
+{
+	m_watchFile = -1;
+	m_watchDescriptor = -1;
+	m_changeHandle = NULL;
+	m_lastWriteTime = 0;
+}
+
+/***********************************************************
+ *  ~MaterialLibrary()
+ *
+ *  The destructor for the class
+ ***********************************************************/
+MaterialLibrary::~MaterialLibrary()
+{
+	Close();
+}
+
+/***********************************************************
+ *  Load()
+ *
+ *  This method is used for reading the library file and
+ *  watching its folder for the file being saved again.
+ ***********************************************************/
+bool MaterialLibrary::Load(const char* filePath)
+{
+	Close();
+
+	std::vector<LIBRARY_MATERIAL> materials;
+	if (!ReadLibraryFile(filePath, materials))
+	{
+		return(false);
+	}
+
+	m_filePath = filePath;
+	size_t slash = m_filePath.find_last_of("/\\");
+	m_fileName = (slash != std::string::npos) ? m_filePath.substr(slash + 1) : m_filePath;
+	m_materials = materials;
+	StartWatching();
+
+	std::cout << "Loaded material library " << filePath << ": " << m_materials.size() << " materials" << std::endl;
+
+	return(true);
+}
+
+/***********************************************************
+ *  Close()
+ *
+ *  This method is used for stopping the watch and forgetting
+ *  the materials.
+ ***********************************************************/
+void MaterialLibrary::Close()
+{
+	StopWatching();
+	m_materials.clear();
+	m_filePath.clear();
+	m_fileName.clear();
+}
+
+/***********************************************************
+ *  PollChanges()
+ *
+ *  This method is used for reading the library file again
+ *  after it was saved. A file that cannot be read, such as
+ *  one saved halfway through an edit, keeps the previous
+ *  materials. Materials missing from the new file keep their
+ *  values as well.
+ ***********************************************************/
+bool MaterialLibrary::PollChanges(std::vector<int>& changedMaterials)
+{
+	changedMaterials.clear();
+	if (!HasFileChanged())
+	{
+		return(false);
+	}
+
+	std::vector<LIBRARY_MATERIAL> materials;
+	if (!ReadLibraryFile(m_filePath, materials))
+	{
+		std::cout << "Keeping the previous materials until " << m_filePath << " can be read" << std::endl;
+		return(false);
+	}
+
+	for (size_t i = 0; i < materials.size(); i++)
+	{
+		int index = -1;
+		for (size_t j = 0; (j < m_materials.size()) && (index < 0); j++)
+		{
+			if (m_materials[j].tag == materials[i].tag)
+			{
+				index = (int)j;
+			}
+		}
+
+		if (index < 0)
+		{
+			m_materials.push_back(materials[i]);
+			changedMaterials.push_back((int)m_materials.size() - 1);
+		}
+		else if ((m_materials[index].diffuseColor != materials[i].diffuseColor) ||
+			(m_materials[index].specularColor != materials[i].specularColor) ||
+			(m_materials[index].shininess != materials[i].shininess))
+		{
+			m_materials[index] = materials[i];
+			changedMaterials.push_back(index);
+		}
+	}
+
+	if (!changedMaterials.empty())
+	{
+		std::cout << "Reloaded material library " << m_filePath << ": "
+			<< changedMaterials.size() << " materials changed" << std::endl;
+	}
+
+	return(!changedMaterials.empty());
+}
+
+/***********************************************************
+ *  StartWatching()
+ *
+ *  This method is used for watching the folder of the file,
+ *  since editors often save by replacing the file, which
+ *  would end a watch on the file itself.
+ ***********************************************************/
+void MaterialLibrary::StartWatching()
+{
+	size_t slash = m_filePath.find_last_of("/\\");
+	std::string folder = (slash != std::string::npos) ? m_filePath.substr(0, slash) : std::string(".");
+
+#ifdef _WIN32
+	HANDLE changeHandle = FindFirstChangeNotificationA(
+		folder.c_str(),
+		FALSE,
+		FILE_NOTIFY_CHANGE_LAST_WRITE | FILE_NOTIFY_CHANGE_FILE_NAME);
+	if (changeHandle != INVALID_HANDLE_VALUE)
+	{
+		m_changeHandle = changeHandle;
+	}
+
+	WIN32_FILE_ATTRIBUTE_DATA attributes;
+	if (GetFileAttributesExA(m_filePath.c_str(), GetFileExInfoStandard, &attributes))
+	{
+		m_lastWriteTime = ((long long)attributes.ftLastWriteTime.dwHighDateTime << 32) |
+			attributes.ftLastWriteTime.dwLowDateTime;
+	}
+#elif defined(__linux__)
+	m_watchFile = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+	if (m_watchFile >= 0)
+	{
+		m_watchDescriptor = inotify_add_watch(m_watchFile, folder.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO);
+	}
+#endif
+
+	if ((m_changeHandle == NULL) && (m_watchDescriptor < 0))
+	{
+		std::cout << "Material library " << m_filePath << " is not watched for changes" << std::endl;
+	}
+}
+
+/***********************************************************
+ *  StopWatching()
+ *
+ *  This method is used for closing the watch.
+ ***********************************************************/
+void MaterialLibrary::StopWatching()
+{
+#ifdef _WIN32
+	if (m_changeHandle != NULL)
+	{
+		FindCloseChangeNotification((HANDLE)m_changeHandle);
+	}
+#elif defined(__linux__)
+	if (m_watchFile >= 0)
+	{
+		// closing the instance removes its watches as well
+		close(m_watchFile);
+	}
+#endif
+
+	m_watchFile = -1;
+	m_watchDescriptor = -1;
+	m_changeHandle = NULL;
+	m_lastWriteTime = 0;
+}
+
+/***********************************************************
+ *  HasFileChanged()
+ *
+ *  This method is used for draining the pending events of
+ *  the watch and checking if one of them was the library
+ *  file being written or moved into place.
+ ***********************************************************/
+bool MaterialLibrary::HasFileChanged()
+{
+	bool bChanged = false;
+
+#ifdef _WIN32
+	if (m_changeHandle == NULL)
+	{
+		return(false);
+	}
+
+	while (WaitForSingleObject((HANDLE)m_changeHandle, 0) == WAIT_OBJECT_0)
+	{
+		FindNextChangeNotification((HANDLE)m_changeHandle);
+
+		// the notification is for the whole folder, so the write
+		// time tells if it was the library file
+		WIN32_FILE_ATTRIBUTE_DATA attributes;
+		if (GetFileAttributesExA(m_filePath.c_str(), GetFileExInfoStandard, &attributes))
+		{
+			long long writeTime = ((long long)attributes.ftLastWriteTime.dwHighDateTime << 32) |
+				attributes.ftLastWriteTime.dwLowDateTime;
+			if (writeTime != m_lastWriteTime)
+			{
+				m_lastWriteTime = writeTime;
+				bChanged = true;
+			}
+		}
+	}
+#elif defined(__linux__)
+	if (m_watchFile < 0)
+	{
+		return(false);
+	}
+
+	alignas(struct inotify_event) char events[4096];
+	ssize_t length = 0;
+	while ((length = read(m_watchFile, events, sizeof(events))) > 0)
+	{
+		ssize_t offset = 0;
+		while (offset < length)
+		{
+			const struct inotify_event* pEvent = (const struct inotify_event*)(events + offset);
+			if ((pEvent->len > 0) && (m_fileName == pEvent->name))
+			{
+				bChanged = true;
+			}
+			offset += sizeof(struct inotify_event) + pEvent->len;
+		}
+	}
+#endif
+
+	return(bChanged);
+}
+
+/***********************************************************
+ *  ReadLibraryFile()
+ *
+ *  This method is used for reading a library file. Each line
+ *  defines one material and # starts a comment:
+ *
+ *    material <tag>  dr dg db  sr sg sb  shininess
+ *
+ *  This is the same statement the text scene files use.
+ ***********************************************************/
+bool MaterialLibrary::ReadLibraryFile(const std::string& filePath, std::vector<LIBRARY_MATERIAL>& materials)
+{
+	std::ifstream file(filePath.c_str());
+	if (!file.is_open())
+	{
+		std::cout << "Could not open material library: " << filePath << std::endl;
+		return(false);
+	}
+
+	std::string text;
+	int lineNumber = 0;
+	while (std::getline(file, text))
+	{
+		lineNumber++;
+		std::istringstream line(text);
+		std::string keyword;
+		if (!(line >> keyword) || (keyword[0] == '#'))
+		{
+			continue;
+		}
+
+		LIBRARY_MATERIAL material;
+		if ((keyword != "material") ||
+			!(line >> material.tag) ||
+			!(line >> material.diffuseColor.r >> material.diffuseColor.g >> material.diffuseColor.b) ||
+			!(line >> material.specularColor.r >> material.specularColor.g >> material.specularColor.b) ||
+			!(line >> material.shininess))
+		{
+			std::cout << filePath << ":" << lineNumber << ": could not read: " << text << std::endl;
+			return(false);
+		}
+		materials.push_back(material);
+	}
+
+	return(true);
+}
@@ -0,0 +1,73 @@
+///////////////////////////////////////////////////////////////////////////////
+// materiallibrary.h
+// ============
+// load the object materials from a text library file and reload them while
+// the application runs whenever the file is saved
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include <string>
+#include <vector>
+
+/***********************************************************
+ *  MaterialLibrary
+ *
+ *  This class reads the object materials from a library file
+ *  and watches the folder of the file, with inotify on Linux
+ *  and a change notification on Windows. Polling the watch
+ *  never blocks, and when the file was saved it is read
+ *  again and only the materials whose values changed are
+ *  reported, so just those have to be uploaded.
+ ***********************************************************/
+class MaterialLibrary
+{
+public:
+	// constructor
+	MaterialLibrary();
+	// destructor
+	~MaterialLibrary();
+
+	// one material of the library file
+	struct LIBRARY_MATERIAL
+	{
+		std::string tag;
+		glm::vec3 diffuseColor;
+		glm::vec3 specularColor;
+		float shininess;
+	};
+
+	// read the library file and start watching it
+	bool Load(const char* filePath);
+	// stop watching the library file
+	void Close();
+
+	// check for a saved library file without blocking, fills
+	// the indices of the materials that were added or changed
+	bool PollChanges(std::vector<int>& changedMaterials);
+
+	// get the materials read from the library file
+	const std::vector<LIBRARY_MATERIAL>& GetMaterials() const { return m_materials; }
+
+private:
+	// the library file, and its name inside its folder
+	std::string m_filePath;
+	std::string m_fileName;
+	// materials read the last time the file was valid
+	std::vector<LIBRARY_MATERIAL> m_materials;
+	// the operating system watch on the folder of the file
+	int m_watchFile;
+	int m_watchDescriptor;
+	void* m_changeHandle;
+	long long m_lastWriteTime;
+
+	// start and stop watching the folder of the file
+	void StartWatching();
+	void StopWatching();
+	// true when the watch saw the library file being saved
+	bool HasFileChanged();
+	// read every material of a library file
+	static bool ReadLibraryFile(const std::string& filePath, std::vector<LIBRARY_MATERIAL>& materials);
+};
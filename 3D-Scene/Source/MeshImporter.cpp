@@ -0,0 +1,1640 @@
+///////////////////////////////////////////////////////////////////////////////
+// meshimporter.cpp
+// ============
+// import triangle meshes from OBJ, glTF and GLB files into the same mesh
+// data the shape generators produce
+///////////////////////////////////////////////////////////////////////////////
+
+#include "MeshImporter.h"
+#include "MappedFile.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+// declaration of the global variables and defines
+namespace
+{
+	// OBJ files are only split when every chunk gets at least this
+	// many bytes, smaller files are not worth the threads
+	const size_t g_MinimumChunkSize = 1 << 20;
+	// relative OBJ indices are stored below this bias until the
+	// number of elements before their chunk is known
+	const int g_RelativeIndexBias = 1 << 30;
+	// deepest nesting accepted in the glTF JSON and node tree
+	const int g_MaximumDepth = 64;
+
+	// GLB container constants
+	const uint32_t g_GLBMagic = 0x46546C67;
+	const uint32_t g_GLBChunkJSON = 0x4E4F534A;
+	const uint32_t g_GLBChunkBinary = 0x004E4942;
+
+	// glTF accessor component types and the triangle list mode
+	const int g_ComponentByte = 5120;
+	const int g_ComponentUnsignedByte = 5121;
+	const int g_ComponentShort = 5122;
+	const int g_ComponentUnsignedShort = 5123;
+	const int g_ComponentUnsignedInt = 5125;
+	const int g_ComponentFloat = 5126;
+	const int g_ModeTriangles = 4;
+
+	/***********************************************************
+	 *  RunParallel()
+	 *
+	 *  This function is used for running a job for every index
+	 *  up to the passed in count, each on its own thread. The
+	 *  first job runs on the calling thread.
+	 ***********************************************************/
+	void RunParallel(int jobCount, const std::function<void(int)>& job)
+	{
+		std::vector<std::thread> threads;
+		for (int i = 1; i < jobCount; i++)
+		{
+			threads.push_back(std::thread(job, i));
+		}
+		if (jobCount > 0)
+		{
+			job(0);
+		}
+		for (size_t i = 0; i < threads.size(); i++)
+		{
+			threads[i].join();
+		}
+	}
+
+	/***********************************************************
+	 *  ComputeMissingNormals()
+	 *
+	 *  This function is used for giving every vertex without a
+	 *  normal the area weighted normal of the triangles around
+	 *  it. Vertices that came with a normal keep it.
+	 ***********************************************************/
+	void ComputeMissingNormals(ShapeLODMeshes::MESH_DATA& mesh)
+	{
+		std::vector<bool> bMissing(mesh.vertices.size());
+		bool bAnyMissing = false;
+		for (size_t i = 0; i < mesh.vertices.size(); i++)
+		{
+			bMissing[i] = (mesh.vertices[i].normal == glm::vec3(0.0f));
+			bAnyMissing = bAnyMissing || bMissing[i];
+		}
+		if (!bAnyMissing)
+		{
+			return;
+		}
+
+		for (size_t i = 0; i + 2 < mesh.indices.size(); i += 3)
+		{
+			GLuint corners[3] = { mesh.indices[i], mesh.indices[i + 1], mesh.indices[i + 2] };
+			glm::vec3 p0 = mesh.vertices[corners[0]].position;
+			glm::vec3 p1 = mesh.vertices[corners[1]].position;
+			glm::vec3 p2 = mesh.vertices[corners[2]].position;
+			// the cross product length weights by the area
+			glm::vec3 faceNormal = glm::cross(p1 - p0, p2 - p0);
+			for (int corner = 0; corner < 3; corner++)
+			{
+				if (bMissing[corners[corner]])
+				{
+					mesh.vertices[corners[corner]].normal += faceNormal;
+				}
+			}
+		}
+
+		for (size_t i = 0; i < mesh.vertices.size(); i++)
+		{
+			float length = glm::length(mesh.vertices[i].normal);
+			if (bMissing[i] && (length > 0.0f))
+			{
+				mesh.vertices[i].normal /= length;
+			}
+		}
+	}
+
+	/***********************************************************
+	 *  AppendMeshData()
+	 *
+	 *  This function is used for appending the vertices and
+	 *  triangles of one mesh to another.
+	 ***********************************************************/
+	void AppendMeshData(ShapeLODMeshes::MESH_DATA& mesh, const ShapeLODMeshes::MESH_DATA& source)
+	{
+		GLuint vertexOffset = (GLuint)mesh.vertices.size();
+		mesh.vertices.insert(mesh.vertices.end(), source.vertices.begin(), source.vertices.end());
+		for (size_t i = 0; i < source.indices.size(); i++)
+		{
+			mesh.indices.push_back(source.indices[i] + vertexOffset);
+		}
+	}
+
+	/***********************************************************
+	 *  SetSingleMeshPart()
+	 *
+	 *  This function is used for making every triangle of an
+	 *  imported mesh part of its sides.
+	 ***********************************************************/
+	void SetSingleMeshPart(ShapeLODMeshes::MESH_DATA& mesh)
+	{
+		mesh.sides.firstIndex = 0;
+		mesh.sides.indexCount = (GLuint)mesh.indices.size();
+		mesh.top.firstIndex = 0;
+		mesh.top.indexCount = 0;
+		mesh.bottom.firstIndex = 0;
+		mesh.bottom.indexCount = 0;
+	}
+
+	/*** text parsing ***/
+
+	/***********************************************************
+	 *  SkipSpaces()
+	 *
+	 *  This function is used for skipping spaces and tabs.
+	 ***********************************************************/
+	void SkipSpaces(const char*& p, const char* end)
+	{
+		while ((p < end) && ((*p == ' ') || (*p == '\t')))
+		{
+			p++;
+		}
+	}
+
+	/***********************************************************
+	 *  SkipLine()
+	 *
+	 *  This function is used for moving to the next line.
+	 ***********************************************************/
+	void SkipLine(const char*& p, const char* end)
+	{
+		while ((p < end) && (*p != '\n'))
+		{
+			p++;
+		}
+		if (p < end)
+		{
+			p++;
+		}
+	}
+
+	/***********************************************************
+	 *  IsDigit()
+	 *
+	 *  This function is used for testing for a decimal digit.
+	 ***********************************************************/
+	bool IsDigit(const char* p, const char* end)
+	{
+		return((p < end) && (*p >= '0') && (*p <= '9'));
+	}
+
+	/***********************************************************
+	 *  ParseInt()
+	 *
+	 *  This function is used for reading a signed integer that
+	 *  may end exactly at the end of the mapped file, where the
+	 *  C library parsers would read past it.
+	 ***********************************************************/
+	bool ParseInt(const char*& p, const char* end, int& value)
+	{
+		bool bNegative = false;
+		if ((p < end) && ((*p == '-') || (*p == '+')))
+		{
+			bNegative = (*p == '-');
+			p++;
+		}
+		if (!IsDigit(p, end))
+		{
+			return(false);
+		}
+
+		long long number = 0;
+		while (IsDigit(p, end))
+		{
+			number = std::min(number * 10 + (*p - '0'), (long long)INT32_MAX);
+			p++;
+		}
+		value = (int)(bNegative ? -number : number);
+
+		return(true);
+	}
+
+	/***********************************************************
+	 *  ParseDouble()
+	 *
+	 *  This function is used for reading a decimal number with
+	 *  an optional fraction and exponent.
+	 ***********************************************************/
+	bool ParseDouble(const char*& p, const char* end, double& value)
+	{
+		bool bNegative = false;
+		if ((p < end) && ((*p == '-') || (*p == '+')))
+		{
+			bNegative = (*p == '-');
+			p++;
+		}
+		if (!IsDigit(p, end) && !((p < end) && (*p == '.')))
+		{
+			return(false);
+		}
+
+		double number = 0.0;
+		while (IsDigit(p, end))
+		{
+			number = number * 10.0 + (*p - '0');
+			p++;
+		}
+		if ((p < end) && (*p == '.'))
+		{
+			p++;
+			// the digits are gathered as one integer so the
+			// fraction is only rounded once
+			unsigned long long fraction = 0;
+			double divisor = 1.0;
+			while (IsDigit(p, end))
+			{
+				if (divisor < 1e18)
+				{
+					fraction = fraction * 10 + (*p - '0');
+					divisor *= 10.0;
+				}
+				p++;
+			}
+			number += (double)fraction / divisor;
+		}
+		if ((p < end) && ((*p == 'e') || (*p == 'E')))
+		{
+			p++;
+			int exponent = 0;
+			if (ParseInt(p, end, exponent))
+			{
+				number *= pow(10.0, (double)exponent);
+			}
+		}
+		value = bNegative ? -number : number;
+
+		return(true);
+	}
+
+	/***********************************************************
+	 *  ParseFloat()
+	 *
+	 *  This function is used for reading a decimal number into
+	 *  a float, which is all the vertex data needs.
+	 ***********************************************************/
+	bool ParseFloat(const char*& p, const char* end, float& value)
+	{
+		double number = 0.0;
+		if (!ParseDouble(p, end, number))
+		{
+			return(false);
+		}
+		value = (float)number;
+
+		return(true);
+	}
+
+	/*** OBJ import ***/
+
+	// one face corner with its position, texture coordinate and
+	// normal index, -1 when the corner does not have one
+	struct OBJ_CORNER
+	{
+		int position;
+		int textureCoordinate;
+		int normal;
+
+		bool operator==(const OBJ_CORNER& other) const
+		{
+			return((position == other.position) &&
+				(textureCoordinate == other.textureCoordinate) &&
+				(normal == other.normal));
+		}
+	};
+
+	// hash of a face corner for merging the repeated corners
+	struct OBJ_CORNER_HASH
+	{
+		size_t operator()(const OBJ_CORNER& corner) const
+		{
+			size_t hash = (size_t)corner.position * 73856093u;
+			hash ^= (size_t)corner.textureCoordinate * 19349663u;
+			hash ^= (size_t)corner.normal * 83492791u;
+			return(hash);
+		}
+	};
+
+	// the part of an OBJ file parsed by one thread
+	struct OBJ_CHUNK
+	{
+		const char* begin;
+		const char* end;
+		// elements defined inside the chunk
+		std::vector<glm::vec3> positions;
+		std::vector<glm::vec2> textureCoordinates;
+		std::vector<glm::vec3> normals;
+		// triangulated face corners, three for each triangle
+		std::vector<OBJ_CORNER> corners;
+		// elements defined before the chunk
+		int positionBase;
+		int textureCoordinateBase;
+		int normalBase;
+		// merged vertices and triangles of the chunk
+		ShapeLODMeshes::MESH_DATA mesh;
+		bool bValid;
+	};
+
+	/***********************************************************
+	 *  StoreOBJIndex()
+	 *
+	 *  This function is used for turning an OBJ index into a
+	 *  zero based one. Negative indices count back from the
+	 *  last element, which is only known inside the chunk, so
+	 *  they are stored below the bias until they are resolved.
+	 ***********************************************************/
+	int StoreOBJIndex(int index, size_t localCount)
+	{
+		if (index > 0)
+		{
+			return(index - 1);
+		}
+		if (index < 0)
+		{
+			return((int)localCount + index - g_RelativeIndexBias);
+		}
+		return(-1);
+	}
+
+	/***********************************************************
+	 *  ResolveOBJIndex()
+	 *
+	 *  This function is used for resolving a stored OBJ index
+	 *  to an index into all the elements of the file.
+	 ***********************************************************/
+	int ResolveOBJIndex(int index, int base, int count)
+	{
+		if (index == -1)
+		{
+			return(-1);
+		}
+		if (index < -1)
+		{
+			index = index + g_RelativeIndexBias + base;
+		}
+		return(((index >= 0) && (index < count)) ? index : -2);
+	}
+
+	/***********************************************************
+	 *  ParseOBJChunk()
+	 *
+	 *  This function is used for parsing the vertex and face
+	 *  lines of one chunk. Polygons are split into a fan of
+	 *  triangles and every other statement is skipped.
+	 ***********************************************************/
+	void ParseOBJChunk(OBJ_CHUNK& chunk)
+	{
+		const char* p = chunk.begin;
+		const char* end = chunk.end;
+		std::vector<OBJ_CORNER> polygon;
+
+		while (p < end)
+		{
+			SkipSpaces(p, end);
+			if (p + 1 >= end)
+			{
+				break;
+			}
+
+			if ((p[0] == 'v') && ((p[1] == ' ') || (p[1] == '\t')))
+			{
+				p += 1;
+				// the components a short line leaves out stay 0
+				glm::vec3 position(0.0f);
+				for (int axis = 0; axis < 3; axis++)
+				{
+					SkipSpaces(p, end);
+					ParseFloat(p, end, position[axis]);
+				}
+				chunk.positions.push_back(position);
+			}
+			else if ((p[0] == 'v') && (p[1] == 't'))
+			{
+				p += 2;
+				// the v coordinate is optional and stays 0
+				glm::vec2 textureCoordinate(0.0f);
+				for (int axis = 0; axis < 2; axis++)
+				{
+					SkipSpaces(p, end);
+					ParseFloat(p, end, textureCoordinate[axis]);
+				}
+				chunk.textureCoordinates.push_back(textureCoordinate);
+			}
+			else if ((p[0] == 'v') && (p[1] == 'n'))
+			{
+				p += 2;
+				glm::vec3 normal(0.0f);
+				for (int axis = 0; axis < 3; axis++)
+				{
+					SkipSpaces(p, end);
+					ParseFloat(p, end, normal[axis]);
+				}
+				chunk.normals.push_back(normal);
+			}
+			else if ((p[0] == 'f') && ((p[1] == ' ') || (p[1] == '\t')))
+			{
+				p += 1;
+				polygon.clear();
+				while (true)
+				{
+					SkipSpaces(p, end);
+					int index = 0;
+					if (!ParseInt(p, end, index))
+					{
+						break;
+					}
+
+					OBJ_CORNER corner;
+					corner.position = StoreOBJIndex(index, chunk.positions.size());
+					corner.textureCoordinate = -1;
+					corner.normal = -1;
+					if ((p < end) && (*p == '/'))
+					{
+						p++;
+						if (ParseInt(p, end, index))
+						{
+							corner.textureCoordinate = StoreOBJIndex(index, chunk.textureCoordinates.size());
+						}
+						if ((p < end) && (*p == '/'))
+						{
+							p++;
+							if (ParseInt(p, end, index))
+							{
+								corner.normal = StoreOBJIndex(index, chunk.normals.size());
+							}
+						}
+					}
+					polygon.push_back(corner);
+				}
+
+				for (size_t i = 2; i < polygon.size(); i++)
+				{
+					chunk.corners.push_back(polygon[0]);
+					chunk.corners.push_back(polygon[i - 1]);
+					chunk.corners.push_back(polygon[i]);
+				}
+			}
+
+			SkipLine(p, end);
+		}
+	}
+
+	/***********************************************************
+	 *  BuildOBJChunkMesh()
+	 *
+	 *  This function is used for resolving the face corners of
+	 *  one chunk and merging the repeated ones into vertices.
+	 ***********************************************************/
+	void BuildOBJChunkMesh(
+		OBJ_CHUNK& chunk,
+		const std::vector<glm::vec3>& positions,
+		const std::vector<glm::vec2>& textureCoordinates,
+		const std::vector<glm::vec3>& normals)
+	{
+		std::unordered_map<OBJ_CORNER, GLuint, OBJ_CORNER_HASH> vertexMap;
+		vertexMap.reserve(chunk.corners.size() / 2);
+		chunk.mesh.indices.reserve(chunk.corners.size());
+		chunk.bValid = true;
+
+		for (size_t i = 0; i < chunk.corners.size(); i++)
+		{
+			OBJ_CORNER corner;
+			corner.position = ResolveOBJIndex(chunk.corners[i].position, chunk.positionBase, (int)positions.size());
+			corner.textureCoordinate = ResolveOBJIndex(
+				chunk.corners[i].textureCoordinate,
+				chunk.textureCoordinateBase,
+				(int)textureCoordinates.size());
+			corner.normal = ResolveOBJIndex(chunk.corners[i].normal, chunk.normalBase, (int)normals.size());
+			if ((corner.position < 0) || (corner.textureCoordinate == -2) || (corner.normal == -2))
+			{
+				chunk.bValid = false;
+				return;
+			}
+
+			std::pair<std::unordered_map<OBJ_CORNER, GLuint, OBJ_CORNER_HASH>::iterator, bool> inserted =
+				vertexMap.insert(std::make_pair(corner, (GLuint)chunk.mesh.vertices.size()));
+			if (inserted.second)
+			{
+				ShapeLODMeshes::MESH_VERTEX vertex;
+				vertex.position = positions[corner.position];
+				vertex.textureCoordinate = (corner.textureCoordinate >= 0) ?
+					textureCoordinates[corner.textureCoordinate] : glm::vec2(0.0f);
+				vertex.normal = (corner.normal >= 0) ? normals[corner.normal] : glm::vec3(0.0f);
+				chunk.mesh.vertices.push_back(vertex);
+			}
+			chunk.mesh.indices.push_back(inserted.first->second);
+		}
+	}
+
+	/*** JSON parsing for glTF ***/
+
+	// one value of a JSON document
+	struct JSON_VALUE
+	{
+		enum JSON_TYPE
+		{
+			JSON_NULL,
+			JSON_BOOL,
+			JSON_NUMBER,
+			JSON_STRING,
+			JSON_ARRAY,
+			JSON_OBJECT
+		};
+
+		JSON_TYPE type;
+		double number;
+		std::string text;
+		// array elements, or object members matching the keys
+		std::vector<JSON_VALUE> items;
+		std::vector<std::string> keys;
+
+		JSON_VALUE() : type(JSON_NULL), number(0.0) {}
+
+		// find an object member, NULL when there is no such member
+		const JSON_VALUE* Find(const char* key) const
+		{
+			for (size_t i = 0; i < keys.size(); i++)
+			{
+				if (keys[i] == key)
+				{
+					return(&items[i]);
+				}
+			}
+			return(NULL);
+		}
+
+		// get a numeric object member or the passed in default
+		double GetNumber(const char* key, double defaultValue) const
+		{
+			const JSON_VALUE* pValue = Find(key);
+			return(((NULL != pValue) && (pValue->type == JSON_NUMBER)) ? pValue->number : defaultValue);
+		}
+
+		// get an array element, NULL when it is out of range
+		const JSON_VALUE* At(double index) const
+		{
+			if ((type != JSON_ARRAY) || (index < 0.0) || (index >= (double)items.size()))
+			{
+				return(NULL);
+			}
+			return(&items[(size_t)index]);
+		}
+	};
+
+	/***********************************************************
+	 *  SkipJSONSpaces()
+	 *
+	 *  This function is used for skipping the JSON white space.
+	 ***********************************************************/
+	void SkipJSONSpaces(const char*& p, const char* end)
+	{
+		while ((p < end) && ((*p == ' ') || (*p == '\t') || (*p == '\n') || (*p == '\r')))
+		{
+			p++;
+		}
+	}
+
+	/***********************************************************
+	 *  AppendUTF8()
+	 *
+	 *  This function is used for appending a code point of a
+	 *  \u escape to a string as UTF-8.
+	 ***********************************************************/
+	void AppendUTF8(std::string& text, unsigned int codePoint)
+	{
+		if (codePoint < 0x80)
+		{
+			text += (char)codePoint;
+		}
+		else if (codePoint < 0x800)
+		{
+			text += (char)(0xC0 | (codePoint >> 6));
+			text += (char)(0x80 | (codePoint & 0x3F));
+		}
+		else
+		{
+			text += (char)(0xE0 | (codePoint >> 12));
+			text += (char)(0x80 | ((codePoint >> 6) & 0x3F));
+			text += (char)(0x80 | (codePoint & 0x3F));
+		}
+	}
+
+	/***********************************************************
+	 *  ParseJSONString()
+	 *
+	 *  This function is used for reading a quoted JSON string.
+	 ***********************************************************/
+	bool ParseJSONString(const char*& p, const char* end, std::string& text)
+	{
+		if ((p >= end) || (*p != '"'))
+		{
+			return(false);
+		}
+		p++;
+
+		while (p < end)
+		{
+			char c = *p++;
+			if (c == '"')
+			{
+				return(true);
+			}
+			if (c != '\\')
+			{
+				text += c;
+				continue;
+			}
+			if (p >= end)
+			{
+				return(false);
+			}
+
+			char escape = *p++;
+			switch (escape)
+			{
+			case 'b': text += '\b'; break;
+			case 'f': text += '\f'; break;
+			case 'n': text += '\n'; break;
+			case 'r': text += '\r'; break;
+			case 't': text += '\t'; break;
+			case 'u':
+			{
+				if (end - p < 4)
+				{
+					return(false);
+				}
+				unsigned int codePoint = 0;
+				for (int i = 0; i < 4; i++)
+				{
+					char digit = *p++;
+					codePoint <<= 4;
+					if ((digit >= '0') && (digit <= '9'))
+						codePoint |= digit - '0';
+					else if ((digit >= 'a') && (digit <= 'f'))
+						codePoint |= digit - 'a' + 10;
+					else if ((digit >= 'A') && (digit <= 'F'))
+						codePoint |= digit - 'A' + 10;
+					else
+						return(false);
+				}
+				AppendUTF8(text, codePoint);
+				break;
+			}
+			default:
+				text += escape;
+				break;
+			}
+		}
+
+		return(false);
+	}
+
+	/***********************************************************
+	 *  ParseJSONValue()
+	 *
+	 *  This function is used for reading one JSON value with
+	 *  all the values nested inside it.
+	 ***********************************************************/
+	bool ParseJSONValue(const char*& p, const char* end, JSON_VALUE& value, int depth)
+	{
+		SkipJSONSpaces(p, end);
+		if ((p >= end) || (depth > g_MaximumDepth))
+		{
+			return(false);
+		}
+
+		if (*p == '{')
+		{
+			value.type = JSON_VALUE::JSON_OBJECT;
+			p++;
+			SkipJSONSpaces(p, end);
+			if ((p < end) && (*p == '}'))
+			{
+				p++;
+				return(true);
+			}
+			while (p < end)
+			{
+				std::string key;
+				SkipJSONSpaces(p, end);
+				if (!ParseJSONString(p, end, key))
+				{
+					return(false);
+				}
+				SkipJSONSpaces(p, end);
+				if ((p >= end) || (*p != ':'))
+				{
+					return(false);
+				}
+				p++;
+				value.keys.push_back(key);
+				value.items.push_back(JSON_VALUE());
+				if (!ParseJSONValue(p, end, value.items.back(), depth + 1))
+				{
+					return(false);
+				}
+				SkipJSONSpaces(p, end);
+				if ((p < end) && (*p == ','))
+				{
+					p++;
+				}
+				else if ((p < end) && (*p == '}'))
+				{
+					p++;
+					return(true);
+				}
+				else
+				{
+					return(false);
+				}
+			}
+			return(false);
+		}
+
+		if (*p == '[')
+		{
+			value.type = JSON_VALUE::JSON_ARRAY;
+			p++;
+			SkipJSONSpaces(p, end);
+			if ((p < end) && (*p == ']'))
+			{
+				p++;
+				return(true);
+			}
+			while (p < end)
+			{
+				value.items.push_back(JSON_VALUE());
+				if (!ParseJSONValue(p, end, value.items.back(), depth + 1))
+				{
+					return(false);
+				}
+				SkipJSONSpaces(p, end);
+				if ((p < end) && (*p == ','))
+				{
+					p++;
+				}
+				else if ((p < end) && (*p == ']'))
+				{
+					p++;
+					return(true);
+				}
+				else
+				{
+					return(false);
+				}
+			}
+			return(false);
+		}
+
+		if (*p == '"')
+		{
+			value.type = JSON_VALUE::JSON_STRING;
+			return(ParseJSONString(p, end, value.text));
+		}
+
+		if ((end - p >= 4) && (strncmp(p, "true", 4) == 0))
+		{
+			value.type = JSON_VALUE::JSON_BOOL;
+			value.number = 1.0;
+			p += 4;
+			return(true);
+		}
+		if ((end - p >= 5) && (strncmp(p, "false", 5) == 0))
+		{
+			value.type = JSON_VALUE::JSON_BOOL;
+			p += 5;
+			return(true);
+		}
+		if ((end - p >= 4) && (strncmp(p, "null", 4) == 0))
+		{
+			p += 4;
+			return(true);
+		}
+
+		// the offsets, lengths and counts of a large file need
+		// every bit of a double
+		value.type = JSON_VALUE::JSON_NUMBER;
+		if (!ParseDouble(p, end, value.number))
+		{
+			return(false);
+		}
+
+		return(true);
+	}
+
+	/*** glTF import ***/
+
+	// one buffer of a glTF document
+	struct GLTF_BUFFER
+	{
+		const char* data;
+		size_t size;
+	};
+
+	// the parsed document with every buffer it refers to
+	struct GLTF_DOCUMENT
+	{
+		JSON_VALUE root;
+		std::vector<GLTF_BUFFER> buffers;
+		// storage of the buffers that are not mapped in place
+		std::vector<std::unique_ptr<std::string>> decodedBuffers;
+		std::vector<std::unique_ptr<MappedFile>> bufferFiles;
+	};
+
+	// one triangle primitive of the scene with its transform
+	struct GLTF_PRIMITIVE_JOB
+	{
+		const JSON_VALUE* primitive;
+		glm::mat4 transform;
+		ShapeLODMeshes::MESH_DATA mesh;
+		bool bValid;
+	};
+
+	/***********************************************************
+	 *  DecodeBase64()
+	 *
+	 *  This function is used for decoding the base64 payload of
+	 *  a data URI buffer.
+	 ***********************************************************/
+	void DecodeBase64(const std::string& text, size_t start, std::string& bytes)
+	{
+		unsigned int bits = 0;
+		int bitCount = 0;
+		for (size_t i = start; i < text.size(); i++)
+		{
+			char c = text[i];
+			int value = -1;
+			if ((c >= 'A') && (c <= 'Z'))
+				value = c - 'A';
+			else if ((c >= 'a') && (c <= 'z'))
+				value = c - 'a' + 26;
+			else if ((c >= '0') && (c <= '9'))
+				value = c - '0' + 52;
+			else if (c == '+')
+				value = 62;
+			else if (c == '/')
+				value = 63;
+			if (value < 0)
+			{
+				continue;
+			}
+
+			bits = (bits << 6) | (unsigned int)value;
+			bitCount += 6;
+			if (bitCount >= 8)
+			{
+				bitCount -= 8;
+				bytes += (char)((bits >> bitCount) & 0xFF);
+			}
+		}
+	}
+
+	/***********************************************************
+	 *  LoadGLTFBuffers()
+	 *
+	 *  This function is used for finding the bytes of every
+	 *  buffer, from the GLB binary chunk, a data URI or a file
+	 *  next to the document that is mapped as well.
+	 ***********************************************************/
+	bool LoadGLTFBuffers(
+		GLTF_DOCUMENT& document,
+		const char* binaryChunk,
+		size_t binarySize,
+		const std::string& baseDirectory)
+	{
+		const JSON_VALUE* pBuffers = document.root.Find("buffers");
+		if (NULL == pBuffers)
+		{
+			return(true);
+		}
+
+		for (size_t i = 0; i < pBuffers->items.size(); i++)
+		{
+			const JSON_VALUE* pURI = pBuffers->items[i].Find("uri");
+			GLTF_BUFFER buffer;
+			buffer.data = NULL;
+			buffer.size = 0;
+
+			if (NULL == pURI)
+			{
+				// the first buffer of a GLB file has no uri
+				buffer.data = binaryChunk;
+				buffer.size = binarySize;
+			}
+			else if (pURI->text.compare(0, 5, "data:") == 0)
+			{
+				size_t comma = pURI->text.find(',');
+				if (comma == std::string::npos)
+				{
+					return(false);
+				}
+				document.decodedBuffers.push_back(std::unique_ptr<std::string>(new std::string()));
+				DecodeBase64(pURI->text, comma + 1, *document.decodedBuffers.back());
+				buffer.data = document.decodedBuffers.back()->data();
+				buffer.size = document.decodedBuffers.back()->size();
+			}
+			else
+			{
+				std::string bufferPath = baseDirectory + pURI->text;
+				document.bufferFiles.push_back(std::unique_ptr<MappedFile>(new MappedFile()));
+				if (!document.bufferFiles.back()->Open(bufferPath.c_str()))
+				{
+					std::cout << "Could not open glTF buffer: " << bufferPath << std::endl;
+					return(false);
+				}
+				buffer.data = document.bufferFiles.back()->GetData();
+				buffer.size = document.bufferFiles.back()->GetSize();
+			}
+
+			// a buffer may be larger than its declared length
+			size_t byteLength = (size_t)pBuffers->items[i].GetNumber("byteLength", (double)buffer.size);
+			buffer.size = std::min(buffer.size, byteLength);
+			document.buffers.push_back(buffer);
+		}
+
+		return(true);
+	}
+
+	/***********************************************************
+	 *  ReadGLTFAccessor()
+	 *
+	 *  This function is used for reading every element of an
+	 *  accessor as floats, with the passed in number of values
+	 *  per element. Normalized integers are scaled to [0, 1] or
+	 *  [-1, 1] and the values an element lacks are zero.
+	 ***********************************************************/
+	bool ReadGLTFAccessor(
+		const GLTF_DOCUMENT& document,
+		double accessorIndex,
+		int components,
+		std::vector<float>& values)
+	{
+		const JSON_VALUE* pAccessors = document.root.Find("accessors");
+		const JSON_VALUE* pAccessor = (NULL != pAccessors) ? pAccessors->At(accessorIndex) : NULL;
+		if (NULL == pAccessor)
+		{
+			return(false);
+		}
+
+		const JSON_VALUE* pViews = document.root.Find("bufferViews");
+		const JSON_VALUE* pView = (NULL != pViews) ? pViews->At(pAccessor->GetNumber("bufferView", -1.0)) : NULL;
+		if ((NULL == pView) || (NULL != pAccessor->Find("sparse")))
+		{
+			std::cout << "Unsupported glTF accessor without a buffer view or with sparse values" << std::endl;
+			return(false);
+		}
+
+		size_t bufferIndex = (size_t)pView->GetNumber("buffer", 0.0);
+		if (bufferIndex >= document.buffers.size())
+		{
+			return(false);
+		}
+		const GLTF_BUFFER& buffer = document.buffers[bufferIndex];
+
+		const JSON_VALUE* pType = pAccessor->Find("type");
+		int elementComponents = 1;
+		if (NULL != pType)
+		{
+			if (pType->text == "VEC2")
+				elementComponents = 2;
+			else if (pType->text == "VEC3")
+				elementComponents = 3;
+			else if (pType->text == "VEC4")
+				elementComponents = 4;
+		}
+
+		int componentType = (int)pAccessor->GetNumber("componentType", 0.0);
+		size_t componentSize = 4;
+		if ((componentType == g_ComponentByte) || (componentType == g_ComponentUnsignedByte))
+			componentSize = 1;
+		else if ((componentType == g_ComponentShort) || (componentType == g_ComponentUnsignedShort))
+			componentSize = 2;
+		else if ((componentType != g_ComponentUnsignedInt) && (componentType != g_ComponentFloat))
+			return(false);
+
+		const JSON_VALUE* pNormalized = pAccessor->Find("normalized");
+		bool bNormalized = (NULL != pNormalized) && (pNormalized->number != 0.0);
+
+		size_t count = (size_t)pAccessor->GetNumber("count", 0.0);
+		size_t elementSize = componentSize * elementComponents;
+		size_t stride = (size_t)pView->GetNumber("byteStride", 0.0);
+		if (stride == 0)
+		{
+			stride = elementSize;
+		}
+		size_t offset = (size_t)pView->GetNumber("byteOffset", 0.0) + (size_t)pAccessor->GetNumber("byteOffset", 0.0);
+		if ((count > 0) && (offset + stride * (count - 1) + elementSize > buffer.size))
+		{
+			std::cout << "glTF accessor reads past the end of its buffer" << std::endl;
+			return(false);
+		}
+
+		values.assign(count * components, 0.0f);
+		for (size_t element = 0; element < count; element++)
+		{
+			const char* pElement = buffer.data + offset + element * stride;
+			for (int component = 0; component < std::min(components, elementComponents); component++)
+			{
+				const char* pComponent = pElement + component * componentSize;
+				float value = 0.0f;
+				// memcpy keeps the unaligned reads well defined
+				if (componentType == g_ComponentFloat)
+				{
+					memcpy(&value, pComponent, 4);
+				}
+				else if (componentType == g_ComponentUnsignedInt)
+				{
+					uint32_t number;
+					memcpy(&number, pComponent, 4);
+					value = (float)number;
+				}
+				else if (componentType == g_ComponentUnsignedShort)
+				{
+					uint16_t number;
+					memcpy(&number, pComponent, 2);
+					value = bNormalized ? number / 65535.0f : (float)number;
+				}
+				else if (componentType == g_ComponentShort)
+				{
+					int16_t number;
+					memcpy(&number, pComponent, 2);
+					value = bNormalized ? std::max(number / 32767.0f, -1.0f) : (float)number;
+				}
+				else if (componentType == g_ComponentUnsignedByte)
+				{
+					uint8_t number = (uint8_t)*pComponent;
+					value = bNormalized ? number / 255.0f : (float)number;
+				}
+				else
+				{
+					int8_t number = (int8_t)*pComponent;
+					value = bNormalized ? std::max(number / 127.0f, -1.0f) : (float)number;
+				}
+				values[element * components + component] = value;
+			}
+		}
+
+		return(true);
+	}
+
+	/***********************************************************
+	 *  ReadGLTFIndices()
+	 *
+	 *  This function is used for reading an index accessor.
+	 ***********************************************************/
+	bool ReadGLTFIndices(const GLTF_DOCUMENT& document, double accessorIndex, std::vector<GLuint>& indices)
+	{
+		// float holds every integer up to 2^24 exactly, so larger
+		// indices are read straight from the buffer instead
+		const JSON_VALUE* pAccessors = document.root.Find("accessors");
+		const JSON_VALUE* pAccessor = (NULL != pAccessors) ? pAccessors->At(accessorIndex) : NULL;
+		if ((NULL != pAccessor) && ((int)pAccessor->GetNumber("componentType", 0.0) == g_ComponentUnsignedInt))
+		{
+			const JSON_VALUE* pViews = document.root.Find("bufferViews");
+			const JSON_VALUE* pView = (NULL != pViews) ? pViews->At(pAccessor->GetNumber("bufferView", -1.0)) : NULL;
+			size_t bufferIndex = (NULL != pView) ? (size_t)pView->GetNumber("buffer", 0.0) : document.buffers.size();
+			if (bufferIndex >= document.buffers.size())
+			{
+				return(false);
+			}
+			const GLTF_BUFFER& buffer = document.buffers[bufferIndex];
+			size_t count = (size_t)pAccessor->GetNumber("count", 0.0);
+			size_t stride = std::max((size_t)pView->GetNumber("byteStride", 0.0), (size_t)4);
+			size_t offset = (size_t)pView->GetNumber("byteOffset", 0.0) + (size_t)pAccessor->GetNumber("byteOffset", 0.0);
+			if ((count > 0) && (offset + stride * (count - 1) + 4 > buffer.size))
+			{
+				return(false);
+			}
+			indices.resize(count);
+			for (size_t i = 0; i < count; i++)
+			{
+				memcpy(&indices[i], buffer.data + offset + i * stride, 4);
+			}
+			return(true);
+		}
+
+		std::vector<float> values;
+		if (!ReadGLTFAccessor(document, accessorIndex, 1, values))
+		{
+			return(false);
+		}
+		indices.resize(values.size());
+		for (size_t i = 0; i < values.size(); i++)
+		{
+			indices[i] = (GLuint)values[i];
+		}
+		return(true);
+	}
+
+	/***********************************************************
+	 *  GetGLTFNodeMatrix()
+	 *
+	 *  This function is used for getting the local transform of
+	 *  a node, either its matrix or its translation, rotation
+	 *  and scale.
+	 ***********************************************************/
+	glm::mat4 GetGLTFNodeMatrix(const JSON_VALUE& node)
+	{
+		glm::mat4 transform = glm::mat4(1.0f);
+
+		const JSON_VALUE* pMatrix = node.Find("matrix");
+		if ((NULL != pMatrix) && (pMatrix->items.size() == 16))
+		{
+			// the matrix is stored column by column like glm
+			for (int column = 0; column < 4; column++)
+			{
+				for (int row = 0; row < 4; row++)
+				{
+					transform[column][row] = (float)pMatrix->items[column * 4 + row].number;
+				}
+			}
+			return(transform);
+		}
+
+		glm::vec3 translation = glm::vec3(0.0f);
+		glm::vec4 rotation = glm::vec4(0.0f, 0.0f, 0.0f, 1.0f);
+		glm::vec3 scale = glm::vec3(1.0f);
+		const JSON_VALUE* pTranslation = node.Find("translation");
+		const JSON_VALUE* pRotation = node.Find("rotation");
+		const JSON_VALUE* pScale = node.Find("scale");
+		for (int i = 0; i < 3; i++)
+		{
+			if ((NULL != pTranslation) && (pTranslation->items.size() == 3))
+				translation[i] = (float)pTranslation->items[i].number;
+			if ((NULL != pScale) && (pScale->items.size() == 3))
+				scale[i] = (float)pScale->items[i].number;
+		}
+		if ((NULL != pRotation) && (pRotation->items.size() == 4))
+		{
+			for (int i = 0; i < 4; i++)
+			{
+				rotation[i] = (float)pRotation->items[i].number;
+			}
+		}
+
+		// rotation matrix of the unit quaternion (x, y, z, w)
+		float x = rotation.x;
+		float y = rotation.y;
+		float z = rotation.z;
+		float w = rotation.w;
+		transform[0] = glm::vec4(1.0f - 2.0f * (y * y + z * z), 2.0f * (x * y + z * w), 2.0f * (x * z - y * w), 0.0f) * scale.x;
+		transform[1] = glm::vec4(2.0f * (x * y - z * w), 1.0f - 2.0f * (x * x + z * z), 2.0f * (y * z + x * w), 0.0f) * scale.y;
+		transform[2] = glm::vec4(2.0f * (x * z + y * w), 2.0f * (y * z - x * w), 1.0f - 2.0f * (x * x + y * y), 0.0f) * scale.z;
+		transform[3] = glm::vec4(translation, 1.0f);
+
+		return(transform);
+	}
+
+	/***********************************************************
+	 *  CollectGLTFPrimitives()
+	 *
+	 *  This function is used for walking the node tree and
+	 *  adding a job for every triangle primitive of the meshes
+	 *  it places, with the transform of its node.
+	 ***********************************************************/
+	void CollectGLTFPrimitives(
+		const GLTF_DOCUMENT& document,
+		double nodeIndex,
+		const glm::mat4& parentTransform,
+		int depth,
+		std::vector<GLTF_PRIMITIVE_JOB>& jobs)
+	{
+		const JSON_VALUE* pNodes = document.root.Find("nodes");
+		const JSON_VALUE* pNode = (NULL != pNodes) ? pNodes->At(nodeIndex) : NULL;
+		if ((NULL == pNode) || (depth > g_MaximumDepth))
+		{
+			return;
+		}
+
+		glm::mat4 transform = parentTransform * GetGLTFNodeMatrix(*pNode);
+
+		const JSON_VALUE* pMeshes = document.root.Find("meshes");
+		const JSON_VALUE* pMesh = (NULL != pMeshes) ? pMeshes->At(pNode->GetNumber("mesh", -1.0)) : NULL;
+		const JSON_VALUE* pPrimitives = (NULL != pMesh) ? pMesh->Find("primitives") : NULL;
+		if (NULL != pPrimitives)
+		{
+			for (size_t i = 0; i < pPrimitives->items.size(); i++)
+			{
+				if ((int)pPrimitives->items[i].GetNumber("mode", g_ModeTriangles) == g_ModeTriangles)
+				{
+					GLTF_PRIMITIVE_JOB job;
+					job.primitive = &pPrimitives->items[i];
+					job.transform = transform;
+					job.bValid = false;
+					jobs.push_back(job);
+				}
+			}
+		}
+
+		const JSON_VALUE* pChildren = pNode->Find("children");
+		if (NULL != pChildren)
+		{
+			for (size_t i = 0; i < pChildren->items.size(); i++)
+			{
+				CollectGLTFPrimitives(document, pChildren->items[i].number, transform, depth + 1, jobs);
+			}
+		}
+	}
+
+	/***********************************************************
+	 *  ConvertGLTFPrimitive()
+	 *
+	 *  This function is used for reading the attributes and the
+	 *  indices of one primitive into mesh data, moved by the
+	 *  transform of its node.
+	 ***********************************************************/
+	void ConvertGLTFPrimitive(const GLTF_DOCUMENT& document, GLTF_PRIMITIVE_JOB& job)
+	{
+		const JSON_VALUE* pAttributes = job.primitive->Find("attributes");
+		if (NULL == pAttributes)
+		{
+			return;
+		}
+
+		std::vector<float> positions;
+		std::vector<float> normals;
+		std::vector<float> textureCoordinates;
+		if (!ReadGLTFAccessor(document, pAttributes->GetNumber("POSITION", -1.0), 3, positions))
+		{
+			return;
+		}
+		size_t vertexCount = positions.size() / 3;
+		if ((NULL != pAttributes->Find("NORMAL")) &&
+			(!ReadGLTFAccessor(document, pAttributes->GetNumber("NORMAL", -1.0), 3, normals) ||
+			(normals.size() != vertexCount * 3)))
+		{
+			return;
+		}
+		if ((NULL != pAttributes->Find("TEXCOORD_0")) &&
+			(!ReadGLTFAccessor(document, pAttributes->GetNumber("TEXCOORD_0", -1.0), 2, textureCoordinates) ||
+			(textureCoordinates.size() != vertexCount * 2)))
+		{
+			return;
+		}
+
+		glm::mat3 normalMatrix = glm::transpose(glm::inverse(glm::mat3(job.transform)));
+		job.mesh.vertices.resize(vertexCount);
+		for (size_t i = 0; i < vertexCount; i++)
+		{
+			ShapeLODMeshes::MESH_VERTEX& vertex = job.mesh.vertices[i];
+			glm::vec3 position = glm::vec3(positions[i * 3], positions[i * 3 + 1], positions[i * 3 + 2]);
+			vertex.position = glm::vec3(job.transform * glm::vec4(position, 1.0f));
+			vertex.normal = glm::vec3(0.0f);
+			if (!normals.empty())
+			{
+				glm::vec3 normal = normalMatrix * glm::vec3(normals[i * 3], normals[i * 3 + 1], normals[i * 3 + 2]);
+				float length = glm::length(normal);
+				vertex.normal = (length > 0.0f) ? (normal / length) : glm::vec3(0.0f);
+			}
+			vertex.textureCoordinate = glm::vec2(0.0f);
+			if (!textureCoordinates.empty())
+			{
+				// glTF puts the texture origin at the top left
+				vertex.textureCoordinate = glm::vec2(textureCoordinates[i * 2], 1.0f - textureCoordinates[i * 2 + 1]);
+			}
+		}
+
+		const JSON_VALUE* pIndices = job.primitive->Find("indices");
+		if (NULL != pIndices)
+		{
+			if (!ReadGLTFIndices(document, pIndices->number, job.mesh.indices))
+			{
+				return;
+			}
+		}
+		else
+		{
+			job.mesh.indices.resize(vertexCount);
+			for (size_t i = 0; i < vertexCount; i++)
+			{
+				job.mesh.indices[i] = (GLuint)i;
+			}
+		}
+		job.mesh.indices.resize(job.mesh.indices.size() - job.mesh.indices.size() % 3);
+		for (size_t i = 0; i < job.mesh.indices.size(); i++)
+		{
+			if (job.mesh.indices[i] >= vertexCount)
+			{
+				return;
+			}
+		}
+
+		// a mirroring transform turns the triangles inside out
+		if (glm::determinant(glm::mat3(job.transform)) < 0.0f)
+		{
+			for (size_t i = 0; i < job.mesh.indices.size(); i += 3)
+			{
+				std::swap(job.mesh.indices[i + 1], job.mesh.indices[i + 2]);
+			}
+		}
+
+		ComputeMissingNormals(job.mesh);
+		job.bValid = true;
+	}
+}
+
+/***********************************************************
+ *  ImportMesh()
+ *
+ *  This method is used for importing the mesh of the passed
+ *  in file, chosen by its extension. The file is mapped into
+ *  memory and parsed in place.
+ ***********************************************************/
+bool MeshImporter::ImportMesh(const char* filePath, ShapeLODMeshes::MESH_DATA& mesh)
+{
+	std::chrono::steady_clock::time_point startTime = std::chrono::steady_clock::now();
+
+	std::string path = filePath;
+	std::string extension;
+	size_t dot = path.find_last_of('.');
+	if (dot != std::string::npos)
+	{
+		extension = path.substr(dot + 1);
+		std::transform(extension.begin(), extension.end(), extension.begin(), ::tolower);
+	}
+	size_t slash = path.find_last_of("/\\");
+	std::string baseDirectory = (slash != std::string::npos) ? path.substr(0, slash + 1) : std::string();
+
+	MappedFile file;
+	if (!file.Open(filePath))
+	{
+		std::cout << "Could not open mesh file: " << filePath << std::endl;
+		return(false);
+	}
+
+	mesh.vertices.clear();
+	mesh.indices.clear();
+
+	bool bSuccess = false;
+	if (extension == "obj")
+	{
+		bSuccess = ImportOBJ(file.GetData(), file.GetSize(), mesh);
+	}
+	else if (extension == "gltf")
+	{
+		bSuccess = ImportGLTF(file.GetData(), file.GetSize(), NULL, 0, baseDirectory, mesh);
+	}
+	else if (extension == "glb")
+	{
+		// header of the magic, the version and the length, then
+		// the JSON chunk and the optional binary chunk
+		const char* pData = file.GetData();
+		size_t size = file.GetSize();
+		uint32_t header[3];
+		uint32_t chunkHeader[2];
+		if (size >= 20)
+		{
+			memcpy(header, pData, sizeof(header));
+			memcpy(chunkHeader, pData + 12, sizeof(chunkHeader));
+		}
+		if ((size < 20) || (header[0] != g_GLBMagic) || (header[1] != 2) ||
+			(chunkHeader[1] != g_GLBChunkJSON) || (20 + (size_t)chunkHeader[0] > size))
+		{
+			std::cout << "Not a valid GLB file: " << filePath << std::endl;
+			return(false);
+		}
+
+		const char* pJSON = pData + 20;
+		size_t jsonSize = chunkHeader[0];
+		const char* pBinary = NULL;
+		size_t binarySize = 0;
+		size_t binaryHeader = 20 + jsonSize;
+		if (binaryHeader + 8 <= size)
+		{
+			memcpy(chunkHeader, pData + binaryHeader, sizeof(chunkHeader));
+			if ((chunkHeader[1] == g_GLBChunkBinary) && (binaryHeader + 8 + (size_t)chunkHeader[0] <= size))
+			{
+				pBinary = pData + binaryHeader + 8;
+				binarySize = chunkHeader[0];
+			}
+		}
+		bSuccess = ImportGLTF(pJSON, jsonSize, pBinary, binarySize, baseDirectory, mesh);
+	}
+	else
+	{
+		std::cout << "Unsupported mesh file type: " << filePath << std::endl;
+	}
+
+	if (!bSuccess || mesh.indices.empty())
+	{
+		std::cout << "Could not import mesh: " << filePath << std::endl;
+		mesh.vertices.clear();
+		mesh.indices.clear();
+		return(false);
+	}
+
+	SetSingleMeshPart(mesh);
+
+	std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - startTime;
+	std::cout << "Imported mesh " << filePath << ": " << mesh.vertices.size() << " vertices, "
+		<< mesh.indices.size() / 3 << " triangles in " << elapsed.count() << " ms" << std::endl;
+
+	return(true);
+}
+
+/***********************************************************
+ *  ImportOBJ()
+ *
+ *  This method is used for parsing an OBJ file on all the
+ *  cores. The text is split into chunks at line boundaries
+ *  that are parsed in parallel, the element counts of the
+ *  chunks before each one resolve the face indices, and each
+ *  chunk merges its own face corners into vertices before
+ *  all the chunks are joined.
+ ***********************************************************/
+bool MeshImporter::ImportOBJ(const char* data, size_t size, ShapeLODMeshes::MESH_DATA& mesh)
+{
+	int chunkCount = (int)std::max(1u, std::thread::hardware_concurrency());
+	chunkCount = (int)std::min((size_t)chunkCount, size / g_MinimumChunkSize + 1);
+
+	std::vector<OBJ_CHUNK> chunks(chunkCount);
+	const char* end = data + size;
+	const char* chunkBegin = data;
+	for (int i = 0; i < chunkCount; i++)
+	{
+		const char* chunkEnd = (i + 1 == chunkCount) ? end : data + size * (i + 1) / chunkCount;
+		chunkEnd = std::max(chunkEnd, chunkBegin);
+		// every chunk ends after a line break
+		while ((chunkEnd < end) && (chunkEnd > data) && (chunkEnd[-1] != '\n'))
+		{
+			chunkEnd++;
+		}
+		chunks[i].begin = chunkBegin;
+		chunks[i].end = chunkEnd;
+		chunkBegin = chunkEnd;
+	}
+
+	RunParallel(chunkCount, [&chunks](int i) { ParseOBJChunk(chunks[i]); });
+
+	// the elements before each chunk turn its indices global
+	std::vector<glm::vec3> positions;
+	std::vector<glm::vec2> textureCoordinates;
+	std::vector<glm::vec3> normals;
+	int positionCount = 0;
+	int textureCoordinateCount = 0;
+	int normalCount = 0;
+	for (int i = 0; i < chunkCount; i++)
+	{
+		chunks[i].positionBase = positionCount;
+		chunks[i].textureCoordinateBase = textureCoordinateCount;
+		chunks[i].normalBase = normalCount;
+		positionCount += (int)chunks[i].positions.size();
+		textureCoordinateCount += (int)chunks[i].textureCoordinates.size();
+		normalCount += (int)chunks[i].normals.size();
+	}
+	positions.resize(positionCount);
+	textureCoordinates.resize(textureCoordinateCount);
+	normals.resize(normalCount);
+
+	RunParallel(chunkCount, [&](int i)
+		{
+			std::copy(chunks[i].positions.begin(), chunks[i].positions.end(), positions.begin() + chunks[i].positionBase);
+			std::copy(chunks[i].textureCoordinates.begin(), chunks[i].textureCoordinates.end(),
+				textureCoordinates.begin() + chunks[i].textureCoordinateBase);
+			std::copy(chunks[i].normals.begin(), chunks[i].normals.end(), normals.begin() + chunks[i].normalBase);
+		});
+
+	RunParallel(chunkCount, [&](int i)
+		{
+			BuildOBJChunkMesh(chunks[i], positions, textureCoordinates, normals);
+		});
+
+	size_t vertexCount = 0;
+	size_t indexCount = 0;
+	for (int i = 0; i < chunkCount; i++)
+	{
+		if (!chunks[i].bValid)
+		{
+			std::cout << "OBJ face refers to an element that does not exist" << std::endl;
+			return(false);
+		}
+		vertexCount += chunks[i].mesh.vertices.size();
+		indexCount += chunks[i].mesh.indices.size();
+	}
+
+	// each chunk is copied into its own place of the mesh
+	mesh.vertices.resize(vertexCount);
+	mesh.indices.resize(indexCount);
+	std::vector<size_t> vertexOffsets(chunkCount);
+	std::vector<size_t> indexOffsets(chunkCount);
+	vertexCount = 0;
+	indexCount = 0;
+	for (int i = 0; i < chunkCount; i++)
+	{
+		vertexOffsets[i] = vertexCount;
+		indexOffsets[i] = indexCount;
+		vertexCount += chunks[i].mesh.vertices.size();
+		indexCount += chunks[i].mesh.indices.size();
+	}
+	RunParallel(chunkCount, [&](int i)
+		{
+			const ShapeLODMeshes::MESH_DATA& chunkMesh = chunks[i].mesh;
+			std::copy(chunkMesh.vertices.begin(), chunkMesh.vertices.end(), mesh.vertices.begin() + vertexOffsets[i]);
+			for (size_t j = 0; j < chunkMesh.indices.size(); j++)
+			{
+				mesh.indices[indexOffsets[i] + j] = chunkMesh.indices[j] + (GLuint)vertexOffsets[i];
+			}
+		});
+
+	ComputeMissingNormals(mesh);
+
+	return(true);
+}
+
+/***********************************************************
+ *  ImportGLTF()
+ *
+ *  This method is used for converting the triangle primitives
+ *  placed by the default scene of a glTF document. Without a
+ *  scene every mesh is converted as it is. The primitives are
+ *  converted on their own threads and then joined.
+ ***********************************************************/
+bool MeshImporter::ImportGLTF(
+	const char* json,
+	size_t jsonSize,
+	const char* binaryChunk,
+	size_t binarySize,
+	const std::string& baseDirectory,
+	ShapeLODMeshes::MESH_DATA& mesh)
+{
+	GLTF_DOCUMENT document;
+	const char* p = json;
+	if (!ParseJSONValue(p, json + jsonSize, document.root, 0) ||
+		(document.root.type != JSON_VALUE::JSON_OBJECT))
+	{
+		std::cout << "Could not parse the glTF JSON" << std::endl;
+		return(false);
+	}
+	if (!LoadGLTFBuffers(document, binaryChunk, binarySize, baseDirectory))
+	{
+		return(false);
+	}
+
+	std::vector<GLTF_PRIMITIVE_JOB> jobs;
+	const JSON_VALUE* pScenes = document.root.Find("scenes");
+	const JSON_VALUE* pScene = (NULL != pScenes) ? pScenes->At(document.root.GetNumber("scene", 0.0)) : NULL;
+	const JSON_VALUE* pSceneNodes = (NULL != pScene) ? pScene->Find("nodes") : NULL;
+	if (NULL != pSceneNodes)
+	{
+		for (size_t i = 0; i < pSceneNodes->items.size(); i++)
+		{
+			CollectGLTFPrimitives(document, pSceneNodes->items[i].number, glm::mat4(1.0f), 0, jobs);
+		}
+	}
+	else
+	{
+		const JSON_VALUE* pMeshes = document.root.Find("meshes");
+		for (size_t i = 0; (NULL != pMeshes) && (i < pMeshes->items.size()); i++)
+		{
+			const JSON_VALUE* pPrimitives = pMeshes->items[i].Find("primitives");
+			for (size_t j = 0; (NULL != pPrimitives) && (j < pPrimitives->items.size()); j++)
+			{
+				if ((int)pPrimitives->items[j].GetNumber("mode", g_ModeTriangles) == g_ModeTriangles)
+				{
+					GLTF_PRIMITIVE_JOB job;
+					job.primitive = &pPrimitives->items[j];
+					job.transform = glm::mat4(1.0f);
+					job.bValid = false;
+					jobs.push_back(job);
+				}
+			}
+		}
+	}
+
+	// the jobs are spread over as many threads as there are cores
+	int threadCount = (int)std::min((size_t)std::max(1u, std::thread::hardware_concurrency()), jobs.size());
+	RunParallel(threadCount, [&](int thread)
+		{
+			for (size_t i = thread; i < jobs.size(); i += threadCount)
+			{
+				ConvertGLTFPrimitive(document, jobs[i]);
+			}
+		});
+
+	for (size_t i = 0; i < jobs.size(); i++)
+	{
+		if (jobs[i].bValid)
+		{
+			AppendMeshData(mesh, jobs[i].mesh);
+		}
+		else
+		{
+			std::cout << "Skipped a glTF primitive that could not be read" << std::endl;
+		}
+	}
+
+	return(true);
+}
@@ -0,0 +1,42 @@
+///////////////////////////////////////////////////////////////////////////////
+// meshimporter.h
+// ============
+// import triangle meshes from OBJ, glTF and GLB files into the same mesh
+// data the shape generators produce
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "ShapeLODMeshes.h"
+
+#include <string>
+
+/***********************************************************
+ *  MeshImporter
+ *
+ *  This class reads mesh files into the MESH_DATA layout of
+ *  the shared shape buffer. The files are memory mapped and
+ *  parsed in place. OBJ files are split into chunks at line
+ *  boundaries that are parsed on all the cores, and glTF
+ *  primitives are converted on their own threads. Every
+ *  imported triangle ends up in the sides part of the mesh.
+ ***********************************************************/
+class MeshImporter
+{
+public:
+	// import the mesh of an .obj, .gltf or .glb file
+	static bool ImportMesh(const char* filePath, ShapeLODMeshes::MESH_DATA& mesh);
+
+private:
+	// parse the text of an OBJ file
+	static bool ImportOBJ(const char* data, size_t size, ShapeLODMeshes::MESH_DATA& mesh);
+	// convert the primitives of a glTF document, the binary
+	// chunk is only present in GLB files
+	static bool ImportGLTF(
+		const char* json,
+		size_t jsonSize,
+		const char* binaryChunk,
+		size_t binarySize,
+		const std::string& baseDirectory,
+		ShapeLODMeshes::MESH_DATA& mesh);
+};
@@ -0,0 +1,539 @@
+///////////////////////////////////////////////////////////////////////////////
+// meshoptimizer.cpp
+// ============
+// reorder mesh indices and vertices for the post-transform vertex cache,
+// for less overdraw and for vertex fetch locality
+///////////////////////////////////////////////////////////////////////////////
+
+#include "MeshOptimizer.h"
+
+#include <algorithm>
+#include <cmath>
+
+// declaration of the global variables and defines
+namespace
+{
+	// tuning of the Forsyth vertex scores
+	const int g_ForsythCacheSize = 32;
+	const float g_CacheDecayPower = 1.5f;
+	const float g_LastTriangleScore = 0.75f;
+	const float g_ValenceBoostScale = 2.0f;
+	const float g_ValenceBoostPower = 0.5f;
+
+	// one cluster of triangles for the overdraw sorting
+	struct TRIANGLE_CLUSTER
+	{
+		int firstTriangle;
+		int triangleCount;
+		float sortKey;
+	};
+
+	/***********************************************************
+	 *  ForsythVertexScore()
+	 *
+	 *  This function is used for scoring a vertex from its place
+	 *  in the simulated cache and the triangles still using it.
+	 ***********************************************************/
+	float ForsythVertexScore(int cachePosition, int remainingTriangles)
+	{
+		if (remainingTriangles == 0)
+		{
+			return(-1.0f);
+		}
+
+		float score = 0.0f;
+		if (cachePosition >= 0)
+		{
+			if (cachePosition < 3)
+			{
+				// the vertices of the last triangle get a fixed
+				// score so the strip does not simply continue
+				score = g_LastTriangleScore;
+			}
+			else
+			{
+				float scale = 1.0f / (g_ForsythCacheSize - 3);
+				score = powf(1.0f - (cachePosition - 3) * scale, g_CacheDecayPower);
+			}
+		}
+
+		// boost the vertices with few triangles left so lone
+		// triangles are not left behind
+		score += g_ValenceBoostScale * powf((float)remainingTriangles, -g_ValenceBoostPower);
+
+		return(score);
+	}
+
+	/***********************************************************
+	 *  PositionAt()
+	 *
+	 *  This function is used for reading the position of a
+	 *  vertex from an interleaved vertex array.
+	 ***********************************************************/
+	glm::vec3 PositionAt(const glm::vec3* positions, size_t positionStride, GLuint vertex)
+	{
+		return(*(const glm::vec3*)((const char*)positions + vertex * positionStride));
+	}
+
+	/***********************************************************
+	 *  CountClusterMisses()
+	 *
+	 *  This function is used for counting the cache misses of a
+	 *  run of triangles starting from an empty FIFO cache.
+	 ***********************************************************/
+	int CountClusterMisses(
+		const GLuint* indices,
+		int firstTriangle,
+		int triangleCount,
+		std::vector<int>& cacheTimestamps,
+		int& timestamp,
+		int cacheSize)
+	{
+		// moving the timestamp past the cache size empties the cache
+		timestamp += cacheSize + 1;
+
+		int misses = 0;
+		for (int i = firstTriangle * 3; i < (firstTriangle + triangleCount) * 3; i++)
+		{
+			GLuint vertex = indices[i];
+			if (timestamp - cacheTimestamps[vertex] > cacheSize)
+			{
+				cacheTimestamps[vertex] = timestamp;
+				timestamp++;
+				misses++;
+			}
+		}
+
+		return(misses);
+	}
+}
+
+/***********************************************************
+ *  OptimizeVertexCache()
+ *
+ *  This method is used for reordering the triangles with
+ *  Forsyth's linear-speed vertex cache optimization. Every
+ *  step adds the best scoring triangle that uses a vertex
+ *  in the simulated LRU cache, and only falls back to a scan
+ *  of the remaining triangles when the cache has none left.
+ ***********************************************************/
+void MeshOptimizer::OptimizeVertexCache(GLuint* indices, int indexCount, int vertexCount)
+{
+	int triangleCount = indexCount / 3;
+	if (triangleCount == 0)
+	{
+		return;
+	}
+
+	// triangles using each vertex, stored as one flat list
+	std::vector<int> remainingTriangles(vertexCount, 0);
+	for (int i = 0; i < triangleCount * 3; i++)
+	{
+		remainingTriangles[indices[i]]++;
+	}
+	std::vector<int> adjacencyOffsets(vertexCount + 1, 0);
+	for (int vertex = 0; vertex < vertexCount; vertex++)
+	{
+		adjacencyOffsets[vertex + 1] = adjacencyOffsets[vertex] + remainingTriangles[vertex];
+	}
+	std::vector<int> adjacency(adjacencyOffsets[vertexCount]);
+	std::vector<int> adjacencyFill(adjacencyOffsets.begin(), adjacencyOffsets.end() - 1);
+	for (int triangle = 0; triangle < triangleCount; triangle++)
+	{
+		for (int corner = 0; corner < 3; corner++)
+		{
+			GLuint vertex = indices[triangle * 3 + corner];
+			adjacency[adjacencyFill[vertex]++] = triangle;
+		}
+	}
+
+	std::vector<int> cachePositions(vertexCount, -1);
+	std::vector<float> vertexScores(vertexCount);
+	for (int vertex = 0; vertex < vertexCount; vertex++)
+	{
+		vertexScores[vertex] = ForsythVertexScore(-1, remainingTriangles[vertex]);
+	}
+	std::vector<float> triangleScores(triangleCount);
+	for (int triangle = 0; triangle < triangleCount; triangle++)
+	{
+		triangleScores[triangle] =
+			vertexScores[indices[triangle * 3]] +
+			vertexScores[indices[triangle * 3 + 1]] +
+			vertexScores[indices[triangle * 3 + 2]];
+	}
+
+	std::vector<bool> triangleAdded(triangleCount, false);
+	std::vector<GLuint> orderedIndices;
+	orderedIndices.reserve(triangleCount * 3);
+
+	// the cache holds three extra entries for the vertices that
+	// are pushed out by the newly added triangle
+	std::vector<int> cache;
+	std::vector<int> newCache;
+	cache.reserve(g_ForsythCacheSize + 3);
+	newCache.reserve(g_ForsythCacheSize + 3);
+
+	// the first triangle comes from a scan of all of them
+	int bestTriangle = -1;
+	int scanPosition = 0;
+	for (int added = 0; added < triangleCount; added++)
+	{
+		if (bestTriangle < 0)
+		{
+			// nothing in the cache is left, take the best scoring
+			// triangle of the ones that are still remaining
+			float bestScore = -1.0f;
+			for (int triangle = scanPosition; triangle < triangleCount; triangle++)
+			{
+				if (!triangleAdded[triangle] && (triangleScores[triangle] > bestScore))
+				{
+					bestScore = triangleScores[triangle];
+					bestTriangle = triangle;
+				}
+			}
+			// every triangle before the first remaining one is done
+			while ((scanPosition < triangleCount) && triangleAdded[scanPosition])
+			{
+				scanPosition++;
+			}
+		}
+
+		triangleAdded[bestTriangle] = true;
+		newCache.clear();
+		for (int corner = 0; corner < 3; corner++)
+		{
+			GLuint vertex = indices[bestTriangle * 3 + corner];
+			orderedIndices.push_back(vertex);
+			newCache.push_back((int)vertex);
+
+			// take the added triangle out of the vertex adjacency
+			int first = adjacencyOffsets[vertex];
+			int last = first + remainingTriangles[vertex];
+			for (int i = first; i < last; i++)
+			{
+				if (adjacency[i] == bestTriangle)
+				{
+					std::swap(adjacency[i], adjacency[last - 1]);
+					break;
+				}
+			}
+			remainingTriangles[vertex]--;
+		}
+		for (size_t i = 0; i < cache.size(); i++)
+		{
+			int vertex = cache[i];
+			if ((vertex != newCache[0]) && (vertex != newCache[1]) && (vertex != newCache[2]))
+			{
+				newCache.push_back(vertex);
+			}
+		}
+		cache.swap(newCache);
+
+		// update the scores of every vertex that was in the cache,
+		// the ones pushed out of it get their uncached score
+		for (size_t i = 0; i < cache.size(); i++)
+		{
+			int vertex = cache[i];
+			cachePositions[vertex] = (i < (size_t)g_ForsythCacheSize) ? (int)i : -1;
+			vertexScores[vertex] = ForsythVertexScore(cachePositions[vertex], remainingTriangles[vertex]);
+		}
+
+		bestTriangle = -1;
+		float bestScore = -1.0f;
+		for (size_t i = 0; i < cache.size(); i++)
+		{
+			int vertex = cache[i];
+			int first = adjacencyOffsets[vertex];
+			for (int j = first; j < first + remainingTriangles[vertex]; j++)
+			{
+				int triangle = adjacency[j];
+				float score =
+					vertexScores[indices[triangle * 3]] +
+					vertexScores[indices[triangle * 3 + 1]] +
+					vertexScores[indices[triangle * 3 + 2]];
+				triangleScores[triangle] = score;
+				if (score > bestScore)
+				{
+					bestScore = score;
+					bestTriangle = triangle;
+				}
+			}
+		}
+
+		if (cache.size() > (size_t)g_ForsythCacheSize)
+		{
+			cache.resize(g_ForsythCacheSize);
+		}
+	}
+
+	std::copy(orderedIndices.begin(), orderedIndices.end(), indices);
+}
+
+/***********************************************************
+ *  OptimizeOverdraw()
+ *
+ *  This method is used for reordering the triangles so the
+ *  outward facing parts of a mesh are drawn first and hide
+ *  the parts behind them. The cache ordered triangles are
+ *  split wherever the cache restarts and wherever a cluster
+ *  already reaches the threshold times its own miss ratio.
+ *  The clusters are then sorted by how far they face away
+ *  from the center of the mesh.
+ ***********************************************************/
+void MeshOptimizer::OptimizeOverdraw(
+	GLuint* indices,
+	int indexCount,
+	const glm::vec3* positions,
+	size_t positionStride,
+	int vertexCount,
+	float threshold)
+{
+	int triangleCount = indexCount / 3;
+	if (triangleCount < 2)
+	{
+		return;
+	}
+
+	std::vector<int> cacheTimestamps(vertexCount, -(STATISTICS_CACHE_SIZE + 1));
+	int timestamp = 0;
+
+	// hard boundaries are the triangles that miss all three
+	// vertices, which means the optimized order jumped there
+	std::vector<int> hardBoundaries;
+	for (int triangle = 0; triangle < triangleCount; triangle++)
+	{
+		int misses = 0;
+		for (int corner = 0; corner < 3; corner++)
+		{
+			GLuint vertex = indices[triangle * 3 + corner];
+			if (timestamp - cacheTimestamps[vertex] > STATISTICS_CACHE_SIZE)
+			{
+				cacheTimestamps[vertex] = timestamp;
+				timestamp++;
+				misses++;
+			}
+		}
+		if ((misses == 3) || (triangle == 0))
+		{
+			hardBoundaries.push_back(triangle);
+		}
+	}
+	hardBoundaries.push_back(triangleCount);
+
+	// soft boundaries split the hard clusters where restarting
+	// the cache costs no more than the threshold allows
+	std::vector<TRIANGLE_CLUSTER> clusters;
+	for (size_t i = 0; i + 1 < hardBoundaries.size(); i++)
+	{
+		int first = hardBoundaries[i];
+		int count = hardBoundaries[i + 1] - first;
+		int clusterMisses = CountClusterMisses(indices, first, count, cacheTimestamps, timestamp, STATISTICS_CACHE_SIZE);
+		float targetACMR = threshold * (float)clusterMisses / (float)count;
+
+		timestamp += STATISTICS_CACHE_SIZE + 1;
+		int clusterStart = first;
+		int misses = 0;
+		for (int triangle = first; triangle < first + count; triangle++)
+		{
+			for (int corner = 0; corner < 3; corner++)
+			{
+				GLuint vertex = indices[triangle * 3 + corner];
+				if (timestamp - cacheTimestamps[vertex] > STATISTICS_CACHE_SIZE)
+				{
+					cacheTimestamps[vertex] = timestamp;
+					timestamp++;
+					misses++;
+				}
+			}
+
+			float runningACMR = (float)misses / (float)(triangle - clusterStart + 1);
+			bool bLast = (triangle + 1 == first + count);
+			if (bLast || (runningACMR <= targetACMR))
+			{
+				TRIANGLE_CLUSTER cluster;
+				cluster.firstTriangle = clusterStart;
+				cluster.triangleCount = triangle - clusterStart + 1;
+				cluster.sortKey = 0.0f;
+				clusters.push_back(cluster);
+
+				clusterStart = triangle + 1;
+				misses = 0;
+				timestamp += STATISTICS_CACHE_SIZE + 1;
+			}
+		}
+	}
+
+	if (clusters.size() < 2)
+	{
+		return;
+	}
+
+	// area weighted center of the whole mesh
+	glm::vec3 meshCenter = glm::vec3(0.0f);
+	float meshArea = 0.0f;
+	for (int triangle = 0; triangle < triangleCount; triangle++)
+	{
+		glm::vec3 p0 = PositionAt(positions, positionStride, indices[triangle * 3]);
+		glm::vec3 p1 = PositionAt(positions, positionStride, indices[triangle * 3 + 1]);
+		glm::vec3 p2 = PositionAt(positions, positionStride, indices[triangle * 3 + 2]);
+		float area = glm::length(glm::cross(p1 - p0, p2 - p0));
+		meshCenter += (p0 + p1 + p2) * (area / 3.0f);
+		meshArea += area;
+	}
+	if (meshArea > 0.0f)
+	{
+		meshCenter /= meshArea;
+	}
+
+	for (size_t i = 0; i < clusters.size(); i++)
+	{
+		glm::vec3 clusterCenter = glm::vec3(0.0f);
+		glm::vec3 clusterNormal = glm::vec3(0.0f);
+		float clusterArea = 0.0f;
+		int first = clusters[i].firstTriangle;
+		for (int triangle = first; triangle < first + clusters[i].triangleCount; triangle++)
+		{
+			glm::vec3 p0 = PositionAt(positions, positionStride, indices[triangle * 3]);
+			glm::vec3 p1 = PositionAt(positions, positionStride, indices[triangle * 3 + 1]);
+			glm::vec3 p2 = PositionAt(positions, positionStride, indices[triangle * 3 + 2]);
+			glm::vec3 normal = glm::cross(p1 - p0, p2 - p0);
+			float area = glm::length(normal);
+			clusterCenter += (p0 + p1 + p2) * (area / 3.0f);
+			clusterNormal += normal;
+			clusterArea += area;
+		}
+		if (clusterArea > 0.0f)
+		{
+			clusterCenter /= clusterArea;
+		}
+		float normalLength = glm::length(clusterNormal);
+		if (normalLength > 0.0f)
+		{
+			clusterNormal /= normalLength;
+		}
+		clusters[i].sortKey = glm::dot(clusterCenter - meshCenter, clusterNormal);
+	}
+
+	std::stable_sort(
+		clusters.begin(),
+		clusters.end(),
+		[](const TRIANGLE_CLUSTER& a, const TRIANGLE_CLUSTER& b) { return a.sortKey > b.sortKey; });
+
+	std::vector<GLuint> sortedIndices;
+	sortedIndices.reserve(triangleCount * 3);
+	for (size_t i = 0; i < clusters.size(); i++)
+	{
+		sortedIndices.insert(
+			sortedIndices.end(),
+			indices + clusters[i].firstTriangle * 3,
+			indices + (clusters[i].firstTriangle + clusters[i].triangleCount) * 3);
+	}
+	std::copy(sortedIndices.begin(), sortedIndices.end(), indices);
+}
+
+/***********************************************************
+ *  OptimizeVertexFetch()
+ *
+ *  This method is used for finding the order the indices
+ *  first use the vertices in, so the vertex fetches walk
+ *  through memory instead of jumping around. The remap holds
+ *  the new place of every vertex, and the vertices that no
+ *  index uses are kept at the end.
+ ***********************************************************/
+void MeshOptimizer::OptimizeVertexFetch(
+	std::vector<GLuint>& indices,
+	int vertexCount,
+	std::vector<GLuint>& remap)
+{
+	const GLuint UNUSED = 0xFFFFFFFF;
+	remap.assign(vertexCount, UNUSED);
+	GLuint nextVertex = 0;
+
+	for (size_t i = 0; i < indices.size(); i++)
+	{
+		GLuint vertex = indices[i];
+		if (remap[vertex] == UNUSED)
+		{
+			remap[vertex] = nextVertex;
+			nextVertex++;
+		}
+		indices[i] = remap[vertex];
+	}
+	for (int vertex = 0; vertex < vertexCount; vertex++)
+	{
+		if (remap[vertex] == UNUSED)
+		{
+			remap[vertex] = nextVertex;
+			nextVertex++;
+		}
+	}
+}
+
+/***********************************************************
+ *  AnalyzeVertexCache()
+ *
+ *  This method is used for simulating a FIFO vertex cache of
+ *  the passed in size over the indices and reporting the
+ *  average cache miss ratio and transform to vertex ratio.
+ ***********************************************************/
+MeshOptimizer::CACHE_STATISTICS MeshOptimizer::AnalyzeVertexCache(
+	const GLuint* indices,
+	int indexCount,
+	int vertexCount,
+	int cacheSize)
+{
+	CACHE_STATISTICS statistics;
+	statistics.vertexTransforms = 0;
+	statistics.triangleCount = indexCount / 3;
+	statistics.uniqueVertexCount = 0;
+
+	std::vector<int> cacheTimestamps(vertexCount, -(cacheSize + 1));
+	std::vector<bool> bUsed(vertexCount, false);
+	int timestamp = 0;
+	for (int i = 0; i < statistics.triangleCount * 3; i++)
+	{
+		GLuint vertex = indices[i];
+		if (timestamp - cacheTimestamps[vertex] > cacheSize)
+		{
+			cacheTimestamps[vertex] = timestamp;
+			timestamp++;
+			statistics.vertexTransforms++;
+		}
+		if (!bUsed[vertex])
+		{
+			bUsed[vertex] = true;
+			statistics.uniqueVertexCount++;
+		}
+	}
+
+	statistics.acmr = 0.0f;
+	statistics.atvr = 0.0f;
+	if (statistics.triangleCount > 0)
+	{
+		statistics.acmr = (float)statistics.vertexTransforms / (float)statistics.triangleCount;
+		statistics.atvr = (float)statistics.vertexTransforms / (float)statistics.uniqueVertexCount;
+	}
+
+	return(statistics);
+}
+
+/***********************************************************
+ *  AccumulateStatistics()
+ *
+ *  This method is used for adding the counts of one analysis
+ *  to a running total and updating the total ratios.
+ ***********************************************************/
+void MeshOptimizer::AccumulateStatistics(CACHE_STATISTICS& total, const CACHE_STATISTICS& statistics)
+{
+	total.vertexTransforms += statistics.vertexTransforms;
+	total.triangleCount += statistics.triangleCount;
+	total.uniqueVertexCount += statistics.uniqueVertexCount;
+
+	total.acmr = 0.0f;
+	total.atvr = 0.0f;
+	if (total.triangleCount > 0)
+	{
+		total.acmr = (float)total.vertexTransforms / (float)total.triangleCount;
+		total.atvr = (float)total.vertexTransforms / (float)total.uniqueVertexCount;
+	}
+}
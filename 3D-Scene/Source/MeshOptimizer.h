@@ -0,0 +1,82 @@
+///////////////////////////////////////////////////////////////////////////////
+// meshoptimizer.h
+// ============
+// reorder mesh indices and vertices for the post-transform vertex cache,
+// for less overdraw and for vertex fetch locality
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+
+#include <vector>
+
+/***********************************************************
+ *  MeshOptimizer
+ *
+ *  This class holds the mesh optimization stage that runs on
+ *  the generated and imported meshes before they are uploaded.
+ *  The triangles are first ordered for the vertex cache with
+ *  Forsyth's algorithm, then split into clusters that are
+ *  sorted so the outward facing ones are drawn first, and at
+ *  last the vertices are stored in the order they are used.
+ ***********************************************************/
+class MeshOptimizer
+{
+public:
+	// vertex cache statistics of an index buffer
+	struct CACHE_STATISTICS
+	{
+		// transformed vertices and triangles of the simulation
+		int vertexTransforms;
+		int triangleCount;
+		int uniqueVertexCount;
+		// average cache miss ratio, transforms per triangle
+		float acmr;
+		// average transform to vertex ratio, 1.0 is the best
+		float atvr;
+	};
+
+	// FIFO cache size used when the statistics are reported
+	static const int STATISTICS_CACHE_SIZE = 16;
+
+	// reorder the triangles for the post-transform vertex cache
+	static void OptimizeVertexCache(GLuint* indices, int indexCount, int vertexCount);
+	// reorder clusters of triangles so the outer ones come first,
+	// keeping the cache efficiency within the passed in threshold,
+	// the positions are read with a stride in bytes
+	static void OptimizeOverdraw(
+		GLuint* indices,
+		int indexCount,
+		const glm::vec3* positions,
+		size_t positionStride,
+		int vertexCount,
+		float threshold);
+	// find the order the indices first use the vertices in, and
+	// rewrite the indices to that order
+	static void OptimizeVertexFetch(
+		std::vector<GLuint>& indices,
+		int vertexCount,
+		std::vector<GLuint>& remap);
+	// move the vertices to where the fetch remap puts them
+	template<typename VERTEX>
+	static void RemapVertices(std::vector<VERTEX>& vertices, const std::vector<GLuint>& remap)
+	{
+		std::vector<VERTEX> remappedVertices(vertices.size());
+		for (size_t i = 0; i < vertices.size(); i++)
+		{
+			remappedVertices[remap[i]] = vertices[i];
+		}
+		vertices.swap(remappedVertices);
+	}
+
+	// simulate a FIFO vertex cache over the indices
+	static CACHE_STATISTICS AnalyzeVertexCache(
+		const GLuint* indices,
+		int indexCount,
+		int vertexCount,
+		int cacheSize = STATISTICS_CACHE_SIZE);
+	// add the counts of one analysis to another
+	static void AccumulateStatistics(CACHE_STATISTICS& total, const CACHE_STATISTICS& statistics);
+};
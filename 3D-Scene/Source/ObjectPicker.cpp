@@ -0,0 +1,224 @@
+///////////////////////////////////////////////////////////////////////////////
+// objectpicker.cpp
+// ============
+// find the scene object under a position of the frame by reading back its
+// object ID buffer through pixel buffers, without waiting for the GPU
+///////////////////////////////////////////////////////////////////////////////
+
+#include "ObjectPicker.h"
+
+/***********************************************************
+ *  ObjectPicker()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+ObjectPicker::ObjectPicker()
+{
+	for (int i = 0; i < MAX_PENDING_PICKS; i++)
+	{
+		m_pixelBuffers[i] = 0;
+		m_picks[i].state = PICK_FREE;
+		m_picks[i].sequence = 0;
+		m_picks[i].fence = NULL;
+		m_picks[i].result.position = glm::vec2(0.0f);
+		m_picks[i].result.objectID = NO_OBJECT;
+	}
+	m_nextSequence = 0;
+}
+
+/***********************************************************
+ *  ~ObjectPicker()
+ *
+ *  The destructor for the class
+ ***********************************************************/
+ObjectPicker::~ObjectPicker()
+{
+	Destroy();
+}
+
+/***********************************************************
+ *  Initialize()
+ *
+ *  This method is used for creating a pixel buffer for each
+ *  pick that can be in flight, with room for one object ID.
+ ***********************************************************/
+bool ObjectPicker::Initialize()
+{
+	if (IsInitialized())
+	{
+		return(true);
+	}
+
+	glGenBuffers(MAX_PENDING_PICKS, m_pixelBuffers);
+	for (int i = 0; i < MAX_PENDING_PICKS; i++)
+	{
+		glBindBuffer(GL_PIXEL_PACK_BUFFER, m_pixelBuffers[i]);
+		glBufferData(GL_PIXEL_PACK_BUFFER, sizeof(GLuint), NULL, GL_STREAM_READ);
+	}
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+	return(true);
+}
+
+/***********************************************************
+ *  Destroy()
+ *
+ *  This method is used for freeing the pixel buffers and
+ *  the fences of the picks still in flight, which are lost.
+ ***********************************************************/
+void ObjectPicker::Destroy()
+{
+	for (int i = 0; i < MAX_PENDING_PICKS; i++)
+	{
+		if (m_picks[i].fence != NULL)
+		{
+			glDeleteSync(m_picks[i].fence);
+			m_picks[i].fence = NULL;
+		}
+		m_picks[i].state = PICK_FREE;
+	}
+
+	if (m_pixelBuffers[0] != 0)
+	{
+		glDeleteBuffers(MAX_PENDING_PICKS, m_pixelBuffers);
+		for (int i = 0; i < MAX_PENDING_PICKS; i++)
+		{
+			m_pixelBuffers[i] = 0;
+		}
+	}
+}
+
+/***********************************************************
+ *  RequestPick()
+ *
+ *  This method is used for starting the read of the object
+ *  ID under a position of the frame, given as fractions of
+ *  its width and height from the top left corner like the
+ *  cursor position. The position is mapped into the part
+ *  of the buffer the frame was drawn into, so it follows
+ *  the resolution scale. The copy into the pixel buffer is
+ *  only queued here.
+ ***********************************************************/
+bool ObjectPicker::RequestPick(const FrameCache* pFrameCache, const glm::vec2& position)
+{
+	if (!IsInitialized() || (NULL == pFrameCache) || (pFrameCache->GetObjectIDTexture() == 0))
+	{
+		return(false);
+	}
+
+	int slot = -1;
+	for (int i = 0; (i < MAX_PENDING_PICKS) && (slot < 0); i++)
+	{
+		if (m_picks[i].state == PICK_FREE)
+		{
+			slot = i;
+		}
+	}
+	if (slot < 0)
+	{
+		return(false);
+	}
+
+	// the rows of the frame go from the bottom up
+	glm::ivec2 renderSize = pFrameCache->GetRenderSize();
+	int x = glm::clamp((int)(position.x * renderSize.x), 0, renderSize.x - 1);
+	int y = glm::clamp((int)((1.0f - position.y) * renderSize.y), 0, renderSize.y - 1);
+
+	glBindFramebuffer(GL_READ_FRAMEBUFFER, pFrameCache->GetFramebuffer());
+	glReadBuffer(FrameCache::OBJECT_ID_ATTACHMENT);
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, m_pixelBuffers[slot]);
+	glReadPixels(x, y, 1, 1, GL_RED_INTEGER, GL_UNSIGNED_INT, (void*)0);
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+	// the frame is presented from the color buffer
+	glReadBuffer(GL_COLOR_ATTACHMENT0);
+	glBindFramebuffer(GL_READ_FRAMEBUFFER, 0);
+
+	PENDING_PICK& pick = m_picks[slot];
+	pick.state = PICK_IN_FLIGHT;
+	pick.sequence = m_nextSequence++;
+	pick.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+	pick.result.position = position;
+	pick.result.objectID = NO_OBJECT;
+	return(true);
+}
+
+/***********************************************************
+ *  Update()
+ *
+ *  This method is used for checking the fences of the picks
+ *  in flight without waiting on them, and reading the pixel
+ *  buffers of the ones the GPU is done with. Once the fence
+ *  has passed the copy is finished, so the read does not
+ *  wait either.
+ ***********************************************************/
+void ObjectPicker::Update()
+{
+	for (int i = 0; i < MAX_PENDING_PICKS; i++)
+	{
+		PENDING_PICK& pick = m_picks[i];
+		if (pick.state != PICK_IN_FLIGHT)
+		{
+			continue;
+		}
+
+		GLenum status = glClientWaitSync(pick.fence, 0, 0);
+		if ((status != GL_ALREADY_SIGNALED) && (status != GL_CONDITION_SATISFIED))
+		{
+			continue;
+		}
+		glDeleteSync(pick.fence);
+		pick.fence = NULL;
+
+		glBindBuffer(GL_PIXEL_PACK_BUFFER, m_pixelBuffers[i]);
+		glGetBufferSubData(GL_PIXEL_PACK_BUFFER, 0, sizeof(GLuint), &pick.result.objectID);
+		glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+		pick.state = PICK_READY;
+	}
+}
+
+/***********************************************************
+ *  TakePickResult()
+ *
+ *  This method is used for taking the result of the oldest
+ *  finished pick, which frees its pixel buffer for the next
+ *  pick. False when no pick has finished.
+ ***********************************************************/
+bool ObjectPicker::TakePickResult(PICK_RESULT& result)
+{
+	int oldest = -1;
+	for (int i = 0; i < MAX_PENDING_PICKS; i++)
+	{
+		if ((m_picks[i].state == PICK_READY) &&
+			((oldest < 0) || ((int)(m_picks[i].sequence - m_picks[oldest].sequence) < 0)))
+		{
+			oldest = i;
+		}
+	}
+	if (oldest < 0)
+	{
+		return(false);
+	}
+
+	result = m_picks[oldest].result;
+	m_picks[oldest].state = PICK_FREE;
+	return(true);
+}
+
+/***********************************************************
+ *  HasPendingPicks()
+ *
+ *  This method is used for checking if a pick has not been
+ *  taken yet, so the caller keeps collecting them.
+ ***********************************************************/
+bool ObjectPicker::HasPendingPicks() const
+{
+	for (int i = 0; i < MAX_PENDING_PICKS; i++)
+	{
+		if (m_picks[i].state != PICK_FREE)
+		{
+			return(true);
+		}
+	}
+
+	return(false);
+}
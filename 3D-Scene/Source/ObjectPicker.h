@@ -0,0 +1,90 @@
+///////////////////////////////////////////////////////////////////////////////
+// objectpicker.h
+// ============
+// find the scene object under a position of the frame by reading back its
+// object ID buffer through pixel buffers, without waiting for the GPU
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "FrameCache.h"
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+
+/***********************************************************
+ *  ObjectPicker
+ *
+ *  This class reads single pixels of the object ID buffer
+ *  of the frame cache. A pick copies the pixel into a pixel
+ *  buffer object and puts a fence behind the copy, so the
+ *  request returns at once and the copy runs with the rest
+ *  of the frame. The result is collected a frame or two
+ *  later, once the fence has passed, so reading it never
+ *  stalls the pipeline. A few picks can be in flight at the
+ *  same time and their results come out in the order they
+ *  were asked for.
+ ***********************************************************/
+class ObjectPicker
+{
+public:
+	// constructor
+	ObjectPicker();
+	// destructor
+	~ObjectPicker();
+
+	// object ID of the pixels no scene object covers
+	static const GLuint NO_OBJECT = 0;
+	// most picks waiting for the GPU at the same time
+	static const int MAX_PENDING_PICKS = 4;
+
+	// a finished pick
+	struct PICK_RESULT
+	{
+		// position asked for, as fractions of the frame width and
+		// height from its top left corner
+		glm::vec2 position;
+		GLuint objectID;
+	};
+
+	// create the pixel buffers
+	bool Initialize();
+	// free the pixel buffers and the fences
+	void Destroy();
+	// true when the pixel buffers were created
+	bool IsInitialized() const { return m_pixelBuffers[0] != 0; }
+
+	// start reading the object ID under a position of the last
+	// drawn frame, false when every pick is still in flight or
+	// the frame has no object IDs
+	bool RequestPick(const FrameCache* pFrameCache, const glm::vec2& position);
+	// collect the picks the GPU has finished, without waiting
+	void Update();
+	// take the oldest finished pick, false when none is ready
+	bool TakePickResult(PICK_RESULT& result);
+	// true while a pick is waiting for the GPU or to be taken
+	bool HasPendingPicks() const;
+
+private:
+	// where a pick is in its way through the GPU
+	enum PICK_STATE
+	{
+		PICK_FREE = 0,
+		PICK_IN_FLIGHT,
+		PICK_READY
+	};
+
+	struct PENDING_PICK
+	{
+		PICK_STATE state;
+		// order the pick was asked for in
+		unsigned int sequence;
+		GLsync fence;
+		PICK_RESULT result;
+	};
+
+	// one pixel buffer for every pick that can be in flight
+	GLuint m_pixelBuffers[MAX_PENDING_PICKS];
+	PENDING_PICK m_picks[MAX_PENDING_PICKS];
+	unsigned int m_nextSequence;
+};
@@ -0,0 +1,447 @@
+///////////////////////////////////////////////////////////////////////////////
+// rendertargetmanager.cpp
+// ============
+// own the offscreen attachments the frames are drawn into, sized from the
+// framebuffer of the window, and keep freed ones in a pool for reuse
+///////////////////////////////////////////////////////////////////////////////
+
+#include "RenderTargetManager.h"
+#include "GLStateCache.h"
+
+#include <algorithm>
+
+// declaration of the global variables and defines
+namespace
+{
+	// pooled storage is freed when it was not reused within this
+	// many resizes, enough to go back and forth between two sizes
+	const unsigned int g_PoolLifetime = 2;
+	// most pieces of storage the pool keeps, a window dragged to
+	// a new size every frame would otherwise fill it up
+	const size_t g_MaxPoolSize = 8;
+
+	// get the format and type glTexImage2D needs for allocating
+	// a texture of the sized format without any pixels
+	void GetTextureUploadFormat(GLenum internalFormat, GLenum& format, GLenum& type)
+	{
+		switch (internalFormat)
+		{
+		case GL_DEPTH24_STENCIL8:
+			format = GL_DEPTH_STENCIL;
+			type = GL_UNSIGNED_INT_24_8;
+			break;
+		case GL_DEPTH_COMPONENT16:
+		case GL_DEPTH_COMPONENT24:
+		case GL_DEPTH_COMPONENT32F:
+			format = GL_DEPTH_COMPONENT;
+			type = GL_FLOAT;
+			break;
+		case GL_R32UI:
+			format = GL_RED_INTEGER;
+			type = GL_UNSIGNED_INT;
+			break;
+		case GL_R32F:
+			format = GL_RED;
+			type = GL_FLOAT;
+			break;
+		case GL_RG16:
+			format = GL_RG;
+			type = GL_UNSIGNED_SHORT;
+			break;
+		case GL_RGBA16F:
+		case GL_RGBA32F:
+			format = GL_RGBA;
+			type = GL_FLOAT;
+			break;
+		default:
+			format = GL_RGBA;
+			type = GL_UNSIGNED_BYTE;
+			break;
+		}
+	}
+}
+
+/***********************************************************
+ *  RenderTargetManager()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+RenderTargetManager::RenderTargetManager()
+{
+	m_width = 0;
+	m_height = 0;
+	m_resizeCount = 0;
+	m_generation = 0;
+}
+
+/***********************************************************
+ *  ~RenderTargetManager()
+ *
+ *  The destructor for the class
+ ***********************************************************/
+RenderTargetManager::~RenderTargetManager()
+{
+	Destroy();
+}
+
+/***********************************************************
+ *  AddTarget()
+ *
+ *  This method is used for adding an attachment. A slot of
+ *  a removed attachment is used again before the list grows.
+ ***********************************************************/
+int RenderTargetManager::AddTarget(const RENDER_TARGET_DESC& desc)
+{
+	RENDER_TARGET target;
+	target.desc = desc;
+	target.storage.name = 0;
+	target.storage.internalFormat = desc.internalFormat;
+	target.storage.bTexture = desc.bTexture;
+	target.storage.width = 0;
+	target.storage.height = 0;
+	target.storage.levels = 0;
+	target.storage.releaseResize = 0;
+	target.bInUse = true;
+	AllocateTarget(target);
+
+	for (size_t i = 0; i < m_targets.size(); i++)
+	{
+		if (!m_targets[i].bInUse)
+		{
+			m_targets[i] = target;
+			return((int)i);
+		}
+	}
+
+	m_targets.push_back(target);
+	return((int)m_targets.size() - 1);
+}
+
+/***********************************************************
+ *  RemoveTarget()
+ *
+ *  This method is used for removing an attachment, its
+ *  storage goes into the pool.
+ ***********************************************************/
+void RenderTargetManager::RemoveTarget(int target)
+{
+	if ((target < 0) || (target >= (int)m_targets.size()) || !m_targets[target].bInUse)
+	{
+		return;
+	}
+
+	ReleaseStorage(m_targets[target]);
+	m_targets[target].bInUse = false;
+	TrimPool();
+}
+
+/***********************************************************
+ *  Destroy()
+ *
+ *  This method is used for freeing every attachment and the
+ *  pooled storage.
+ ***********************************************************/
+void RenderTargetManager::Destroy()
+{
+	for (size_t i = 0; i < m_targets.size(); i++)
+	{
+		DeleteStorage(m_targets[i].storage);
+	}
+	m_targets.clear();
+
+	for (size_t i = 0; i < m_pool.size(); i++)
+	{
+		DeleteStorage(m_pool[i]);
+	}
+	m_pool.clear();
+}
+
+/***********************************************************
+ *  Resize()
+ *
+ *  This method is used for following the size of the
+ *  framebuffer. An attachment keeps its storage when its
+ *  size stays the same, such as one of a fixed size. While
+ *  the window is minimized the framebuffer has no size, and
+ *  the attachments keep the storage they have until it is
+ *  restored.
+ ***********************************************************/
+bool RenderTargetManager::Resize(int width, int height)
+{
+	if (((width == m_width) && (height == m_height)) || (width <= 0) || (height <= 0))
+	{
+		return(false);
+	}
+
+	m_width = width;
+	m_height = height;
+	m_resizeCount++;
+
+	// release every attachment that changes size first, so they
+	// can trade storage with each other through the pool
+	std::vector<size_t> changed;
+	for (size_t i = 0; i < m_targets.size(); i++)
+	{
+		RENDER_TARGET& target = m_targets[i];
+		glm::ivec2 size = GetDesiredSize(target.desc);
+		if (target.bInUse && ((size.x != target.storage.width) || (size.y != target.storage.height)))
+		{
+			ReleaseStorage(target);
+			changed.push_back(i);
+		}
+	}
+
+	for (size_t i = 0; i < changed.size(); i++)
+	{
+		AllocateTarget(m_targets[changed[i]]);
+	}
+	TrimPool();
+
+	if (changed.empty())
+	{
+		return(false);
+	}
+
+	m_generation++;
+	return(true);
+}
+
+/***********************************************************
+ *  GetTargetName()
+ *
+ *  This method is used for getting the texture or the
+ *  renderbuffer holding an attachment.
+ ***********************************************************/
+GLuint RenderTargetManager::GetTargetName(int target) const
+{
+	if ((target < 0) || (target >= (int)m_targets.size()))
+	{
+		return(0);
+	}
+	return(m_targets[target].storage.name);
+}
+
+/***********************************************************
+ *  GetTargetSize()
+ *
+ *  This method is used for getting the size in pixels of an
+ *  attachment.
+ ***********************************************************/
+glm::ivec2 RenderTargetManager::GetTargetSize(int target) const
+{
+	if ((target < 0) || (target >= (int)m_targets.size()))
+	{
+		return(glm::ivec2(0));
+	}
+	return(glm::ivec2(m_targets[target].storage.width, m_targets[target].storage.height));
+}
+
+/***********************************************************
+ *  GetTargetLevels()
+ *
+ *  This method is used for getting the number of levels of
+ *  an attachment, 1 for one without mipmaps.
+ ***********************************************************/
+int RenderTargetManager::GetTargetLevels(int target) const
+{
+	if ((target < 0) || (target >= (int)m_targets.size()))
+	{
+		return(0);
+	}
+	return(m_targets[target].storage.levels);
+}
+
+/***********************************************************
+ *  GetDesiredSize()
+ *
+ *  This method is used for getting the size an attachment
+ *  should have at the current framebuffer size.
+ ***********************************************************/
+glm::ivec2 RenderTargetManager::GetDesiredSize(const RENDER_TARGET_DESC& desc) const
+{
+	if ((desc.fixedWidth > 0) && (desc.fixedHeight > 0))
+	{
+		return(glm::ivec2(desc.fixedWidth, desc.fixedHeight));
+	}
+	if ((m_width <= 0) || (m_height <= 0))
+	{
+		return(glm::ivec2(0));
+	}
+	return(glm::ivec2(
+		std::max(1, (int)(m_width * desc.sizeScale + 0.5f)),
+		std::max(1, (int)(m_height * desc.sizeScale + 0.5f))));
+}
+
+/***********************************************************
+ *  AllocateTarget()
+ *
+ *  This method is used for giving an attachment storage of
+ *  the size it should have, none while that size is not
+ *  known yet.
+ ***********************************************************/
+void RenderTargetManager::AllocateTarget(RENDER_TARGET& target)
+{
+	glm::ivec2 size = GetDesiredSize(target.desc);
+	if ((size.x <= 0) || (size.y <= 0))
+	{
+		return;
+	}
+
+	target.storage = AcquireStorage(target.desc.internalFormat, target.desc.bTexture, target.desc.bMipmapped, size.x, size.y);
+}
+
+/***********************************************************
+ *  ReleaseStorage()
+ *
+ *  This method is used for moving the storage of an
+ *  attachment into the pool.
+ ***********************************************************/
+void RenderTargetManager::ReleaseStorage(RENDER_TARGET& target)
+{
+	if (target.storage.name != 0)
+	{
+		target.storage.releaseResize = m_resizeCount;
+		m_pool.push_back(target.storage);
+	}
+	target.storage.name = 0;
+	target.storage.width = 0;
+	target.storage.height = 0;
+}
+
+/***********************************************************
+ *  AcquireStorage()
+ *
+ *  This method is used for taking storage of the passed in
+ *  format and size from the pool, or allocating it when the
+ *  pool has none. Textures filter linearly and clamp at the
+ *  edges, which suits both scaling a frame and reading it
+ *  one texel at a time. A texture with mipmaps is read one
+ *  level at a time instead, so it is not filtered at all.
+ ***********************************************************/
+RenderTargetManager::TARGET_STORAGE RenderTargetManager::AcquireStorage(GLenum internalFormat, bool bTexture, bool bMipmapped, int width, int height)
+{
+	int levels = 1;
+	if (bTexture && bMipmapped)
+	{
+		while ((width >> levels) > 0 || (height >> levels) > 0)
+		{
+			levels++;
+		}
+	}
+
+	for (size_t i = 0; i < m_pool.size(); i++)
+	{
+		TARGET_STORAGE& pooled = m_pool[i];
+		if ((pooled.internalFormat == internalFormat) && (pooled.bTexture == bTexture) &&
+			(pooled.width == width) && (pooled.height == height) && (pooled.levels == levels))
+		{
+			TARGET_STORAGE storage = pooled;
+			m_pool.erase(m_pool.begin() + i);
+			return(storage);
+		}
+	}
+
+	TARGET_STORAGE storage;
+	storage.name = 0;
+	storage.internalFormat = internalFormat;
+	storage.bTexture = bTexture;
+	storage.width = width;
+	storage.height = height;
+	storage.levels = levels;
+	storage.releaseResize = 0;
+
+	if (bTexture)
+	{
+		GLenum format = GL_RGBA;
+		GLenum type = GL_UNSIGNED_BYTE;
+		GetTextureUploadFormat(internalFormat, format, type);
+
+		// integer textures cannot be filtered
+		GLint filter = ((format == GL_RED_INTEGER) || (levels > 1)) ? GL_NEAREST : GL_LINEAR;
+
+		glGenTextures(1, &storage.name);
+		GLStateCache::BindTexture(GLStateCache::SCRATCH_TEXTURE_UNIT, GL_TEXTURE_2D, storage.name);
+		for (int level = 0; level < levels; level++)
+		{
+			glTexImage2D(
+				GL_TEXTURE_2D, level, internalFormat,
+				std::max(1, width >> level), std::max(1, height >> level),
+				0, format, type, NULL);
+		}
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, levels - 1);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, (levels > 1) ? GL_NEAREST_MIPMAP_NEAREST : filter);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, filter);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+		GLStateCache::BindTexture(GLStateCache::SCRATCH_TEXTURE_UNIT, GL_TEXTURE_2D, 0);
+	}
+	else
+	{
+		glGenRenderbuffers(1, &storage.name);
+		glBindRenderbuffer(GL_RENDERBUFFER, storage.name);
+		glRenderbufferStorage(GL_RENDERBUFFER, internalFormat, width, height);
+		glBindRenderbuffer(GL_RENDERBUFFER, 0);
+	}
+
+	return(storage);
+}
+
+/***********************************************************
+ *  TrimPool()
+ *
+ *  This method is used for freeing the pooled storage that
+ *  was not reused within its lifetime, and the oldest when
+ *  the pool holds too much.
+ ***********************************************************/
+void RenderTargetManager::TrimPool()
+{
+	size_t kept = 0;
+	for (size_t i = 0; i < m_pool.size(); i++)
+	{
+		if (m_pool[i].releaseResize + g_PoolLifetime < m_resizeCount)
+		{
+			DeleteStorage(m_pool[i]);
+		}
+		else
+		{
+			m_pool[kept++] = m_pool[i];
+		}
+	}
+	m_pool.resize(kept);
+
+	// the pool is in release order, so the oldest come first
+	if (m_pool.size() > g_MaxPoolSize)
+	{
+		size_t excess = m_pool.size() - g_MaxPoolSize;
+		for (size_t i = 0; i < excess; i++)
+		{
+			DeleteStorage(m_pool[i]);
+		}
+		m_pool.erase(m_pool.begin(), m_pool.begin() + excess);
+	}
+}
+
+/***********************************************************
+ *  DeleteStorage()
+ *
+ *  This method is used for freeing the texture or the
+ *  renderbuffer of a piece of storage.
+ ***********************************************************/
+void RenderTargetManager::DeleteStorage(TARGET_STORAGE& storage)
+{
+	if (storage.name == 0)
+	{
+		return;
+	}
+
+	if (storage.bTexture)
+	{
+		GLStateCache::ForgetTexture(storage.name);
+		glDeleteTextures(1, &storage.name);
+	}
+	else
+	{
+		glDeleteRenderbuffers(1, &storage.name);
+	}
+	storage.name = 0;
+}
@@ -0,0 +1,123 @@
+///////////////////////////////////////////////////////////////////////////////
+// rendertargetmanager.h
+// ============
+// own the offscreen attachments the frames are drawn into, sized from the
+// framebuffer of the window, and keep freed ones in a pool for reuse
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+
+#include <vector>
+
+/***********************************************************
+ *  RenderTargetManager
+ *
+ *  This class holds every offscreen attachment, as a texture
+ *  or a renderbuffer, together with the fraction of the
+ *  framebuffer size it is allocated at, or a fixed size that
+ *  does not follow the window. When the framebuffer size
+ *  changes only the attachments whose size actually changes
+ *  are allocated again. Their old storage goes into a pool
+ *  and is handed out again to an attachment asking for the
+ *  same format and size, so going back and forth between
+ *  two sizes, such as a window toggled between maximized and
+ *  restored, allocates nothing. Pooled storage that is not
+ *  asked for again within a few resizes is freed.
+ ***********************************************************/
+class RenderTargetManager
+{
+public:
+	// constructor
+	RenderTargetManager();
+	// destructor
+	~RenderTargetManager();
+
+	// how an attachment is allocated
+	struct RENDER_TARGET_DESC
+	{
+		// sized format, such as GL_RGBA8 or GL_DEPTH24_STENCIL8
+		GLenum internalFormat;
+		// a texture when it is sampled later, else a renderbuffer
+		bool bTexture;
+		// a texture with every level down to 1x1
+		bool bMipmapped;
+		// fraction of the framebuffer size, when no fixed size
+		float sizeScale;
+		// size in pixels that ignores the framebuffer, 0 when
+		// the attachment follows the framebuffer
+		int fixedWidth;
+		int fixedHeight;
+	};
+
+	// add an attachment, allocated at once when the framebuffer
+	// size is known, and get its handle
+	int AddTarget(const RENDER_TARGET_DESC& desc);
+	// give the storage of an attachment back to the pool
+	void RemoveTarget(int target);
+	// free every attachment and the pool
+	void Destroy();
+
+	// follow the size of the framebuffer, true when any
+	// attachment was allocated again
+	bool Resize(int width, int height);
+
+	// get the texture or renderbuffer of an attachment, 0 while
+	// the framebuffer has no size
+	GLuint GetTargetName(int target) const;
+	// get the size of an attachment in pixels
+	glm::ivec2 GetTargetSize(int target) const;
+	// get the number of levels of an attachment
+	int GetTargetLevels(int target) const;
+	// get the size of the framebuffer the attachments follow
+	glm::ivec2 GetFramebufferSize() const { return glm::ivec2(m_width, m_height); }
+	// goes up whenever an attachment was allocated again, so the
+	// framebuffers using it know to attach it again
+	unsigned int GetGeneration() const { return m_generation; }
+
+private:
+	// allocated storage of an attachment
+	struct TARGET_STORAGE
+	{
+		GLuint name;
+		GLenum internalFormat;
+		bool bTexture;
+		int width;
+		int height;
+		int levels;
+		// resize count when the storage went into the pool
+		unsigned int releaseResize;
+	};
+
+	// an attachment and its current storage
+	struct RENDER_TARGET
+	{
+		RENDER_TARGET_DESC desc;
+		TARGET_STORAGE storage;
+		bool bInUse;
+	};
+
+	std::vector<RENDER_TARGET> m_targets;
+	// storage waiting to be reused
+	std::vector<TARGET_STORAGE> m_pool;
+	// size of the framebuffer of the window
+	int m_width;
+	int m_height;
+	unsigned int m_resizeCount;
+	unsigned int m_generation;
+
+	// get the size an attachment has at the framebuffer size
+	glm::ivec2 GetDesiredSize(const RENDER_TARGET_DESC& desc) const;
+	// give an attachment storage of its desired size
+	void AllocateTarget(RENDER_TARGET& target);
+	// move the storage of an attachment into the pool
+	void ReleaseStorage(RENDER_TARGET& target);
+	// take matching storage from the pool or create it
+	TARGET_STORAGE AcquireStorage(GLenum internalFormat, bool bTexture, bool bMipmapped, int width, int height);
+	// free the pooled storage that was not reused in time
+	void TrimPool();
+	// free the GL object of the storage
+	static void DeleteStorage(TARGET_STORAGE& storage);
+};
@@ -0,0 +1,186 @@
+///////////////////////////////////////////////////////////////////////////////
+// samplermanager.cpp
+// ============
+// own the few sampler objects every scene texture is filtered through, with
+// the anisotropy picked by a texture quality preset
+///////////////////////////////////////////////////////////////////////////////
+
+#include "SamplerManager.h"
+#include "GLStateCache.h"
+
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+
+// declaration of the global variables and defines
+namespace
+{
+	// anisotropy of each quality preset, before it is limited to
+	// what the driver supports
+	const float g_QualityAnisotropy[] = { 1.0f, 4.0f, 16.0f };
+	// names of the quality presets on the command line
+	const char* g_QualityNames[] = { "low", "medium", "high" };
+	const int g_QualityCount = sizeof(g_QualityNames) / sizeof(g_QualityNames[0]);
+
+	// get the highest anisotropy the driver supports, 1 when
+	// anisotropic filtering is not available at all
+	float GetMaxAnisotropy()
+	{
+		if (!GLEW_ARB_texture_filter_anisotropic && !GLEW_EXT_texture_filter_anisotropic)
+		{
+			return(1.0f);
+		}
+
+		GLfloat maxAnisotropy = 1.0f;
+		glGetFloatv(GL_MAX_TEXTURE_MAX_ANISOTROPY_EXT, &maxAnisotropy);
+		return(std::max(1.0f, maxAnisotropy));
+	}
+}
+
+/***********************************************************
+ *  SamplerManager()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+SamplerManager::SamplerManager()
+{
+	for (int i = 0; i < SAMPLER_COUNT; i++)
+	{
+		m_samplers[i] = 0;
+	}
+	m_quality = QUALITY_HIGH;
+}
+
+/***********************************************************
+ *  ~SamplerManager()
+ *
+ *  The destructor for the class
+ ***********************************************************/
+SamplerManager::~SamplerManager()
+{
+	Destroy();
+}
+
+/***********************************************************
+ *  Initialize()
+ *
+ *  This method is used for creating a sampler for each wrap
+ *  mode. The textures are sampled through their mipmaps with
+ *  trilinear filtering, so a texture far away or seen at a
+ *  grazing angle reads a smaller level instead of skipping
+ *  across the full size image.
+ ***********************************************************/
+void SamplerManager::Initialize()
+{
+	if (m_samplers[0] != 0)
+	{
+		return;
+	}
+
+	glGenSamplers(SAMPLER_COUNT, m_samplers);
+	for (int i = 0; i < SAMPLER_COUNT; i++)
+	{
+		GLint wrap = (i == SAMPLER_CLAMP) ? GL_CLAMP_TO_EDGE : GL_REPEAT;
+		glSamplerParameteri(m_samplers[i], GL_TEXTURE_WRAP_S, wrap);
+		glSamplerParameteri(m_samplers[i], GL_TEXTURE_WRAP_T, wrap);
+		glSamplerParameteri(m_samplers[i], GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+		glSamplerParameteri(m_samplers[i], GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	}
+	ApplyQuality();
+}
+
+/***********************************************************
+ *  Destroy()
+ *
+ *  This method is used for freeing the samplers.
+ ***********************************************************/
+void SamplerManager::Destroy()
+{
+	if (m_samplers[0] == 0)
+	{
+		return;
+	}
+
+	for (int i = 0; i < SAMPLER_COUNT; i++)
+	{
+		GLStateCache::ForgetSampler(m_samplers[i]);
+	}
+	glDeleteSamplers(SAMPLER_COUNT, m_samplers);
+	for (int i = 0; i < SAMPLER_COUNT; i++)
+	{
+		m_samplers[i] = 0;
+	}
+}
+
+/***********************************************************
+ *  SetQuality()
+ *
+ *  This method is used for picking the quality preset. The
+ *  textures keep their samplers, so the new anisotropy takes
+ *  effect on the next frame.
+ ***********************************************************/
+void SamplerManager::SetQuality(TEXTURE_QUALITY quality)
+{
+	m_quality = quality;
+	if (m_samplers[0] != 0)
+	{
+		ApplyQuality();
+	}
+}
+
+/***********************************************************
+ *  ParseQuality()
+ *
+ *  This method is used for getting the preset of a name
+ *  given on the command line.
+ ***********************************************************/
+bool SamplerManager::ParseQuality(const char* name, TEXTURE_QUALITY& quality)
+{
+	for (int i = 0; i < g_QualityCount; i++)
+	{
+		if (strcmp(name, g_QualityNames[i]) == 0)
+		{
+			quality = (TEXTURE_QUALITY)i;
+			return(true);
+		}
+	}
+	return(false);
+}
+
+/***********************************************************
+ *  BindSampler()
+ *
+ *  This method is used for binding the sampler of a wrap
+ *  mode to a texture unit.
+ ***********************************************************/
+void SamplerManager::BindSampler(GLuint unit, SAMPLER_TYPE type) const
+{
+	GLStateCache::BindSampler(unit, m_samplers[type]);
+}
+
+/***********************************************************
+ *  ApplyQuality()
+ *
+ *  This method is used for setting the anisotropy of the
+ *  preset on every sampler, limited to what the driver
+ *  supports.
+ ***********************************************************/
+void SamplerManager::ApplyQuality()
+{
+	float maxAnisotropy = GetMaxAnisotropy();
+	float anisotropy = std::min(g_QualityAnisotropy[m_quality], maxAnisotropy);
+	if (maxAnisotropy > 1.0f)
+	{
+		for (int i = 0; i < SAMPLER_COUNT; i++)
+		{
+			glSamplerParameterf(m_samplers[i], GL_TEXTURE_MAX_ANISOTROPY_EXT, anisotropy);
+		}
+	}
+
+	std::cout << "Texture quality " << g_QualityNames[m_quality] << ": trilinear filtering";
+	if (anisotropy > 1.0f)
+	{
+		std::cout << " with " << anisotropy << "x anisotropy";
+	}
+	std::cout << std::endl;
+}
@@ -0,0 +1,72 @@
+///////////////////////////////////////////////////////////////////////////////
+// samplermanager.h
+// ============
+// own the few sampler objects every scene texture is filtered through, with
+// the anisotropy picked by a texture quality preset
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <GL/glew.h>
+
+/***********************************************************
+ *  SamplerManager
+ *
+ *  This class holds one sampler object for each way a scene
+ *  texture is wrapped. Every sampler filters trilinearly
+ *  through the mipmaps of the texture, and anisotropically
+ *  on top when the quality preset asks for it and the driver
+ *  supports it. The samplers are bound to the texture units
+ *  once, next to the textures, so the textures themselves
+ *  carry no filtering state and changing the preset only
+ *  touches the few samplers.
+ ***********************************************************/
+class SamplerManager
+{
+public:
+	// constructor
+	SamplerManager();
+	// destructor
+	~SamplerManager();
+
+	// how a texture is wrapped past its edges
+	enum SAMPLER_TYPE
+	{
+		SAMPLER_REPEAT = 0,
+		SAMPLER_CLAMP,
+		SAMPLER_COUNT
+	};
+
+	// texture quality presets, picking the anisotropy
+	enum TEXTURE_QUALITY
+	{
+		// trilinear filtering only
+		QUALITY_LOW = 0,
+		// 4x anisotropic filtering
+		QUALITY_MEDIUM,
+		// 16x anisotropic filtering
+		QUALITY_HIGH
+	};
+
+	// create the samplers with the current preset
+	void Initialize();
+	// free the samplers
+	void Destroy();
+
+	// pick the preset, the samplers that already exist follow it
+	void SetQuality(TEXTURE_QUALITY quality);
+	TEXTURE_QUALITY GetQuality() const { return m_quality; }
+	// get the preset named low, medium or high, false for any
+	// other name
+	static bool ParseQuality(const char* name, TEXTURE_QUALITY& quality);
+
+	// bind the sampler of a wrap mode to a texture unit
+	void BindSampler(GLuint unit, SAMPLER_TYPE type) const;
+
+private:
+	GLuint m_samplers[SAMPLER_COUNT];
+	TEXTURE_QUALITY m_quality;
+
+	// set the anisotropy of the preset on every sampler
+	void ApplyQuality();
+};
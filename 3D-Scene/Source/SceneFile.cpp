@@ -0,0 +1,659 @@
+///////////////////////////////////////////////////////////////////////////////
+// scenefile.cpp
+// ============
+// memory mapped binary scene files holding the textures, materials, lights,
+// meshes and placed nodes of a scene, and the converter from the text form
+///////////////////////////////////////////////////////////////////////////////
+
+#include "SceneFile.h"
+#include "ShapeLODMeshes.h"
+
+#include <glm/gtx/transform.hpp>
+
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+
+// declaration of the global variables and defines
+namespace
+{
+	// every section starts at a multiple of this many bytes
+	const uint32_t g_SectionAlignment = 16;
+
+	// names of the basic shapes in the text form
+	struct SHAPE_NAME
+	{
+		const char* name;
+		ShapeLODMeshes::LOD_SHAPE shape;
+	};
+	const SHAPE_NAME g_ShapeNames[] =
+	{
+		{ "sphere", ShapeLODMeshes::LOD_SPHERE },
+		{ "half_sphere", ShapeLODMeshes::LOD_HALF_SPHERE },
+		{ "cylinder", ShapeLODMeshes::LOD_CYLINDER },
+		{ "tapered_cylinder", ShapeLODMeshes::LOD_TAPERED_CYLINDER },
+		{ "torus", ShapeLODMeshes::LOD_TORUS },
+		{ "box", ShapeLODMeshes::LOD_BOX },
+		{ "plane", ShapeLODMeshes::LOD_PLANE },
+		{ "pyramid4", ShapeLODMeshes::LOD_PYRAMID4 }
+	};
+
+	// the record layouts are part of the file format
+	static_assert(sizeof(SceneFile::SCENE_HEADER) == 128, "scene header layout changed");
+	static_assert(sizeof(SceneFile::SCENE_TEXTURE) == 16, "scene texture layout changed");
+	static_assert(sizeof(SceneFile::SCENE_MATERIAL) == 32, "scene material layout changed");
+	static_assert(sizeof(SceneFile::SCENE_LIGHT) == 48, "scene light layout changed");
+	static_assert(sizeof(SceneFile::SCENE_MESH) == 16, "scene mesh layout changed");
+	static_assert(sizeof(SceneFile::SCENE_NODE) == 112, "scene node layout changed");
+
+	/***********************************************************
+	 *  TEXT_SCENE
+	 *
+	 *  The records of a text scene collected for writing, with
+	 *  the names the later lines refer to them by.
+	 ***********************************************************/
+	struct TEXT_SCENE
+	{
+		glm::vec4 globalAmbientColor;
+		std::string strings;
+		std::map<std::string, uint32_t> stringOffsets;
+		std::vector<SceneFile::SCENE_TEXTURE> textures;
+		std::vector<SceneFile::SCENE_MATERIAL> materials;
+		std::vector<SceneFile::SCENE_LIGHT> lights;
+		std::vector<SceneFile::SCENE_MESH> meshes;
+		std::vector<SceneFile::SCENE_NODE> nodes;
+		std::map<std::string, int> textureNames;
+		std::map<std::string, int> materialNames;
+		std::map<std::string, int> meshNames;
+
+		// add a string to the string section once
+		uint32_t AddString(const std::string& text)
+		{
+			std::map<std::string, uint32_t>::iterator found = stringOffsets.find(text);
+			if (found != stringOffsets.end())
+			{
+				return(found->second);
+			}
+			uint32_t offset = (uint32_t)strings.size();
+			strings += text;
+			strings += '\0';
+			stringOffsets[text] = offset;
+			return(offset);
+		}
+	};
+
+	/***********************************************************
+	 *  ReadVec3()
+	 *
+	 *  This function is used for reading three numbers.
+	 ***********************************************************/
+	bool ReadVec3(std::istringstream& line, glm::vec3& value)
+	{
+		line >> value.x >> value.y >> value.z;
+		return(!line.fail());
+	}
+
+	/***********************************************************
+	 *  ReadName()
+	 *
+	 *  This function is used for reading a name and finding
+	 *  what it was declared as.
+	 ***********************************************************/
+	bool ReadName(std::istringstream& line, const std::map<std::string, int>& names, int& index)
+	{
+		std::string name;
+		line >> name;
+		std::map<std::string, int>::const_iterator found = names.find(name);
+		if (line.fail() || (found == names.end()))
+		{
+			return(false);
+		}
+		index = found->second;
+		return(true);
+	}
+
+	/***********************************************************
+	 *  ParseNode()
+	 *
+	 *  This function is used for reading the mesh and the
+	 *  optional keyword values of a node line. The transform is
+	 *  built in the same order as SceneManager builds it.
+	 ***********************************************************/
+	bool ParseNode(std::istringstream& line, TEXT_SCENE& scene, SceneFile::SCENE_NODE& node)
+	{
+		glm::vec3 scale = glm::vec3(1.0f);
+		glm::vec3 rotation = glm::vec3(0.0f);
+		glm::vec3 position = glm::vec3(0.0f);
+
+		node.color = glm::vec4(1.0f);
+		node.uvScale = glm::vec2(1.0f);
+		node.material = -1;
+		node.texture = -1;
+		node.parts = SceneFile::PART_ALL;
+		node.padding[0] = 0;
+		node.padding[1] = 0;
+		if (!ReadName(line, scene.meshNames, node.mesh))
+		{
+			return(false);
+		}
+
+		std::string keyword;
+		while (line >> keyword)
+		{
+			bool bValid = true;
+			if (keyword == "scale")
+				bValid = ReadVec3(line, scale);
+			else if (keyword == "rotation")
+				bValid = ReadVec3(line, rotation);
+			else if (keyword == "position")
+				bValid = ReadVec3(line, position);
+			else if (keyword == "color")
+				bValid = !(line >> node.color.r >> node.color.g >> node.color.b >> node.color.a).fail();
+			else if (keyword == "uvscale")
+				bValid = !(line >> node.uvScale.x >> node.uvScale.y).fail();
+			else if (keyword == "texture")
+				bValid = ReadName(line, scene.textureNames, node.texture);
+			else if (keyword == "material")
+				bValid = ReadName(line, scene.materialNames, node.material);
+			else if (keyword == "parts")
+			{
+				// a comma separated list of top, bottom and sides
+				std::string parts;
+				line >> parts;
+				std::istringstream partList(parts);
+				std::string part;
+				node.parts = 0;
+				while (std::getline(partList, part, ','))
+				{
+					if (part == "top")
+						node.parts |= SceneFile::PART_TOP;
+					else if (part == "bottom")
+						node.parts |= SceneFile::PART_BOTTOM;
+					else if (part == "sides")
+						node.parts |= SceneFile::PART_SIDES;
+					else
+						bValid = false;
+				}
+			}
+			else
+				bValid = false;
+
+			if (!bValid)
+			{
+				return(false);
+			}
+		}
+
+		node.transform = glm::translate(position) *
+			glm::rotate(glm::radians(rotation.z), glm::vec3(0.0f, 0.0f, 1.0f)) *
+			glm::rotate(glm::radians(rotation.y), glm::vec3(0.0f, 1.0f, 0.0f)) *
+			glm::rotate(glm::radians(rotation.x), glm::vec3(1.0f, 0.0f, 0.0f)) *
+			glm::scale(scale);
+
+		return(true);
+	}
+
+	/***********************************************************
+	 *  ParseTextLine()
+	 *
+	 *  This function is used for reading one statement of a
+	 *  text scene into the collected records.
+	 ***********************************************************/
+	bool ParseTextLine(const std::string& text, TEXT_SCENE& scene)
+	{
+		std::istringstream line(text);
+		std::string keyword;
+		if (!(line >> keyword) || (keyword[0] == '#'))
+		{
+			return(true);
+		}
+
+		if (keyword == "ambient")
+		{
+			glm::vec3 color;
+			if (!ReadVec3(line, color))
+			{
+				return(false);
+			}
+			scene.globalAmbientColor = glm::vec4(color, 0.0f);
+		}
+		else if (keyword == "texture")
+		{
+			std::string tag;
+			std::string path;
+			if (!(line >> tag >> path))
+			{
+				return(false);
+			}
+			SceneFile::SCENE_TEXTURE texture;
+			texture.tag = scene.AddString(tag);
+			texture.path = scene.AddString(path);
+			texture.wrap = SceneFile::WRAP_REPEAT;
+			texture.padding = 0;
+			std::string wrap;
+			if (line >> wrap)
+			{
+				if (wrap != "clamp")
+				{
+					return(false);
+				}
+				texture.wrap = SceneFile::WRAP_CLAMP;
+			}
+			scene.textureNames[tag] = (int)scene.textures.size();
+			scene.textures.push_back(texture);
+		}
+		else if (keyword == "material")
+		{
+			std::string tag;
+			SceneFile::SCENE_MATERIAL material;
+			line >> tag;
+			if (!ReadVec3(line, material.diffuseColor) || !ReadVec3(line, material.specularColor) ||
+				!(line >> material.shininess))
+			{
+				return(false);
+			}
+			material.tag = scene.AddString(tag);
+			scene.materialNames[tag] = (int)scene.materials.size();
+			scene.materials.push_back(material);
+		}
+		else if (keyword == "light")
+		{
+			SceneFile::SCENE_LIGHT light;
+			light.range = 0.0f;
+			if (!ReadVec3(line, light.position) || !ReadVec3(line, light.diffuseColor) ||
+				!ReadVec3(line, light.specularColor) || !(line >> light.focalStrength >> light.specularIntensity))
+			{
+				return(false);
+			}
+			// the range is optional, without it the light reaches
+			// everything like the lights of the code scene
+			if (!(line >> light.range))
+			{
+				light.range = 0.0f;
+			}
+			if ((int)scene.lights.size() >= SceneFile::MAX_LIGHTS)
+			{
+				std::cout << "Only " << SceneFile::MAX_LIGHTS << " lights are used, the others are skipped" << std::endl;
+				return(true);
+			}
+			scene.lights.push_back(light);
+		}
+		else if (keyword == "mesh")
+		{
+			std::string name;
+			std::string source;
+			std::string value;
+			if (!(line >> name >> source >> value))
+			{
+				return(false);
+			}
+			SceneFile::SCENE_MESH mesh;
+			mesh.shape = 0;
+			mesh.path = 0;
+			mesh.padding = 0;
+			if (source == "shape")
+			{
+				mesh.source = SceneFile::MESH_SHAPE;
+				bool bFound = false;
+				for (size_t i = 0; i < sizeof(g_ShapeNames) / sizeof(g_ShapeNames[0]); i++)
+				{
+					if (value == g_ShapeNames[i].name)
+					{
+						mesh.shape = g_ShapeNames[i].shape;
+						bFound = true;
+					}
+				}
+				if (!bFound)
+				{
+					return(false);
+				}
+			}
+			else if (source == "file")
+			{
+				mesh.source = SceneFile::MESH_FILE;
+				mesh.path = scene.AddString(value);
+			}
+			else
+			{
+				return(false);
+			}
+			scene.meshNames[name] = (int)scene.meshes.size();
+			scene.meshes.push_back(mesh);
+		}
+		else if (keyword == "node")
+		{
+			SceneFile::SCENE_NODE node;
+			if (!ParseNode(line, scene, node))
+			{
+				return(false);
+			}
+			scene.nodes.push_back(node);
+		}
+		else
+		{
+			return(false);
+		}
+
+		return(true);
+	}
+
+	/***********************************************************
+	 *  AddSection()
+	 *
+	 *  This function is used for appending the records of one
+	 *  section to the file image and recording where they are.
+	 ***********************************************************/
+	void AddSection(
+		std::string& image,
+		SceneFile::SECTION_TYPE type,
+		const void* records,
+		size_t count,
+		size_t stride)
+	{
+		// the padding keeps every section aligned
+		image.resize((image.size() + g_SectionAlignment - 1) / g_SectionAlignment * g_SectionAlignment, '\0');
+
+		SceneFile::SCENE_HEADER* pHeader = (SceneFile::SCENE_HEADER*)&image[0];
+		pHeader->sections[type].offset = (uint32_t)image.size();
+		pHeader->sections[type].count = (uint32_t)count;
+		pHeader->sections[type].stride = (uint32_t)stride;
+		pHeader->sections[type].padding = 0;
+
+		image.append((const char*)records, count * stride);
+	}
+}
+
+/***********************************************************
+ *  SceneFile()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+SceneFile::SceneFile()
+{
+	m_pHeader = NULL;
+}
+
+/***********************************************************
+ *  Load()
+ *
+ *  This method is used for mapping a binary scene file and
+ *  checking that its header, sections and references can be
+ *  trusted. Nothing is copied, the sections are used from
+ *  the mapped file.
+ ***********************************************************/
+bool SceneFile::Load(const char* filePath)
+{
+	Close();
+
+	if (!m_file.Open(filePath))
+	{
+		std::cout << "Could not open scene file: " << filePath << std::endl;
+		return(false);
+	}
+
+	const SCENE_HEADER* pHeader = (const SCENE_HEADER*)m_file.GetData();
+	if ((m_file.GetSize() < sizeof(SCENE_HEADER)) || (pHeader->magic != SCENE_MAGIC))
+	{
+		std::cout << "Not a scene file: " << filePath << std::endl;
+		m_file.Close();
+		return(false);
+	}
+	if (pHeader->version != SCENE_VERSION)
+	{
+		std::cout << "Scene file " << filePath << " has version " << pHeader->version
+			<< ", expected " << SCENE_VERSION << std::endl;
+		m_file.Close();
+		return(false);
+	}
+	if (pHeader->fileSize != m_file.GetSize())
+	{
+		std::cout << "Scene file " << filePath << " is cut short or has extra bytes" << std::endl;
+		m_file.Close();
+		return(false);
+	}
+
+	// the record sizes this build expects for each section
+	const size_t strides[SECTION_COUNT] =
+	{
+		1,
+		sizeof(SCENE_TEXTURE),
+		sizeof(SCENE_MATERIAL),
+		sizeof(SCENE_LIGHT),
+		sizeof(SCENE_MESH),
+		sizeof(SCENE_NODE)
+	};
+	for (int i = 0; i < SECTION_COUNT; i++)
+	{
+		const SCENE_SECTION& section = pHeader->sections[i];
+		if ((section.stride != strides[i]) || (section.offset % g_SectionAlignment != 0) ||
+			((uint64_t)section.offset + (uint64_t)section.count * section.stride > m_file.GetSize()))
+		{
+			std::cout << "Scene file " << filePath << " has a damaged section" << std::endl;
+			m_file.Close();
+			return(false);
+		}
+	}
+
+	m_pHeader = pHeader;
+	if (!CheckReferences())
+	{
+		std::cout << "Scene file " << filePath << " refers to records that do not exist" << std::endl;
+		Close();
+		return(false);
+	}
+
+	std::cout << "Loaded scene file " << filePath << ": " << GetCount(SECTION_NODES) << " nodes, "
+		<< GetCount(SECTION_MESHES) << " meshes, " << GetCount(SECTION_MATERIALS) << " materials" << std::endl;
+
+	return(true);
+}
+
+/***********************************************************
+ *  Close()
+ *
+ *  This method is used for unmapping the scene file.
+ ***********************************************************/
+void SceneFile::Close()
+{
+	m_pHeader = NULL;
+	m_file.Close();
+}
+
+/***********************************************************
+ *  GetSection()
+ *
+ *  This method is used for getting the first record of a
+ *  section inside the mapped file.
+ ***********************************************************/
+const char* SceneFile::GetSection(SECTION_TYPE section) const
+{
+	if (NULL == m_pHeader)
+	{
+		return(NULL);
+	}
+
+	return(m_file.GetData() + m_pHeader->sections[section].offset);
+}
+
+/***********************************************************
+ *  GetCount()
+ *
+ *  This method is used for getting the number of records in
+ *  a section.
+ ***********************************************************/
+int SceneFile::GetCount(SECTION_TYPE section) const
+{
+	if (NULL == m_pHeader)
+	{
+		return(0);
+	}
+
+	return((int)m_pHeader->sections[section].count);
+}
+
+/***********************************************************
+ *  GetString()
+ *
+ *  This method is used for getting a string the records
+ *  refer to by its offset.
+ ***********************************************************/
+const char* SceneFile::GetString(uint32_t offset) const
+{
+	return(GetSection(SECTION_STRINGS) + offset);
+}
+
+/***********************************************************
+ *  GetGlobalAmbientColor()
+ *
+ *  This method is used for getting the ambient color the
+ *  scene adds with every light.
+ ***********************************************************/
+glm::vec3 SceneFile::GetGlobalAmbientColor() const
+{
+	if (NULL == m_pHeader)
+	{
+		return(glm::vec3(0.0f));
+	}
+
+	return(glm::vec3(m_pHeader->globalAmbientColor));
+}
+
+/***********************************************************
+ *  CheckReferences()
+ *
+ *  This method is used for checking every string offset and
+ *  record index once, so the users of the sections do not
+ *  have to check them on every access.
+ ***********************************************************/
+bool SceneFile::CheckReferences() const
+{
+	uint32_t stringBytes = (uint32_t)GetCount(SECTION_STRINGS);
+	const char* pStrings = GetSection(SECTION_STRINGS);
+	// the last string ends inside the section
+	if ((stringBytes > 0) && (pStrings[stringBytes - 1] != '\0'))
+	{
+		return(false);
+	}
+
+	const SCENE_TEXTURE* pTextures = GetTextures();
+	for (int i = 0; i < GetCount(SECTION_TEXTURES); i++)
+	{
+		if ((pTextures[i].tag >= stringBytes) || (pTextures[i].path >= stringBytes) ||
+			(pTextures[i].wrap > WRAP_CLAMP))
+		{
+			return(false);
+		}
+	}
+
+	const SCENE_MATERIAL* pMaterials = GetMaterials();
+	for (int i = 0; i < GetCount(SECTION_MATERIALS); i++)
+	{
+		if (pMaterials[i].tag >= stringBytes)
+		{
+			return(false);
+		}
+	}
+
+	const SCENE_MESH* pMeshes = GetMeshes();
+	for (int i = 0; i < GetCount(SECTION_MESHES); i++)
+	{
+		if (((pMeshes[i].source == MESH_SHAPE) && (pMeshes[i].shape >= ShapeLODMeshes::LOD_SHAPE_COUNT)) ||
+			((pMeshes[i].source == MESH_FILE) && (pMeshes[i].path >= stringBytes)) ||
+			(pMeshes[i].source > MESH_FILE))
+		{
+			return(false);
+		}
+	}
+
+	const SCENE_NODE* pNodes = GetNodes();
+	for (int i = 0; i < GetCount(SECTION_NODES); i++)
+	{
+		if ((pNodes[i].mesh < 0) || (pNodes[i].mesh >= GetCount(SECTION_MESHES)) ||
+			(pNodes[i].material < -1) || (pNodes[i].material >= GetCount(SECTION_MATERIALS)) ||
+			(pNodes[i].texture < -1) || (pNodes[i].texture >= GetCount(SECTION_TEXTURES)))
+		{
+			return(false);
+		}
+	}
+
+	return(GetCount(SECTION_LIGHTS) <= MAX_LIGHTS);
+}
+
+/***********************************************************
+ *  ConvertTextScene()
+ *
+ *  This method is used for converting the text form of a
+ *  scene into a binary scene file. Each line of the text is
+ *  one statement and # starts a comment:
+ *
+ *    ambient r g b
+ *    light px py pz  dr dg db  sr sg sb  focal intensity [range]
+ *    texture <tag> <image path> [clamp]
+ *    material <tag>  dr dg db  sr sg sb  shininess
+ *    mesh <name> shape <sphere|half_sphere|cylinder|
+ *        tapered_cylinder|torus|box|plane|pyramid4>
+ *    mesh <name> file <obj, gltf or glb path>
+ *    node <mesh> [scale x y z] [rotation x y z]
+ *        [position x y z] [texture <tag>] [color r g b a]
+ *        [uvscale u v] [material <tag>] [parts top,bottom,sides]
+ *
+ *  The names a line refers to must be declared above it. A
+ *  clamped texture is not repeated past its edges, and a
+ *  node with a texture ignores its color.
+ ***********************************************************/
+bool SceneFile::ConvertTextScene(const char* textPath, const char* binaryPath)
+{
+	std::ifstream textFile(textPath);
+	if (!textFile.is_open())
+	{
+		std::cout << "Could not open text scene: " << textPath << std::endl;
+		return(false);
+	}
+
+	TEXT_SCENE scene;
+	scene.globalAmbientColor = glm::vec4(0.0f);
+	std::string text;
+	int lineNumber = 0;
+	while (std::getline(textFile, text))
+	{
+		lineNumber++;
+		if (!ParseTextLine(text, scene))
+		{
+			std::cout << textPath << ":" << lineNumber << ": could not read: " << text << std::endl;
+			return(false);
+		}
+	}
+
+	// the zeroed header is written first and filled in as
+	// the sections are appended behind it
+	std::string image(sizeof(SCENE_HEADER), '\0');
+	SCENE_HEADER* pHeader = (SCENE_HEADER*)&image[0];
+	pHeader->magic = SCENE_MAGIC;
+	pHeader->version = SCENE_VERSION;
+	pHeader->globalAmbientColor = scene.globalAmbientColor;
+
+	AddSection(image, SECTION_STRINGS, scene.strings.data(), scene.strings.size(), 1);
+	AddSection(image, SECTION_TEXTURES, scene.textures.data(), scene.textures.size(), sizeof(SCENE_TEXTURE));
+	AddSection(image, SECTION_MATERIALS, scene.materials.data(), scene.materials.size(), sizeof(SCENE_MATERIAL));
+	AddSection(image, SECTION_LIGHTS, scene.lights.data(), scene.lights.size(), sizeof(SCENE_LIGHT));
+	AddSection(image, SECTION_MESHES, scene.meshes.data(), scene.meshes.size(), sizeof(SCENE_MESH));
+	AddSection(image, SECTION_NODES, scene.nodes.data(), scene.nodes.size(), sizeof(SCENE_NODE));
+	((SCENE_HEADER*)&image[0])->fileSize = (uint32_t)image.size();
+
+	std::ofstream binaryFile(binaryPath, std::ios::binary);
+	binaryFile.write(image.data(), image.size());
+	if (!binaryFile.good())
+	{
+		std::cout << "Could not write scene file: " << binaryPath << std::endl;
+		return(false);
+	}
+
+	std::cout << "Converted " << textPath << " to " << binaryPath << ": " << scene.nodes.size()
+		<< " nodes, " << image.size() / 1024 << " KB" << std::endl;
+
+	return(true);
+}
@@ -0,0 +1,176 @@
+///////////////////////////////////////////////////////////////////////////////
+// scenefile.h
+// ============
+// memory mapped binary scene files holding the textures, materials, lights,
+// meshes and placed nodes of a scene, and the converter from the text form
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "MappedFile.h"
+
+#include <glm/glm.hpp>
+
+#include <cstdint>
+
+/***********************************************************
+ *  SceneFile
+ *
+ *  This class maps a binary scene file and hands out its
+ *  sections in place. Every section is an array of fixed
+ *  size little-endian records at a 16 byte aligned offset,
+ *  so after the header and the references are checked the
+ *  records are used as they are, without parsing any field.
+ *  Strings are stored once in a string section and the
+ *  records refer to them by their offset.
+ ***********************************************************/
+class SceneFile
+{
+public:
+	// constructor
+	SceneFile();
+
+	// "SCN1" read as a little-endian number
+	static const uint32_t SCENE_MAGIC = 0x314E4353;
+	// bumped whenever the layout of a record changes
+	static const uint32_t SCENE_VERSION = 2;
+	// number of lights the shaders have uniforms for
+	static const int MAX_LIGHTS = 32;
+
+	// the sections of a scene file, in the order they are stored
+	enum SECTION_TYPE
+	{
+		SECTION_STRINGS = 0,
+		SECTION_TEXTURES,
+		SECTION_MATERIALS,
+		SECTION_LIGHTS,
+		SECTION_MESHES,
+		SECTION_NODES,
+		SECTION_COUNT
+	};
+
+	// where the meshes of a scene come from
+	enum MESH_SOURCE
+	{
+		MESH_SHAPE = 0,
+		MESH_FILE
+	};
+
+	// how a texture is wrapped past its edges
+	enum TEXTURE_WRAP
+	{
+		WRAP_REPEAT = 0,
+		WRAP_CLAMP
+	};
+
+	// the parts of a basic shape a node draws
+	enum NODE_PARTS
+	{
+		PART_TOP = 1,
+		PART_BOTTOM = 2,
+		PART_SIDES = 4,
+		PART_ALL = 7
+	};
+
+	// location of one section, the stride is the record size
+	// the file was written with and must match this build
+	struct SCENE_SECTION
+	{
+		uint32_t offset;
+		uint32_t count;
+		uint32_t stride;
+		uint32_t padding;
+	};
+
+	struct SCENE_HEADER
+	{
+		uint32_t magic;
+		uint32_t version;
+		uint32_t fileSize;
+		uint32_t padding;
+		// xyz is the ambient color added by every light
+		glm::vec4 globalAmbientColor;
+		SCENE_SECTION sections[SECTION_COUNT];
+	};
+
+	// an image file loaded into a texture slot under its tag
+	struct SCENE_TEXTURE
+	{
+		uint32_t tag;
+		uint32_t path;
+		uint32_t wrap;
+		uint32_t padding;
+	};
+
+	struct SCENE_MATERIAL
+	{
+		glm::vec3 diffuseColor;
+		float shininess;
+		glm::vec3 specularColor;
+		uint32_t tag;
+	};
+
+	struct SCENE_LIGHT
+	{
+		glm::vec3 position;
+		float focalStrength;
+		glm::vec3 diffuseColor;
+		float specularIntensity;
+		glm::vec3 specularColor;
+		// distance the light reaches, 0 when it lights everything
+		float range;
+	};
+
+	// a basic shape, or a mesh file imported at load time
+	struct SCENE_MESH
+	{
+		uint32_t source;
+		uint32_t shape;
+		uint32_t path;
+		uint32_t padding;
+	};
+
+	// one placed mesh, the indices are -1 when not used
+	struct SCENE_NODE
+	{
+		glm::mat4 transform;
+		glm::vec4 color;
+		glm::vec2 uvScale;
+		int32_t mesh;
+		int32_t material;
+		int32_t texture;
+		uint32_t parts;
+		uint32_t padding[2];
+	};
+
+	// map and check a binary scene file
+	bool Load(const char* filePath);
+	// unmap the scene file
+	void Close();
+	bool IsLoaded() const { return m_pHeader != NULL; }
+
+	// get the records of each section and their counts
+	const SCENE_TEXTURE* GetTextures() const { return (const SCENE_TEXTURE*)GetSection(SECTION_TEXTURES); }
+	const SCENE_MATERIAL* GetMaterials() const { return (const SCENE_MATERIAL*)GetSection(SECTION_MATERIALS); }
+	const SCENE_LIGHT* GetLights() const { return (const SCENE_LIGHT*)GetSection(SECTION_LIGHTS); }
+	const SCENE_MESH* GetMeshes() const { return (const SCENE_MESH*)GetSection(SECTION_MESHES); }
+	const SCENE_NODE* GetNodes() const { return (const SCENE_NODE*)GetSection(SECTION_NODES); }
+	int GetCount(SECTION_TYPE section) const;
+	// get a string the records refer to
+	const char* GetString(uint32_t offset) const;
+	// get the ambient color added by every light
+	glm::vec3 GetGlobalAmbientColor() const;
+
+	// write the binary form of a text scene description
+	static bool ConvertTextScene(const char* textPath, const char* binaryPath);
+
+private:
+	// the mapped file and its header, NULL until it is loaded
+	MappedFile m_file;
+	const SCENE_HEADER* m_pHeader;
+
+	// get the first record of a section
+	const char* GetSection(SECTION_TYPE section) const;
+	// check the references between the records
+	bool CheckReferences() const;
+};
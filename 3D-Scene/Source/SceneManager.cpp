@@ -1,4 +1,6 @@
 #include "SceneManager.h"
+#include "ViewManager.h"
+#include "GLStateCache.h"
 
 #ifndef STB_IMAGE_IMPLEMENTATION
 #define STB_IMAGE_IMPLEMENTATION
@@ -7,14 +9,68 @@
 
 #include <glm/gtx/transform.hpp>
 
+#include <algorithm>
+#include <iostream>
+
 // declaration of global variables
 namespace
 {
-	const char* g_ModelName = "model";
-	const char* g_ColorValueName = "objectColor";
-	const char* g_TextureValueName = "objectTexture";
-	const char* g_UseTextureName = "bUseTexture";
 	const char* g_UseLightingName = "bUseLighting";
+	const char* g_TextureArrayName = "objectTextures";
+	const char* g_PackedVerticesName = "bPackedVertices";
+	// pass of the batch shaders, matching the PASS_ defines in
+	// the batch fragment shader
+	const char* g_ShadingPassName = "shadingPass";
+	// uniforms of the batch shaders drawing both eyes at once
+	const char* g_StereoName = "bStereo";
+	const char* g_EyeViewProjectionNames[2] = { "eyeViewProjections[0]", "eyeViewProjections[1]" };
+	const char* g_EyePositionNames[2] = { "eyePositions[0]", "eyePositions[1]" };
+	const int g_ShadingPassForward = 0;
+	const int g_ShadingPassGBuffer = 1;
+	const int g_ShadingPassTransparent = 2;
+	// the scenes were lit by four light slots that each add the
+	// ambient color, so fewer lights are padded with dark ones
+	// to keep the scenes as bright as they were
+	const int g_MinLightSlots = 4;
+	// largest side of a texture unless set otherwise, the larger
+	// images are scaled down when they are loaded
+	const int g_DefaultMaxTextureSize = 2048;
+
+	// shader code used for drawing the static batch
+	const char* g_BatchVertexShaderPath = "shaders/batchVertexShader.glsl";
+	const char* g_BatchFragmentShaderPath = "shaders/batchFragmentShader.glsl";
+	// shader code used for drawing the occluders into the depth
+	// buffer, with the batch vertex shader
+	const char* g_DepthFragmentShaderPath = "shaders/depthFragmentShader.glsl";
+	// shader code used for culling the static batch
+	const char* g_CullComputeShaderPath = "shaders/cullComputeShader.glsl";
+	// materials that override the ones defined in the code,
+	// the file is watched and reloaded when it is saved
+	const char* g_MaterialLibraryPath = "materials/scene.mat";
+	// number of texture slots available to the shaders
+	const int g_MaxTextureSlots = 16;
+	// seconds between two printed culling reports
+	const double g_ReportInterval = 5.0;
+	// scene file nodes prepared or sorted by one job
+	const int g_SceneDrawBatchSize = 256;
+	// material of the scene file nodes without one, the first
+	// defined material like the other draws start with
+	const int g_SceneDefaultMaterial = 0;
+	// draws the draw constant ring has room for in each frame
+	// before it grows, a scene file asks for one per node
+	const int g_InitialDrawsPerFrame = 256;
+
+	// projected size in pixels below which the next coarser level
+	// of a curved shape is used
+	const float g_LODPixelThresholds[ShapeLODMeshes::LOD_LEVELS - 1] = { 300.0f, 120.0f, 40.0f };
+	// fraction a size has to move past a threshold before the level
+	// changes, to avoid popping back and forth at the boundary
+	const float g_LODHysteresis = 0.15f;
+
+	// space taken by the beer bottle built from the basic shapes,
+	// an imported bottle mesh is scaled and moved to fill it
+	const glm::vec3 g_BottleBaseCenter = glm::vec3(-4.5f, -0.3625f, -2.0f);
+	const float g_BottleHeight = 9.4625f;
 }
 
 /***********************************************************
@@ -25,8 +81,50 @@ namespace
 SceneManager::SceneManager(ShaderManager* pShaderManager)
 {
 	m_pShaderManager = pShaderManager;
-	m_basicMeshes = new ShapeMeshes();
+	m_lodMeshes = new ShapeLODMeshes();
+	m_staticBatch = new StaticBatch();
+	m_pBatchShaderManager = NULL;
+	m_bRecordingStaticBatch = false;
+	m_bUseStaticBatch = true;
+	m_gpuCulling = new GPUCulling();
+	m_bUseGPUCulling = true;
+	m_pHiZPyramid = NULL;
+	m_pFrameCache = NULL;
+	m_pDepthShaderManager = NULL;
+	m_bUseOcclusionCulling = true;
+	m_pDeferredShading = NULL;
+	m_bDeferred = false;
+	m_bReportStats = false;
+	m_lastReportTime = std::chrono::steady_clock::now();
+	m_bPackVertices = true;
+	m_bOptimizeMeshes = true;
+	m_bottleMeshID = -1;
+	m_sceneFile = new SceneFile();
+	m_materialLibrary = new MaterialLibrary();
+	m_materialLibraryPath = g_MaterialLibraryPath;
+	m_drawData.color = glm::vec4(1.0f);
+	m_drawData.uvScale = glm::vec2(1.0f, 1.0f);
+	m_drawData.textureSlot = 0;
+	m_drawData.materialIndex = 0;
+	m_drawData.bUseTexture = 0;
+	m_drawData.objectID = 0;
+	m_drawData.padding[0] = 0;
+	m_drawData.padding[1] = 0;
+	m_drawConstants = new DrawConstantRing();
+	m_pViewManager = NULL;
+	m_modelMatrix = glm::mat4(1.0f);
+	m_lodDrawIndex = 0;
 	m_loadedTextures = 0;
+	m_pSamplers = new SamplerManager();
+	m_pTextureCache = new TextureCache();
+	m_imageOptions.maxSize = g_DefaultMaxTextureSize;
+	m_imageOptions.filter = ImageProcessor::FILTER_LANCZOS;
+	m_jobSystem = new JobSystem();
+	m_jobSystem->Start();
+	for (int i = 0; i < m_jobSystem->GetThreadCount(); i++)
+	{
+		m_frameArenas.push_back(new FrameArena());
+	}
 }
 
 /***********************************************************
@@ -37,324 +135,1750 @@ SceneManager::SceneManager(ShaderManager* pShaderManager)
 SceneManager::~SceneManager()
 {
 	m_pShaderManager = NULL;
-	delete m_basicMeshes;
-	m_basicMeshes = NULL;
+	m_pViewManager = NULL;
+	m_pHiZPyramid = NULL;
+	m_pFrameCache = NULL;
+	m_pDeferredShading = NULL;
+	delete m_jobSystem;
+	m_jobSystem = NULL;
+	for (size_t i = 0; i < m_frameArenas.size(); i++)
+	{
+		delete m_frameArenas[i];
+	}
+	m_frameArenas.clear();
+	delete m_lodMeshes;
+	m_lodMeshes = NULL;
+	delete m_gpuCulling;
+	m_gpuCulling = NULL;
+	delete m_staticBatch;
+	m_staticBatch = NULL;
+	delete m_sceneFile;
+	m_sceneFile = NULL;
+	delete m_materialLibrary;
+	m_materialLibrary = NULL;
+	delete m_drawConstants;
+	m_drawConstants = NULL;
+	if (NULL != m_pBatchShaderManager)
+	{
+		GLStateCache::ForgetProgram(m_pBatchShaderManager->m_programID);
+		delete m_pBatchShaderManager;
+		m_pBatchShaderManager = NULL;
+	}
+	if (NULL != m_pDepthShaderManager)
+	{
+		GLStateCache::ForgetProgram(m_pDepthShaderManager->m_programID);
+		delete m_pDepthShaderManager;
+		m_pDepthShaderManager = NULL;
+	}
 	DestroyGLTextures();
+	delete m_pTextureCache;
+	m_pTextureCache = NULL;
+	delete m_pSamplers;
+	m_pSamplers = NULL;
 }
 
 /***********************************************************
  *  CreateGLTexture()
  *
- *  This method is used for loading textures from image files,
- *  configuring the texture mapping parameters in OpenGL,
- *  generating the mipmaps, and loading the read texture into
- *  the next available texture slot in memory.
- ***********************************************************/
-bool SceneManager::CreateGLTexture(const char* filename, std::string tag)
-{
-	int width = 0;
-	int height = 0;
-	int colorChannels = 0;
-	GLuint textureID = 0;
-
-	// indicate to always flip images vertically when loaded
-	stbi_set_flip_vertically_on_load(true);
-
-	// try to parse the image data from the specified image file
-	unsigned char* image = stbi_load(
-		filename,
-		&width,
-		&height,
-		&colorChannels,
-		0);
-
-	// if the image was successfully read from the image file
-	if (image)
-	{
-		std::cout << "Successfully loaded image:" << filename << ", width:" << width << ", height:" << height << ", channels:" << colorChannels << std::endl;
-
-		glGenTextures(1, &textureID);
-		glBindTexture(GL_TEXTURE_2D, textureID);
-
-		// set the texture wrapping parameters
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-		// set texture filtering parameters
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-
-		// if the loaded image is in RGB format
-		if (colorChannels == 3)
-			glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB8, width, height, 0, GL_RGB, GL_UNSIGNED_BYTE, image);
-		// if the loaded image is in RGBA format - it supports transparency
-		else if (colorChannels == 4)
-			glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, image);
-		else
+ *  This method is used for getting the texture of an image
+ *  file from the texture cache, which loads it only when it
+ *  holds no texture of the same image, and registering it
+ *  under the tag. The tags with the same texture and sampler
+ *  share a texture slot. The wrapping and filtering come
+ *  from the shared sampler it is bound with, not from the
+ *  texture.
+ ***********************************************************/
+bool SceneManager::CreateGLTexture(const char* filename, std::string tag, SamplerManager::SAMPLER_TYPE sampler)
+{
+	// scale the image down to the largest size the settings and
+	// the driver allow
+	GLint maxDriverSize = 0;
+	glGetIntegerv(GL_MAX_TEXTURE_SIZE, &maxDriverSize);
+	ImageProcessor::PROCESS_OPTIONS options = m_imageOptions;
+	if ((options.maxSize <= 0) || ((maxDriverSize > 0) && (options.maxSize > maxDriverSize)))
+	{
+		options.maxSize = maxDriverSize;
+	}
+
+	GLuint textureID = m_pTextureCache->Acquire(filename, options);
+	if (textureID == 0)
+	{
+		// Error loading the image
+		return false;
+	}
+
+	int textureSlot = -1;
+	for (int i = 0; (i < m_loadedTextures) && (textureSlot < 0); i++)
+	{
+		if ((m_textureSlots[i].ID == textureID) && (m_textureSlots[i].sampler == sampler))
+		{
+			textureSlot = i;
+		}
+	}
+	if (textureSlot < 0)
+	{
+		if (m_loadedTextures >= g_MaxTextureSlots)
 		{
-			std::cout << "Not implemented to handle image with " << colorChannels << " channels" << std::endl;
+			std::cerr << "No texture slot left for: " << filename << std::endl;
+			m_pTextureCache->Release(textureID);
 			return false;
 		}
-
-		// generate the texture mipmaps for mapping textures to lower resolutions
-		glGenerateMipmap(GL_TEXTURE_2D);
-
-		// free the image data from local memory
-		stbi_image_free(image);
-		glBindTexture(GL_TEXTURE_2D, 0); // Unbind the texture
-
-		// register the loaded texture and associate it with the special tag string
-		m_textureIDs[m_loadedTextures].ID = textureID;
-		m_textureIDs[m_loadedTextures].tag = tag;
-		m_loadedTextures++;
-
-		return true;
+		textureSlot = m_loadedTextures++;
+		m_textureSlots[textureSlot].ID = textureID;
+		m_textureSlots[textureSlot].sampler = sampler;
 	}
 
-	std::cout << "Could not load image:" << filename << std::endl;
+	// register the loaded texture and associate it with the special tag string
+	TEXTURE_INFO textureInfo;
+	textureInfo.tag = tag;
+	textureInfo.ID = textureID;
+	textureInfo.sampler = sampler;
+	textureInfo.slot = textureSlot;
+	m_textureIDs.push_back(textureInfo);
 
-	// Error loading the image
-	return false;
+	return true;
 }
 
 /***********************************************************
  *  BindGLTextures()
  *
  *  This method is used for binding the loaded textures to
- *  OpenGL texture memory slots.  There are up to 16 slots.
+ *  OpenGL texture memory slots, each with the sampler of its
+ *  wrap mode.  There are up to 16 slots.
  ***********************************************************/
 void SceneManager::BindGLTextures()
 {
+	m_pSamplers->Initialize();
 	for (int i = 0; i < m_loadedTextures; i++)
 	{
-		// bind textures on corresponding texture units
-		glActiveTexture(GL_TEXTURE0 + i);
-		glBindTexture(GL_TEXTURE_2D, m_textureIDs[i].ID);
+		// bind textures on corresponding texture units
+		GLStateCache::BindTexture(i, GL_TEXTURE_2D, m_textureSlots[i].ID);
+		m_pSamplers->BindSampler(i, m_textureSlots[i].sampler);
+	}
+}
+
+/***********************************************************
+ *  DestroyGLTextures()
+ *
+ *  This method is used for releasing the textures of every
+ *  tag, the cache frees each one with its last tag.
+ ***********************************************************/
+void SceneManager::DestroyGLTextures()
+{
+	for (size_t i = 0; i < m_textureIDs.size(); i++)
+	{
+		m_pTextureCache->Release(m_textureIDs[i].ID);
+	}
+	m_textureIDs.clear();
+	m_loadedTextures = 0;
+}
+
+/***********************************************************
+ *  FindTextureID()
+ *
+ *  This method is used for getting an ID for the previously
+ *  loaded texture bitmap associated with the passed in tag.
+ ***********************************************************/
+int SceneManager::FindTextureID(const char* tag)
+{
+	int textureID = -1;
+	int index = 0;
+	bool bFound = false;
+
+	while ((index < (int)m_textureIDs.size()) && (bFound == false))
+	{
+		if (m_textureIDs[index].tag.compare(tag) == 0)
+		{
+			textureID = m_textureIDs[index].ID;
+			bFound = true;
+		}
+		else
+			index++;
+	}
+
+	return(textureID);
+}
+
+/***********************************************************
+ *  FindTextureSlot()
+ *
+ *  This method is used for getting a slot index for the previously
+ *  loaded texture bitmap associated with the passed in tag.
+ ***********************************************************/
+int SceneManager::FindTextureSlot(const char* tag)
+{
+	int textureSlot = -1;
+	int index = 0;
+	bool bFound = false;
+
+	while ((index < (int)m_textureIDs.size()) && (bFound == false))
+	{
+		if (m_textureIDs[index].tag.compare(tag) == 0)
+		{
+			textureSlot = m_textureIDs[index].slot;
+			bFound = true;
+		}
+		else
+			index++;
+	}
+
+	return(textureSlot);
+}
+
+/***********************************************************
+ *  FindMaterial()
+ *
+ *  This method is used for getting a material from the previously
+ *  defined materials list that is associated with the passed in tag.
+ ***********************************************************/
+bool SceneManager::FindMaterial(const char* tag, OBJECT_MATERIAL& material)
+{
+	if (m_objectMaterials.size() == 0)
+	{
+		return(false);
+	}
+
+	int index = 0;
+	bool bFound = false;
+	while ((index < m_objectMaterials.size()) && (bFound == false))
+	{
+		if (m_objectMaterials[index].tag.compare(tag) == 0)
+		{
+			bFound = true;
+			material.ambientColor = m_objectMaterials[index].ambientColor;
+			material.ambientStrength = m_objectMaterials[index].ambientStrength;
+			material.diffuseColor = m_objectMaterials[index].diffuseColor;
+			material.specularColor = m_objectMaterials[index].specularColor;
+			material.shininess = m_objectMaterials[index].shininess;
+		}
+		else
+		{
+			index++;
+		}
+	}
+
+	return(true);
+}
+
+/***********************************************************
+ *  FindMaterialIndex()
+ *
+ *  This method is used for getting the position in the
+ *  defined materials list of the material associated with
+ *  the passed in tag, or -1 when there is no such material.
+ ***********************************************************/
+int SceneManager::FindMaterialIndex(const char* tag)
+{
+	int index = 0;
+	while (index < (int)m_objectMaterials.size())
+	{
+		if (m_objectMaterials[index].tag.compare(tag) == 0)
+		{
+			return(index);
+		}
+		index++;
+	}
+
+	return(-1);
+}
+
+/***********************************************************
+ *  SetTransformations()
+ *
+ *  This method is used for setting the transform buffer
+ *  using the passed in transformation values. The matrix
+ *  reaches the shaders with the next draw.
+ ***********************************************************/
+void SceneManager::SetTransformations(
+	glm::vec3 scaleXYZ,
+	float XrotationDegrees,
+	float YrotationDegrees,
+	float ZrotationDegrees,
+	glm::vec3 positionXYZ)
+{
+	// variables for this method
+	glm::mat4 modelView;
+	glm::mat4 scale;
+	glm::mat4 rotationX;
+	glm::mat4 rotationY;
+	glm::mat4 rotationZ;
+	glm::mat4 translation;
+
+	// set the scale value in the transform buffer
+	scale = glm::scale(scaleXYZ);
+	// set the rotation values in the transform buffer
+	rotationX = glm::rotate(glm::radians(XrotationDegrees), glm::vec3(1.0f, 0.0f, 0.0f));
+	rotationY = glm::rotate(glm::radians(YrotationDegrees), glm::vec3(0.0f, 1.0f, 0.0f));
+	rotationZ = glm::rotate(glm::radians(ZrotationDegrees), glm::vec3(0.0f, 0.0f, 1.0f));
+	// set the translation value in the transform buffer
+	translation = glm::translate(positionXYZ);
+
+	modelView = translation * rotationZ * rotationY * rotationX * scale;
+	m_modelMatrix = modelView;
+}
+
+/***********************************************************
+ *  SetShaderColor()
+ *
+ *  This method is used for setting the passed in color
+ *  into the shader for the next draw command
+ ***********************************************************/
+void SceneManager::SetShaderColor(
+	float redColorValue,
+	float greenColorValue,
+	float blueColorValue,
+	float alphaValue)
+{
+	// variables for this method
+	glm::vec4 currentColor;
+
+	currentColor.r = redColorValue;
+	currentColor.g = greenColorValue;
+	currentColor.b = blueColorValue;
+	currentColor.a = alphaValue;
+
+	m_drawData.color = currentColor;
+	m_drawData.bUseTexture = 0;
+}
+
+/***********************************************************
+ *  SetShaderTexture()
+ *
+ *  This method is used for setting the texture data
+ *  associated with the passed in ID into the shader.
+ ***********************************************************/
+void SceneManager::SetShaderTexture(
+	const char* textureTag)
+{
+	int textureID = -1;
+	textureID = FindTextureSlot(textureTag);
+
+	// an unknown tag leaves the previous texture slot in place
+	m_drawData.bUseTexture = 1;
+	if (textureID >= 0)
+	{
+		m_drawData.textureSlot = textureID;
+	}
+}
+
+/***********************************************************
+ *  SetTextureUVScale()
+ *
+ *  This method is used for setting the texture UV scale
+ *  values into the shader.
+ ***********************************************************/
+void SceneManager::SetTextureUVScale(float u, float v)
+{
+	m_drawData.uvScale = glm::vec2(u, v);
+}
+
+/***********************************************************
+ *  SetShaderMaterial()
+ *
+ *  This method is used for passing the material values
+ *  into the shader.
+ ***********************************************************/
+void SceneManager::SetShaderMaterial(
+	const char* materialTag)
+{
+	if (m_objectMaterials.size() > 0)
+	{
+		// an unknown tag leaves the previous material in place
+		int materialIndex = FindMaterialIndex(materialTag);
+		if (materialIndex >= 0)
+		{
+			m_drawData.materialIndex = materialIndex;
+		}
+	}
+}
+
+/***********************************************************
+ *  SetShaderTextureSlot()
+ *
+ *  This method is used for setting an already loaded texture
+ *  slot into the shader without looking up its tag.
+ ***********************************************************/
+void SceneManager::SetShaderTextureSlot(int textureSlot)
+{
+	m_drawData.bUseTexture = 1;
+	m_drawData.textureSlot = textureSlot;
+}
+
+/***********************************************************
+ *  SetShaderMaterialIndex()
+ *
+ *  This method is used for passing the values of a defined
+ *  material into the shader without looking up its tag.
+ ***********************************************************/
+void SceneManager::SetShaderMaterialIndex(int materialIndex)
+{
+	m_drawData.materialIndex = materialIndex;
+}
+
+/***********************************************************
+ *  SubmitDrawConstants()
+ *
+ *  This method is used for writing the model matrix and the
+ *  color, texture and material set for the next draw into
+ *  the draw constant ring, which binds them for the draw.
+ *  The material is read at every draw, so a material changed
+ *  by the material library shows up in the next frame.
+ ***********************************************************/
+void SceneManager::SubmitDrawConstants(const glm::mat4& model)
+{
+	DrawConstantRing::DRAW_CONSTANTS constants;
+	constants.model = model;
+	constants.color = m_drawData.color;
+	constants.uvScale = m_drawData.uvScale;
+	constants.bUseTexture = m_drawData.bUseTexture;
+	constants.textureSlot = m_drawData.textureSlot;
+	constants.objectID = m_drawData.objectID;
+	constants.diffuseColor = glm::vec4(0.0f);
+	constants.specularColor = glm::vec4(0.0f);
+	if (m_drawData.materialIndex < (int)m_objectMaterials.size())
+	{
+		StaticBatch::MATERIAL_DATA material = GetBatchMaterial(m_drawData.materialIndex);
+		constants.diffuseColor = material.diffuseColor;
+		constants.specularColor = material.specularColor;
+	}
+
+	m_drawConstants->Submit(constants);
+}
+
+/***********************************************************
+ *  SetSceneObject()
+ *
+ *  This method is used for setting the scene object the
+ *  next draws belong to, which is written into the object
+ *  ID buffer. An object seen for the first time is given
+ *  the next object ID.
+ ***********************************************************/
+void SceneManager::SetSceneObject(const char* objectName)
+{
+	int index = 0;
+	while ((index < (int)m_objectNames.size()) && (m_objectNames[index] != objectName))
+	{
+		index++;
+	}
+	if (index == (int)m_objectNames.size())
+	{
+		m_objectNames.push_back(objectName);
+	}
+
+	m_drawData.objectID = index + 1;
+}
+
+/***********************************************************
+ *  GetSceneObjectName()
+ *
+ *  This method is used for getting the name of the scene
+ *  object with an object ID. The nodes of a scene file have
+ *  no names, so they are named by their index in the file.
+ ***********************************************************/
+std::string SceneManager::GetSceneObjectName(GLuint objectID) const
+{
+	if (objectID == 0)
+	{
+		return("");
+	}
+	if (m_sceneFile->IsLoaded())
+	{
+		return("node " + std::to_string(objectID - 1));
+	}
+	if (objectID > m_objectNames.size())
+	{
+		return("object " + std::to_string(objectID));
+	}
+
+	return(m_objectNames[objectID - 1]);
+}
+
+/***********************************************************
+ *  SetViewManager()
+ *
+ *  This method is used for setting the view manager whose
+ *  projection is used for choosing the detail levels.
+ ***********************************************************/
+void SceneManager::SetViewManager(ViewManager* pViewManager)
+{
+	m_pViewManager = pViewManager;
+}
+
+/***********************************************************
+ *  SelectLODLevel()
+ *
+ *  This method is used for choosing the tessellation level of
+ *  a curved shape from the projected size of its bounding
+ *  sphere, using the passed in model matrix and the projection
+ *  of the view manager. The level chosen for the same draw in
+ *  the previous frame is kept until the size moves clearly
+ *  past a threshold. It only reads the scene, so the worker
+ *  threads can call it for many draws at once.
+ ***********************************************************/
+int SceneManager::SelectLODLevel(ShapeLODMeshes::LOD_SHAPE shape, const glm::mat4& model, int previousLevel) const
+{
+	// without a view the most detailed level is always used
+	if (NULL == m_pViewManager)
+	{
+		return(0);
+	}
+
+	glm::vec3 center;
+	float radius = 0.0f;
+	m_lodMeshes->GetBoundingSphere(shape, center, radius);
+
+	// move the bounding sphere into world space
+	glm::vec3 worldCenter = glm::vec3(model * glm::vec4(center, 1.0f));
+	float maxScale = glm::max(
+		glm::length(glm::vec3(model[0])),
+		glm::max(glm::length(glm::vec3(model[1])), glm::length(glm::vec3(model[2]))));
+	float worldRadius = radius * maxScale;
+
+	glm::mat4 projection = m_pViewManager->GetProjectionMatrix();
+	glm::vec4 clipCenter = projection * m_pViewManager->GetViewMatrix() * glm::vec4(worldCenter, 1.0f);
+
+	// a perspective projection has a zero in the last element, the
+	// camera is inside or right next to the bounding sphere
+	bool bPerspective = (projection[3][3] == 0.0f);
+	if (bPerspective && (clipCenter.w <= worldRadius))
+	{
+		return(0);
+	}
+
+	// projected diameter of the bounding sphere in pixels
+	float pixelSize = worldRadius * projection[1][1] / clipCenter.w * (float)m_pViewManager->GetViewportHeight();
+
+	int level = 0;
+	for (int i = 0; i < ShapeLODMeshes::LOD_LEVELS - 1; i++)
+	{
+		float threshold = g_LODPixelThresholds[i];
+		if (previousLevel >= 0)
+		{
+			// make it harder to cross back over the threshold
+			if (previousLevel <= i)
+				threshold *= (1.0f - g_LODHysteresis);
+			else
+				threshold *= (1.0f + g_LODHysteresis);
+		}
+
+		if (pixelSize < threshold)
+		{
+			level = i + 1;
+		}
+	}
+
+	return(level);
+}
+
+/***********************************************************
+ *  DrawLODShape()
+ *
+ *  This method is used for drawing a shape with the current
+ *  transformations at the detail level chosen for it. While
+ *  the static batch is recorded the draw is only added to it.
+ ***********************************************************/
+void SceneManager::DrawLODShape(
+	ShapeLODMeshes::LOD_SHAPE shape,
+	bool bDrawTop,
+	bool bDrawBottom,
+	bool bDrawSides)
+{
+	// the static batch gets every level, the cull chooses one
+	if (m_bRecordingStaticBatch)
+	{
+		ShapeLODMeshes::MESH_RANGE levelRanges[ShapeLODMeshes::LOD_LEVELS];
+		for (int level = 0; level < ShapeLODMeshes::LOD_LEVELS; level++)
+		{
+			levelRanges[level] = m_lodMeshes->GetMeshRange(shape, level);
+		}
+		m_staticBatch->AddDraw(
+			*m_lodMeshes,
+			levelRanges,
+			ShapeLODMeshes::LOD_LEVELS,
+			bDrawTop,
+			bDrawBottom,
+			bDrawSides,
+			m_modelMatrix,
+			m_drawData);
+		return;
+	}
+
+	// remember the level for the hysteresis in the next frame
+	if (m_lodDrawIndex >= (int)m_lodLevels.size())
+	{
+		m_lodLevels.resize(m_lodDrawIndex + 1, -1);
+	}
+	int level = SelectLODLevel(shape, m_modelMatrix, m_lodLevels[m_lodDrawIndex]);
+	m_lodLevels[m_lodDrawIndex] = level;
+	m_lodDrawIndex++;
+
+	// packed positions are scaled back by the model matrix
+	glm::mat4 model = m_modelMatrix;
+	if (m_lodMeshes->IsPacked())
+	{
+		model = m_modelMatrix * m_lodMeshes->GetPositionDecodeMatrix(shape, level);
+	}
+	SubmitDrawConstants(model);
+
+	m_lodMeshes->DrawLODMesh(shape, level, bDrawTop, bDrawBottom, bDrawSides);
+}
+
+/***********************************************************
+ *  DrawImportedMesh()
+ *
+ *  This method is used for drawing a mesh imported from a
+ *  file with the current transformations. While the static
+ *  batch is recorded the draw is only added to it.
+ ***********************************************************/
+void SceneManager::DrawImportedMesh(int meshID)
+{
+	if (!m_lodMeshes->IsImportedMeshLoaded(meshID))
+	{
+		return;
+	}
+
+	const ShapeLODMeshes::MESH_RANGE& range = m_lodMeshes->GetImportedMeshRange(meshID);
+	if (m_bRecordingStaticBatch)
+	{
+		m_staticBatch->AddDraw(*m_lodMeshes, range, false, false, true, m_modelMatrix, m_drawData);
+		return;
+	}
+
+	// packed positions are scaled back by the model matrix
+	glm::mat4 model = m_modelMatrix;
+	if (m_lodMeshes->IsPacked())
+	{
+		model = m_modelMatrix * m_lodMeshes->GetPositionDecodeMatrix(range);
+	}
+	SubmitDrawConstants(model);
+
+	m_lodMeshes->DrawImportedMesh(meshID);
+}
+
+/***********************************************************
+ *  SetStaticBatching()
+ *
+ *  This method is used for choosing between drawing the
+ *  merged static batch and drawing each object separately.
+ ***********************************************************/
+void SceneManager::SetStaticBatching(bool bUseStaticBatch)
+{
+	m_bUseStaticBatch = bUseStaticBatch;
+}
+
+/***********************************************************
+ *  SetGPUCulling()
+ *
+ *  This method is used for turning the GPU culling of the
+ *  static batch on or off.
+ ***********************************************************/
+void SceneManager::SetGPUCulling(bool bUseGPUCulling)
+{
+	m_bUseGPUCulling = bUseGPUCulling;
+}
+
+/***********************************************************
+ *  SetFrameCache()
+ *
+ *  This method is used for setting the frame cache the scene
+ *  is drawn into, whose depth buffer the occluders and the
+ *  G-buffer share.
+ ***********************************************************/
+void SceneManager::SetFrameCache(FrameCache* pFrameCache)
+{
+	m_pFrameCache = pFrameCache;
+}
+
+/***********************************************************
+ *  SetHiZPyramid()
+ *
+ *  This method is used for setting the depth pyramid the
+ *  static batch is tested against.
+ ***********************************************************/
+void SceneManager::SetHiZPyramid(HiZPyramid* pHiZPyramid)
+{
+	m_pHiZPyramid = pHiZPyramid;
+}
+
+/***********************************************************
+ *  SetDeferredShading()
+ *
+ *  This method is used for setting the G-buffer and light
+ *  pass the static batch is drawn with in deferred mode, and
+ *  handing it the lights of the scene. The scene must be
+ *  prepared before.
+ ***********************************************************/
+void SceneManager::SetDeferredShading(DeferredShading* pDeferredShading)
+{
+	m_pDeferredShading = pDeferredShading;
+	if ((NULL == m_pDeferredShading) || !m_pDeferredShading->IsInitialized())
+	{
+		return;
+	}
+
+	std::vector<SceneFile::SCENE_LIGHT> sceneLights;
+	glm::vec3 globalAmbientColor;
+	GetSceneLights(sceneLights, globalAmbientColor);
+
+	std::vector<DeferredShading::LIGHT_DATA> lights(sceneLights.size());
+	for (size_t i = 0; i < sceneLights.size(); i++)
+	{
+		lights[i].positionRange = glm::vec4(sceneLights[i].position, sceneLights[i].range);
+		lights[i].diffuseColor = glm::vec4(sceneLights[i].diffuseColor, sceneLights[i].focalStrength);
+		lights[i].specularColor = glm::vec4(sceneLights[i].specularColor, sceneLights[i].specularIntensity);
+	}
+	m_pDeferredShading->SetLights(lights, globalAmbientColor);
+}
+
+/***********************************************************
+ *  SetDeferred()
+ *
+ *  This method is used for choosing between forward and
+ *  deferred shading of the static batch. The draws that are
+ *  not batched are always forward shaded.
+ ***********************************************************/
+void SceneManager::SetDeferred(bool bDeferred)
+{
+	m_bDeferred = bDeferred;
+}
+
+/***********************************************************
+ *  SetOcclusionCulling()
+ *
+ *  This method is used for turning the culling of the draws
+ *  hidden behind the occluders on or off. It only has an
+ *  effect while the GPU culling is on.
+ ***********************************************************/
+void SceneManager::SetOcclusionCulling(bool bUseOcclusionCulling)
+{
+	m_bUseOcclusionCulling = bUseOcclusionCulling;
+}
+
+/***********************************************************
+ *  SetReportStats()
+ *
+ *  This method is used for turning the printed culling
+ *  results on or off.
+ ***********************************************************/
+void SceneManager::SetReportStats(bool bReportStats)
+{
+	m_bReportStats = bReportStats;
+}
+
+/***********************************************************
+ *  SetVertexPacking()
+ *
+ *  This method is used for choosing between the packed and
+ *  the float vertex layout. It must be called before the
+ *  scene is prepared.
+ ***********************************************************/
+void SceneManager::SetVertexPacking(bool bPackVertices)
+{
+	m_bPackVertices = bPackVertices;
+}
+
+/***********************************************************
+ *  SetMeshOptimization()
+ *
+ *  This method is used for turning the reordering of the
+ *  mesh indices and vertices on or off. It must be called
+ *  before the scene is prepared.
+ ***********************************************************/
+void SceneManager::SetMeshOptimization(bool bOptimizeMeshes)
+{
+	m_bOptimizeMeshes = bOptimizeMeshes;
+}
+
+/***********************************************************
+ *  SetTextureQuality()
+ *
+ *  This method is used for picking the quality preset the
+ *  textures are filtered with.
+ ***********************************************************/
+void SceneManager::SetTextureQuality(SamplerManager::TEXTURE_QUALITY quality)
+{
+	m_pSamplers->SetQuality(quality);
+}
+
+/***********************************************************
+ *  SetMaxTextureSize()
+ *
+ *  This method is used for setting the largest width or
+ *  height of a texture, 0 for the largest the driver takes.
+ *  It must be called before the scene is prepared.
+ ***********************************************************/
+void SceneManager::SetMaxTextureSize(int maxSize)
+{
+	m_imageOptions.maxSize = std::max(0, maxSize);
+}
+
+/***********************************************************
+ *  SetTextureResizeFilter()
+ *
+ *  This method is used for choosing the filter the images
+ *  larger than the maximum size are scaled down with. It
+ *  must be called before the scene is prepared.
+ ***********************************************************/
+void SceneManager::SetTextureResizeFilter(ImageProcessor::RESIZE_FILTER filter)
+{
+	m_imageOptions.filter = filter;
+}
+
+/***********************************************************
+ *  SetBottleMeshPath()
+ *
+ *  This method is used for setting an OBJ, glTF or GLB file
+ *  that replaces the beer bottle built from basic shapes. It
+ *  must be called before the scene is prepared.
+ ***********************************************************/
+void SceneManager::SetBottleMeshPath(const char* filePath)
+{
+	m_bottleMeshPath = filePath;
+}
+
+/***********************************************************
+ *  SetSceneFilePath()
+ *
+ *  This method is used for setting a binary scene file whose
+ *  textures, materials, lights and nodes replace the scene
+ *  defined in the code. It must be called before the scene
+ *  is prepared.
+ ***********************************************************/
+void SceneManager::SetSceneFilePath(const char* filePath)
+{
+	m_sceneFilePath = filePath;
+}
+
+/***********************************************************
+ *  SetMaterialLibraryPath()
+ *
+ *  This method is used for reading the materials from
+ *  another library file than the default one. It must be
+ *  called before the scene is prepared.
+ ***********************************************************/
+void SceneManager::SetMaterialLibraryPath(const char* filePath)
+{
+	m_materialLibraryPath = filePath;
+}
+
+/***********************************************************
+ *  GetBatchMaterial()
+ *
+ *  This method is used for getting a defined material in
+ *  the layout of the static batch material buffer.
+ ***********************************************************/
+StaticBatch::MATERIAL_DATA SceneManager::GetBatchMaterial(int materialIndex)
+{
+	StaticBatch::MATERIAL_DATA material;
+	material.diffuseColor = glm::vec4(m_objectMaterials[materialIndex].diffuseColor, m_objectMaterials[materialIndex].shininess);
+	material.specularColor = glm::vec4(m_objectMaterials[materialIndex].specularColor, 0.0f);
+	return(material);
+}
+
+/***********************************************************
+ *  ApplyLibraryMaterial()
+ *
+ *  This method is used for replacing the values of the
+ *  defined material with the same tag, or defining a new
+ *  one. A material of the built static batch is uploaded
+ *  again on its own, the forward shaders read the defined
+ *  materials on every draw.
+ ***********************************************************/
+void SceneManager::ApplyLibraryMaterial(const MaterialLibrary::LIBRARY_MATERIAL& libraryMaterial)
+{
+	int materialIndex = FindMaterialIndex(libraryMaterial.tag.c_str());
+	if (materialIndex < 0)
+	{
+		OBJECT_MATERIAL material;
+		material.ambientColor = glm::vec3(0.0f);
+		material.ambientStrength = 0.0f;
+		material.tag = libraryMaterial.tag;
+		m_objectMaterials.push_back(material);
+		materialIndex = (int)m_objectMaterials.size() - 1;
+	}
+
+	m_objectMaterials[materialIndex].diffuseColor = libraryMaterial.diffuseColor;
+	m_objectMaterials[materialIndex].specularColor = libraryMaterial.specularColor;
+	m_objectMaterials[materialIndex].shininess = libraryMaterial.shininess;
+
+	m_staticBatch->UpdateMaterial(materialIndex, GetBatchMaterial(materialIndex));
+}
+
+/***********************************************************
+ *  UpdateMaterialLibrary()
+ *
+ *  This method is used for applying the materials that
+ *  changed since the material library was last saved. The
+ *  static batch knows where each of its draws is, so only
+ *  the screen area of the draws using a changed material is
+ *  drawn again, otherwise the whole frame is.
+ ***********************************************************/
+void SceneManager::UpdateMaterialLibrary(FrameCache* pFrameCache)
+{
+	std::vector<int> changedMaterials;
+	if (!m_materialLibrary->PollChanges(changedMaterials))
+	{
+		return;
+	}
+
+	const std::vector<MaterialLibrary::LIBRARY_MATERIAL>& materials = m_materialLibrary->GetMaterials();
+	std::vector<glm::vec4> damagedBounds;
+	for (size_t i = 0; i < changedMaterials.size(); i++)
+	{
+		ApplyLibraryMaterial(materials[changedMaterials[i]]);
+
+		int materialIndex = FindMaterialIndex(materials[changedMaterials[i]].tag.c_str());
+		m_staticBatch->GetMaterialBounds(materialIndex, damagedBounds);
+	}
+
+	// the damaged rectangles are found for a single view only
+	if (!m_bUseStaticBatch || !m_staticBatch->IsBuilt() || (NULL == m_pViewManager) ||
+		(m_pViewManager->GetViewCount() > 1))
+	{
+		pFrameCache->Invalidate();
+		return;
+	}
+
+	glm::mat4 viewProjection = m_pViewManager->GetProjectionMatrix() * m_pViewManager->GetViewMatrix();
+	for (size_t i = 0; i < damagedBounds.size(); i++)
+	{
+		pFrameCache->AddDamage(damagedBounds[i], viewProjection);
+	}
+}
+
+/***********************************************************
+ *  LoadSceneFile()
+ *
+ *  This method is used for mapping the scene file, starting
+ *  the import of the mesh files it refers to and defining
+ *  its materials in the order the nodes refer to them.
+ ***********************************************************/
+void SceneManager::LoadSceneFile()
+{
+	if (!m_sceneFile->Load(m_sceneFilePath.c_str()))
+	{
+		return;
+	}
+
+	const SceneFile::SCENE_MESH* pMeshes = m_sceneFile->GetMeshes();
+	m_sceneMeshIDs.assign(m_sceneFile->GetCount(SceneFile::SECTION_MESHES), -1);
+	for (int i = 0; i < (int)m_sceneMeshIDs.size(); i++)
+	{
+		if (pMeshes[i].source == SceneFile::MESH_FILE)
+		{
+			m_sceneMeshIDs[i] = m_lodMeshes->ImportMesh(m_sceneFile->GetString(pMeshes[i].path));
+		}
+	}
+
+	const SceneFile::SCENE_MATERIAL* pMaterials = m_sceneFile->GetMaterials();
+	for (int i = 0; i < m_sceneFile->GetCount(SceneFile::SECTION_MATERIALS); i++)
+	{
+		OBJECT_MATERIAL material;
+		material.ambientColor = glm::vec3(0.0f);
+		material.ambientStrength = 0.0f;
+		material.diffuseColor = pMaterials[i].diffuseColor;
+		material.specularColor = pMaterials[i].specularColor;
+		material.shininess = pMaterials[i].shininess;
+		material.tag = m_sceneFile->GetString(pMaterials[i].tag);
+		m_objectMaterials.push_back(material);
+	}
+}
+
+/***********************************************************
+ *  LoadSceneFileTextures()
+ *
+ *  This method is used for loading the textures of the scene
+ *  file into the texture slots. The textures that do not fit
+ *  into the slots or fail to load are drawn with the node
+ *  color instead, the ones sharing an image share a slot.
+ ***********************************************************/
+void SceneManager::LoadSceneFileTextures()
+{
+	const SceneFile::SCENE_TEXTURE* pTextures = m_sceneFile->GetTextures();
+	m_sceneTextureSlots.assign(m_sceneFile->GetCount(SceneFile::SECTION_TEXTURES), -1);
+	for (int i = 0; i < (int)m_sceneTextureSlots.size(); i++)
+	{
+		const char* path = m_sceneFile->GetString(pTextures[i].path);
+		SamplerManager::SAMPLER_TYPE sampler = (pTextures[i].wrap == SceneFile::WRAP_CLAMP) ? SamplerManager::SAMPLER_CLAMP : SamplerManager::SAMPLER_REPEAT;
+		if (CreateGLTexture(path, m_sceneFile->GetString(pTextures[i].tag), sampler))
+		{
+			m_sceneTextureSlots[i] = m_textureIDs.back().slot;
+		}
+		else
+		{
+			std::cerr << "Failed to load texture: " << path << std::endl;
+		}
+	}
+}
+
+/***********************************************************
+ *  RenderSceneFile()
+ *
+ *  This method is used for drawing the nodes of the scene
+ *  file. The worker threads cull the nodes and choose their
+ *  detail levels, matrices and sort keys, so this thread only
+ *  walks the sorted draws, writes their draw constants and
+ *  submits them.
+ ***********************************************************/
+void SceneManager::RenderSceneFile()
+{
+	if (m_bRecordingStaticBatch)
+	{
+		RecordSceneFile();
+		return;
+	}
+
+	// the draw list and the sort keys only live for this frame
+	FrameArena& arena = GetThreadArena();
+	FrameVector<SCENE_DRAW> draws((FrameAllocator<SCENE_DRAW>(&arena)));
+	FrameVector<uint64_t> drawKeys((FrameAllocator<uint64_t>(&arena)));
+	PrepareSceneFileDraws(draws, drawKeys);
+	SortSceneFileDraws(drawKeys);
+
+	const SceneFile::SCENE_MESH* pMeshes = m_sceneFile->GetMeshes();
+	const SceneFile::SCENE_NODE* pNodes = m_sceneFile->GetNodes();
+
+	// the scene file does not say which nodes are transparent,
+	// so blending is on for all of them like the static batch
+	GLStateCache::Enable(GL_BLEND);
+	GLStateCache::BlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+
+	for (size_t i = 0; i < drawKeys.size(); i++)
+	{
+		// the culled nodes are sorted behind every drawn one
+		if (drawKeys[i] == UINT64_MAX)
+		{
+			break;
+		}
+
+		int nodeIndex = (int)(drawKeys[i] & 0xFFFFFFFF);
+		const SceneFile::SCENE_NODE& node = pNodes[nodeIndex];
+		const SCENE_DRAW& draw = draws[nodeIndex];
+
+		int textureSlot = (node.texture >= 0) ? m_sceneTextureSlots[node.texture] : -1;
+		if (textureSlot >= 0)
+		{
+			SetShaderTextureSlot(textureSlot);
+		}
+		else
+		{
+			SetShaderColor(node.color.r, node.color.g, node.color.b, node.color.a);
+		}
+		SetTextureUVScale(node.uvScale.x, node.uvScale.y);
+		// a node without a material must not keep the one of the
+		// draw before it, which the sorting changes from frame to
+		// frame
+		SetShaderMaterialIndex((node.material >= 0) ? node.material : g_SceneDefaultMaterial);
+		m_drawData.objectID = nodeIndex + 1;
+		SubmitDrawConstants(draw.model);
+
+		const SceneFile::SCENE_MESH& mesh = pMeshes[node.mesh];
+		if (mesh.source == SceneFile::MESH_FILE)
+		{
+			m_lodMeshes->DrawImportedMesh(m_sceneMeshIDs[node.mesh]);
+		}
+		else
+		{
+			m_lodMeshes->DrawLODMesh(
+				(ShapeLODMeshes::LOD_SHAPE)mesh.shape,
+				draw.level,
+				(node.parts & SceneFile::PART_TOP) != 0,
+				(node.parts & SceneFile::PART_BOTTOM) != 0,
+				(node.parts & SceneFile::PART_SIDES) != 0);
+		}
+	}
+
+	GLStateCache::Disable(GL_BLEND);
+}
+
+/***********************************************************
+ *  RecordSceneFile()
+ *
+ *  This method is used for adding every node of the scene
+ *  file to the static batch, in the order of the file.
+ ***********************************************************/
+void SceneManager::RecordSceneFile()
+{
+	const SceneFile::SCENE_MESH* pMeshes = m_sceneFile->GetMeshes();
+	const SceneFile::SCENE_NODE* pNodes = m_sceneFile->GetNodes();
+	int nodeCount = m_sceneFile->GetCount(SceneFile::SECTION_NODES);
+
+	for (int i = 0; i < nodeCount; i++)
+	{
+		const SceneFile::SCENE_NODE& node = pNodes[i];
+
+		m_modelMatrix = node.transform;
+
+		int textureSlot = (node.texture >= 0) ? m_sceneTextureSlots[node.texture] : -1;
+		if (textureSlot >= 0)
+		{
+			SetShaderTextureSlot(textureSlot);
+		}
+		else
+		{
+			SetShaderColor(node.color.r, node.color.g, node.color.b, node.color.a);
+		}
+		SetTextureUVScale(node.uvScale.x, node.uvScale.y);
+		SetShaderMaterialIndex((node.material >= 0) ? node.material : g_SceneDefaultMaterial);
+		m_drawData.objectID = i + 1;
+
+		const SceneFile::SCENE_MESH& mesh = pMeshes[node.mesh];
+		if (mesh.source == SceneFile::MESH_FILE)
+		{
+			DrawImportedMesh(m_sceneMeshIDs[node.mesh]);
+		}
+		else
+		{
+			DrawLODShape(
+				(ShapeLODMeshes::LOD_SHAPE)mesh.shape,
+				(node.parts & SceneFile::PART_TOP) != 0,
+				(node.parts & SceneFile::PART_BOTTOM) != 0,
+				(node.parts & SceneFile::PART_SIDES) != 0);
+		}
+	}
+}
+
+/***********************************************************
+ *  PrepareSceneFileDraws()
+ *
+ *  This method is used for preparing every scene file node
+ *  on the worker threads. A node whose bounding sphere is
+ *  outside the view is culled, and a drawn one gets its
+ *  detail level, its model matrix with the decode of the
+ *  packed positions, and a sort key.
+ *
+ *  Nodes drawn with a texture or a see-through color keep
+ *  the order of the file, since they are blended over what
+ *  was drawn before them. The solid colored nodes are drawn
+ *  first, sorted by material and then mesh. Every node still
+ *  writes its own draw constants, so the grouping only keeps
+ *  the draws reading the same material and index range next
+ *  to each other.
+ ***********************************************************/
+void SceneManager::PrepareSceneFileDraws(FrameVector<SCENE_DRAW>& draws, FrameVector<uint64_t>& drawKeys)
+{
+	const SceneFile::SCENE_MESH* pMeshes = m_sceneFile->GetMeshes();
+	const SceneFile::SCENE_NODE* pNodes = m_sceneFile->GetNodes();
+	int nodeCount = m_sceneFile->GetCount(SceneFile::SECTION_NODES);
+
+	draws.resize(nodeCount);
+	drawKeys.resize(nodeCount);
+	if ((int)m_lodLevels.size() < nodeCount)
+	{
+		m_lodLevels.resize(nodeCount, -1);
+	}
+
+	bool bCulling = (NULL != m_pViewManager);
+	glm::vec4 frustumPlanes[6];
+	if (bCulling)
+	{
+		GPUCulling::ExtractFrustumPlanes(
+			m_pViewManager->GetProjectionMatrix() * m_pViewManager->GetViewMatrix(),
+			frustumPlanes);
+	}
+
+	m_jobSystem->ParallelFor(nodeCount, g_SceneDrawBatchSize, [&](int first, int last)
+		{
+			for (int i = first; i < last; i++)
+			{
+				const SceneFile::SCENE_NODE& node = pNodes[i];
+				const SceneFile::SCENE_MESH& mesh = pMeshes[node.mesh];
+				SCENE_DRAW& draw = draws[i];
+
+				// bounding sphere and range of the mesh of the node
+				glm::vec3 center;
+				float radius = 0.0f;
+				const ShapeLODMeshes::MESH_RANGE* pRange = NULL;
+				bool bImported = (mesh.source == SceneFile::MESH_FILE);
+				if (bImported)
+				{
+					int meshID = m_sceneMeshIDs[node.mesh];
+					if (!m_lodMeshes->IsImportedMeshLoaded(meshID))
+					{
+						drawKeys[i] = UINT64_MAX;
+						continue;
+					}
+					pRange = &m_lodMeshes->GetImportedMeshRange(meshID);
+					center = pRange->boundsMin + pRange->boundsExtent * 0.5f;
+					radius = glm::length(pRange->boundsExtent) * 0.5f;
+				}
+				else
+				{
+					m_lodMeshes->GetBoundingSphere((ShapeLODMeshes::LOD_SHAPE)mesh.shape, center, radius);
+				}
+
+				if (bCulling)
+				{
+					glm::vec3 worldCenter = glm::vec3(node.transform * glm::vec4(center, 1.0f));
+					float worldRadius = radius * glm::max(
+						glm::length(glm::vec3(node.transform[0])),
+						glm::max(glm::length(glm::vec3(node.transform[1])), glm::length(glm::vec3(node.transform[2]))));
+
+					bool bVisible = true;
+					for (int plane = 0; (plane < 6) && bVisible; plane++)
+					{
+						bVisible = (glm::dot(glm::vec3(frustumPlanes[plane]), worldCenter) + frustumPlanes[plane].w >= -worldRadius);
+					}
+					if (!bVisible)
+					{
+						drawKeys[i] = UINT64_MAX;
+						continue;
+					}
+				}
+
+				draw.level = 0;
+				draw.model = node.transform;
+				if (bImported)
+				{
+					if (m_lodMeshes->IsPacked())
+					{
+						draw.model = node.transform * m_lodMeshes->GetPositionDecodeMatrix(*pRange);
+					}
+				}
+				else
+				{
+					ShapeLODMeshes::LOD_SHAPE shape = (ShapeLODMeshes::LOD_SHAPE)mesh.shape;
+					draw.level = SelectLODLevel(shape, node.transform, m_lodLevels[i]);
+					m_lodLevels[i] = draw.level;
+					if (m_lodMeshes->IsPacked())
+					{
+						draw.model = node.transform * m_lodMeshes->GetPositionDecodeMatrix(shape, draw.level);
+					}
+				}
+
+				uint64_t key = (uint64_t)i;
+				bool bBlended = (node.texture >= 0) || (node.color.a < 1.0f);
+				if (bBlended)
+				{
+					key |= (uint64_t)1 << 62;
+				}
+				else
+				{
+					int material = (node.material >= 0) ? node.material : g_SceneDefaultMaterial;
+					uint64_t state = ((uint64_t)material & 0x3FF) << 20;
+					state |= ((uint64_t)node.mesh & 0xFFFF) << 4;
+					state |= (uint64_t)draw.level & 0xF;
+					key |= state << 32;
+				}
+				drawKeys[i] = key;
+			}
+		});
+}
+
+/***********************************************************
+ *  SortSceneFileDraws()
+ *
+ *  This method is used for sorting the sort keys of the
+ *  prepared draws. Each job sorts one run of the keys, and
+ *  the runs are then merged in pairs, with every pair of a
+ *  round merged by its own job. A merge goes through
+ *  scratch memory from the frame arena of the thread that
+ *  runs it, where an in place merge would take a buffer
+ *  from the heap every time.
+ ***********************************************************/
+void SceneManager::SortSceneFileDraws(FrameVector<uint64_t>& drawKeys)
+{
+	int keyCount = (int)drawKeys.size();
+	int runSize = std::max(
+		g_SceneDrawBatchSize,
+		(keyCount + m_jobSystem->GetThreadCount() - 1) / m_jobSystem->GetThreadCount());
+	uint64_t* pKeys = drawKeys.data();
+
+	m_jobSystem->ParallelFor(keyCount, runSize, [pKeys](int first, int last)
+		{
+			std::sort(pKeys + first, pKeys + last);
+		});
+
+	for (int width = runSize; width < keyCount; width *= 2)
+	{
+		int pairCount = (keyCount + 2 * width - 1) / (2 * width);
+		m_jobSystem->ParallelFor(pairCount, 1, [this, pKeys, keyCount, width](int first, int last)
+			{
+				for (int pair = first; pair < last; pair++)
+				{
+					int begin = pair * 2 * width;
+					int middle = std::min(begin + width, keyCount);
+					int end = std::min(begin + 2 * width, keyCount);
+					if (middle >= end)
+					{
+						continue;
+					}
+
+					uint64_t* pScratch = GetThreadArena().AllocateArray<uint64_t>(end - begin);
+					std::merge(pKeys + begin, pKeys + middle, pKeys + middle, pKeys + end, pScratch);
+					std::copy(pScratch, pScratch + (end - begin), pKeys + begin);
+				}
+			});
+	}
+}
+
+/***********************************************************
+ *  GetThreadArena()
+ *
+ *  This method is used for getting the frame arena of the
+ *  calling thread, the OpenGL thread or a job thread.
+ ***********************************************************/
+FrameArena& SceneManager::GetThreadArena()
+{
+	return(*m_frameArenas[m_jobSystem->GetThreadIndex()]);
+}
+
+/***********************************************************
+ *  BuildStaticBatch()
+ *
+ *  This method is used for recording every draw of the scene
+ *  by running the render methods once with drawing turned
+ *  off, and merging the recorded draws into the static batch.
+ *  The batch needs multi-draw indirect and storage buffers,
+ *  which are core in OpenGL 4.3. Without them the batch is
+ *  not built, and the scene is drawn object by object the
+ *  same as with --immediate. The draw count read from a
+ *  buffer, core in OpenGL 4.6, is optional and only used by
+ *  the culled draws when it is available.
+ ***********************************************************/
+void SceneManager::BuildStaticBatch()
+{
+	if (!GLEW_VERSION_4_3)
+	{
+		std::cout << "Static batch disabled: OpenGL 4.3 is not available" << std::endl;
+		return;
+	}
+
+	m_pBatchShaderManager = new ShaderManager();
+	m_pBatchShaderManager->LoadShaders(g_BatchVertexShaderPath, g_BatchFragmentShaderPath);
+	GLStateCache::UseProgram(m_pBatchShaderManager);
+
+	// every texture slot is bound once to its own texture unit
+	for (int i = 0; i < g_MaxTextureSlots; i++)
+	{
+		m_pBatchShaderManager->setSampler2DValue(
+			std::string(g_TextureArrayName) + "[" + std::to_string(i) + "]", i);
+	}
+	ApplySceneLights(m_pBatchShaderManager);
+
+	// the render methods set their uniforms into the forward
+	// shaders, so those are in use while the draws are recorded
+	GLStateCache::UseProgram(m_pShaderManager);
+
+	// run the render methods once to record every draw
+	m_bRecordingStaticBatch = true;
+	RenderScene();
+	m_bRecordingStaticBatch = false;
+
+	std::vector<StaticBatch::MATERIAL_DATA> materials;
+	for (int i = 0; i < (int)m_objectMaterials.size(); i++)
+	{
+		materials.push_back(GetBatchMaterial(i));
+	}
+	m_staticBatch->Build(materials, m_bPackVertices);
+
+	GLStateCache::UseProgram(m_pBatchShaderManager);
+	m_pBatchShaderManager->setBoolValue(g_PackedVerticesName, m_staticBatch->IsPacked());
+	m_pBatchShaderManager->setMat4Value("positionDecode", m_staticBatch->GetPositionDecodeMatrix());
+
+	// the occluders are drawn with the same vertex shader, so
+	// their depth matches the one of the full pass exactly
+	m_pDepthShaderManager = new ShaderManager();
+	m_pDepthShaderManager->LoadShaders(g_BatchVertexShaderPath, g_DepthFragmentShaderPath);
+	GLStateCache::UseProgram(m_pDepthShaderManager);
+	m_pDepthShaderManager->setBoolValue(g_PackedVerticesName, m_staticBatch->IsPacked());
+	m_pDepthShaderManager->setMat4Value("positionDecode", m_staticBatch->GetPositionDecodeMatrix());
+	GLStateCache::UseProgram(m_pShaderManager);
+
+	// the batched draws are culled on the GPU every frame, which
+	// also chooses the detail level of the curved shapes
+	if (m_gpuCulling->Initialize(g_CullComputeShaderPath))
+	{
+		m_gpuCulling->SetLODSelection(
+			m_staticBatch->GetLODCommandBuffer(),
+			ShapeLODMeshes::LOD_LEVELS,
+			g_LODPixelThresholds,
+			g_LODHysteresis);
 	}
 }
 
 /***********************************************************
- *  DestroyGLTextures()
+ *  RenderOccluderDepth()
  *
- *  This method is used for freeing the memory in all the
- *  used texture memory slots.
+ *  This method is used for drawing the large opaque draws of
+ *  the static batch into the depth buffer only, and building
+ *  the depth pyramid from it. The pyramid is built from the
+ *  current frame rather than the last one, so a moving camera
+ *  never hides a draw that has come into view.
  ***********************************************************/
-void SceneManager::DestroyGLTextures()
+bool SceneManager::RenderOccluderDepth()
 {
-	for (int i = 0; i < m_loadedTextures; i++)
+	if ((NULL == m_pHiZPyramid) || !m_pHiZPyramid->IsInitialized() ||
+		(NULL == m_pFrameCache) || (NULL == m_pDepthShaderManager) ||
+		(m_staticBatch->GetOccluderCount() == 0))
 	{
-		glDeleteTextures(1, &m_textureIDs[i].ID);
+		return(false);
 	}
+
+	GLStateCache::UseProgram(m_pDepthShaderManager);
+	GLStateCache::SetMat4(m_pDepthShaderManager, "view", m_pViewManager->GetViewMatrix());
+	GLStateCache::SetMat4(m_pDepthShaderManager, "projection", m_pViewManager->GetProjectionMatrix());
+
+	glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+	m_staticBatch->RenderOccluders();
+	glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+
+	m_pHiZPyramid->Build(m_pFrameCache->GetDepthTexture(), m_pFrameCache->GetRenderSize());
+	return(m_pHiZPyramid->IsBuilt());
 }
 
 /***********************************************************
- *  FindTextureID()
+ *  ReportCullStats()
  *
- *  This method is used for getting an ID for the previously
- *  loaded texture bitmap associated with the passed in tag.
+ *  This method is used for printing how many draws of the
+ *  last frame were culled, and how many pixels the bounds
+ *  of the hidden draws cover, which is about how many
+ *  fragments were not shaded. Reading the results waits for
+ *  the GPU, so it is only done when a report is due.
  ***********************************************************/
-int SceneManager::FindTextureID(std::string tag)
+void SceneManager::ReportCullStats()
 {
-	int textureID = -1;
-	int index = 0;
-	bool bFound = false;
-
-	while ((index < m_loadedTextures) && (bFound == false))
+	std::chrono::steady_clock::time_point currentTime = std::chrono::steady_clock::now();
+	if (!m_bReportStats || (std::chrono::duration<double>(currentTime - m_lastReportTime).count() < g_ReportInterval))
 	{
-		if (m_textureIDs[index].tag.compare(tag) == 0)
-		{
-			textureID = m_textureIDs[index].ID;
-			bFound = true;
-		}
-		else
-			index++;
+		return;
 	}
+	m_lastReportTime = currentTime;
 
-	return(textureID);
-}
+	GPUCulling::CULL_STATS stats = m_gpuCulling->ReadCullStats();
+	glm::ivec2 renderSize = (NULL != m_pFrameCache) ? m_pFrameCache->GetRenderSize() : glm::ivec2(0);
+	int drawCount = m_staticBatch->GetDrawCount();
 
-/***********************************************************
- *  FindTextureSlot()
- *
- *  This method is used for getting a slot index for the previously
- *  loaded texture bitmap associated with the passed in tag.
- ***********************************************************/
-int SceneManager::FindTextureSlot(std::string tag)
-{
-	int textureSlot = -1;
-	int index = 0;
-	bool bFound = false;
+	std::cout << "Culling: " << stats.visibleDrawCount << " of " << drawCount << " draws visible, "
+		<< drawCount - stats.visibleDrawCount - stats.occludedDrawCount << " outside the view, "
+		<< stats.occludedDrawCount << " occluded covering about "
+		<< (long long)(stats.occludedArea * renderSize.x * renderSize.y) << " pixels" << std::endl;
 
-	while ((index < m_loadedTextures) && (bFound == false))
+	// the other views are only culled against their frustums, the
+	// eyes of the stereo view share a single cull
+	int viewCount = ((NULL != m_pViewManager) && !m_pViewManager->IsStereo()) ? m_pViewManager->GetViewCount() : 1;
+	for (int i = 1; i < viewCount; i++)
 	{
-		if (m_textureIDs[index].tag.compare(tag) == 0)
-		{
-			textureSlot = index;
-			bFound = true;
-		}
-		else
-			index++;
+		stats = m_gpuCulling->ReadCullStats(i);
+		std::cout << "Culling view " << i << ": " << stats.visibleDrawCount << " of " << drawCount
+			<< " draws visible" << std::endl;
 	}
-
-	return(textureSlot);
 }
 
 /***********************************************************
- *  FindMaterial()
+ *  RenderStaticBatch()
  *
- *  This method is used for getting a material from the previously
- *  defined materials list that is associated with the passed in tag.
+ *  This method is used for drawing the whole static batch
+ *  with the view of the current frame. With occlusion
+ *  culling the occluders are drawn into the depth buffer
+ *  first, and the draws hidden behind them are culled.
  ***********************************************************/
-bool SceneManager::FindMaterial(std::string tag, OBJECT_MATERIAL& material)
+void SceneManager::RenderStaticBatch()
 {
-	if (m_objectMaterials.size() == 0)
+	// the stereo draws are instanced once for each eye
+	bool bStereo = (NULL != m_pViewManager) && m_pViewManager->IsStereo();
+	m_staticBatch->SetInstanceCount(bStereo ? 2 : 1);
+	if (bStereo)
 	{
-		return(false);
+		RenderStaticBatchStereo();
+		return;
+	}
+	if ((NULL != m_pViewManager) && (m_pViewManager->GetViewCount() > 1))
+	{
+		RenderStaticBatchViews();
+		return;
 	}
 
-	int index = 0;
-	bool bFound = false;
-	while ((index < m_objectMaterials.size()) && (bFound == false))
+	GLStateCache::UseProgram(m_pBatchShaderManager);
+
+	if (NULL != m_pViewManager)
 	{
-		if (m_objectMaterials[index].tag.compare(tag) == 0)
+		GLStateCache::SetMat4(m_pBatchShaderManager, "view", m_pViewManager->GetViewMatrix());
+		GLStateCache::SetMat4(m_pBatchShaderManager, "projection", m_pViewManager->GetProjectionMatrix());
+		GLStateCache::SetVec3(m_pBatchShaderManager, "viewPosition", m_pViewManager->GetCameraPosition());
+	}
+
+	bool bCulled = false;
+	bool bOcclusion = false;
+	if (m_bUseGPUCulling && m_gpuCulling->IsInitialized() && (NULL != m_pViewManager))
+	{
+		// the occluders are drawn again by the full pass, on top
+		// of their own depth
+		bOcclusion = m_bUseOcclusionCulling && RenderOccluderDepth();
+		if (bOcclusion)
 		{
-			bFound = true;
-			material.ambientColor = m_objectMaterials[index].ambientColor;
-			material.ambientStrength = m_objectMaterials[index].ambientStrength;
-			material.diffuseColor = m_objectMaterials[index].diffuseColor;
-			material.specularColor = m_objectMaterials[index].specularColor;
-			material.shininess = m_objectMaterials[index].shininess;
+			glm::ivec2 pyramidSize = m_pHiZPyramid->GetSize();
+			m_gpuCulling->SetHiZTexture(m_pHiZPyramid->GetTexture(), pyramidSize.x, pyramidSize.y, m_pHiZPyramid->GetLevels());
+			GLStateCache::DepthFunc(GL_LEQUAL);
 		}
 		else
 		{
-			index++;
+			m_gpuCulling->SetHiZTexture(0, 0, 0, 0);
 		}
+
+		glm::mat4 viewProjection = m_pViewManager->GetProjectionMatrix() * m_pViewManager->GetViewMatrix();
+		int viewportHeight = m_pViewManager->GetViewportHeight();
+		m_gpuCulling->Cull(
+			m_staticBatch->GetCommandBuffer(),
+			m_staticBatch->GetDrawBoundsBuffer(),
+			m_staticBatch->GetDrawCount(),
+			&viewProjection,
+			1,
+			1,
+			&viewportHeight);
+		bCulled = true;
 	}
 
-	return(true);
+	GLStateCache::UseProgram(m_pBatchShaderManager);
+	if (!m_bDeferred || !RenderDeferredBatch(bCulled))
+	{
+		// the culling keeps the draws in their original order, so
+		// the transparent parts still blend over the ones behind
+		GLStateCache::Enable(GL_BLEND);
+		DrawStaticBatch(bCulled);
+		GLStateCache::Disable(GL_BLEND);
+	}
+
+	if (bOcclusion)
+	{
+		GLStateCache::DepthFunc(GL_LESS);
+	}
+	if (bCulled)
+	{
+		ReportCullStats();
+	}
+
+	GLStateCache::UseProgram(m_pShaderManager);
 }
 
 /***********************************************************
- *  SetTransformations()
+ *  RenderStaticBatchViews()
  *
- *  This method is used for setting the transform buffer
- *  using the passed in transformation values.
+ *  This method is used for drawing the static batch into
+ *  every view of the frame. The batch, its transforms and
+ *  its bounds are shared by the views, and a single cull
+ *  tests every draw against the frustums of all of them, so
+ *  each extra view only adds its indirect draw. The views
+ *  are shaded forward and culled against their frustums
+ *  only, as the G-buffer and the depth pyramid are built for
+ *  a single camera.
  ***********************************************************/
-void SceneManager::SetTransformations(
-	glm::vec3 scaleXYZ,
-	float XrotationDegrees,
-	float YrotationDegrees,
-	float ZrotationDegrees,
-	glm::vec3 positionXYZ)
+void SceneManager::RenderStaticBatchViews()
 {
-	// variables for this method
-	glm::mat4 modelView;
-	glm::mat4 scale;
-	glm::mat4 rotationX;
-	glm::mat4 rotationY;
-	glm::mat4 rotationZ;
-	glm::mat4 translation;
+	int viewCount = std::min(m_pViewManager->GetViewCount(), (int)GPUCulling::MAX_VIEWS);
+	glm::ivec2 frameSize = (NULL != m_pFrameCache) ? m_pFrameCache->GetRenderSize() : m_pViewManager->GetFramebufferSize();
 
-	// set the scale value in the transform buffer
-	scale = glm::scale(scaleXYZ);
-	// set the rotation values in the transform buffer
-	rotationX = glm::rotate(glm::radians(XrotationDegrees), glm::vec3(1.0f, 0.0f, 0.0f));
-	rotationY = glm::rotate(glm::radians(YrotationDegrees), glm::vec3(0.0f, 1.0f, 0.0f));
-	rotationZ = glm::rotate(glm::radians(ZrotationDegrees), glm::vec3(0.0f, 0.0f, 1.0f));
-	// set the translation value in the transform buffer
-	translation = glm::translate(positionXYZ);
+	bool bCulled = false;
+	if (m_bUseGPUCulling && m_gpuCulling->IsInitialized())
+	{
+		// every view picks the detail levels for its own size in
+		// the window, like the draws of the scene do
+		glm::mat4 viewProjections[GPUCulling::MAX_VIEWS];
+		int viewportHeights[GPUCulling::MAX_VIEWS];
+		for (int i = 0; i < viewCount; i++)
+		{
+			const ViewManager::SCENE_VIEW& view = m_pViewManager->GetView(i);
+			viewProjections[i] = view.projection * view.view;
+			viewportHeights[i] = ViewManager::GetViewportRect(view.viewport, m_pViewManager->GetFramebufferSize()).w;
+		}
 
-	modelView = translation * rotationZ * rotationY * rotationX * scale;
+		m_gpuCulling->SetHiZTexture(0, 0, 0, 0);
+		m_gpuCulling->Cull(
+			m_staticBatch->GetCommandBuffer(),
+			m_staticBatch->GetDrawBoundsBuffer(),
+			m_staticBatch->GetDrawCount(),
+			viewProjections,
+			viewCount,
+			1,
+			viewportHeights);
+		bCulled = true;
+	}
 
-	if (NULL != m_pShaderManager)
+	GLStateCache::UseProgram(m_pBatchShaderManager);
+	GLStateCache::Enable(GL_BLEND);
+	for (int i = 0; i < viewCount; i++)
 	{
-		m_pShaderManager->setMat4Value(g_ModelName, modelView);
-	}
-}
+		const ViewManager::SCENE_VIEW& view = m_pViewManager->GetView(i);
+		glm::ivec4 rect = ViewManager::GetViewportRect(view.viewport, frameSize);
+		glViewport(rect.x, rect.y, rect.z, rect.w);
 
-/***********************************************************
- *  SetShaderColor()
- *
- *  This method is used for setting the passed in color
- *  into the shader for the next draw command
- ***********************************************************/
-void SceneManager::SetShaderColor(
-	float redColorValue,
-	float greenColorValue,
-	float blueColorValue,
-	float alphaValue)
-{
-	// variables for this method
-	glm::vec4 currentColor;
+		// a view inset over an earlier one starts from a cleared
+		// part of the frame, the first view was cleared with it
+		if (i > 0)
+		{
+			GLStateCache::Enable(GL_SCISSOR_TEST);
+			glScissor(rect.x, rect.y, rect.z, rect.w);
+			if (NULL != m_pFrameCache)
+			{
+				m_pFrameCache->ClearBuffers();
+			}
+			else
+			{
+				glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+			}
+			GLStateCache::Disable(GL_SCISSOR_TEST);
+		}
 
-	currentColor.r = redColorValue;
-	currentColor.g = greenColorValue;
-	currentColor.b = blueColorValue;
-	currentColor.a = alphaValue;
+		GLStateCache::SetMat4(m_pBatchShaderManager, "view", view.view);
+		GLStateCache::SetMat4(m_pBatchShaderManager, "projection", view.projection);
+		GLStateCache::SetVec3(m_pBatchShaderManager, "viewPosition", view.position);
+
+		if (bCulled)
+		{
+			m_staticBatch->RenderCulled(
+				m_gpuCulling->GetCommandBuffer(),
+				m_gpuCulling->GetDrawCountBuffer(),
+				m_gpuCulling->GetCommandOffset(i),
+				m_gpuCulling->GetDrawCountOffset(i));
+		}
+		else
+		{
+			m_staticBatch->Render();
+		}
+	}
+	GLStateCache::Disable(GL_BLEND);
+	glViewport(0, 0, frameSize.x, frameSize.y);
 
-	if (NULL != m_pShaderManager)
+	if (bCulled)
 	{
-		m_pShaderManager->setIntValue(g_UseTextureName, false);
-		m_pShaderManager->setVec4Value(g_ColorValueName, currentColor);
+		ReportCullStats();
 	}
+
+	GLStateCache::UseProgram(m_pShaderManager);
 }
 
 /***********************************************************
- *  SetShaderTexture()
+ *  RenderStaticBatchStereo()
  *
- *  This method is used for setting the texture data
- *  associated with the passed in ID into the shader.
+ *  This method is used for drawing the static batch for the
+ *  left and the right eye with one submission. Every command
+ *  draws two instances, and the batch vertex shader moves the
+ *  even ones into the left half of the frame with the left
+ *  eye and the odd ones into the right half with the right
+ *  eye, clipped at the edge between them. The cull keeps the
+ *  draws seen by either eye, so the work on the CPU is that
+ *  of a single view. The eyes are shaded forward, without
+ *  occlusion culling, as the G-buffer and the depth pyramid
+ *  are built for a single camera.
  ***********************************************************/
-void SceneManager::SetShaderTexture(
-	std::string textureTag)
+void SceneManager::RenderStaticBatchStereo()
 {
-	if (NULL != m_pShaderManager)
+	glm::mat4 eyeViewProjections[2];
+	GLStateCache::UseProgram(m_pBatchShaderManager);
+	for (int eye = 0; eye < 2; eye++)
+	{
+		const ViewManager::SCENE_VIEW& view = m_pViewManager->GetView(eye);
+		eyeViewProjections[eye] = view.projection * view.view;
+		GLStateCache::SetMat4(m_pBatchShaderManager, g_EyeViewProjectionNames[eye], eyeViewProjections[eye]);
+		GLStateCache::SetVec3(m_pBatchShaderManager, g_EyePositionNames[eye], view.position);
+	}
+
+	bool bCulled = false;
+	if (m_bUseGPUCulling && m_gpuCulling->IsInitialized())
 	{
-		m_pShaderManager->setIntValue(g_UseTextureName, true);
+		// both eyes draw the level chosen for the left one
+		int viewportHeight = m_pViewManager->GetViewportHeight();
+		m_gpuCulling->SetHiZTexture(0, 0, 0, 0);
+		m_gpuCulling->Cull(
+			m_staticBatch->GetCommandBuffer(),
+			m_staticBatch->GetDrawBoundsBuffer(),
+			m_staticBatch->GetDrawCount(),
+			eyeViewProjections,
+			1,
+			2,
+			&viewportHeight);
+		bCulled = true;
+	}
 
-		int textureID = -1;
-		textureID = FindTextureSlot(textureTag);
-		m_pShaderManager->setSampler2DValue(g_TextureValueName, textureID);
+	GLStateCache::UseProgram(m_pBatchShaderManager);
+	GLStateCache::SetInt(m_pBatchShaderManager, g_StereoName, 1);
+	GLStateCache::Enable(GL_CLIP_DISTANCE0);
+	GLStateCache::Enable(GL_CLIP_DISTANCE1);
+	GLStateCache::Enable(GL_BLEND);
+	DrawStaticBatch(bCulled);
+	GLStateCache::Disable(GL_BLEND);
+	GLStateCache::Disable(GL_CLIP_DISTANCE0);
+	GLStateCache::Disable(GL_CLIP_DISTANCE1);
+	GLStateCache::SetInt(m_pBatchShaderManager, g_StereoName, 0);
+
+	if (bCulled)
+	{
+		ReportCullStats();
 	}
+
+	GLStateCache::UseProgram(m_pShaderManager);
 }
 
 /***********************************************************
- *  SetTextureUVScale()
+ *  DrawStaticBatch()
  *
- *  This method is used for setting the texture UV scale
- *  values into the shader.
+ *  This method is used for submitting the static batch with
+ *  the program in use, as culled by the last cull or whole.
  ***********************************************************/
-void SceneManager::SetTextureUVScale(float u, float v)
+void SceneManager::DrawStaticBatch(bool bCulled)
 {
-	if (NULL != m_pShaderManager)
+	if (bCulled)
+	{
+		m_staticBatch->RenderCulled(
+			m_gpuCulling->GetCommandBuffer(),
+			m_gpuCulling->GetDrawCountBuffer());
+	}
+	else
 	{
-		m_pShaderManager->setVec2Value("UVscale", glm::vec2(u, v));
+		m_staticBatch->Render();
 	}
 }
 
 /***********************************************************
- *  SetShaderMaterial()
+ *  RenderDeferredBatch()
  *
- *  This method is used for passing the material values
- *  into the shader.
+ *  This method is used for drawing the static batch with
+ *  deferred shading. The opaque draws fill the G-buffer
+ *  without blending, the tiled light pass writes the lit
+ *  pixels into the frame, and the transparent draws are
+ *  then drawn forward and blended on top. False when the
+ *  G-buffer cannot be used, and nothing was drawn.
  ***********************************************************/
-void SceneManager::SetShaderMaterial(
-	std::string materialTag)
+bool SceneManager::RenderDeferredBatch(bool bCulled)
 {
-	if (m_objectMaterials.size() > 0)
+	if ((NULL == m_pDeferredShading) || !m_pDeferredShading->IsInitialized() ||
+		(NULL == m_pFrameCache) || (NULL == m_pViewManager) ||
+		((int)m_objectMaterials.size() > DeferredShading::MAX_MATERIALS))
 	{
-		OBJECT_MATERIAL material;
-		bool bReturn = false;
-
-		bReturn = FindMaterial(materialTag, material);
-		if (bReturn == true)
-		{
-			m_pShaderManager->setVec3Value("material.ambientColor", material.ambientColor);
-			m_pShaderManager->setFloatValue("material.ambientStrength", material.ambientStrength);
-			m_pShaderManager->setVec3Value("material.diffuseColor", material.diffuseColor);
-			m_pShaderManager->setVec3Value("material.specularColor", material.specularColor);
-			m_pShaderManager->setFloatValue("material.shininess", material.shininess);
-		}
+		return(false);
+	}
+	if (!m_pDeferredShading->BeginGeometryPass(m_pFrameCache->GetDepthTexture(), m_pFrameCache->GetObjectIDTexture()))
+	{
+		return(false);
 	}
+
+	GLStateCache::Disable(GL_BLEND);
+	GLStateCache::SetInt(m_pBatchShaderManager, g_ShadingPassName, g_ShadingPassGBuffer);
+	DrawStaticBatch(bCulled);
+
+	glBindFramebuffer(GL_FRAMEBUFFER, m_pFrameCache->GetFramebuffer());
+	m_pDeferredShading->ShadeLights(
+		m_pFrameCache->GetColorTexture(),
+		m_pFrameCache->GetDepthTexture(),
+		m_pFrameCache->GetRenderSize(),
+		m_pFrameCache->GetRedrawRect(),
+		m_pViewManager->GetViewMatrix(),
+		m_pViewManager->GetProjectionMatrix(),
+		m_pViewManager->GetCameraPosition(),
+		m_staticBatch->GetMaterialBuffer());
+
+	// the transparent draws test against the depth of the opaque
+	// ones, which they are drawn in front of or not at all
+	GLStateCache::UseProgram(m_pBatchShaderManager);
+	GLStateCache::DepthFunc(GL_LEQUAL);
+	GLStateCache::Enable(GL_BLEND);
+	GLStateCache::SetInt(m_pBatchShaderManager, g_ShadingPassName, g_ShadingPassTransparent);
+	DrawStaticBatch(bCulled);
+	GLStateCache::Disable(GL_BLEND);
+	GLStateCache::DepthFunc(GL_LESS);
+	GLStateCache::SetInt(m_pBatchShaderManager, g_ShadingPassName, g_ShadingPassForward);
+
+	return(true);
 }
 
 /**************************************************************/
@@ -456,50 +1980,125 @@ void SceneManager::DefineObjectMaterials()
 /***********************************************************
  *  SetupSceneLights()
  *
- *  This method is called to add and configure the light
- *  sources for the 3D scene.  There are up to 4 light sources.
+ *  This method is used for adding and configuring the light
+ *  sources for the 3D scene in the forward shaders.
  ***********************************************************/
 void SceneManager::SetupSceneLights()
 {
-	// this line of code is NEEDED for telling the shaders to render 
-	// the 3D scene with custom lighting, if no light sources have
-	// been added then the display window will be black - to use the 
-	// default OpenGL lighting then comment out the following line
-	m_pShaderManager->setBoolValue(g_UseLightingName, true);
+	ApplySceneLights(m_pShaderManager);
+}
 
-	// Define brightness modifier
-	float brightnessModifier = 1.0f; // Adjust this value to increase or decrease brightness
+/***********************************************************
+ *  GetSceneLights()
+ *
+ *  This method is used for getting the light sources of the
+ *  3D scene, from the scene file or the ones defined here,
+ *  and the ambient color every light adds.
+ ***********************************************************/
+void SceneManager::GetSceneLights(std::vector<SceneFile::SCENE_LIGHT>& lights, glm::vec3& globalAmbientColor)
+{
+	lights.clear();
 
-	// Set global ambient color to a slightly reduced subtle gray for natural base lighting
-	m_pShaderManager->setVec3Value("globalAmbientColor", 0.15f, 0.15f, 0.15f);
+	// a scene file brings its own lights
+	if (m_sceneFile->IsLoaded())
+	{
+		const SceneFile::SCENE_LIGHT* pLights = m_sceneFile->GetLights();
+		globalAmbientColor = m_sceneFile->GetGlobalAmbientColor();
+		for (int i = 0; (i < m_sceneFile->GetCount(SceneFile::SECTION_LIGHTS)) && (i < SceneFile::MAX_LIGHTS); i++)
+		{
+			lights.push_back(pLights[i]);
+		}
+	}
+	else
+	{
+		// Define brightness modifier
+		float brightnessModifier = 1.0f; // Adjust this value to increase or decrease brightness
+
+		// Set global ambient color to a slightly reduced subtle gray for natural base lighting
+		globalAmbientColor = glm::vec3(0.15f, 0.15f, 0.15f);
+
+		SceneFile::SCENE_LIGHT light;
+		// every light reaches the whole scene
+		light.range = 0.0f;
+
+		// Light Source 0: Sunlight from above (warm light)
+		light.position = glm::vec3(0.0f, 10.0f, 0.0f);
+		light.diffuseColor = glm::vec3(0.9f, 0.8f, 0.7f) * brightnessModifier;
+		light.specularColor = glm::vec3(0.9f, 0.8f, 0.7f) * brightnessModifier;
+		light.focalStrength = 20.0f * brightnessModifier;
+		light.specularIntensity = 0.5f * brightnessModifier;
+		lights.push_back(light);
+
+		// Light Source 1: Fill light from the front-right (dim soft light)
+		light.position = glm::vec3(5.0f, 5.0f, 5.0f);
+		light.diffuseColor = glm::vec3(0.2f, 0.2f, 0.2f) * brightnessModifier;
+		light.specularColor = glm::vec3(0.2f, 0.2f, 0.2f) * brightnessModifier;
+		light.focalStrength = 8.0f * brightnessModifier;
+		light.specularIntensity = 0.05f * brightnessModifier;
+		lights.push_back(light);
+
+		// Light Source 2: Fill light from the front-left (dim soft light)
+		light.position = glm::vec3(-5.0f, 5.0f, 5.0f);
+		light.diffuseColor = glm::vec3(0.2f, 0.2f, 0.2f) * brightnessModifier;
+		light.specularColor = glm::vec3(0.2f, 0.2f, 0.2f) * brightnessModifier;
+		light.focalStrength = 8.0f * brightnessModifier;
+		light.specularIntensity = 0.05f * brightnessModifier;
+		lights.push_back(light);
+
+		// Light Source 3: Low intensity fill light from the back (blue light)
+		light.position = glm::vec3(0.0f, 3.0f, -5.0f);
+		light.diffuseColor = glm::vec3(0.1f, 0.1f, 1.0f) * brightnessModifier; // More blue
+		light.specularColor = glm::vec3(0.1f, 0.1f, 1.0f) * brightnessModifier; // More blue
+		light.focalStrength = 20.0f * brightnessModifier;
+		light.specularIntensity = 0.5f * brightnessModifier;
+		lights.push_back(light);
+	}
 
-	// Light Source 0: Sunlight from above (warm light)
-	m_pShaderManager->setVec3Value("lightSources[0].position", 0.0f, 10.0f, 0.0f);
-	m_pShaderManager->setVec3Value("lightSources[0].diffuseColor", 0.9f * brightnessModifier, 0.8f * brightnessModifier, 0.7f * brightnessModifier);
-	m_pShaderManager->setVec3Value("lightSources[0].specularColor", 0.9f * brightnessModifier, 0.8f * brightnessModifier, 0.7f * brightnessModifier);
-	m_pShaderManager->setFloatValue("lightSources[0].focalStrength", 20.0f * brightnessModifier);
-	m_pShaderManager->setFloatValue("lightSources[0].specularIntensity", 0.5f * brightnessModifier);
+	// the slots a scene file does not fill are turned off
+	while ((int)lights.size() < g_MinLightSlots)
+	{
+		SceneFile::SCENE_LIGHT light;
+		light.position = glm::vec3(0.0f);
+		light.diffuseColor = glm::vec3(0.0f);
+		light.specularColor = glm::vec3(0.0f);
+		light.focalStrength = 0.0f;
+		light.specularIntensity = 0.0f;
+		light.range = 0.0f;
+		lights.push_back(light);
+	}
+}
 
-	// Light Source 1: Fill light from the front-right (dim soft light)
-	m_pShaderManager->setVec3Value("lightSources[1].position", 5.0f, 5.0f, 5.0f);
-	m_pShaderManager->setVec3Value("lightSources[1].diffuseColor", 0.2f * brightnessModifier, 0.2f * brightnessModifier, 0.2f * brightnessModifier);
-	m_pShaderManager->setVec3Value("lightSources[1].specularColor", 0.2f * brightnessModifier, 0.2f * brightnessModifier, 0.2f * brightnessModifier);
-	m_pShaderManager->setFloatValue("lightSources[1].focalStrength", 8.0f * brightnessModifier);
-	m_pShaderManager->setFloatValue("lightSources[1].specularIntensity", 0.05f * brightnessModifier);
+/***********************************************************
+ *  ApplySceneLights()
+ *
+ *  This method is called to add and configure the light
+ *  sources for the 3D scene.  There are up to 32 light
+ *  sources.
+ ***********************************************************/
+void SceneManager::ApplySceneLights(ShaderManager* pShaderManager)
+{
+	// this line of code is NEEDED for telling the shaders to render 
+	// the 3D scene with custom lighting, if no light sources have
+	// been added then the display window will be black - to use the 
+	// default OpenGL lighting then comment out the following line
+	pShaderManager->setBoolValue(g_UseLightingName, true);
 
-	// Light Source 2: Fill light from the front-left (dim soft light)
-	m_pShaderManager->setVec3Value("lightSources[2].position", -5.0f, 5.0f, 5.0f);
-	m_pShaderManager->setVec3Value("lightSources[2].diffuseColor", 0.2f * brightnessModifier, 0.2f * brightnessModifier, 0.2f * brightnessModifier);
-	m_pShaderManager->setVec3Value("lightSources[2].specularColor", 0.2f * brightnessModifier, 0.2f * brightnessModifier, 0.2f * brightnessModifier);
-	m_pShaderManager->setFloatValue("lightSources[2].focalStrength", 8.0f * brightnessModifier);
-	m_pShaderManager->setFloatValue("lightSources[2].specularIntensity", 0.05f * brightnessModifier);
+	std::vector<SceneFile::SCENE_LIGHT> lights;
+	glm::vec3 globalAmbientColor;
+	GetSceneLights(lights, globalAmbientColor);
 
-	// Light Source 3: Low intensity fill light from the back (blue light)
-	m_pShaderManager->setVec3Value("lightSources[3].position", 0.0f, 3.0f, -5.0f);
-	m_pShaderManager->setVec3Value("lightSources[3].diffuseColor", 0.1f * brightnessModifier, 0.1f * brightnessModifier, 1.0f * brightnessModifier); // More blue
-	m_pShaderManager->setVec3Value("lightSources[3].specularColor", 0.1f * brightnessModifier, 0.1f * brightnessModifier, 1.0f * brightnessModifier); // More blue
-	m_pShaderManager->setFloatValue("lightSources[3].focalStrength", 20.0f * brightnessModifier);
-	m_pShaderManager->setFloatValue("lightSources[3].specularIntensity", 0.5f * brightnessModifier);
+	pShaderManager->setVec3Value("globalAmbientColor", globalAmbientColor);
+	pShaderManager->setIntValue("lightCount", (int)lights.size());
+	for (int i = 0; i < (int)lights.size(); i++)
+	{
+		std::string name = "lightSources[" + std::to_string(i) + "].";
+		pShaderManager->setVec3Value(name + "position", lights[i].position);
+		pShaderManager->setVec3Value(name + "diffuseColor", lights[i].diffuseColor);
+		pShaderManager->setVec3Value(name + "specularColor", lights[i].specularColor);
+		pShaderManager->setFloatValue(name + "focalStrength", lights[i].focalStrength);
+		pShaderManager->setFloatValue(name + "specularIntensity", lights[i].specularIntensity);
+		pShaderManager->setFloatValue(name + "range", lights[i].range);
+	}
 }
 
 
@@ -514,23 +2113,62 @@ void SceneManager::SetupSceneLights()
  ***********************************************************/
 void SceneManager::PrepareScene()
 {
+	// a scene file replaces the scene defined in the code
+	if (!m_sceneFilePath.empty())
+	{
+		LoadSceneFile();
+	}
+
+	// the imported meshes are parsed on worker threads while
+	// the rest of the scene is prepared
+	if (!m_bottleMeshPath.empty())
+	{
+		m_bottleMeshID = m_lodMeshes->ImportMesh(m_bottleMeshPath.c_str());
+	}
+
 	//LoadSceneTextures();
-	DefineObjectMaterials();
+	if (!m_sceneFile->IsLoaded())
+	{
+		DefineObjectMaterials();
+	}
+
+	// the material library overrides the materials with the
+	// same tag, before anything is drawn with them
+	if (m_materialLibrary->Load(m_materialLibraryPath.c_str()))
+	{
+		const std::vector<MaterialLibrary::LIBRARY_MATERIAL>& materials = m_materialLibrary->GetMaterials();
+		for (size_t i = 0; i < materials.size(); i++)
+		{
+			ApplyLibraryMaterial(materials[i]);
+		}
+	}
 	SetupSceneLights();
 	// only one instance of a particular mesh needs to be
 	// loaded in memory no matter how many times it is drawn
 	// in the rendered 3D scene
 
-	m_basicMeshes->LoadBoxMesh();
-	m_basicMeshes->LoadPlaneMesh();
-	m_basicMeshes->LoadCylinderMesh();
-	m_basicMeshes->LoadConeMesh();
-	m_basicMeshes->LoadPrismMesh();
-	m_basicMeshes->LoadPyramid4Mesh();
-	m_basicMeshes->LoadSphereMesh();
-	m_basicMeshes->LoadTaperedCylinderMesh();
-	m_basicMeshes->LoadTorusMesh();
+	// the curved shapes are generated at several detail levels
+	m_lodMeshes->LoadMeshes(m_bPackVertices, m_bOptimizeMeshes);
+	m_pShaderManager->setBoolValue(g_PackedVerticesName, m_lodMeshes->IsPacked());
+
+	// every texture slot is bound once to its own texture unit,
+	// and the draws pick theirs through the draw constants
+	for (int i = 0; i < g_MaxTextureSlots; i++)
+	{
+		m_pShaderManager->setSampler2DValue(
+			std::string(g_TextureArrayName) + "[" + std::to_string(i) + "]", i);
+	}
+	m_drawConstants->Initialize(std::max(g_InitialDrawsPerFrame, m_sceneFile->GetCount(SceneFile::SECTION_NODES)));
 
+	// a scene file brings its own textures
+	if (m_sceneFile->IsLoaded())
+	{
+		LoadSceneFileTextures();
+		BindGLTextures();
+		m_pTextureCache->ReportStats();
+		BuildStaticBatch();
+		return;
+	}
 
 	// Load the wood texture
 	bool bReturn = CreateGLTexture("textures/rusticwood.jpg", "table");
@@ -577,7 +2215,9 @@ void SceneManager::PrepareScene()
 		std::cerr << "Failed to load texture: bubbles.png" << std::endl;
 	}
 
-	bReturn = CreateGLTexture("textures/field.jpg", "backdrop");
+	// the backdrop is stretched once across its plane, so its
+	// edges must not blend with the opposite ones
+	bReturn = CreateGLTexture("textures/field.jpg", "backdrop", SamplerManager::SAMPLER_CLAMP);
 	if (!bReturn)
 	{
 		std::cerr << "Failed to load texture: field.jpg" << std::endl;
@@ -612,6 +2252,32 @@ void SceneManager::PrepareScene()
 
 	// Bind the textures
 	BindGLTextures();
+	m_pTextureCache->ReportStats();
+
+	// every object is static, so the draws are merged once
+	BuildStaticBatch();
+}
+
+/***********************************************************
+ *  UpdateScene()
+ *
+ *  This method is used for applying the changes made to the
+ *  scene since the last frame. The lights and the placement
+ *  of the objects are fixed once the scene is prepared, so
+ *  the saved material library is the only thing that can
+ *  change while running.
+ ***********************************************************/
+void SceneManager::UpdateScene(FrameCache* pFrameCache)
+{
+	// the memory of the last frame is handed out again, the
+	// job threads are idle between frames
+	for (size_t i = 0; i < m_frameArenas.size(); i++)
+	{
+		m_frameArenas[i]->Reset();
+	}
+
+	// pick up the materials saved since the last frame
+	UpdateMaterialLibrary(pFrameCache);
 }
 
 /***********************************************************
@@ -622,13 +2288,60 @@ void SceneManager::PrepareScene()
  ***********************************************************/
 void SceneManager::RenderScene()
 {
-	RenderTable();
-	RenderBackdrop();
-	RenderBeerGlass();
-	RenderBeerBottle();
-	RenderPlate();
-	RenderLemon();
-	RenderKnife();
+	if (m_bUseStaticBatch && !m_bRecordingStaticBatch && m_staticBatch->IsBuilt())
+	{
+		RenderStaticBatch();
+		return;
+	}
+
+	// the draws of each object are only made for the interactive
+	// camera, which keeps its part of the frame with more views
+	bool bViewport = !m_bRecordingStaticBatch && (NULL != m_pViewManager) && (NULL != m_pFrameCache) &&
+		(m_pViewManager->GetViewCount() > 1);
+	if (bViewport)
+	{
+		glm::ivec4 rect = ViewManager::GetViewportRect(
+			m_pViewManager->GetView(0).viewport, m_pFrameCache->GetRenderSize());
+		glViewport(rect.x, rect.y, rect.z, rect.w);
+	}
+
+	// the curved draws are counted again every frame so each one
+	// finds the detail level it used in the previous frame
+	m_lodDrawIndex = 0;
+	m_lodMeshes->ResetTrianglesDrawn();
+
+	// the draws of the frame write their values into the next
+	// region of the draw constant ring
+	if (!m_bRecordingStaticBatch)
+	{
+		m_drawConstants->BeginFrame();
+	}
+
+	if (m_sceneFile->IsLoaded())
+	{
+		RenderSceneFile();
+	}
+	else
+	{
+		RenderTable();
+		RenderBackdrop();
+		RenderBeerGlass();
+		RenderBeerBottle();
+		RenderPlate();
+		RenderLemon();
+		RenderKnife();
+	}
+
+	if (!m_bRecordingStaticBatch)
+	{
+		m_drawConstants->EndFrame();
+	}
+
+	if (bViewport)
+	{
+		glm::ivec2 renderSize = m_pFrameCache->GetRenderSize();
+		glViewport(0, 0, renderSize.x, renderSize.y);
+	}
 }
 
 /***********************************************************
@@ -646,9 +2359,11 @@ void SceneManager::RenderTable()
 	float ZrotationDegrees = 0.0f;
 	glm::vec3 positionXYZ;
 
+	SetSceneObject("table");
+
 	// Enable blending
-	glEnable(GL_BLEND);
-	glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+	GLStateCache::Enable(GL_BLEND);
+	GLStateCache::BlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
 
 	// set the XYZ scale for the mesh
 	scaleXYZ = glm::vec3(50.0f, 2.0f, 30.0f); // updated y to 2.0
@@ -665,8 +2380,8 @@ void SceneManager::RenderTable()
 	SetShaderMaterial("wood");  // set shader for wood
 
 	// draw the mesh with transformation values
-	m_basicMeshes->DrawBoxMesh();  // This will be a box mesh in the final project
-	glDisable(GL_BLEND);
+	DrawLODShape(ShapeLODMeshes::LOD_BOX);  // This will be a box mesh in the final project
+	GLStateCache::Disable(GL_BLEND);
 }
 
 /***********************************************************
@@ -684,6 +2399,8 @@ void SceneManager::RenderBackdrop()
 	float ZrotationDegrees = 0.0f;
 	glm::vec3 positionXYZ;
 
+	SetSceneObject("backdrop");
+
 	/*** Set needed transformations before drawing the basic mesh ***/
 
 	// set the XYZ scale for the mesh
@@ -710,7 +2427,7 @@ void SceneManager::RenderBackdrop()
 	SetShaderMaterial("backdrop");
 
 	// draw the mesh with transformation values - this plane is used for the backdrop
-	m_basicMeshes->DrawPlaneMesh();
+	DrawLODShape(ShapeLODMeshes::LOD_PLANE);
 }
 
 
@@ -729,9 +2446,11 @@ void SceneManager::RenderBeerGlass()
 	float ZrotationDegrees = 0.0f;
 	glm::vec3 positionXYZ;
 
+	SetSceneObject("beer glass");
+
 	// Enable blending
-	glEnable(GL_BLEND);
-	glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+	GLStateCache::Enable(GL_BLEND);
+	GLStateCache::BlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
 
 	// Render Beer Glass Base
 	// set the XYZ scale for the mesh
@@ -748,7 +2467,7 @@ void SceneManager::RenderBeerGlass()
 	SetShaderMaterial("glass"); // set shader for glass
 
 	// draw the base cylinder mesh
-	m_basicMeshes->DrawTaperedCylinderMesh();
+	DrawLODShape(ShapeLODMeshes::LOD_TAPERED_CYLINDER);
 
 	// Render Beer Glass Body
 	// set the XYZ scale for the mesh
@@ -768,7 +2487,7 @@ void SceneManager::RenderBeerGlass()
 	SetTextureUVScale(1.0f, 1.0f);
 
 	// draw the body tapered cylinder mesh
-	m_basicMeshes->DrawTaperedCylinderMesh();
+	DrawLODShape(ShapeLODMeshes::LOD_TAPERED_CYLINDER);
 
 	// Overlay bubbles texture on top of beer body
 	SetShaderTexture("bubbles");
@@ -776,7 +2495,7 @@ void SceneManager::RenderBeerGlass()
 	SetShaderMaterial("beer"); // set shader for middle body of beer
 
 	// draw the body tapered cylinder mesh again with bubbles texture
-	m_basicMeshes->DrawTaperedCylinderMesh();
+	DrawLODShape(ShapeLODMeshes::LOD_TAPERED_CYLINDER);
 
 	// Render Beer Head
 	// set the XYZ scale for the mesh
@@ -797,7 +2516,7 @@ void SceneManager::RenderBeerGlass()
 	SetShaderMaterial("foam"); // set shader for beer foam
 
 	// draw the head cylinder mesh
-	m_basicMeshes->DrawCylinderMesh();
+	DrawLODShape(ShapeLODMeshes::LOD_CYLINDER);
 
 	// Render Inner Lemon
 	// set the XYZ scale for the mesh
@@ -818,7 +2537,7 @@ void SceneManager::RenderBeerGlass()
 	//SetShaderMaterial("lemon"); // set lemon shader
 
 	// draw the lemon cylinder mesh
-	m_basicMeshes->DrawCylinderMesh();
+	DrawLODShape(ShapeLODMeshes::LOD_CYLINDER);
 
 	// Render Outer Lemon
 	// set the XYZ scale for the mesh
@@ -839,10 +2558,10 @@ void SceneManager::RenderBeerGlass()
 	SetShaderMaterial("lemon"); // set lemon shader
 
 	// draw the lemon cylinder mesh
-	m_basicMeshes->DrawCylinderMesh();
+	DrawLODShape(ShapeLODMeshes::LOD_CYLINDER);
 
 	// Disable blending after drawing
-	glDisable(GL_BLEND);
+	GLStateCache::Disable(GL_BLEND);
 }
 
 
@@ -861,6 +2580,36 @@ void SceneManager::RenderBeerBottle()
 	float ZrotationDegrees = 0.0f;
 	glm::vec3 positionXYZ;
 
+	SetSceneObject("beer bottle");
+
+	/*** Draw the imported bottle mesh instead of the shapes when there is one ***/
+
+	if (m_lodMeshes->IsImportedMeshLoaded(m_bottleMeshID))
+	{
+		const ShapeLODMeshes::MESH_RANGE& range = m_lodMeshes->GetImportedMeshRange(m_bottleMeshID);
+
+		// scale the mesh to the bottle height and stand the center
+		// of the bottom of its bounding box on the bottle base
+		float scale = g_BottleHeight / std::max(range.boundsExtent.y, 0.0001f);
+		glm::vec3 baseCenter = range.boundsMin + glm::vec3(0.5f * range.boundsExtent.x, 0.0f, 0.5f * range.boundsExtent.z);
+		scaleXYZ = glm::vec3(scale);
+		positionXYZ = g_BottleBaseCenter - scale * baseCenter;
+
+		SetTransformations(
+			scaleXYZ,
+			XrotationDegrees,
+			YrotationDegrees,
+			ZrotationDegrees,
+			positionXYZ);
+
+		SetShaderTexture("bottleglass");
+		SetTextureUVScale(1.0f, 1.0f);
+		SetShaderMaterial("glass");
+
+		DrawImportedMesh(m_bottleMeshID);
+		return;
+	}
+
 	/*** Set needed transformations before drawing the bottom half-sphere ***/
 
 	// set the XYZ scale for the mesh (scaled up by 1.25x)
@@ -887,7 +2636,7 @@ void SceneManager::RenderBeerBottle()
 	SetShaderMaterial("glass");
 
 	// draw the mesh with transformation values - this half-sphere is used for the bottom of the bottle
-	m_basicMeshes->DrawHalfSphereMesh();
+	DrawLODShape(ShapeLODMeshes::LOD_HALF_SPHERE);
 
 	/*** Set needed transformations before drawing the main cylinder body ***/
 
@@ -915,7 +2664,7 @@ void SceneManager::RenderBeerBottle()
 	SetShaderMaterial("glass");
 
 	// draw the mesh with transformation values - this cylinder is used for the main body of the bottle
-	m_basicMeshes->DrawCylinderMesh(false, false, true);
+	DrawLODShape(ShapeLODMeshes::LOD_CYLINDER, false, false, true);
 
 	/*** Set needed transformations before drawing the top half-sphere ***/
 
@@ -943,7 +2692,7 @@ void SceneManager::RenderBeerBottle()
 	SetShaderMaterial("glass");
 
 	// draw the mesh with transformation values - this half-sphere is used for the top of the bottle
-	m_basicMeshes->DrawHalfSphereMesh();
+	DrawLODShape(ShapeLODMeshes::LOD_HALF_SPHERE);
 
 	/*** Set needed transformations before drawing the neck cylinder ***/
 
@@ -971,7 +2720,7 @@ void SceneManager::RenderBeerBottle()
 	SetShaderMaterial("glass");
 
 	// draw the mesh with transformation values - this cylinder is used for the neck
-	m_basicMeshes->DrawCylinderMesh(false, false, true);
+	DrawLODShape(ShapeLODMeshes::LOD_CYLINDER, false, false, true);
 
 	/*** Set needed transformations before drawing the brass bottle cap ***/
 
@@ -998,7 +2747,7 @@ void SceneManager::RenderBeerBottle()
 	SetShaderMaterial("glass");
 
 	// draw the mesh with transformation values - this cylinder is used for the bottle cap
-	m_basicMeshes->DrawCylinderMesh();
+	DrawLODShape(ShapeLODMeshes::LOD_CYLINDER);
 
 	/*** Set needed transformations before drawing the torus at the neck ***/
 
@@ -1026,7 +2775,7 @@ void SceneManager::RenderBeerBottle()
 	SetShaderMaterial("glass");
 
 	// draw the mesh with transformation values - this torus is used for the neck ring
-	m_basicMeshes->DrawTorusMesh();
+	DrawLODShape(ShapeLODMeshes::LOD_TORUS);
 }
 
 
@@ -1044,6 +2793,8 @@ void SceneManager::RenderPlate()
 	float ZrotationDegrees = 0.0f;
 	glm::vec3 positionXYZ;
 
+	SetSceneObject("plate");
+
 	/*** Set needed transformations before drawing the basic mesh.  ***/
 	/*** This same ordering of code should be used for transforming ***/
 	/*** and drawing all the basic 3D shapes.                        ***/
@@ -1072,7 +2823,7 @@ void SceneManager::RenderPlate()
 	SetShaderMaterial("plate");
 
 	// draw the mesh with transformation values - this cylinder is used for the base of the plate
-	m_basicMeshes->DrawCylinderMesh();
+	DrawLODShape(ShapeLODMeshes::LOD_CYLINDER);
 	/******************************************************************/
 
 	/*** Set needed transformations before drawing the basic mesh.  ***/
@@ -1103,7 +2854,7 @@ void SceneManager::RenderPlate()
 	SetShaderMaterial("plate");
 
 	// draw the mesh with transformation values - this half-sphere is used for the top of the plate
-	m_basicMeshes->DrawHalfSphereMesh();
+	DrawLODShape(ShapeLODMeshes::LOD_HALF_SPHERE);
 }
 
 /***********************************************************
@@ -1120,6 +2871,8 @@ void SceneManager::RenderLemon()
 	float ZrotationDegrees = 0.0f;
 	glm::vec3 positionXYZ;
 
+	SetSceneObject("lemon");
+
 	// Render the first lemon
 	scaleXYZ = glm::vec3(0.95f, 0.75f, 0.95f);
 	positionXYZ = glm::vec3(-3.7f, 1.1f, 1.3f); // Adjusted position to sit on the plate
@@ -1127,13 +2880,13 @@ void SceneManager::RenderLemon()
 	SetShaderTexture("outLemon");
 	SetTextureUVScale(1.0f, 1.0f);
 	SetShaderMaterial("lemon");
-	m_basicMeshes->DrawSphereMesh();
+	DrawLODShape(ShapeLODMeshes::LOD_SPHERE);
 
 	// Render the second lemon
 	scaleXYZ = glm::vec3(0.85f, 0.75f, 0.75f);
 	positionXYZ = glm::vec3(-1.9f, 1.1f, 1.4f); // Adjusted position to sit next to the first lemon
 	SetTransformations(scaleXYZ, XrotationDegrees, YrotationDegrees, ZrotationDegrees, positionXYZ);
-	m_basicMeshes->DrawSphereMesh();
+	DrawLODShape(ShapeLODMeshes::LOD_SPHERE);
 	
 	
 	// Render the first lemon slice (inner and outer)
@@ -1146,33 +2899,33 @@ void SceneManager::RenderLemon()
 	SetShaderTexture("inLemon");
 	SetTextureUVScale(1.0f, 1.0f);
 	SetShaderMaterial("lemon");
-	m_basicMeshes->DrawCylinderMesh();
+	DrawLODShape(ShapeLODMeshes::LOD_CYLINDER);
 	scaleXYZ = glm::vec3(0.8f, 0.14925f, 0.8f);
 	SetTransformations(scaleXYZ, XrotationDegrees, YrotationDegrees, ZrotationDegrees, positionXYZ);
 	SetShaderTexture("outLemon");
-	m_basicMeshes->DrawCylinderMesh();
+	DrawLODShape(ShapeLODMeshes::LOD_CYLINDER);
 
 	// Render the second lemon slice (inner and outer)
 	scaleXYZ = glm::vec3(0.72f, 0.15f, 0.72f);
 	positionXYZ = glm::vec3(-3.2f, 0.65f, 2.9f); // Slightly in front and above the first slice
 	SetTransformations(scaleXYZ, XrotationDegrees, YrotationDegrees, ZrotationDegrees, positionXYZ);
 	SetShaderTexture("inLemon");
-	m_basicMeshes->DrawCylinderMesh();
+	DrawLODShape(ShapeLODMeshes::LOD_CYLINDER);
 	scaleXYZ = glm::vec3(0.8f, 0.14925f, 0.8f);
 	SetTransformations(scaleXYZ, XrotationDegrees, YrotationDegrees, ZrotationDegrees, positionXYZ);
 	SetShaderTexture("outLemon");
-	m_basicMeshes->DrawCylinderMesh();
+	DrawLODShape(ShapeLODMeshes::LOD_CYLINDER);
 
 	// Render the third lemon slice (inner and outer)
 	scaleXYZ = glm::vec3(0.70f, 0.15f, 0.70f);
 	positionXYZ = glm::vec3(-2.8f, 0.8f, 2.8f); // Slightly in front and above the second slice
 	SetTransformations(scaleXYZ, XrotationDegrees, YrotationDegrees, ZrotationDegrees, positionXYZ);
 	SetShaderTexture("inLemon");
-	m_basicMeshes->DrawCylinderMesh();
+	DrawLODShape(ShapeLODMeshes::LOD_CYLINDER);
 	scaleXYZ = glm::vec3(0.8f, 0.14925f, 0.8f);
 	SetTransformations(scaleXYZ, XrotationDegrees, YrotationDegrees, ZrotationDegrees, positionXYZ);
 	SetShaderTexture("outLemon");
-	m_basicMeshes->DrawCylinderMesh();
+	DrawLODShape(ShapeLODMeshes::LOD_CYLINDER);
 
 }
 
@@ -1190,6 +2943,8 @@ void SceneManager::RenderKnife()
 	float ZrotationDegrees = 0.0f;
 	glm::vec3 positionXYZ;
 
+	SetSceneObject("knife");
+
 	// Render the knife handle
 	scaleXYZ = glm::vec3(1.0f, 0.18f, 0.20f);
 	XrotationDegrees = 0.0f;
@@ -1200,7 +2955,7 @@ void SceneManager::RenderKnife()
 	SetShaderTexture("knifeHandle");
 	SetTextureUVScale(1.0f, 1.0f);
 	SetShaderMaterial("wood");
-	m_basicMeshes->DrawCylinderMesh();
+	DrawLODShape(ShapeLODMeshes::LOD_CYLINDER);
 
 	// Render the knife blade
 	scaleXYZ = glm::vec3(0.3f, 2.0f, 0.02f);
@@ -1212,7 +2967,7 @@ void SceneManager::RenderKnife()
 	SetShaderTexture("stainless");
 	SetTextureUVScale(1.0f, 1.0f);
 	SetShaderMaterial("metal");
-	m_basicMeshes->DrawPyramid4Mesh();
+	DrawLODShape(ShapeLODMeshes::LOD_PYRAMID4);
 
 
 	// set the XYZ scale for the mesh
@@ -1239,6 +2994,6 @@ void SceneManager::RenderKnife()
 	SetShaderMaterial("glass");
 
 	// draw the mesh with transformation values - this plane is used for the base
-	m_basicMeshes->DrawCylinderMesh(true, true, false);
+	DrawLODShape(ShapeLODMeshes::LOD_CYLINDER, true, true, false);
 	/******************************************************************/
 }
\ No newline at end of file
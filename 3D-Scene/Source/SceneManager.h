@@ -1,11 +1,27 @@
 #pragma once
 
 #include "ShaderManager.h"
-#include "ShapeMeshes.h"
+#include "ShapeLODMeshes.h"
+#include "StaticBatch.h"
+#include "GPUCulling.h"
+#include "HiZPyramid.h"
+#include "DeferredShading.h"
+#include "SceneFile.h"
+#include "MaterialLibrary.h"
+#include "JobSystem.h"
+#include "FrameArena.h"
+#include "FrameCache.h"
+#include "DrawConstantRing.h"
+#include "SamplerManager.h"
+#include "ImageProcessor.h"
+#include "TextureCache.h"
 
+#include <chrono>
 #include <string>
 #include <vector>
 
+class ViewManager;
+
 /***********************************************************
  *  SceneManager
  *
@@ -25,6 +41,10 @@ public:
 	{
 		std::string tag;
 		uint32_t ID;
+		SamplerManager::SAMPLER_TYPE sampler;
+		// texture unit the texture is bound to, shared by the tags
+		// with the same texture and sampler
+		int slot;
 	};
 
 	// properties for object materials
@@ -41,26 +61,116 @@ public:
 private:
 	// pointer to shader manager object
 	ShaderManager* m_pShaderManager;
-	// pointer to basic shapes object
-	ShapeMeshes* m_basicMeshes;
-	// total number of loaded textures
+	// pointer to the basic shapes, with the curved shapes generated
+	// at several detail levels
+	ShapeLODMeshes* m_lodMeshes;
+	// pointer to the merged static geometry of the scene
+	StaticBatch* m_staticBatch;
+	// pointer to shader manager object for the static batch shaders
+	ShaderManager* m_pBatchShaderManager;
+	// true while the draws are recorded into the static batch
+	bool m_bRecordingStaticBatch;
+	// true when the static batch is drawn instead of each object
+	bool m_bUseStaticBatch;
+	// pointer to the compute pass culling the static batch
+	GPUCulling* m_gpuCulling;
+	// true when the static batch is culled before it is drawn
+	bool m_bUseGPUCulling;
+	// pointer to the depth pyramid the draws are tested against,
+	// built from the depth buffer of the frame cache
+	HiZPyramid* m_pHiZPyramid;
+	FrameCache* m_pFrameCache;
+	// pointer to shader manager object for the depth-only pass
+	// drawing the occluders of the static batch
+	ShaderManager* m_pDepthShaderManager;
+	// true when the hidden draws are culled as well
+	bool m_bUseOcclusionCulling;
+	// pointer to the G-buffer and light pass of deferred shading,
+	// and true when the static batch is drawn with it
+	DeferredShading* m_pDeferredShading;
+	bool m_bDeferred;
+	// print the culling results every few seconds
+	bool m_bReportStats;
+	std::chrono::steady_clock::time_point m_lastReportTime;
+	// true when the meshes are uploaded in the packed layout
+	bool m_bPackVertices;
+	// true when the mesh indices and vertices are reordered
+	bool m_bOptimizeMeshes;
+	// file the beer bottle mesh is imported from, and its id
+	std::string m_bottleMeshPath;
+	int m_bottleMeshID;
+	// pointer to the binary scene file replacing the scene code
+	SceneFile* m_sceneFile;
+	std::string m_sceneFilePath;
+	// imported mesh id and texture slot of each scene file record
+	std::vector<int> m_sceneMeshIDs;
+	std::vector<int> m_sceneTextureSlots;
+	// pointer to the material library reloaded while running
+	MaterialLibrary* m_materialLibrary;
+	std::string m_materialLibraryPath;
+	// color, texture and material of the mesh that is drawn next
+	StaticBatch::DRAW_DATA m_drawData;
+	// names of the scene objects, the object ID of each one is
+	// its index plus one
+	std::vector<std::string> m_objectNames;
+	// pointer to the streamed per-draw values of the forward shaders
+	DrawConstantRing* m_drawConstants;
+	// pointer to view manager object, used for the detail selection
+	ViewManager* m_pViewManager;
+	// model matrix of the mesh that is drawn next
+	glm::mat4 m_modelMatrix;
+	// detail level chosen for each curved draw in the last frame
+	std::vector<int> m_lodLevels;
+	// index of the next curved draw within the current frame
+	int m_lodDrawIndex;
+	// total number of texture slots in use
 	int m_loadedTextures;
-	// loaded textures info
-	TEXTURE_INFO m_textureIDs[16];
+	// loaded textures info, one for each tag
+	std::vector<TEXTURE_INFO> m_textureIDs;
+	// texture and sampler bound to each slot in use
+	struct TEXTURE_SLOT
+	{
+		uint32_t ID;
+		SamplerManager::SAMPLER_TYPE sampler;
+	};
+	TEXTURE_SLOT m_textureSlots[16];
+	// pointer to the cache sharing the textures of the same image
+	TextureCache* m_pTextureCache;
+	// pointer to the samplers the loaded textures are filtered with
+	SamplerManager* m_pSamplers;
+	// how the texture images are converted before uploading
+	ImageProcessor::PROCESS_OPTIONS m_imageOptions;
 	// defined object materials
 	std::vector<OBJECT_MATERIAL> m_objectMaterials;
+	// pointer to the worker threads preparing the draws of a frame
+	JobSystem* m_jobSystem;
+	// memory of the frame for each job thread, in the order of
+	// the thread indices of the job system
+	std::vector<FrameArena*> m_frameArenas;
+
+	// a scene file node prepared for drawing by the job system
+	struct SCENE_DRAW
+	{
+		// model matrix with the packed position decode applied
+		glm::mat4 model;
+		int level;
+	};
+
+	// get the frame memory of the calling job thread
+	FrameArena& GetThreadArena();
 
 	// load texture images and convert to OpenGL texture data
-	bool CreateGLTexture(const char* filename, std::string tag);
+	bool CreateGLTexture(const char* filename, std::string tag, SamplerManager::SAMPLER_TYPE sampler = SamplerManager::SAMPLER_REPEAT);
 	// bind loaded OpenGL textures to slots in memory
 	void BindGLTextures();
 	// free the loaded OpenGL textures
 	void DestroyGLTextures();
 	// find a loaded texture by tag
-	int FindTextureID(std::string tag);
-	int FindTextureSlot(std::string tag);
+	int FindTextureID(const char* tag);
+	int FindTextureSlot(const char* tag);
 	// find a defined material by tag
-	bool FindMaterial(std::string tag, OBJECT_MATERIAL& material);
+	bool FindMaterial(const char* tag, OBJECT_MATERIAL& material);
+	int FindMaterialIndex(const char* tag);
 
 	// set the transformation values 
 	// into the transform buffer
@@ -80,7 +190,7 @@ private:
 
 	// set the texture data into the shader
 	void SetShaderTexture(
-		std::string textureTag);
+		const char* textureTag);
 
 	// set the UV scale for the texture mapping
 	void SetTextureUVScale(
@@ -88,12 +198,121 @@ private:
 
 	// set the object material into the shader
 	void SetShaderMaterial(
-		std::string materialTag);
+		const char* materialTag);
+	// set a loaded texture slot and a defined material by index
+	void SetShaderTextureSlot(int textureSlot);
+	void SetShaderMaterialIndex(int materialIndex);
+	// write the values of the next draw into the draw constants
+	void SubmitDrawConstants(const glm::mat4& model);
+	// set the scene object the next draws belong to
+	void SetSceneObject(const char* objectName);
+
+	// choose the detail level of a curved shape from its size on screen
+	int SelectLODLevel(ShapeLODMeshes::LOD_SHAPE shape, const glm::mat4& model, int previousLevel) const;
+	// draw a shape at the detail level chosen for it
+	void DrawLODShape(
+		ShapeLODMeshes::LOD_SHAPE shape,
+		bool bDrawTop = true,
+		bool bDrawBottom = true,
+		bool bDrawSides = true);
+	// draw a mesh imported from a file
+	void DrawImportedMesh(int meshID);
+
+	// get the light sources of the scene and the ambient color
+	// each of them adds
+	void GetSceneLights(std::vector<SceneFile::SCENE_LIGHT>& lights, glm::vec3& globalAmbientColor);
+	// set the light sources into the passed in shader program
+	void ApplySceneLights(ShaderManager* pShaderManager);
+	// record the static draws and merge them into the static batch
+	void BuildStaticBatch();
+	// draw the whole static batch with the batch shaders
+	void RenderStaticBatch();
+	// draw the static batch once for every view, culled for all
+	// of them by one cull
+	void RenderStaticBatchViews();
+	// draw the static batch for both eyes of the stereo view in
+	// a single submission
+	void RenderStaticBatchStereo();
+	// draw the occluders into the depth buffer and build the
+	// depth pyramid from it, false when there is no pyramid
+	bool RenderOccluderDepth();
+	// print the results of the last cull when a report is due
+	void ReportCullStats();
+	// submit the static batch, culled or whole
+	void DrawStaticBatch(bool bCulled);
+	// draw the static batch through the G-buffer and the light
+	// pass, false when deferred shading cannot be used
+	bool RenderDeferredBatch(bool bCulled);
+
+	// map the scene file, start its imports and add its materials
+	void LoadSceneFile();
+	// load the textures the scene file refers to
+	void LoadSceneFileTextures();
+	// draw every node of the scene file
+	void RenderSceneFile();
+	// record every node of the scene file into the static batch
+	void RecordSceneFile();
+	// cull the scene file nodes and choose their detail levels and
+	// sort keys on the worker threads, the node index is kept in
+	// the low bits of the key and culled nodes sort to the end
+	void PrepareSceneFileDraws(FrameVector<SCENE_DRAW>& draws, FrameVector<uint64_t>& drawKeys);
+	// sort the prepared scene file draws on the worker threads
+	void SortSceneFileDraws(FrameVector<uint64_t>& drawKeys);
+
+	// get the batch layout of a defined material
+	StaticBatch::MATERIAL_DATA GetBatchMaterial(int materialIndex);
+	// define or update a material from the material library
+	void ApplyLibraryMaterial(const MaterialLibrary::LIBRARY_MATERIAL& libraryMaterial);
+	// apply the materials changed in the saved material library,
+	// marking the parts of the frame drawn with them
+	void UpdateMaterialLibrary(FrameCache* pFrameCache);
 
 public:
 
+	// set the view manager used for the level-of-detail selection
+	void SetViewManager(ViewManager* pViewManager);
+	// choose between the static batch and drawing each object
+	void SetStaticBatching(bool bUseStaticBatch);
+	// turn the GPU culling of the static batch on or off
+	void SetGPUCulling(bool bUseGPUCulling);
+	// set the frame cache the scene is drawn into
+	void SetFrameCache(FrameCache* pFrameCache);
+	// set the depth pyramid built from the frame cache depth
+	void SetHiZPyramid(HiZPyramid* pHiZPyramid);
+	// set the G-buffer and light pass of deferred shading
+	void SetDeferredShading(DeferredShading* pDeferredShading);
+	// choose between forward and deferred shading
+	void SetDeferred(bool bDeferred);
+	bool IsDeferred() const { return m_bDeferred; }
+	// turn the culling of the hidden draws on or off
+	void SetOcclusionCulling(bool bUseOcclusionCulling);
+	// print the culling results every few seconds
+	void SetReportStats(bool bReportStats);
+	// choose between the packed and the float vertex layout
+	void SetVertexPacking(bool bPackVertices);
+	// turn the reordering of the mesh indices on or off
+	void SetMeshOptimization(bool bOptimizeMeshes);
+	// pick the filtering quality of the textures
+	void SetTextureQuality(SamplerManager::TEXTURE_QUALITY quality);
+	// set the largest texture side and the filter the larger
+	// images are scaled down with
+	void SetMaxTextureSize(int maxSize);
+	void SetTextureResizeFilter(ImageProcessor::RESIZE_FILTER filter);
+	// import the beer bottle from a mesh file
+	void SetBottleMeshPath(const char* filePath);
+	// draw the scene of a binary scene file instead of the code
+	void SetSceneFilePath(const char* filePath);
+	// read the materials from another material library file
+	void SetMaterialLibraryPath(const char* filePath);
+	// get the name of the scene object with an object ID, empty
+	// for no object
+	std::string GetSceneObjectName(GLuint objectID) const;
+
 	// prepare the 3D scene for rendering
 	void PrepareScene();
+	// apply the changes to the scene since the last frame and
+	// mark the parts of the frame they touch
+	void UpdateScene(FrameCache* pFrameCache);
 	// render the objects in the 3D scene
 	void RenderScene();
 
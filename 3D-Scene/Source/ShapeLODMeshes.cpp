@@ -0,0 +1,1009 @@
+///////////////////////////////////////////////////////////////////////////////
+// shapelodmeshes.cpp
+// ============
+// generate the basic shapes into one shared buffer, with the curved shapes
+// at several tessellation levels so the level-of-detail can be chosen from
+// the projected size on screen
+///////////////////////////////////////////////////////////////////////////////
+
+#include "ShapeLODMeshes.h"
+#include "MeshImporter.h"
+#include "GLStateCache.h"
+
+#include <glm/gtc/packing.hpp>
+#include <glm/gtx/transform.hpp>
+
+#include <cfloat>
+#include <cmath>
+#include <cstddef>
+#include <iostream>
+#include <string>
+
+// declaration of the global variables and defines
+namespace
+{
+	const float PI = 3.14159265358979f;
+
+	// tessellation used for each level, level 0 matches the
+	// detail of the single mesh generated by ShapeMeshes
+	const int g_SphereSlices[ShapeLODMeshes::LOD_LEVELS] = { 64, 32, 16, 8 };
+	const int g_SphereStacks[ShapeLODMeshes::LOD_LEVELS] = { 32, 16, 8, 4 };
+	const int g_CylinderSlices[ShapeLODMeshes::LOD_LEVELS] = { 64, 32, 16, 8 };
+	const int g_TorusMainSegments[ShapeLODMeshes::LOD_LEVELS] = { 64, 32, 16, 8 };
+	const int g_TorusTubeSegments[ShapeLODMeshes::LOD_LEVELS] = { 24, 12, 8, 4 };
+
+	// how much worse than the cache order the overdraw order
+	// is allowed to make the vertex cache misses
+	const float g_OverdrawThreshold = 1.05f;
+
+	// radius of the tapered cylinder top, the bottom radius is 1
+	const float g_TaperedTopRadius = 0.5f;
+	// torus dimensions, the ring lies in the XY plane
+	const float g_TorusMainRadius = 1.0f;
+	const float g_TorusTubeRadius = 0.1f;
+}
+
+/***********************************************************
+ *  ShapeLODMeshes()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+ShapeLODMeshes::ShapeLODMeshes()
+{
+	m_vao = 0;
+	m_vbos[0] = 0;
+	m_vbos[1] = 0;
+	m_trianglesDrawn = 0;
+	m_bPackedVertices = false;
+	m_bOptimizeMeshes = false;
+	MeshOptimizer::CACHE_STATISTICS emptyStatistics = { 0, 0, 0, 0.0f, 0.0f };
+	m_cacheStatisticsBefore = emptyStatistics;
+	m_cacheStatisticsAfter = emptyStatistics;
+	for (int shape = 0; shape < LOD_SHAPE_COUNT; shape++)
+	{
+		for (int level = 0; level < LOD_LEVELS; level++)
+		{
+			m_meshRanges[shape][level] = MESH_RANGE();
+		}
+	}
+}
+
+/***********************************************************
+ *  ~ShapeLODMeshes()
+ *
+ *  The destructor for the class
+ ***********************************************************/
+ShapeLODMeshes::~ShapeLODMeshes()
+{
+	DestroyMeshes();
+}
+
+/***********************************************************
+ *  LoadMeshes()
+ *
+ *  This method is used for generating every shape at every
+ *  tessellation level and uploading all of them into one
+ *  shared vertex buffer and one shared index buffer. Packed
+ *  vertices take 16 bytes instead of the 32 of the floats.
+ ***********************************************************/
+void ShapeLODMeshes::LoadMeshes(bool bPackVertices, bool bOptimizeMeshes)
+{
+	std::vector<MESH_VERTEX>& vertices = m_vertices;
+	std::vector<GLuint>& indices = m_indices;
+
+	vertices.clear();
+	indices.clear();
+
+	m_bOptimizeMeshes = bOptimizeMeshes;
+	MeshOptimizer::CACHE_STATISTICS emptyStatistics = { 0, 0, 0, 0.0f, 0.0f };
+	m_cacheStatisticsBefore = emptyStatistics;
+	m_cacheStatisticsAfter = emptyStatistics;
+
+	for (int level = 0; level < LOD_LEVELS; level++)
+	{
+		MESH_DATA sphere;
+		GenerateSphere(g_SphereSlices[level], g_SphereStacks[level], false, sphere);
+		m_meshRanges[LOD_SPHERE][level] = AppendMesh(sphere, vertices, indices);
+
+		MESH_DATA halfSphere;
+		GenerateSphere(g_SphereSlices[level], g_SphereStacks[level] / 2, true, halfSphere);
+		m_meshRanges[LOD_HALF_SPHERE][level] = AppendMesh(halfSphere, vertices, indices);
+
+		MESH_DATA cylinder;
+		GenerateCylinder(g_CylinderSlices[level], 1.0f, cylinder);
+		m_meshRanges[LOD_CYLINDER][level] = AppendMesh(cylinder, vertices, indices);
+
+		MESH_DATA taperedCylinder;
+		GenerateCylinder(g_CylinderSlices[level], g_TaperedTopRadius, taperedCylinder);
+		m_meshRanges[LOD_TAPERED_CYLINDER][level] = AppendMesh(taperedCylinder, vertices, indices);
+
+		MESH_DATA torus;
+		GenerateTorus(g_TorusMainSegments[level], g_TorusTubeSegments[level], torus);
+		m_meshRanges[LOD_TORUS][level] = AppendMesh(torus, vertices, indices);
+	}
+
+	// the flat shapes are the same at every level
+	MESH_DATA box;
+	GenerateBox(box);
+	m_meshRanges[LOD_BOX][0] = AppendMesh(box, vertices, indices);
+
+	MESH_DATA plane;
+	GeneratePlane(plane);
+	m_meshRanges[LOD_PLANE][0] = AppendMesh(plane, vertices, indices);
+
+	MESH_DATA pyramid;
+	GeneratePyramid4(pyramid);
+	m_meshRanges[LOD_PYRAMID4][0] = AppendMesh(pyramid, vertices, indices);
+
+	for (int level = 1; level < LOD_LEVELS; level++)
+	{
+		m_meshRanges[LOD_BOX][level] = m_meshRanges[LOD_BOX][0];
+		m_meshRanges[LOD_PLANE][level] = m_meshRanges[LOD_PLANE][0];
+		m_meshRanges[LOD_PYRAMID4][level] = m_meshRanges[LOD_PYRAMID4][0];
+	}
+
+	// the imported meshes were parsed while the shapes were
+	// generated, only the ones that failed are left out
+	for (size_t i = 0; i < m_importedMeshes.size(); i++)
+	{
+		IMPORTED_MESH& imported = *m_importedMeshes[i];
+		if (imported.import.valid())
+		{
+			imported.bLoaded = imported.import.get();
+		}
+		if (imported.bLoaded)
+		{
+			imported.range = AppendMesh(imported.mesh, vertices, indices);
+			imported.mesh = MESH_DATA();
+		}
+	}
+
+	glGenVertexArrays(1, &m_vao);
+	GLStateCache::BindVertexArray(m_vao);
+
+	// create the shared vertex and index buffers
+	glGenBuffers(2, m_vbos);
+	glBindBuffer(GL_ARRAY_BUFFER, m_vbos[0]);
+	m_bPackedVertices = bPackVertices;
+	size_t vertexBytes = 0;
+	if (m_bPackedVertices)
+	{
+		// each mesh is packed inside its own bounding box
+		std::vector<PACKED_VERTEX> packedVertices(vertices.size());
+		for (int shape = 0; shape < LOD_SHAPE_COUNT; shape++)
+		{
+			for (int level = 0; level < LOD_LEVELS; level++)
+			{
+				const MESH_RANGE& range = m_meshRanges[shape][level];
+				PackVertices(
+					&vertices[range.baseVertex],
+					(int)range.vertexCount,
+					range.boundsMin,
+					range.boundsExtent,
+					&packedVertices[range.baseVertex]);
+			}
+		}
+		for (size_t i = 0; i < m_importedMeshes.size(); i++)
+		{
+			const MESH_RANGE& range = m_importedMeshes[i]->range;
+			if (m_importedMeshes[i]->bLoaded)
+			{
+				PackVertices(
+					&vertices[range.baseVertex],
+					(int)range.vertexCount,
+					range.boundsMin,
+					range.boundsExtent,
+					&packedVertices[range.baseVertex]);
+			}
+		}
+		vertexBytes = packedVertices.size() * sizeof(PACKED_VERTEX);
+		glBufferData(GL_ARRAY_BUFFER, vertexBytes, packedVertices.data(), GL_STATIC_DRAW);
+	}
+	else
+	{
+		vertexBytes = vertices.size() * sizeof(MESH_VERTEX);
+		glBufferData(GL_ARRAY_BUFFER, vertexBytes, vertices.data(), GL_STATIC_DRAW);
+	}
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_vbos[1]);
+	glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(GLuint), indices.data(), GL_STATIC_DRAW);
+
+	SetVertexAttributes(m_bPackedVertices);
+
+	GLStateCache::BindVertexArray(0);
+
+	std::cout << "Generated LOD meshes: " << vertices.size() << " vertices ("
+		<< vertexBytes / 1024 << " KB), " << indices.size() / 3 << " triangles in "
+		<< LOD_LEVELS << " levels" << std::endl;
+	if (m_bOptimizeMeshes)
+	{
+		std::cout << "Optimized LOD meshes: ACMR " << m_cacheStatisticsBefore.acmr
+			<< " -> " << m_cacheStatisticsAfter.acmr << ", ATVR " << m_cacheStatisticsBefore.atvr
+			<< " -> " << m_cacheStatisticsAfter.atvr << std::endl;
+	}
+}
+
+/***********************************************************
+ *  DestroyMeshes()
+ *
+ *  This method is used for freeing the shared OpenGL buffers.
+ ***********************************************************/
+void ShapeLODMeshes::DestroyMeshes()
+{
+	if (m_vao != 0)
+	{
+		glDeleteBuffers(2, m_vbos);
+		GLStateCache::BindVertexArray(0);
+		glDeleteVertexArrays(1, &m_vao);
+		m_vao = 0;
+		m_vbos[0] = 0;
+		m_vbos[1] = 0;
+	}
+}
+
+/***********************************************************
+ *  DrawLODMesh()
+ *
+ *  This method is used for drawing one shape at the passed
+ *  in tessellation level. The top and bottom flags are used
+ *  for the capped shapes, everything else is in the sides.
+ ***********************************************************/
+void ShapeLODMeshes::DrawLODMesh(
+	LOD_SHAPE shape,
+	int level,
+	bool bDrawTop,
+	bool bDrawBottom,
+	bool bDrawSides)
+{
+	if ((m_vao == 0) || (shape < 0) || (shape >= LOD_SHAPE_COUNT))
+	{
+		return;
+	}
+
+	level = glm::clamp(level, 0, LOD_LEVELS - 1);
+	DrawRange(m_meshRanges[shape][level], bDrawTop, bDrawBottom, bDrawSides);
+}
+
+/***********************************************************
+ *  ImportMesh()
+ *
+ *  This method is used for starting the import of a mesh
+ *  file on a worker thread. It has to be called before the
+ *  meshes are loaded, which waits for the import and adds
+ *  the mesh to the shared buffers.
+ ***********************************************************/
+int ShapeLODMeshes::ImportMesh(const char* filePath)
+{
+	std::unique_ptr<IMPORTED_MESH> imported(new IMPORTED_MESH());
+	imported->range = MESH_RANGE();
+	imported->bLoaded = false;
+
+	std::string path = filePath;
+	MESH_DATA* pMesh = &imported->mesh;
+	imported->import = std::async(std::launch::async, [path, pMesh]()
+		{
+			return(MeshImporter::ImportMesh(path.c_str(), *pMesh));
+		});
+
+	m_importedMeshes.push_back(std::move(imported));
+
+	return((int)m_importedMeshes.size() - 1);
+}
+
+/***********************************************************
+ *  IsImportedMeshLoaded()
+ *
+ *  This method is used for checking that an imported mesh
+ *  was read and added to the shared buffers.
+ ***********************************************************/
+bool ShapeLODMeshes::IsImportedMeshLoaded(int meshID) const
+{
+	return((m_vao != 0) && (meshID >= 0) && (meshID < (int)m_importedMeshes.size()) &&
+		m_importedMeshes[meshID]->bLoaded);
+}
+
+/***********************************************************
+ *  GetImportedMeshRange()
+ *
+ *  This method is used for getting where an imported mesh
+ *  lives in the shared buffers.
+ ***********************************************************/
+const ShapeLODMeshes::MESH_RANGE& ShapeLODMeshes::GetImportedMeshRange(int meshID) const
+{
+	return(m_importedMeshes[meshID]->range);
+}
+
+/***********************************************************
+ *  DrawImportedMesh()
+ *
+ *  This method is used for drawing an imported mesh.
+ ***********************************************************/
+void ShapeLODMeshes::DrawImportedMesh(int meshID)
+{
+	if (!IsImportedMeshLoaded(meshID))
+	{
+		return;
+	}
+
+	DrawRange(m_importedMeshes[meshID]->range, false, false, true);
+}
+
+/***********************************************************
+ *  DrawRange()
+ *
+ *  This method is used for drawing the chosen parts of one
+ *  range of the shared buffers.
+ ***********************************************************/
+void ShapeLODMeshes::DrawRange(const MESH_RANGE& range, bool bDrawTop, bool bDrawBottom, bool bDrawSides)
+{
+	// the vertex array stays bound for the next draw of a range
+	GLStateCache::BindVertexArray(m_vao);
+
+	const MESH_PART* parts[3] = { NULL, NULL, NULL };
+	if (bDrawSides)
+		parts[0] = &range.sides;
+	if (bDrawTop)
+		parts[1] = &range.top;
+	if (bDrawBottom)
+		parts[2] = &range.bottom;
+
+	for (int i = 0; i < 3; i++)
+	{
+		if ((parts[i] != NULL) && (parts[i]->indexCount > 0))
+		{
+			glDrawElementsBaseVertex(
+				GL_TRIANGLES,
+				parts[i]->indexCount,
+				GL_UNSIGNED_INT,
+				(void*)(parts[i]->firstIndex * sizeof(GLuint)),
+				range.baseVertex);
+			m_trianglesDrawn += parts[i]->indexCount / 3;
+		}
+	}
+}
+
+/***********************************************************
+ *  GetBoundingSphere()
+ *
+ *  This method is used for getting the object space bounding
+ *  sphere of a shape, which is the same for every level.
+ ***********************************************************/
+void ShapeLODMeshes::GetBoundingSphere(LOD_SHAPE shape, glm::vec3& center, float& radius) const
+{
+	switch (shape)
+	{
+	case LOD_CYLINDER:
+	case LOD_TAPERED_CYLINDER:
+		// unit radius with the height going from 0 to 1
+		center = glm::vec3(0.0f, 0.5f, 0.0f);
+		radius = std::sqrt(1.25f);
+		break;
+	case LOD_TORUS:
+		center = glm::vec3(0.0f);
+		radius = g_TorusMainRadius + g_TorusTubeRadius;
+		break;
+	case LOD_BOX:
+	case LOD_PYRAMID4:
+		// unit size around the origin
+		center = glm::vec3(0.0f);
+		radius = std::sqrt(0.75f);
+		break;
+	case LOD_PLANE:
+		// two units wide in X and Z
+		center = glm::vec3(0.0f);
+		radius = std::sqrt(2.0f);
+		break;
+	default:
+		center = glm::vec3(0.0f);
+		radius = 1.0f;
+		break;
+	}
+}
+
+/***********************************************************
+ *  GetTriangleCount()
+ *
+ *  This method is used for getting the number of triangles
+ *  in a shape at the passed in tessellation level.
+ ***********************************************************/
+int ShapeLODMeshes::GetTriangleCount(LOD_SHAPE shape, int level) const
+{
+	level = glm::clamp(level, 0, LOD_LEVELS - 1);
+	const MESH_RANGE& range = m_meshRanges[shape][level];
+	return((range.sides.indexCount + range.top.indexCount + range.bottom.indexCount) / 3);
+}
+
+/***********************************************************
+ *  GetMeshRange()
+ *
+ *  This method is used for getting where a shape at the
+ *  passed in level lives in the shared buffers.
+ ***********************************************************/
+const ShapeLODMeshes::MESH_RANGE& ShapeLODMeshes::GetMeshRange(LOD_SHAPE shape, int level) const
+{
+	level = glm::clamp(level, 0, LOD_LEVELS - 1);
+	return(m_meshRanges[shape][level]);
+}
+
+/***********************************************************
+ *  OptimizeMesh()
+ *
+ *  This method is used for reordering each drawable part of
+ *  a generated mesh for the vertex cache and for overdraw,
+ *  then storing the vertices in the order they are used. The
+ *  parts stay in their own index ranges so they can still be
+ *  drawn on their own.
+ ***********************************************************/
+void ShapeLODMeshes::OptimizeMesh(MESH_DATA& mesh)
+{
+	int vertexCount = (int)mesh.vertices.size();
+	MESH_PART* parts[3] = { &mesh.sides, &mesh.top, &mesh.bottom };
+
+	for (int part = 0; part < 3; part++)
+	{
+		if (parts[part]->indexCount == 0)
+		{
+			continue;
+		}
+
+		GLuint* partIndices = &mesh.indices[parts[part]->firstIndex];
+		int indexCount = (int)parts[part]->indexCount;
+
+		MeshOptimizer::AccumulateStatistics(
+			m_cacheStatisticsBefore,
+			MeshOptimizer::AnalyzeVertexCache(partIndices, indexCount, vertexCount));
+
+		MeshOptimizer::OptimizeVertexCache(partIndices, indexCount, vertexCount);
+		MeshOptimizer::OptimizeOverdraw(
+			partIndices,
+			indexCount,
+			&mesh.vertices[0].position,
+			sizeof(MESH_VERTEX),
+			vertexCount,
+			g_OverdrawThreshold);
+
+		MeshOptimizer::AccumulateStatistics(
+			m_cacheStatisticsAfter,
+			MeshOptimizer::AnalyzeVertexCache(partIndices, indexCount, vertexCount));
+	}
+
+	std::vector<GLuint> remap;
+	MeshOptimizer::OptimizeVertexFetch(mesh.indices, vertexCount, remap);
+	MeshOptimizer::RemapVertices(mesh.vertices, remap);
+}
+
+/***********************************************************
+ *  AppendMesh()
+ *
+ *  This method is used for appending a generated mesh to the
+ *  shared vertex and index arrays and recording where it is.
+ ***********************************************************/
+ShapeLODMeshes::MESH_RANGE ShapeLODMeshes::AppendMesh(
+	MESH_DATA& mesh,
+	std::vector<MESH_VERTEX>& vertices,
+	std::vector<GLuint>& indices)
+{
+	if (m_bOptimizeMeshes)
+	{
+		OptimizeMesh(mesh);
+	}
+
+	MESH_RANGE range;
+	GLuint firstIndex = (GLuint)indices.size();
+
+	range.baseVertex = (GLint)vertices.size();
+	range.vertexCount = (GLuint)mesh.vertices.size();
+	range.sides.firstIndex = firstIndex + mesh.sides.firstIndex;
+	range.sides.indexCount = mesh.sides.indexCount;
+	range.top.firstIndex = firstIndex + mesh.top.firstIndex;
+	range.top.indexCount = mesh.top.indexCount;
+	range.bottom.firstIndex = firstIndex + mesh.bottom.firstIndex;
+	range.bottom.indexCount = mesh.bottom.indexCount;
+
+	// the indices stay relative to the mesh, the base vertex
+	// is applied when the mesh is drawn
+	vertices.insert(vertices.end(), mesh.vertices.begin(), mesh.vertices.end());
+	indices.insert(indices.end(), mesh.indices.begin(), mesh.indices.end());
+
+	glm::vec3 boundsMax = glm::vec3(-FLT_MAX);
+	range.boundsMin = glm::vec3(FLT_MAX);
+	for (size_t i = 0; i < mesh.vertices.size(); i++)
+	{
+		range.boundsMin = glm::min(range.boundsMin, mesh.vertices[i].position);
+		boundsMax = glm::max(boundsMax, mesh.vertices[i].position);
+	}
+	range.boundsExtent = boundsMax - range.boundsMin;
+
+	return(range);
+}
+
+/***********************************************************
+ *  GetPositionDecodeMatrix()
+ *
+ *  This method is used for getting the matrix that scales
+ *  and moves the packed unit positions of a shape back into
+ *  object space, so it can be folded into the model matrix.
+ ***********************************************************/
+glm::mat4 ShapeLODMeshes::GetPositionDecodeMatrix(LOD_SHAPE shape, int level) const
+{
+	if (!m_bPackedVertices)
+	{
+		return(glm::mat4(1.0f));
+	}
+
+	return(GetPositionDecodeMatrix(m_meshRanges[shape][level]));
+}
+
+/***********************************************************
+ *  GetPositionDecodeMatrix()
+ *
+ *  This method is used for getting the decode matrix of any
+ *  range of the shared buffers, such as an imported mesh.
+ ***********************************************************/
+glm::mat4 ShapeLODMeshes::GetPositionDecodeMatrix(const MESH_RANGE& range) const
+{
+	if (!m_bPackedVertices)
+	{
+		return(glm::mat4(1.0f));
+	}
+
+	return(glm::translate(range.boundsMin) * glm::scale(range.boundsExtent));
+}
+
+/***********************************************************
+ *  PackVertices()
+ *
+ *  This method is used for packing vertices into the compact
+ *  layout. The normals are folded onto an octahedron so two
+ *  values hold the whole direction.
+ ***********************************************************/
+void ShapeLODMeshes::PackVertices(
+	const MESH_VERTEX* vertices,
+	int vertexCount,
+	const glm::vec3& boundsMin,
+	const glm::vec3& boundsExtent,
+	PACKED_VERTEX* packedVertices)
+{
+	// a flat box axis has no extent and packs to zero
+	glm::vec3 inverseExtent;
+	for (int axis = 0; axis < 3; axis++)
+	{
+		inverseExtent[axis] = (boundsExtent[axis] > 0.0f) ? (1.0f / boundsExtent[axis]) : 0.0f;
+	}
+
+	for (int i = 0; i < vertexCount; i++)
+	{
+		PACKED_VERTEX& packed = packedVertices[i];
+
+		glm::vec3 unitPosition = (vertices[i].position - boundsMin) * inverseExtent;
+		for (int axis = 0; axis < 3; axis++)
+		{
+			packed.position[axis] = glm::packUnorm1x16(unitPosition[axis]);
+		}
+		packed.padding = 0;
+
+		glm::vec3 normal = vertices[i].normal;
+		float normalSum = fabs(normal.x) + fabs(normal.y) + fabs(normal.z);
+		normal /= normalSum;
+		glm::vec2 octahedral = glm::vec2(normal.x, normal.y);
+		if (normal.z < 0.0f)
+		{
+			// fold the lower half over the diagonals
+			octahedral.x = (1.0f - fabs(normal.y)) * ((normal.x >= 0.0f) ? 1.0f : -1.0f);
+			octahedral.y = (1.0f - fabs(normal.x)) * ((normal.y >= 0.0f) ? 1.0f : -1.0f);
+		}
+		packed.normal = glm::packSnorm2x16(octahedral);
+
+		packed.textureCoordinate = glm::packHalf2x16(vertices[i].textureCoordinate);
+	}
+}
+
+/***********************************************************
+ *  SetVertexAttributes()
+ *
+ *  This method is used for describing the vertex layout of
+ *  the bound vertex buffer to the bound vertex array. The
+ *  attribute locations match the ones in the vertex shaders.
+ ***********************************************************/
+void ShapeLODMeshes::SetVertexAttributes(bool bPackedVertices)
+{
+	if (bPackedVertices)
+	{
+		GLsizei stride = sizeof(PACKED_VERTEX);
+		glVertexAttribPointer(0, 3, GL_UNSIGNED_SHORT, GL_TRUE, stride, (void*)offsetof(PACKED_VERTEX, position));
+		glVertexAttribPointer(1, 2, GL_SHORT, GL_TRUE, stride, (void*)offsetof(PACKED_VERTEX, normal));
+		glVertexAttribPointer(2, 2, GL_HALF_FLOAT, GL_FALSE, stride, (void*)offsetof(PACKED_VERTEX, textureCoordinate));
+	}
+	else
+	{
+		GLsizei stride = sizeof(MESH_VERTEX);
+		glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, stride, (void*)offsetof(MESH_VERTEX, position));
+		glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, stride, (void*)offsetof(MESH_VERTEX, normal));
+		glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, stride, (void*)offsetof(MESH_VERTEX, textureCoordinate));
+	}
+	glEnableVertexAttribArray(0);
+	glEnableVertexAttribArray(1);
+	glEnableVertexAttribArray(2);
+}
+
+/***********************************************************
+ *  GenerateSphere()
+ *
+ *  This method is used for generating a sphere of radius 1
+ *  around the origin. The half-sphere is the upper half with
+ *  a flat disk closing the bottom at y = 0.
+ ***********************************************************/
+void ShapeLODMeshes::GenerateSphere(int slices, int stacks, bool bHalf, MESH_DATA& mesh)
+{
+	float maxPhi = bHalf ? (PI / 2.0f) : PI;
+
+	mesh.sides.firstIndex = (GLuint)mesh.indices.size();
+	GLuint firstVertex = (GLuint)mesh.vertices.size();
+
+	for (int stack = 0; stack <= stacks; stack++)
+	{
+		// phi goes from the top pole downwards
+		float phi = maxPhi * (float)stack / (float)stacks;
+		float y = std::cos(phi);
+		float ringRadius = std::sin(phi);
+
+		for (int slice = 0; slice <= slices; slice++)
+		{
+			float theta = 2.0f * PI * (float)slice / (float)slices;
+
+			MESH_VERTEX vertex;
+			vertex.normal = glm::vec3(ringRadius * std::sin(theta), y, ringRadius * std::cos(theta));
+			vertex.position = vertex.normal;
+			vertex.textureCoordinate = glm::vec2(
+				(float)slice / (float)slices,
+				1.0f - (float)stack / (float)stacks);
+			mesh.vertices.push_back(vertex);
+		}
+	}
+
+	for (int stack = 0; stack < stacks; stack++)
+	{
+		for (int slice = 0; slice < slices; slice++)
+		{
+			GLuint upper = firstVertex + stack * (slices + 1) + slice;
+			GLuint lower = upper + slices + 1;
+
+			// the triangles touching the poles would be degenerate
+			if (stack != 0)
+			{
+				mesh.indices.push_back(upper);
+				mesh.indices.push_back(lower);
+				mesh.indices.push_back(upper + 1);
+			}
+			if ((bHalf == true) || (stack != stacks - 1))
+			{
+				mesh.indices.push_back(upper + 1);
+				mesh.indices.push_back(lower);
+				mesh.indices.push_back(lower + 1);
+			}
+		}
+	}
+	mesh.sides.indexCount = (GLuint)mesh.indices.size() - mesh.sides.firstIndex;
+
+	mesh.top.firstIndex = (GLuint)mesh.indices.size();
+	mesh.top.indexCount = 0;
+
+	mesh.bottom.firstIndex = (GLuint)mesh.indices.size();
+	if (bHalf)
+	{
+		GenerateDisk(slices, 1.0f, 0.0f, false, mesh);
+	}
+	mesh.bottom.indexCount = (GLuint)mesh.indices.size() - mesh.bottom.firstIndex;
+}
+
+/***********************************************************
+ *  GenerateCylinder()
+ *
+ *  This method is used for generating a cylinder with a
+ *  bottom radius of 1 at y = 0 and the passed in top radius
+ *  at y = 1. A top radius below 1 makes a tapered cylinder.
+ ***********************************************************/
+void ShapeLODMeshes::GenerateCylinder(int slices, float topRadius, MESH_DATA& mesh)
+{
+	// slope of the sides used for the side normals
+	float radiusChange = topRadius - 1.0f;
+
+	mesh.sides.firstIndex = (GLuint)mesh.indices.size();
+	GLuint firstVertex = (GLuint)mesh.vertices.size();
+
+	for (int slice = 0; slice <= slices; slice++)
+	{
+		float theta = 2.0f * PI * (float)slice / (float)slices;
+		float sinTheta = std::sin(theta);
+		float cosTheta = std::cos(theta);
+		glm::vec3 normal = glm::normalize(glm::vec3(sinTheta, -radiusChange, cosTheta));
+
+		MESH_VERTEX bottom;
+		bottom.position = glm::vec3(sinTheta, 0.0f, cosTheta);
+		bottom.normal = normal;
+		bottom.textureCoordinate = glm::vec2((float)slice / (float)slices, 0.0f);
+		mesh.vertices.push_back(bottom);
+
+		MESH_VERTEX top;
+		top.position = glm::vec3(topRadius * sinTheta, 1.0f, topRadius * cosTheta);
+		top.normal = normal;
+		top.textureCoordinate = glm::vec2((float)slice / (float)slices, 1.0f);
+		mesh.vertices.push_back(top);
+	}
+
+	for (int slice = 0; slice < slices; slice++)
+	{
+		GLuint bottom = firstVertex + slice * 2;
+		GLuint top = bottom + 1;
+
+		mesh.indices.push_back(bottom);
+		mesh.indices.push_back(bottom + 2);
+		mesh.indices.push_back(top);
+
+		mesh.indices.push_back(top);
+		mesh.indices.push_back(bottom + 2);
+		mesh.indices.push_back(top + 2);
+	}
+	mesh.sides.indexCount = (GLuint)mesh.indices.size() - mesh.sides.firstIndex;
+
+	mesh.top.firstIndex = (GLuint)mesh.indices.size();
+	GenerateDisk(slices, topRadius, 1.0f, true, mesh);
+	mesh.top.indexCount = (GLuint)mesh.indices.size() - mesh.top.firstIndex;
+
+	mesh.bottom.firstIndex = (GLuint)mesh.indices.size();
+	GenerateDisk(slices, 1.0f, 0.0f, false, mesh);
+	mesh.bottom.indexCount = (GLuint)mesh.indices.size() - mesh.bottom.firstIndex;
+}
+
+/***********************************************************
+ *  GenerateTorus()
+ *
+ *  This method is used for generating a torus lying in the
+ *  XY plane around the origin.
+ ***********************************************************/
+void ShapeLODMeshes::GenerateTorus(int mainSegments, int tubeSegments, MESH_DATA& mesh)
+{
+	mesh.sides.firstIndex = (GLuint)mesh.indices.size();
+	GLuint firstVertex = (GLuint)mesh.vertices.size();
+
+	for (int main = 0; main <= mainSegments; main++)
+	{
+		float u = 2.0f * PI * (float)main / (float)mainSegments;
+
+		for (int tube = 0; tube <= tubeSegments; tube++)
+		{
+			float v = 2.0f * PI * (float)tube / (float)tubeSegments;
+
+			MESH_VERTEX vertex;
+			vertex.normal = glm::vec3(
+				std::cos(v) * std::cos(u),
+				std::cos(v) * std::sin(u),
+				std::sin(v));
+			vertex.position = glm::vec3(
+				(g_TorusMainRadius + g_TorusTubeRadius * std::cos(v)) * std::cos(u),
+				(g_TorusMainRadius + g_TorusTubeRadius * std::cos(v)) * std::sin(u),
+				g_TorusTubeRadius * std::sin(v));
+			vertex.textureCoordinate = glm::vec2(
+				(float)main / (float)mainSegments,
+				(float)tube / (float)tubeSegments);
+			mesh.vertices.push_back(vertex);
+		}
+	}
+
+	for (int main = 0; main < mainSegments; main++)
+	{
+		for (int tube = 0; tube < tubeSegments; tube++)
+		{
+			GLuint current = firstVertex + main * (tubeSegments + 1) + tube;
+			GLuint next = current + tubeSegments + 1;
+
+			mesh.indices.push_back(current);
+			mesh.indices.push_back(next);
+			mesh.indices.push_back(current + 1);
+
+			mesh.indices.push_back(current + 1);
+			mesh.indices.push_back(next);
+			mesh.indices.push_back(next + 1);
+		}
+	}
+	mesh.sides.indexCount = (GLuint)mesh.indices.size() - mesh.sides.firstIndex;
+
+	mesh.top.firstIndex = (GLuint)mesh.indices.size();
+	mesh.top.indexCount = 0;
+	mesh.bottom.firstIndex = (GLuint)mesh.indices.size();
+	mesh.bottom.indexCount = 0;
+}
+
+/***********************************************************
+ *  GenerateDisk()
+ *
+ *  This method is used for appending a flat disk at the
+ *  passed in height, used for closing cylinders and the
+ *  half-sphere.
+ ***********************************************************/
+void ShapeLODMeshes::GenerateDisk(
+	int slices,
+	float radius,
+	float height,
+	bool bFacingUp,
+	MESH_DATA& mesh)
+{
+	GLuint center = (GLuint)mesh.vertices.size();
+	glm::vec3 normal(0.0f, bFacingUp ? 1.0f : -1.0f, 0.0f);
+
+	MESH_VERTEX centerVertex;
+	centerVertex.position = glm::vec3(0.0f, height, 0.0f);
+	centerVertex.normal = normal;
+	centerVertex.textureCoordinate = glm::vec2(0.5f, 0.5f);
+	mesh.vertices.push_back(centerVertex);
+
+	for (int slice = 0; slice <= slices; slice++)
+	{
+		float theta = 2.0f * PI * (float)slice / (float)slices;
+
+		MESH_VERTEX vertex;
+		vertex.position = glm::vec3(radius * std::sin(theta), height, radius * std::cos(theta));
+		vertex.normal = normal;
+		vertex.textureCoordinate = glm::vec2(
+			0.5f + 0.5f * std::sin(theta),
+			0.5f + 0.5f * std::cos(theta));
+		mesh.vertices.push_back(vertex);
+	}
+
+	for (int slice = 0; slice < slices; slice++)
+	{
+		GLuint current = center + 1 + slice;
+
+		// keep the front face pointing away from the shape
+		mesh.indices.push_back(center);
+		if (bFacingUp)
+		{
+			mesh.indices.push_back(current);
+			mesh.indices.push_back(current + 1);
+		}
+		else
+		{
+			mesh.indices.push_back(current + 1);
+			mesh.indices.push_back(current);
+		}
+	}
+}
+
+/***********************************************************
+ *  GenerateBox()
+ *
+ *  This method is used for generating a box of size 1 around
+ *  the origin with separate vertices for every face.
+ ***********************************************************/
+void ShapeLODMeshes::GenerateBox(MESH_DATA& mesh)
+{
+	mesh.sides.firstIndex = (GLuint)mesh.indices.size();
+
+	// right and left faces
+	GenerateQuad(glm::vec3(0.5f, -0.5f, 0.5f), glm::vec3(0.5f, -0.5f, -0.5f),
+		glm::vec3(0.5f, 0.5f, -0.5f), glm::vec3(0.5f, 0.5f, 0.5f), mesh);
+	GenerateQuad(glm::vec3(-0.5f, -0.5f, -0.5f), glm::vec3(-0.5f, -0.5f, 0.5f),
+		glm::vec3(-0.5f, 0.5f, 0.5f), glm::vec3(-0.5f, 0.5f, -0.5f), mesh);
+	// top and bottom faces
+	GenerateQuad(glm::vec3(-0.5f, 0.5f, 0.5f), glm::vec3(0.5f, 0.5f, 0.5f),
+		glm::vec3(0.5f, 0.5f, -0.5f), glm::vec3(-0.5f, 0.5f, -0.5f), mesh);
+	GenerateQuad(glm::vec3(-0.5f, -0.5f, -0.5f), glm::vec3(0.5f, -0.5f, -0.5f),
+		glm::vec3(0.5f, -0.5f, 0.5f), glm::vec3(-0.5f, -0.5f, 0.5f), mesh);
+	// front and back faces
+	GenerateQuad(glm::vec3(-0.5f, -0.5f, 0.5f), glm::vec3(0.5f, -0.5f, 0.5f),
+		glm::vec3(0.5f, 0.5f, 0.5f), glm::vec3(-0.5f, 0.5f, 0.5f), mesh);
+	GenerateQuad(glm::vec3(0.5f, -0.5f, -0.5f), glm::vec3(-0.5f, -0.5f, -0.5f),
+		glm::vec3(-0.5f, 0.5f, -0.5f), glm::vec3(0.5f, 0.5f, -0.5f), mesh);
+
+	mesh.sides.indexCount = (GLuint)mesh.indices.size() - mesh.sides.firstIndex;
+	mesh.top.firstIndex = (GLuint)mesh.indices.size();
+	mesh.top.indexCount = 0;
+	mesh.bottom.firstIndex = (GLuint)mesh.indices.size();
+	mesh.bottom.indexCount = 0;
+}
+
+/***********************************************************
+ *  GeneratePlane()
+ *
+ *  This method is used for generating a plane facing up that
+ *  goes from -1 to 1 in X and Z.
+ ***********************************************************/
+void ShapeLODMeshes::GeneratePlane(MESH_DATA& mesh)
+{
+	mesh.sides.firstIndex = (GLuint)mesh.indices.size();
+
+	GenerateQuad(glm::vec3(-1.0f, 0.0f, 1.0f), glm::vec3(1.0f, 0.0f, 1.0f),
+		glm::vec3(1.0f, 0.0f, -1.0f), glm::vec3(-1.0f, 0.0f, -1.0f), mesh);
+
+	mesh.sides.indexCount = (GLuint)mesh.indices.size() - mesh.sides.firstIndex;
+	mesh.top.firstIndex = (GLuint)mesh.indices.size();
+	mesh.top.indexCount = 0;
+	mesh.bottom.firstIndex = (GLuint)mesh.indices.size();
+	mesh.bottom.indexCount = 0;
+}
+
+/***********************************************************
+ *  GeneratePyramid4()
+ *
+ *  This method is used for generating a pyramid of size 1
+ *  around the origin with a square base.
+ ***********************************************************/
+void ShapeLODMeshes::GeneratePyramid4(MESH_DATA& mesh)
+{
+	glm::vec3 apex(0.0f, 0.5f, 0.0f);
+	glm::vec3 base[4] = {
+		glm::vec3(-0.5f, -0.5f, 0.5f),
+		glm::vec3(0.5f, -0.5f, 0.5f),
+		glm::vec3(0.5f, -0.5f, -0.5f),
+		glm::vec3(-0.5f, -0.5f, -0.5f) };
+
+	mesh.sides.firstIndex = (GLuint)mesh.indices.size();
+	for (int side = 0; side < 4; side++)
+	{
+		glm::vec3 p0 = base[side];
+		glm::vec3 p1 = base[(side + 1) % 4];
+		glm::vec3 normal = glm::normalize(glm::cross(p1 - p0, apex - p0));
+		GLuint first = (GLuint)mesh.vertices.size();
+
+		MESH_VERTEX vertex;
+		vertex.normal = normal;
+		vertex.position = p0;
+		vertex.textureCoordinate = glm::vec2(0.0f, 0.0f);
+		mesh.vertices.push_back(vertex);
+		vertex.position = p1;
+		vertex.textureCoordinate = glm::vec2(1.0f, 0.0f);
+		mesh.vertices.push_back(vertex);
+		vertex.position = apex;
+		vertex.textureCoordinate = glm::vec2(0.5f, 1.0f);
+		mesh.vertices.push_back(vertex);
+
+		mesh.indices.push_back(first);
+		mesh.indices.push_back(first + 1);
+		mesh.indices.push_back(first + 2);
+	}
+	mesh.sides.indexCount = (GLuint)mesh.indices.size() - mesh.sides.firstIndex;
+
+	mesh.top.firstIndex = (GLuint)mesh.indices.size();
+	mesh.top.indexCount = 0;
+
+	mesh.bottom.firstIndex = (GLuint)mesh.indices.size();
+	GenerateQuad(base[3], base[2], base[1], base[0], mesh);
+	mesh.bottom.indexCount = (GLuint)mesh.indices.size() - mesh.bottom.firstIndex;
+}
+
+/***********************************************************
+ *  GenerateQuad()
+ *
+ *  This method is used for appending a flat quad, the corners
+ *  are passed in counter-clockwise order seen from the front.
+ ***********************************************************/
+void ShapeLODMeshes::GenerateQuad(
+	glm::vec3 p0,
+	glm::vec3 p1,
+	glm::vec3 p2,
+	glm::vec3 p3,
+	MESH_DATA& mesh)
+{
+	GLuint first = (GLuint)mesh.vertices.size();
+	glm::vec3 corners[4] = { p0, p1, p2, p3 };
+	glm::vec2 uvs[4] = {
+		glm::vec2(0.0f, 0.0f),
+		glm::vec2(1.0f, 0.0f),
+		glm::vec2(1.0f, 1.0f),
+		glm::vec2(0.0f, 1.0f) };
+
+	MESH_VERTEX vertex;
+	vertex.normal = glm::normalize(glm::cross(p1 - p0, p2 - p0));
+	for (int i = 0; i < 4; i++)
+	{
+		vertex.position = corners[i];
+		vertex.textureCoordinate = uvs[i];
+		mesh.vertices.push_back(vertex);
+	}
+
+	mesh.indices.push_back(first);
+	mesh.indices.push_back(first + 1);
+	mesh.indices.push_back(first + 2);
+	mesh.indices.push_back(first);
+	mesh.indices.push_back(first + 2);
+	mesh.indices.push_back(first + 3);
+}
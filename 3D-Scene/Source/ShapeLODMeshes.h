@@ -0,0 +1,237 @@
+///////////////////////////////////////////////////////////////////////////////
+// shapelodmeshes.h
+// ============
+// generate the basic shapes into one shared buffer, with the curved shapes
+// at several tessellation levels so the level-of-detail can be chosen from
+// the projected size on screen
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "MeshOptimizer.h"
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+
+#include <future>
+#include <memory>
+#include <vector>
+
+/***********************************************************
+ *  ShapeLODMeshes
+ *
+ *  This class generates the sphere, half-sphere, cylinder,
+ *  tapered cylinder and torus shapes at several tessellation
+ *  levels, plus the flat box, plane and pyramid shapes, and
+ *  stores all of them in one shared vertex and index buffer.
+ *  The shapes have the same dimensions as the ones drawn by
+ *  ShapeMeshes so they can replace them. Meshes imported
+ *  from files are parsed on worker threads while the shapes
+ *  are generated and join the same shared buffers.
+ ***********************************************************/
+class ShapeLODMeshes
+{
+public:
+	// constructor
+	ShapeLODMeshes();
+	// destructor
+	~ShapeLODMeshes();
+
+	// number of tessellation levels generated for each shape,
+	// level 0 is the most detailed one
+	static const int LOD_LEVELS = 4;
+
+	// the shapes that are generated at several tessellation levels
+	enum LOD_SHAPE
+	{
+		LOD_SPHERE = 0,
+		LOD_HALF_SPHERE,
+		LOD_CYLINDER,
+		LOD_TAPERED_CYLINDER,
+		LOD_TORUS,
+		// the flat shapes only have one level, every level
+		// refers to the same mesh
+		LOD_BOX,
+		LOD_PLANE,
+		LOD_PYRAMID4,
+		LOD_SHAPE_COUNT
+	};
+
+	// interleaved vertex layout matching the vertex shader inputs
+	struct MESH_VERTEX
+	{
+		glm::vec3 position;
+		glm::vec3 normal;
+		glm::vec2 textureCoordinate;
+	};
+
+	// packed vertex layout of 16 bytes uploaded to the GPU - the
+	// position is unorm16 inside the bounding box of its mesh,
+	// the normal is octahedral encoded into two snorm16 values
+	// and the texture coordinate is two half floats
+	struct PACKED_VERTEX
+	{
+		GLushort position[3];
+		GLushort padding;
+		GLuint normal;
+		GLuint textureCoordinate;
+	};
+
+	// range of indices for one drawable part of a mesh
+	struct MESH_PART
+	{
+		GLuint firstIndex;
+		GLuint indexCount;
+	};
+
+	// CPU-side mesh data produced by the shape generators, the
+	// part index ranges are relative to the start of the mesh
+	struct MESH_DATA
+	{
+		std::vector<MESH_VERTEX> vertices;
+		std::vector<GLuint> indices;
+		MESH_PART sides;
+		MESH_PART top;
+		MESH_PART bottom;
+	};
+
+	// location of one generated mesh inside the shared buffers
+	struct MESH_RANGE
+	{
+		GLint baseVertex;
+		GLuint vertexCount;
+		MESH_PART sides;
+		MESH_PART top;
+		MESH_PART bottom;
+		// bounding box the packed positions are stored inside
+		glm::vec3 boundsMin;
+		glm::vec3 boundsExtent;
+	};
+
+	// generate all the shapes at every level and upload them,
+	// packed into the compact vertex layout and with the index
+	// and vertex order optimized when requested
+	void LoadMeshes(bool bPackVertices = true, bool bOptimizeMeshes = true);
+	// free the shared OpenGL buffers
+	void DestroyMeshes();
+
+	// start importing a mesh file in the background, it joins
+	// the shared buffers in LoadMeshes, returns the mesh id
+	int ImportMesh(const char* filePath);
+	// true when the imported mesh was read and uploaded
+	bool IsImportedMeshLoaded(int meshID) const;
+	// get where an imported mesh lives in the shared buffers
+	const MESH_RANGE& GetImportedMeshRange(int meshID) const;
+	// draw every triangle of an imported mesh
+	void DrawImportedMesh(int meshID);
+
+	// draw one shape at the passed in tessellation level
+	void DrawLODMesh(
+		LOD_SHAPE shape,
+		int level,
+		bool bDrawTop = true,
+		bool bDrawBottom = true,
+		bool bDrawSides = true);
+
+	// get the bounding sphere of a shape in object space
+	void GetBoundingSphere(LOD_SHAPE shape, glm::vec3& center, float& radius) const;
+	// get the number of triangles in a shape at a level
+	int GetTriangleCount(LOD_SHAPE shape, int level) const;
+
+	// get where a shape and level lives in the shared buffers
+	const MESH_RANGE& GetMeshRange(LOD_SHAPE shape, int level) const;
+	// true when the uploaded vertices use the packed layout
+	bool IsPacked() const { return m_bPackedVertices; }
+	// get the vertex cache statistics of all the generated
+	// meshes before and after they were optimized
+	const MeshOptimizer::CACHE_STATISTICS& GetCacheStatisticsBefore() const { return m_cacheStatisticsBefore; }
+	const MeshOptimizer::CACHE_STATISTICS& GetCacheStatisticsAfter() const { return m_cacheStatisticsAfter; }
+	// get the matrix that moves the packed positions of a shape
+	// from its unit bounding box back into object space
+	glm::mat4 GetPositionDecodeMatrix(LOD_SHAPE shape, int level) const;
+	glm::mat4 GetPositionDecodeMatrix(const MESH_RANGE& range) const;
+
+	// pack vertices into the compact layout, with the positions
+	// stored inside the passed in bounding box
+	static void PackVertices(
+		const MESH_VERTEX* vertices,
+		int vertexCount,
+		const glm::vec3& boundsMin,
+		const glm::vec3& boundsExtent,
+		PACKED_VERTEX* packedVertices);
+	// set the vertex attributes of the bound vertex array for
+	// either the packed or the float vertex layout
+	static void SetVertexAttributes(bool bPackedVertices);
+
+	// get the CPU-side copy of the shared buffers
+	const std::vector<MESH_VERTEX>& GetVertices() const { return m_vertices; }
+	const std::vector<GLuint>& GetIndices() const { return m_indices; }
+
+	// triangles submitted since the counter was last reset
+	int GetTrianglesDrawn() const { return m_trianglesDrawn; }
+	void ResetTrianglesDrawn() { m_trianglesDrawn = 0; }
+
+private:
+	// shared OpenGL buffers holding every generated mesh
+	GLuint m_vao;
+	GLuint m_vbos[2];
+	// where each shape and level lives in the shared buffers
+	MESH_RANGE m_meshRanges[LOD_SHAPE_COUNT][LOD_LEVELS];
+	// CPU-side copy of the shared buffers, kept for building
+	// the merged static geometry
+	std::vector<MESH_VERTEX> m_vertices;
+	std::vector<GLuint> m_indices;
+	// true when the uploaded vertices use the packed layout
+	bool m_bPackedVertices;
+	// true when the generated meshes are optimized
+	bool m_bOptimizeMeshes;
+	// vertex cache statistics before and after the optimization
+	MeshOptimizer::CACHE_STATISTICS m_cacheStatisticsBefore;
+	MeshOptimizer::CACHE_STATISTICS m_cacheStatisticsAfter;
+	// triangles submitted since the counter was last reset
+	int m_trianglesDrawn;
+
+	// a mesh file that is imported on a worker thread
+	struct IMPORTED_MESH
+	{
+		MESH_DATA mesh;
+		MESH_RANGE range;
+		bool bLoaded;
+		// declared last so a running import is waited for
+		// before the mesh it writes is destroyed
+		std::future<bool> import;
+	};
+	// the meshes imported from files, indexed by mesh id
+	std::vector<std::unique_ptr<IMPORTED_MESH>> m_importedMeshes;
+
+	// draw the chosen parts of a range of the shared buffers
+	void DrawRange(const MESH_RANGE& range, bool bDrawTop, bool bDrawBottom, bool bDrawSides);
+	// reorder the indices and vertices of a generated mesh
+	void OptimizeMesh(MESH_DATA& mesh);
+	// append a generated mesh to the CPU-side shared arrays
+	MESH_RANGE AppendMesh(
+		MESH_DATA& mesh,
+		std::vector<MESH_VERTEX>& vertices,
+		std::vector<GLuint>& indices);
+
+	// shape generators - all shapes are built around the origin
+	// with the same dimensions as the ShapeMeshes versions
+	static void GenerateSphere(int slices, int stacks, bool bHalf, MESH_DATA& mesh);
+	static void GenerateCylinder(int slices, float topRadius, MESH_DATA& mesh);
+	static void GenerateTorus(int mainSegments, int tubeSegments, MESH_DATA& mesh);
+	static void GenerateBox(MESH_DATA& mesh);
+	static void GeneratePlane(MESH_DATA& mesh);
+	static void GeneratePyramid4(MESH_DATA& mesh);
+	static void GenerateQuad(
+		glm::vec3 p0,
+		glm::vec3 p1,
+		glm::vec3 p2,
+		glm::vec3 p3,
+		MESH_DATA& mesh);
+	static void GenerateDisk(
+		int slices,
+		float radius,
+		float height,
+		bool bFacingUp,
+		MESH_DATA& mesh);
+};
@@ -0,0 +1,593 @@
+///////////////////////////////////////////////////////////////////////////////
+// staticbatch.cpp
+// ============
+// merge the static draws of the scene into shared buffers and submit them
+// with a single multi-draw indirect call
+///////////////////////////////////////////////////////////////////////////////
+
+#include "StaticBatch.h"
+#include "GLStateCache.h"
+
+#include <glm/gtx/transform.hpp>
+
+#include <algorithm>
+#include <cfloat>
+#include <iostream>
+
+// declaration of global variables
+namespace
+{
+	// an opaque draw becomes an occluder when its bounding radius
+	// is at least this fraction of the largest one in the batch
+	const float g_OccluderRadiusFraction = 0.15f;
+}
+
+/***********************************************************
+ *  StaticBatch()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+StaticBatch::StaticBatch()
+{
+	m_vao = 0;
+	m_vertexBuffer = 0;
+	m_indexBuffer = 0;
+	m_indirectBuffer = 0;
+	m_lodCommandBuffer = 0;
+	m_drawDataBuffer = 0;
+	m_materialBuffer = 0;
+	m_materialCount = 0;
+	m_instanceCount = 1;
+	m_drawIndexBuffer = 0;
+	m_drawBoundsBuffer = 0;
+	m_occluderBuffer = 0;
+	m_occluderCount = 0;
+	m_bPackedVertices = false;
+	m_positionDecode = glm::mat4(1.0f);
+}
+
+/***********************************************************
+ *  ~StaticBatch()
+ *
+ *  The destructor for the class
+ ***********************************************************/
+StaticBatch::~StaticBatch()
+{
+	Destroy();
+}
+
+/***********************************************************
+ *  AddDraw()
+ *
+ *  This method is used for adding one draw of a shape or an
+ *  imported mesh to the batch. The vertices are moved into world space with the
+ *  model matrix and the selected parts become one command.
+ ***********************************************************/
+void StaticBatch::AddDraw(
+	const ShapeLODMeshes& meshes,
+	const ShapeLODMeshes::MESH_RANGE& range,
+	bool bDrawTop,
+	bool bDrawBottom,
+	bool bDrawSides,
+	const glm::mat4& model,
+	const DRAW_DATA& drawData)
+{
+	AddDraw(meshes, &range, 1, bDrawTop, bDrawBottom, bDrawSides, model, drawData);
+}
+
+/***********************************************************
+ *  AddDraw()
+ *
+ *  This method is used for adding one draw of a curved shape
+ *  with the ranges of its detail levels, most detailed first.
+ *  Every level is merged into the batch with a command of
+ *  its own, and the cull chooses which one is drawn. The
+ *  bounds of the draw are the ones of the first level, and
+ *  the batch is drawn with it when it is not culled.
+ ***********************************************************/
+void StaticBatch::AddDraw(
+	const ShapeLODMeshes& meshes,
+	const ShapeLODMeshes::MESH_RANGE* levelRanges,
+	int levelCount,
+	bool bDrawTop,
+	bool bDrawBottom,
+	bool bDrawSides,
+	const glm::mat4& model,
+	const DRAW_DATA& drawData)
+{
+	if (levelCount <= 0)
+	{
+		return;
+	}
+
+	glm::vec3 boundsMin = glm::vec3(FLT_MAX);
+	glm::vec3 boundsMax = glm::vec3(-FLT_MAX);
+	DRAW_INDIRECT_COMMAND command = AppendRange(meshes, levelRanges[0], bDrawTop, bDrawBottom, bDrawSides, model, boundsMin, boundsMax);
+	if (command.count == 0)
+	{
+		return;
+	}
+
+	// the levels past the ones given draw the last one, and a
+	// level sharing the mesh of the one before it shares its
+	// command, like the flat shapes do at every level
+	glm::vec3 levelMin;
+	glm::vec3 levelMax;
+	m_lodCommands.push_back(command);
+	for (int level = 1; level < ShapeLODMeshes::LOD_LEVELS; level++)
+	{
+		if ((level < levelCount) && (levelRanges[level].baseVertex != levelRanges[level - 1].baseVertex))
+		{
+			m_lodCommands.push_back(AppendRange(meshes, levelRanges[level], bDrawTop, bDrawBottom, bDrawSides, model, levelMin, levelMax));
+		}
+		else
+		{
+			m_lodCommands.push_back(m_lodCommands.back());
+		}
+	}
+
+	m_commands.push_back(command);
+	m_drawData.push_back(drawData);
+	m_drawBounds.push_back(glm::vec4(
+		(boundsMin + boundsMax) * 0.5f,
+		glm::length(boundsMax - boundsMin) * 0.5f));
+}
+
+/***********************************************************
+ *  AppendRange()
+ *
+ *  This method is used for merging the vertices and the
+ *  indices of the selected parts of one mesh range into the
+ *  batch, and getting the command that draws them as the
+ *  next draw. The bounds are set to the box of the moved
+ *  vertices.
+ ***********************************************************/
+StaticBatch::DRAW_INDIRECT_COMMAND StaticBatch::AppendRange(
+	const ShapeLODMeshes& meshes,
+	const ShapeLODMeshes::MESH_RANGE& range,
+	bool bDrawTop,
+	bool bDrawBottom,
+	bool bDrawSides,
+	const glm::mat4& model,
+	glm::vec3& boundsMin,
+	glm::vec3& boundsMax)
+{
+	const std::vector<ShapeLODMeshes::MESH_VERTEX>& sourceVertices = meshes.GetVertices();
+	const std::vector<GLuint>& sourceIndices = meshes.GetIndices();
+
+	DRAW_INDIRECT_COMMAND command;
+	command.count = 0;
+	command.instanceCount = 1;
+	command.firstIndex = (GLuint)m_indices.size();
+	command.baseVertex = (GLint)m_vertices.size();
+	// the base instance selects the draw index attribute
+	command.baseInstance = (GLuint)m_commands.size();
+
+	boundsMin = glm::vec3(FLT_MAX);
+	boundsMax = glm::vec3(-FLT_MAX);
+	for (GLuint i = 0; i < range.vertexCount; i++)
+	{
+		ShapeLODMeshes::MESH_VERTEX vertex = sourceVertices[range.baseVertex + i];
+		vertex.position = glm::vec3(model * glm::vec4(vertex.position, 1.0f));
+		boundsMin = glm::min(boundsMin, vertex.position);
+		boundsMax = glm::max(boundsMax, vertex.position);
+		// the normals stay in object space, the same as the
+		// forward vertex shader passes them on, so the batch
+		// is lit exactly like the per-draw path
+		m_vertices.push_back(vertex);
+	}
+
+	// the indices are relative to the mesh so they are copied
+	// as they are and the base vertex points at the new copy
+	const ShapeLODMeshes::MESH_PART* parts[3] = {
+		bDrawSides ? &range.sides : NULL,
+		bDrawTop ? &range.top : NULL,
+		bDrawBottom ? &range.bottom : NULL };
+	for (int part = 0; part < 3; part++)
+	{
+		if (parts[part] != NULL)
+		{
+			m_indices.insert(
+				m_indices.end(),
+				sourceIndices.begin() + parts[part]->firstIndex,
+				sourceIndices.begin() + parts[part]->firstIndex + parts[part]->indexCount);
+			command.count += parts[part]->indexCount;
+		}
+	}
+
+	return(command);
+}
+
+/***********************************************************
+ *  Build()
+ *
+ *  This method is used for uploading the merged geometry,
+ *  the indirect draw commands and the storage buffers read
+ *  by the batch shaders. Packed vertices store the positions
+ *  inside the bounding box of the whole batch. The opaque
+ *  draws with the largest bounds get a second command buffer
+ *  so they can be drawn on their own as occluders.
+ ***********************************************************/
+void StaticBatch::Build(const std::vector<MATERIAL_DATA>& materials, bool bPackVertices)
+{
+	if (m_commands.size() == 0)
+	{
+		return;
+	}
+
+	glGenVertexArrays(1, &m_vao);
+	GLStateCache::BindVertexArray(m_vao);
+
+	glGenBuffers(1, &m_vertexBuffer);
+	glBindBuffer(GL_ARRAY_BUFFER, m_vertexBuffer);
+	m_bPackedVertices = bPackVertices;
+	m_positionDecode = glm::mat4(1.0f);
+	if (m_bPackedVertices)
+	{
+		glm::vec3 boundsMin = glm::vec3(FLT_MAX);
+		glm::vec3 boundsMax = glm::vec3(-FLT_MAX);
+		for (size_t i = 0; i < m_vertices.size(); i++)
+		{
+			boundsMin = glm::min(boundsMin, m_vertices[i].position);
+			boundsMax = glm::max(boundsMax, m_vertices[i].position);
+		}
+
+		std::vector<ShapeLODMeshes::PACKED_VERTEX> packedVertices(m_vertices.size());
+		ShapeLODMeshes::PackVertices(
+			m_vertices.data(),
+			(int)m_vertices.size(),
+			boundsMin,
+			boundsMax - boundsMin,
+			packedVertices.data());
+		m_positionDecode = glm::translate(boundsMin) * glm::scale(boundsMax - boundsMin);
+		glBufferData(GL_ARRAY_BUFFER, packedVertices.size() * sizeof(ShapeLODMeshes::PACKED_VERTEX), packedVertices.data(), GL_STATIC_DRAW);
+	}
+	else
+	{
+		glBufferData(GL_ARRAY_BUFFER, m_vertices.size() * sizeof(ShapeLODMeshes::MESH_VERTEX), m_vertices.data(), GL_STATIC_DRAW);
+	}
+
+	glGenBuffers(1, &m_indexBuffer);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_indexBuffer);
+	glBufferData(GL_ELEMENT_ARRAY_BUFFER, m_indices.size() * sizeof(GLuint), m_indices.data(), GL_STATIC_DRAW);
+
+	ShapeLODMeshes::SetVertexAttributes(m_bPackedVertices);
+
+	// one index per draw, advanced once per instance so every
+	// draw reads the entry at its base instance
+	std::vector<GLuint> drawIndices(m_commands.size());
+	for (GLuint i = 0; i < (GLuint)drawIndices.size(); i++)
+	{
+		drawIndices[i] = i;
+	}
+	glGenBuffers(1, &m_drawIndexBuffer);
+	glBindBuffer(GL_ARRAY_BUFFER, m_drawIndexBuffer);
+	glBufferData(GL_ARRAY_BUFFER, drawIndices.size() * sizeof(GLuint), drawIndices.data(), GL_STATIC_DRAW);
+	glVertexAttribIPointer(DRAW_INDEX_ATTRIBUTE, 1, GL_UNSIGNED_INT, sizeof(GLuint), (void*)0);
+	glVertexAttribDivisor(DRAW_INDEX_ATTRIBUTE, 1);
+	glEnableVertexAttribArray(DRAW_INDEX_ATTRIBUTE);
+
+	GLStateCache::BindVertexArray(0);
+
+	glGenBuffers(1, &m_indirectBuffer);
+	glBindBuffer(GL_DRAW_INDIRECT_BUFFER, m_indirectBuffer);
+	glBufferData(GL_DRAW_INDIRECT_BUFFER, m_commands.size() * sizeof(DRAW_INDIRECT_COMMAND), m_commands.data(), GL_STATIC_DRAW);
+
+	// the occluders keep their base instance, so they read the
+	// same draw index as in the full batch
+	float largestRadius = 0.0f;
+	for (size_t i = 0; i < m_drawBounds.size(); i++)
+	{
+		largestRadius = std::max(largestRadius, m_drawBounds[i].w);
+	}
+	std::vector<DRAW_INDIRECT_COMMAND> occluders;
+	for (size_t i = 0; i < m_commands.size(); i++)
+	{
+		bool bOpaque = (m_drawData[i].bUseTexture != 0) || (m_drawData[i].color.a >= 1.0f);
+		if (bOpaque && (m_drawBounds[i].w >= largestRadius * g_OccluderRadiusFraction))
+		{
+			occluders.push_back(m_commands[i]);
+			// the full pass draws the occluders again on top of
+			// their own depth, so they keep the level they were
+			// drawn into the depth buffer with
+			for (int level = 1; level < ShapeLODMeshes::LOD_LEVELS; level++)
+			{
+				m_lodCommands[i * ShapeLODMeshes::LOD_LEVELS + level] = m_commands[i];
+			}
+		}
+	}
+	m_occluderCount = (int)occluders.size();
+	if (m_occluderCount > 0)
+	{
+		glGenBuffers(1, &m_occluderBuffer);
+		glBindBuffer(GL_DRAW_INDIRECT_BUFFER, m_occluderBuffer);
+		glBufferData(GL_DRAW_INDIRECT_BUFFER, occluders.size() * sizeof(DRAW_INDIRECT_COMMAND), occluders.data(), GL_STATIC_DRAW);
+	}
+	glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+
+	// only read by the cull, which copies the command of the
+	// chosen level for each visible draw
+	glGenBuffers(1, &m_lodCommandBuffer);
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, m_lodCommandBuffer);
+	glBufferData(GL_SHADER_STORAGE_BUFFER, m_lodCommands.size() * sizeof(DRAW_INDIRECT_COMMAND), m_lodCommands.data(), GL_STATIC_DRAW);
+
+	glGenBuffers(1, &m_drawDataBuffer);
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, m_drawDataBuffer);
+	glBufferData(GL_SHADER_STORAGE_BUFFER, m_drawData.size() * sizeof(DRAW_DATA), m_drawData.data(), GL_STATIC_DRAW);
+
+	glGenBuffers(1, &m_drawBoundsBuffer);
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, m_drawBoundsBuffer);
+	glBufferData(GL_SHADER_STORAGE_BUFFER, m_drawBounds.size() * sizeof(glm::vec4), m_drawBounds.data(), GL_STATIC_DRAW);
+
+	glGenBuffers(1, &m_materialBuffer);
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, m_materialBuffer);
+	if (materials.size() > 0)
+	{
+		glBufferData(GL_SHADER_STORAGE_BUFFER, materials.size() * sizeof(MATERIAL_DATA), materials.data(), GL_STATIC_DRAW);
+		m_materialCount = (int)materials.size();
+	}
+	else
+	{
+		// keep the binding valid even without any materials
+		MATERIAL_DATA defaultMaterial;
+		defaultMaterial.diffuseColor = glm::vec4(1.0f, 1.0f, 1.0f, 0.0f);
+		defaultMaterial.specularColor = glm::vec4(0.0f);
+		glBufferData(GL_SHADER_STORAGE_BUFFER, sizeof(MATERIAL_DATA), &defaultMaterial, GL_STATIC_DRAW);
+	}
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+	std::cout << "Built static batch: " << m_commands.size() << " draws, "
+		<< m_vertices.size() << " vertices, " << m_indices.size() / 3 << " triangles at every detail level, "
+		<< m_occluderCount << " occluders" << std::endl;
+
+	// the geometry only lives on the GPU from now on, the
+	// bounds are kept for finding the draws of a material
+	m_vertices.clear();
+	m_vertices.shrink_to_fit();
+	m_indices.clear();
+	m_indices.shrink_to_fit();
+	m_lodCommands.clear();
+	m_lodCommands.shrink_to_fit();
+}
+
+/***********************************************************
+ *  Destroy()
+ *
+ *  This method is used for freeing the OpenGL buffers and
+ *  forgetting all the recorded draws.
+ ***********************************************************/
+void StaticBatch::Destroy()
+{
+	if (m_vao != 0)
+	{
+		GLuint buffers[8] = {
+			m_vertexBuffer,
+			m_indexBuffer,
+			m_indirectBuffer,
+			m_lodCommandBuffer,
+			m_drawDataBuffer,
+			m_materialBuffer,
+			m_drawIndexBuffer,
+			m_drawBoundsBuffer };
+		glDeleteBuffers(8, buffers);
+		if (m_occluderBuffer != 0)
+		{
+			glDeleteBuffers(1, &m_occluderBuffer);
+		}
+		GLStateCache::BindVertexArray(0);
+		glDeleteVertexArrays(1, &m_vao);
+	}
+
+	m_vao = 0;
+	m_vertexBuffer = 0;
+	m_indexBuffer = 0;
+	m_indirectBuffer = 0;
+	m_lodCommandBuffer = 0;
+	m_drawDataBuffer = 0;
+	m_materialBuffer = 0;
+	m_drawIndexBuffer = 0;
+	m_drawBoundsBuffer = 0;
+	m_occluderBuffer = 0;
+	m_occluderCount = 0;
+	m_materialCount = 0;
+	m_instanceCount = 1;
+
+	m_vertices.clear();
+	m_indices.clear();
+	m_commands.clear();
+	m_lodCommands.clear();
+	m_drawData.clear();
+	m_drawBounds.clear();
+}
+
+/***********************************************************
+ *  UpdateMaterial()
+ *
+ *  This method is used for replacing the values of one
+ *  material in the uploaded material buffer. Only that
+ *  material is uploaded again, the geometry and the draws
+ *  stay as they are.
+ ***********************************************************/
+void StaticBatch::UpdateMaterial(int materialIndex, const MATERIAL_DATA& material)
+{
+	if ((m_vao == 0) || (materialIndex < 0) || (materialIndex >= m_materialCount))
+	{
+		return;
+	}
+
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, m_materialBuffer);
+	glBufferSubData(
+		GL_SHADER_STORAGE_BUFFER,
+		materialIndex * sizeof(MATERIAL_DATA),
+		sizeof(MATERIAL_DATA),
+		&material);
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+}
+
+/***********************************************************
+ *  GetMaterialBounds()
+ *
+ *  This method is used for finding where the draws using a
+ *  material are, so a change to the material only has to
+ *  redraw that part of the frame.
+ ***********************************************************/
+void StaticBatch::GetMaterialBounds(int materialIndex, std::vector<glm::vec4>& bounds) const
+{
+	for (size_t i = 0; i < m_drawData.size(); i++)
+	{
+		if (m_drawData[i].materialIndex == materialIndex)
+		{
+			bounds.push_back(m_drawBounds[i]);
+		}
+	}
+}
+
+/***********************************************************
+ *  Render()
+ *
+ *  This method is used for submitting every recorded draw
+ *  with a single glMultiDrawElementsIndirect call. The batch
+ *  shader program must already be in use. Without the cull
+ *  choosing the detail levels every draw uses its first.
+ ***********************************************************/
+void StaticBatch::Render()
+{
+	if (m_vao == 0)
+	{
+		return;
+	}
+
+	GLStateCache::BindVertexArray(m_vao);
+	glBindBuffer(GL_DRAW_INDIRECT_BUFFER, m_indirectBuffer);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, DRAW_DATA_BINDING, m_drawDataBuffer);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, MATERIAL_BINDING, m_materialBuffer);
+
+	glMultiDrawElementsIndirect(
+		GL_TRIANGLES,
+		GL_UNSIGNED_INT,
+		(void*)0,
+		(GLsizei)m_commands.size(),
+		0);
+
+	glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+}
+
+/***********************************************************
+ *  RenderCulled()
+ *
+ *  This method is used for submitting the draws written by
+ *  the culling pass. The draw count is read on the GPU when
+ *  indirect parameters are supported, otherwise every slot
+ *  is submitted and the culled ones draw no instances.
+ ***********************************************************/
+void StaticBatch::RenderCulled(
+	GLuint commandBuffer,
+	GLuint drawCountBuffer,
+	GLintptr commandOffset,
+	GLintptr drawCountOffset)
+{
+	if (m_vao == 0)
+	{
+		return;
+	}
+
+	GLStateCache::BindVertexArray(m_vao);
+	glBindBuffer(GL_DRAW_INDIRECT_BUFFER, commandBuffer);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, DRAW_DATA_BINDING, m_drawDataBuffer);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, MATERIAL_BINDING, m_materialBuffer);
+
+	if (GLEW_VERSION_4_6)
+	{
+		glBindBuffer(GL_PARAMETER_BUFFER, drawCountBuffer);
+		glMultiDrawElementsIndirectCount(
+			GL_TRIANGLES,
+			GL_UNSIGNED_INT,
+			(void*)commandOffset,
+			drawCountOffset,
+			(GLsizei)m_commands.size(),
+			0);
+		glBindBuffer(GL_PARAMETER_BUFFER, 0);
+	}
+	else if (GLEW_ARB_indirect_parameters)
+	{
+		glBindBuffer(GL_PARAMETER_BUFFER_ARB, drawCountBuffer);
+		glMultiDrawElementsIndirectCountARB(
+			GL_TRIANGLES,
+			GL_UNSIGNED_INT,
+			(void*)commandOffset,
+			drawCountOffset,
+			(GLsizei)m_commands.size(),
+			0);
+		glBindBuffer(GL_PARAMETER_BUFFER_ARB, 0);
+	}
+	else
+	{
+		glMultiDrawElementsIndirect(
+			GL_TRIANGLES,
+			GL_UNSIGNED_INT,
+			(void*)commandOffset,
+			(GLsizei)m_commands.size(),
+			0);
+	}
+
+	glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+}
+
+/***********************************************************
+ *  SetInstanceCount()
+ *
+ *  This method is used for drawing every command of the
+ *  batch more than once, like once for each eye of a stereo
+ *  view. The draw index attribute advances once per command
+ *  rather than once per instance, so every instance still
+ *  reads the values of its own draw. The commands are only
+ *  uploaded again when the count changes.
+ ***********************************************************/
+void StaticBatch::SetInstanceCount(int instanceCount)
+{
+	if ((m_vao == 0) || (instanceCount < 1) || (instanceCount == m_instanceCount))
+	{
+		return;
+	}
+	m_instanceCount = instanceCount;
+
+	for (size_t i = 0; i < m_commands.size(); i++)
+	{
+		m_commands[i].instanceCount = (GLuint)instanceCount;
+	}
+	glBindBuffer(GL_DRAW_INDIRECT_BUFFER, m_indirectBuffer);
+	glBufferSubData(GL_DRAW_INDIRECT_BUFFER, 0, m_commands.size() * sizeof(DRAW_INDIRECT_COMMAND), m_commands.data());
+	glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+
+	GLStateCache::BindVertexArray(m_vao);
+	glVertexAttribDivisor(DRAW_INDEX_ATTRIBUTE, instanceCount);
+	GLStateCache::BindVertexArray(0);
+}
+
+/***********************************************************
+ *  RenderOccluders()
+ *
+ *  This method is used for submitting only the draws chosen
+ *  as occluders, for filling the depth buffer before the
+ *  rest of the batch is tested against it. The program in
+ *  use only has to write the depth.
+ ***********************************************************/
+void StaticBatch::RenderOccluders()
+{
+	if ((m_vao == 0) || (m_occluderCount == 0))
+	{
+		return;
+	}
+
+	GLStateCache::BindVertexArray(m_vao);
+	glBindBuffer(GL_DRAW_INDIRECT_BUFFER, m_occluderBuffer);
+
+	glMultiDrawElementsIndirect(
+		GL_TRIANGLES,
+		GL_UNSIGNED_INT,
+		(void*)0,
+		(GLsizei)m_occluderCount,
+		0);
+
+	glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+}
@@ -0,0 +1,189 @@
+///////////////////////////////////////////////////////////////////////////////
+// staticbatch.h
+// ============
+// merge the static draws of the scene into shared buffers and submit them
+// with a single multi-draw indirect call
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "ShapeLODMeshes.h"
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+
+#include <vector>
+
+/***********************************************************
+ *  StaticBatch
+ *
+ *  This class transforms the static draws of the scene into
+ *  world space, merges them into one vertex and index buffer
+ *  and submits all of them with glMultiDrawElementsIndirect.
+ *  The per-draw color, texture and material values are read
+ *  by the batch shaders from storage buffers. The index of
+ *  each draw is passed in as the base instance of its command
+ *  and read through a per-instance attribute, so it stays the
+ *  same when the commands are culled and compacted.
+ ***********************************************************/
+class StaticBatch
+{
+public:
+	// constructor
+	StaticBatch();
+	// destructor
+	~StaticBatch();
+
+	// storage buffer binding points used by the batch shaders
+	static const GLuint DRAW_DATA_BINDING = 0;
+	static const GLuint MATERIAL_BINDING = 1;
+	// vertex attribute holding the index of the draw
+	static const GLuint DRAW_INDEX_ATTRIBUTE = 3;
+
+	// per-draw values, laid out to match the std430 DrawData
+	// struct in the batch shaders
+	struct DRAW_DATA
+	{
+		glm::vec4 color;
+		glm::vec2 uvScale;
+		GLint textureSlot;
+		GLint materialIndex;
+		GLint bUseTexture;
+		// scene object written into the object ID buffer, 0 when
+		// the draw belongs to none
+		GLint objectID;
+		GLint padding[2];
+	};
+
+	// material values, laid out to match the std430 Material
+	// struct in the batch shaders
+	struct MATERIAL_DATA
+	{
+		// the shininess is stored in the w component
+		glm::vec4 diffuseColor;
+		glm::vec4 specularColor;
+	};
+
+	// add one draw of a range of the shared shape buffers
+	// transformed by the model matrix
+	void AddDraw(
+		const ShapeLODMeshes& meshes,
+		const ShapeLODMeshes::MESH_RANGE& range,
+		bool bDrawTop,
+		bool bDrawBottom,
+		bool bDrawSides,
+		const glm::mat4& model,
+		const DRAW_DATA& drawData);
+	// add one draw of a shape at several detail levels, most
+	// detailed first, the cull chooses the level drawn
+	void AddDraw(
+		const ShapeLODMeshes& meshes,
+		const ShapeLODMeshes::MESH_RANGE* levelRanges,
+		int levelCount,
+		bool bDrawTop,
+		bool bDrawBottom,
+		bool bDrawSides,
+		const glm::mat4& model,
+		const DRAW_DATA& drawData);
+	// upload the merged geometry, the draw commands and the
+	// per-draw and material data
+	void Build(const std::vector<MATERIAL_DATA>& materials, bool bPackVertices = true);
+	// free the OpenGL buffers and the recorded draws
+	void Destroy();
+	// replace the values of one uploaded material
+	void UpdateMaterial(int materialIndex, const MATERIAL_DATA& material);
+	// add the world space bounding sphere of every draw using a
+	// material, w is the radius
+	void GetMaterialBounds(int materialIndex, std::vector<glm::vec4>& bounds) const;
+	// submit every recorded draw with one indirect call
+	void Render();
+	// submit the draws of a culled command buffer, with the
+	// number of draws read from the draw count buffer, starting
+	// at the byte offsets of one view in both buffers
+	void RenderCulled(
+		GLuint commandBuffer,
+		GLuint drawCountBuffer,
+		GLintptr commandOffset = 0,
+		GLintptr drawCountOffset = 0);
+	// submit only the large opaque draws chosen as occluders
+	void RenderOccluders();
+	// draw every command this many times, with every instance
+	// reading the draw index of its command
+	void SetInstanceCount(int instanceCount);
+
+	// true when the batch has been uploaded and can be drawn
+	bool IsBuilt() const { return m_vao != 0; }
+	// number of draws merged into the batch
+	int GetDrawCount() const { return (int)m_commands.size(); }
+	// number of draws drawn by the occluder pass
+	int GetOccluderCount() const { return m_occluderCount; }
+	// true when the uploaded vertices use the packed layout
+	bool IsPacked() const { return m_bPackedVertices; }
+	// get the matrix that moves the packed positions from the
+	// unit bounding box back into world space
+	glm::mat4 GetPositionDecodeMatrix() const { return m_positionDecode; }
+	// get the buffers read by the culling pass
+	GLuint GetCommandBuffer() const { return m_indirectBuffer; }
+	GLuint GetDrawBoundsBuffer() const { return m_drawBoundsBuffer; }
+	// get the commands of every detail level of every draw, in
+	// groups of ShapeLODMeshes::LOD_LEVELS for each draw
+	GLuint GetLODCommandBuffer() const { return m_lodCommandBuffer; }
+	// get the material buffer, also read by the deferred lighting
+	GLuint GetMaterialBuffer() const { return m_materialBuffer; }
+
+private:
+	// command layout read by glMultiDrawElementsIndirect
+	struct DRAW_INDIRECT_COMMAND
+	{
+		GLuint count;
+		GLuint instanceCount;
+		GLuint firstIndex;
+		GLint baseVertex;
+		GLuint baseInstance;
+	};
+
+	// merged geometry and draws recorded before the upload
+	std::vector<ShapeLODMeshes::MESH_VERTEX> m_vertices;
+	std::vector<GLuint> m_indices;
+	std::vector<DRAW_INDIRECT_COMMAND> m_commands;
+	// command of every detail level of each draw
+	std::vector<DRAW_INDIRECT_COMMAND> m_lodCommands;
+	std::vector<DRAW_DATA> m_drawData;
+	// world space bounding sphere of each draw, w is the radius
+	std::vector<glm::vec4> m_drawBounds;
+
+	// packed vertex layout and the matrix that decodes it
+	bool m_bPackedVertices;
+	glm::mat4 m_positionDecode;
+
+	// number of materials in the uploaded material buffer
+	int m_materialCount;
+	// instances of every uploaded command
+	int m_instanceCount;
+
+	// OpenGL objects holding the uploaded batch
+	GLuint m_vao;
+	GLuint m_vertexBuffer;
+	GLuint m_indexBuffer;
+	GLuint m_indirectBuffer;
+	GLuint m_lodCommandBuffer;
+	GLuint m_drawDataBuffer;
+	GLuint m_materialBuffer;
+	GLuint m_drawIndexBuffer;
+	GLuint m_drawBoundsBuffer;
+	// commands of the draws large enough to hide others
+	GLuint m_occluderBuffer;
+	int m_occluderCount;
+
+	// merge the selected parts of a mesh range and get the
+	// command drawing them
+	DRAW_INDIRECT_COMMAND AppendRange(
+		const ShapeLODMeshes& meshes,
+		const ShapeLODMeshes::MESH_RANGE& range,
+		bool bDrawTop,
+		bool bDrawBottom,
+		bool bDrawSides,
+		const glm::mat4& model,
+		glm::vec3& boundsMin,
+		glm::vec3& boundsMax);
+};
@@ -0,0 +1,358 @@
+///////////////////////////////////////////////////////////////////////////////
+// texturecache.cpp
+// ============
+// share one texture between the image files and tags holding the same
+// image, found by hashing the file and the decoded pixels
+///////////////////////////////////////////////////////////////////////////////
+
+#include "TextureCache.h"
+#include "GLStateCache.h"
+#include "MappedFile.h"
+
+#include "stb_image.h"
+
+#include <cstring>
+#include <iostream>
+
+// declaration of the global variables and defines
+namespace
+{
+	// seed and multiplier of the 64 bit FNV-1a hash, applied to
+	// whole 8 byte words instead of single bytes
+	const uint64_t g_HashSeed = 14695981039346656037ull;
+	const uint64_t g_HashPrime = 1099511628211ull;
+
+	// add bytes to a hash
+	uint64_t HashBytes(const void* data, size_t size, uint64_t hash)
+	{
+		const unsigned char* bytes = (const unsigned char*)data;
+		size_t wordCount = size / sizeof(uint64_t);
+		for (size_t i = 0; i < wordCount; i++)
+		{
+			uint64_t word;
+			memcpy(&word, bytes + i * sizeof(uint64_t), sizeof(word));
+			hash = (hash ^ word) * g_HashPrime;
+			// the multiply only carries up, so the high bits are
+			// folded down before the next word, or a difference
+			// in the top bit of two words would cancel out
+			hash ^= hash >> 29;
+		}
+		for (size_t i = wordCount * sizeof(uint64_t); i < size; i++)
+		{
+			hash = (hash ^ bytes[i]) * g_HashPrime;
+		}
+		// mix the high bits down, the multiply only carries up
+		hash ^= hash >> 29;
+		hash *= 0xBF58476D1CE4E5B9ull;
+		hash ^= hash >> 32;
+		return(hash);
+	}
+
+	// add a value to a hash
+	template<typename VALUE>
+	uint64_t HashValue(const VALUE& value, uint64_t hash)
+	{
+		return(HashBytes(&value, sizeof(value), hash));
+	}
+
+	// get the plain byte at a time FNV-1a hash of the bytes,
+	// which shares nothing with the word hash above, to check
+	// that a file key match is the same file
+	uint64_t CheckBytes(const void* data, size_t size)
+	{
+		const unsigned char* bytes = (const unsigned char*)data;
+		uint64_t hash = g_HashSeed;
+		for (size_t i = 0; i < size; i++)
+		{
+			hash = (hash ^ bytes[i]) * g_HashPrime;
+		}
+		return(hash);
+	}
+
+	// get the bytes of a texture and its mipmaps
+	size_t GetTextureBytes(int width, int height)
+	{
+		size_t bytes = 0;
+		while (true)
+		{
+			bytes += (size_t)width * height * 4;
+			if ((width == 1) && (height == 1))
+			{
+				break;
+			}
+			width = (width > 1) ? width / 2 : 1;
+			height = (height > 1) ? height / 2 : 1;
+		}
+		return(bytes);
+	}
+}
+
+/***********************************************************
+ *  TextureCache()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+TextureCache::TextureCache()
+{
+	memset(&m_stats, 0, sizeof(m_stats));
+}
+
+/***********************************************************
+ *  ~TextureCache()
+ *
+ *  The destructor for the class
+ ***********************************************************/
+TextureCache::~TextureCache()
+{
+	Clear();
+}
+
+/***********************************************************
+ *  Acquire()
+ *
+ *  This method is used for getting the texture of an image
+ *  file. The file is mapped and hashed together with the
+ *  decode options, and a texture made from the same bytes
+ *  the same way is handed out without decoding anything.
+ *  Otherwise the file is decoded and processed, and the
+ *  pixels are hashed in turn, so an image stored twice
+ *  still shares one texture once its pixels are compared
+ *  with the ones of the texture. Only an image the cache
+ *  does not hold yet is uploaded.
+ ***********************************************************/
+GLuint TextureCache::Acquire(const char* filePath, const ImageProcessor::PROCESS_OPTIONS& options)
+{
+	m_stats.requestCount++;
+
+	MappedFile file;
+	if (!file.Open(filePath) || (file.GetSize() == 0))
+	{
+		std::cout << "Could not load image:" << filePath << std::endl;
+		return(0);
+	}
+
+	// the images are always flipped, so only the scaling
+	// changes the texture made from the same file
+	uint64_t fileKey = HashValue(options.maxSize, g_HashSeed);
+	fileKey = HashValue((int)options.filter, fileKey);
+	fileKey = HashValue(file.GetSize(), fileKey);
+	fileKey = HashBytes(file.GetData(), file.GetSize(), fileKey);
+	// a match is only taken as the same file when its size and
+	// its second hash agree too, anything else is decoded and
+	// goes through the pixel comparison
+	FILE_MATCH fileCheck;
+	fileCheck.fileSize = file.GetSize();
+	fileCheck.checkHash = CheckBytes(file.GetData(), file.GetSize());
+	std::unordered_map<uint64_t, FILE_MATCH>::iterator fileMatch = m_fileKeys.find(fileKey);
+	if ((fileMatch != m_fileKeys.end()) &&
+		(fileMatch->second.fileSize == fileCheck.fileSize) &&
+		(fileMatch->second.checkHash == fileCheck.checkHash))
+	{
+		std::cout << "Shared texture for image:" << filePath << std::endl;
+		return(AddReference(fileMatch->second.texture, m_stats.fileHitCount));
+	}
+
+	int width = 0;
+	int height = 0;
+	int colorChannels = 0;
+
+	// indicate to always flip images vertically when loaded
+	stbi_set_flip_vertically_on_load(true);
+
+	// try to parse the image data from the mapped image file
+	unsigned char* image = stbi_load_from_memory(
+		(const unsigned char*)file.GetData(),
+		(int)file.GetSize(),
+		&width,
+		&height,
+		&colorChannels,
+		0);
+	file.Close();
+	if (NULL == image)
+	{
+		std::cout << "Could not load image:" << filePath << std::endl;
+		return(0);
+	}
+
+	std::cout << "Successfully loaded image:" << filePath << ", width:" << width << ", height:" << height << ", channels:" << colorChannels << std::endl;
+
+	std::vector<unsigned char> pixels;
+	int textureWidth = 0;
+	int textureHeight = 0;
+	bool bProcessed = ImageProcessor::ProcessImage(
+		image, width, height, colorChannels, options, pixels, textureWidth, textureHeight);
+
+	// free the image data from local memory
+	stbi_image_free(image);
+
+	if (!bProcessed)
+	{
+		std::cout << "Not implemented to handle image with " << colorChannels << " channels" << std::endl;
+		return(0);
+	}
+	if ((textureWidth != width) || (textureHeight != height))
+	{
+		std::cout << "Scaled image down to width:" << textureWidth << ", height:" << textureHeight << std::endl;
+	}
+
+	uint64_t pixelKey = HashValue(textureWidth, g_HashSeed);
+	pixelKey = HashValue(textureHeight, pixelKey);
+	pixelKey = HashBytes(pixels.data(), pixels.size(), pixelKey);
+	std::unordered_map<uint64_t, GLuint>::iterator pixelMatch = m_pixelKeys.find(pixelKey);
+	if ((pixelMatch != m_pixelKeys.end()) && HoldsImage(pixelMatch->second, pixels, textureWidth, textureHeight))
+	{
+		std::cout << "Shared texture for image:" << filePath << std::endl;
+		// the next request for this file needs no decoding
+		fileCheck.texture = pixelMatch->second;
+		m_fileKeys[fileKey] = fileCheck;
+		return(AddReference(pixelMatch->second, m_stats.pixelHitCount));
+	}
+
+	GLuint textureID = 0;
+	glGenTextures(1, &textureID);
+	GLStateCache::BindTexture(GLStateCache::SCRATCH_TEXTURE_UNIT, GL_TEXTURE_2D, textureID);
+
+	// the rows of RGBA pixels always start 4 byte aligned
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, textureWidth, textureHeight, 0, GL_RGBA, GL_UNSIGNED_BYTE, pixels.data());
+
+	// generate the texture mipmaps for mapping textures to lower resolutions
+	glGenerateMipmap(GL_TEXTURE_2D);
+
+	GLStateCache::BindTexture(GLStateCache::SCRATCH_TEXTURE_UNIT, GL_TEXTURE_2D, 0); // Unbind the texture
+
+	CACHE_ENTRY entry;
+	entry.fileKey = fileKey;
+	entry.pixelKey = pixelKey;
+	entry.referenceCount = 1;
+	entry.bytes = GetTextureBytes(textureWidth, textureHeight);
+	entry.width = textureWidth;
+	entry.height = textureHeight;
+	m_entries[textureID] = entry;
+	fileCheck.texture = textureID;
+	m_fileKeys[fileKey] = fileCheck;
+	// a different image with the same hash keeps the key
+	m_pixelKeys.insert(std::make_pair(pixelKey, textureID));
+
+	m_stats.uploadCount++;
+	m_stats.uploadedBytes += entry.bytes;
+	return(textureID);
+}
+
+/***********************************************************
+ *  AddReference()
+ *
+ *  This method is used for handing out a texture the cache
+ *  already holds, and counting the memory it saved.
+ ***********************************************************/
+GLuint TextureCache::AddReference(GLuint texture, int& hitCount)
+{
+	CACHE_ENTRY& entry = m_entries[texture];
+	entry.referenceCount++;
+	hitCount++;
+	m_stats.savedBytes += entry.bytes;
+	return(texture);
+}
+
+/***********************************************************
+ *  HoldsImage()
+ *
+ *  This method is used for checking that a texture found by
+ *  the pixel hash holds the same image. The size is compared
+ *  first, and only a texture of the same size is read back
+ *  and compared byte for byte, which stalls for the GPU but
+ *  only happens while an image is loaded.
+ ***********************************************************/
+bool TextureCache::HoldsImage(GLuint texture, const std::vector<unsigned char>& pixels, int width, int height) const
+{
+	std::unordered_map<GLuint, CACHE_ENTRY>::const_iterator match = m_entries.find(texture);
+	if ((match == m_entries.end()) ||
+		(match->second.width != width) ||
+		(match->second.height != height) ||
+		(pixels.size() != (size_t)width * height * 4))
+	{
+		return(false);
+	}
+
+	// the rows of RGBA pixels always end 4 byte aligned
+	std::vector<unsigned char> texturePixels(pixels.size());
+	GLStateCache::BindTexture(GLStateCache::SCRATCH_TEXTURE_UNIT, GL_TEXTURE_2D, texture);
+	glGetTexImage(GL_TEXTURE_2D, 0, GL_RGBA, GL_UNSIGNED_BYTE, texturePixels.data());
+	GLStateCache::BindTexture(GLStateCache::SCRATCH_TEXTURE_UNIT, GL_TEXTURE_2D, 0);
+
+	return(memcmp(texturePixels.data(), pixels.data(), pixels.size()) == 0);
+}
+
+/***********************************************************
+ *  Release()
+ *
+ *  This method is used for dropping a reference to a
+ *  texture. The last one deletes it and forgets its keys,
+ *  including the keys of other files that led to it.
+ ***********************************************************/
+void TextureCache::Release(GLuint texture)
+{
+	std::unordered_map<GLuint, CACHE_ENTRY>::iterator match = m_entries.find(texture);
+	if (match == m_entries.end())
+	{
+		return;
+	}
+	if (--match->second.referenceCount > 0)
+	{
+		return;
+	}
+
+	for (std::unordered_map<uint64_t, FILE_MATCH>::iterator key = m_fileKeys.begin(); key != m_fileKeys.end();)
+	{
+		if (key->second.texture == texture)
+		{
+			key = m_fileKeys.erase(key);
+		}
+		else
+		{
+			++key;
+		}
+	}
+	std::unordered_map<uint64_t, GLuint>::iterator pixelKey = m_pixelKeys.find(match->second.pixelKey);
+	if ((pixelKey != m_pixelKeys.end()) && (pixelKey->second == texture))
+	{
+		m_pixelKeys.erase(pixelKey);
+	}
+	m_entries.erase(match);
+	GLStateCache::ForgetTexture(texture);
+	glDeleteTextures(1, &texture);
+}
+
+/***********************************************************
+ *  Clear()
+ *
+ *  This method is used for deleting every texture of the
+ *  cache, whether it is still referenced or not.
+ ***********************************************************/
+void TextureCache::Clear()
+{
+	for (std::unordered_map<GLuint, CACHE_ENTRY>::iterator entry = m_entries.begin(); entry != m_entries.end(); ++entry)
+	{
+		GLuint texture = entry->first;
+		GLStateCache::ForgetTexture(texture);
+		glDeleteTextures(1, &texture);
+	}
+	m_entries.clear();
+	m_fileKeys.clear();
+	m_pixelKeys.clear();
+}
+
+/***********************************************************
+ *  ReportStats()
+ *
+ *  This method is used for printing how many requests were
+ *  answered with a shared texture and the memory it saved.
+ ***********************************************************/
+void TextureCache::ReportStats() const
+{
+	std::cout << "Texture cache: " << m_stats.requestCount << " requests, "
+		<< m_stats.uploadCount << " textures uploaded, "
+		<< m_stats.fileHitCount << " shared by file, "
+		<< m_stats.pixelHitCount << " shared by pixels, "
+		<< m_stats.uploadedBytes / 1024 << " KB used, "
+		<< m_stats.savedBytes / 1024 << " KB saved" << std::endl;
+}
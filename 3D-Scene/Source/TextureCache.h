@@ -0,0 +1,102 @@
+///////////////////////////////////////////////////////////////////////////////
+// texturecache.h
+// ============
+// share one texture between the image files and tags holding the same
+// image, found by hashing the file and the decoded pixels
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "ImageProcessor.h"
+
+#include <GL/glew.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+/***********************************************************
+ *  TextureCache
+ *
+ *  This class creates the textures of the image files and
+ *  hands out the same texture again for an image it already
+ *  holds, counting the references to each one. An image is
+ *  looked up twice: by a hash of the file bytes and the
+ *  decode options, which finds the same file loaded under
+ *  another tag and copies of a file before decoding them,
+ *  and by a hash of the processed pixels, which finds the
+ *  same image stored in different files once it is decoded.
+ *  A file hash match is only shared when the file size and
+ *  a second, byte at a time hash of the file agree as well,
+ *  and a pixel hash match only after the size and the pixels
+ *  of the texture are compared with the new image.
+ *  A texture is deleted when its last reference is released.
+ ***********************************************************/
+class TextureCache
+{
+public:
+	// constructor
+	TextureCache();
+	// destructor
+	~TextureCache();
+
+	// counts of the requests and the texture memory they took
+	struct CACHE_STATS
+	{
+		int requestCount;
+		// requests that created a texture
+		int uploadCount;
+		// requests answered by the file or the pixel hash
+		int fileHitCount;
+		int pixelHitCount;
+		// texture memory with the mipmaps, created and avoided
+		size_t uploadedBytes;
+		size_t savedBytes;
+	};
+
+	// get the texture of an image file, creating it only when
+	// no texture holds the same image, 0 when it fails to load
+	GLuint Acquire(const char* filePath, const ImageProcessor::PROCESS_OPTIONS& options);
+	// drop a reference to a texture, deleting it with the last
+	void Release(GLuint texture);
+	// delete every texture, referenced or not
+	void Clear();
+
+	const CACHE_STATS& GetStats() const { return m_stats; }
+	// print the counts and the memory saved
+	void ReportStats() const;
+
+private:
+	// a texture held by the cache
+	struct CACHE_ENTRY
+	{
+		uint64_t fileKey;
+		uint64_t pixelKey;
+		int referenceCount;
+		size_t bytes;
+		// size of the top level of the texture
+		int width;
+		int height;
+	};
+
+	// the texture of a file key, with the size and a second
+	// hash of the file checked on a match
+	struct FILE_MATCH
+	{
+		GLuint texture;
+		size_t fileSize;
+		uint64_t checkHash;
+	};
+
+	// entries by texture name, and texture names by each key
+	std::unordered_map<GLuint, CACHE_ENTRY> m_entries;
+	std::unordered_map<uint64_t, FILE_MATCH> m_fileKeys;
+	std::unordered_map<uint64_t, GLuint> m_pixelKeys;
+	CACHE_STATS m_stats;
+
+	// add a reference to a texture found by one of the keys
+	GLuint AddReference(GLuint texture, int& hitCount);
+	// true when the texture holds exactly the passed in pixels
+	bool HoldsImage(GLuint texture, const std::vector<unsigned char>& pixels, int width, int height) const;
+};
@@ -0,0 +1,72 @@
+///////////////////////////////////////////////////////////////////////////////
+// triplebuffer.h
+// ============
+// hand the latest state from one thread to another without locks
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <atomic>
+
+/***********************************************************
+ *  TripleBuffer
+ *
+ *  This class passes values from one writing thread to one
+ *  reading thread. The writer fills its back slot and swaps
+ *  it with the middle slot, and the reader swaps its front
+ *  slot with the middle one when a new value was published.
+ *  Neither side ever waits on the other, and the reader
+ *  always sees the newest complete value, skipping the ones
+ *  it was too slow to read.
+ ***********************************************************/
+template <typename T>
+class TripleBuffer
+{
+public:
+	// constructor
+	TripleBuffer()
+	{
+		m_backIndex = 0;
+		m_middleIndex = 1;
+		m_frontIndex = 2;
+	}
+
+	// get the slot the writer fills in next
+	T& GetBack() { return m_slots[m_backIndex]; }
+
+	// publish the filled back slot to the reader
+	void Publish()
+	{
+		int previous = m_middleIndex.exchange(m_backIndex | NEW_VALUE_BIT, std::memory_order_acq_rel);
+		m_backIndex = previous & INDEX_MASK;
+	}
+
+	// take the newest published value if there is one, false
+	// when the front slot already holds it
+	bool Update()
+	{
+		if ((m_middleIndex.load(std::memory_order_relaxed) & NEW_VALUE_BIT) == 0)
+		{
+			return(false);
+		}
+
+		int previous = m_middleIndex.exchange(m_frontIndex, std::memory_order_acq_rel);
+		m_frontIndex = previous & INDEX_MASK;
+		return(true);
+	}
+
+	// get the value the reader took last
+	const T& GetFront() const { return m_slots[m_frontIndex]; }
+
+private:
+	// the middle index is marked while it holds an unread value
+	static const int NEW_VALUE_BIT = 4;
+	static const int INDEX_MASK = 3;
+
+	T m_slots[3];
+	// slot owned by the writer, by the reader, and the one
+	// passed between them
+	int m_backIndex;
+	int m_frontIndex;
+	std::atomic<int> m_middleIndex;
+};
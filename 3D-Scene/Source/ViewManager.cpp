@@ -8,12 +8,18 @@
 ///////////////////////////////////////////////////////////////////////////////
 
 #include "ViewManager.h"
+#include "EventQueue.h"
+#include "GLStateCache.h"
 
 // GLM Math Header inclusions
 #include <glm/glm.hpp>
 #include <glm/gtx/transform.hpp>
 #include <glm/gtc/type_ptr.hpp>    
 
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+
 // declaration of the global variables and defines
 namespace
 {
@@ -27,18 +33,133 @@ namespace
 	// the 3D scene
 	Camera* g_pCamera = nullptr;
 
-	// these variables are used for mouse movement processing
+	// these variables are used for mouse movement processing,
+	// only the simulation reads and writes them
 	float gLastX = WINDOW_WIDTH / 2.0f;
 	float gLastY = WINDOW_HEIGHT / 2.0f;
 	bool gFirstMouse = true;
 
-	// time between current frame and last frame
-	float gDeltaTime = 0.0f; 
-	float gLastFrame = 0.0f;
+	// the camera is simulated at a fixed rate, independent of
+	// how fast the frames are drawn
+	const double g_SimulationTickLength = 1.0 / 120.0;
+	// a simulation further behind than this skips ahead instead
+	// of running every missed tick
+	const double g_MaxSimulationLag = 0.25;
 
 	// the following variable is false when orthographic projection
 	// is off and true when it is on
 	bool bOrthographicProjection = false;
+
+	// kinds of input events passed to the simulation
+	enum INPUT_EVENT_TYPE
+	{
+		INPUT_MOUSE_POSITION = 0,
+		INPUT_MOUSE_SCROLL,
+		INPUT_KEY
+	};
+
+	// an input event received by a GLFW callback
+	struct INPUT_EVENT
+	{
+		INPUT_EVENT_TYPE type;
+		int key;
+		int action;
+		double x;
+		double y;
+	};
+
+	// events pushed by the GLFW callbacks on the main thread and
+	// popped by the simulation
+	EventQueue<INPUT_EVENT, 1024> g_InputEvents;
+
+	// set when the window was uncovered or resized and the last
+	// frame has to be shown again, only used on the main thread
+	bool g_bWindowRefresh = false;
+	// set when the shading of the scene is switched between
+	// forward and deferred, only used on the main thread
+	bool g_bShadingSwitch = false;
+	// set when the left mouse button was pressed to pick the
+	// scene object in sight, only used on the main thread
+	bool g_bPickRequest = false;
+
+	// size in pixels of the framebuffer, which differs from the
+	// window size on a monitor with a high DPI, and the content
+	// scale of that monitor, only used on the main thread
+	int g_FramebufferWidth = WINDOW_WIDTH;
+	int g_FramebufferHeight = WINDOW_HEIGHT;
+	float g_ContentScale = 1.0f;
+
+	// a camera of the view layouts that stays in place and
+	// looks at the table from another side
+	struct FIXED_CAMERA
+	{
+		glm::vec3 position;
+		glm::vec3 target;
+		float zoom;
+	};
+
+	const FIXED_CAMERA g_FixedCameras[] =
+	{
+		// overhead, looking down on the table
+		{ glm::vec3(0.0f, 16.0f, 2.0f), glm::vec3(0.0f, 0.0f, 0.0f), 60.0f },
+		// right of the table
+		{ glm::vec3(13.0f, 6.0f, 2.0f), glm::vec3(0.0f, 2.0f, 0.0f), 60.0f },
+		// left of the table
+		{ glm::vec3(-13.0f, 6.0f, 2.0f), glm::vec3(0.0f, 2.0f, 0.0f), 60.0f }
+	};
+	// camera index of the view following the interactive camera,
+	// and of the views of its left and right eye
+	const int g_InteractiveCamera = -1;
+	const int g_LeftEyeCamera = -2;
+	const int g_RightEyeCamera = -3;
+	// distance between the eyes, and the distance in front of
+	// the camera where both eyes see the same image, about that
+	// of the table from the starting camera
+	const float g_EyeSeparation = 0.3f;
+	const float g_ConvergenceDistance = 12.0f;
+
+	// a view of a layout and the part of the frame it fills, as
+	// left, bottom, width and height fractions
+	struct LAYOUT_VIEW
+	{
+		int camera;
+		glm::vec4 viewport;
+	};
+
+	struct LAYOUT_DESC
+	{
+		const char* name;
+		int viewCount;
+		LAYOUT_VIEW views[ViewManager::MAX_VIEWS];
+	};
+
+	// the views of each layout, in the order of VIEW_LAYOUT, and
+	// the names they are chosen by on the command line
+	const LAYOUT_DESC g_ViewLayouts[ViewManager::LAYOUT_COUNT] =
+	{
+		{ "single", 1, {
+			{ g_InteractiveCamera, glm::vec4(0.0f, 0.0f, 1.0f, 1.0f) } } },
+		{ "split", 2, {
+			{ g_InteractiveCamera, glm::vec4(0.0f, 0.0f, 0.5f, 1.0f) },
+			{ 1, glm::vec4(0.5f, 0.0f, 0.5f, 1.0f) } } },
+		{ "pip", 2, {
+			{ g_InteractiveCamera, glm::vec4(0.0f, 0.0f, 1.0f, 1.0f) },
+			{ 0, glm::vec4(0.68f, 0.68f, 0.3f, 0.3f) } } },
+		{ "wall", 4, {
+			{ g_InteractiveCamera, glm::vec4(0.0f, 0.5f, 0.5f, 0.5f) },
+			{ 0, glm::vec4(0.5f, 0.5f, 0.5f, 0.5f) },
+			{ 1, glm::vec4(0.0f, 0.0f, 0.5f, 0.5f) },
+			{ 2, glm::vec4(0.5f, 0.0f, 0.5f, 0.5f) } } },
+		{ "stereo", 2, {
+			{ g_LeftEyeCamera, glm::vec4(0.0f, 0.0f, 0.5f, 1.0f) },
+			{ g_RightEyeCamera, glm::vec4(0.5f, 0.0f, 0.5f, 1.0f) } } }
+	};
+
+	// seconds on a clock every thread can read
+	double GetSimulationTime()
+	{
+		return(std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count());
+	}
 }
 
 /***********************************************************
@@ -52,6 +173,24 @@ ViewManager::ViewManager(
 	// initialize the member variables
 	m_pShaderManager = pShaderManager;
 	m_pWindow = NULL;
+	for (int i = 0; i < MAX_VIEWS; i++)
+	{
+		m_views[i].view = glm::mat4(1.0f);
+		m_views[i].projection = glm::mat4(1.0f);
+		m_views[i].position = glm::vec3(0.0f);
+		m_views[i].viewport = glm::vec4(0.0f, 0.0f, 1.0f, 1.0f);
+	}
+	m_viewCount = 1;
+	m_viewLayout = LAYOUT_SINGLE;
+	m_bViewChanged = true;
+	m_aspectRatio = (float)WINDOW_WIDTH / (float)WINDOW_HEIGHT;
+	m_bSimulating = false;
+	m_bUseSimulationThread = true;
+	m_nextTickTime = 0.0;
+	for (int i = 0; i < 6; i++)
+	{
+		m_bMovementKeys[i] = false;
+	}
 	g_pCamera = new Camera();
 	// default camera view parameters
 	g_pCamera->Position = glm::vec3(0.0f, 5.0f, 12.0f);
@@ -59,6 +198,8 @@ ViewManager::ViewManager(
 	g_pCamera->Up = glm::vec3(0.0f, 1.0f, 0.0f);
 	g_pCamera->Zoom = 80;
 	g_pCamera->MovementSpeed = 20;
+	m_cameraState = CaptureCameraState();
+	m_views[0].position = m_cameraState.position;
 }
 
 /***********************************************************
@@ -68,6 +209,9 @@ ViewManager::ViewManager(
  ***********************************************************/
 ViewManager::~ViewManager()
 {
+	// the simulation uses the camera until it is stopped
+	StopSimulation();
+
 	// free up allocated memory
 	m_pShaderManager = NULL;
 	m_pWindow = NULL;
@@ -87,6 +231,10 @@ GLFWwindow* ViewManager::CreateDisplayWindow(const char* windowTitle)
 {
 	GLFWwindow* window = nullptr;
 
+	// let the window grow with the DPI of the monitor, so it has
+	// the same size on the screen at any pixel density
+	glfwWindowHint(GLFW_SCALE_TO_MONITOR, GL_TRUE);
+
 	// try to create the displayed OpenGL window
 	window = glfwCreateWindow(
 		WINDOW_WIDTH,
@@ -107,12 +255,34 @@ GLFWwindow* ViewManager::CreateDisplayWindow(const char* windowTitle)
 	// this callback is used to receive mouse moving events
 	glfwSetCursorPosCallback(window, &ViewManager::Mouse_Position_Callback);
 
+	// this callback is used to receive mouse button events
+	glfwSetMouseButtonCallback(window, &ViewManager::Mouse_Button_Callback);
+
 	// this callback is used to receive mouse scroll wheel events
 	glfwSetScrollCallback(window, &ViewManager::Mouse_Scroll_Wheel_Callback);
 
+	// this callback is used to receive keyboard events
+	glfwSetKeyCallback(window, &ViewManager::Key_Callback);
+
+	// this callback is used to receive window repaint requests
+	glfwSetWindowRefreshCallback(window, &ViewManager::Window_Refresh_Callback);
+
+	// this callback is used to receive the size of the framebuffer
+	glfwSetFramebufferSizeCallback(window, &ViewManager::Framebuffer_Size_Callback);
+
+	// this callback is used to receive the DPI changes of the monitor
+	glfwSetWindowContentScaleCallback(window, &ViewManager::Window_Content_Scale_Callback);
+
+	// the framebuffer can be larger than the window asked for
+	glfwGetFramebufferSize(window, &g_FramebufferWidth, &g_FramebufferHeight);
+	float yScale = 1.0f;
+	glfwGetWindowContentScale(window, &g_ContentScale, &yScale);
+	std::cout << "Framebuffer " << g_FramebufferWidth << "x" << g_FramebufferHeight
+		<< " at content scale " << g_ContentScale << std::endl;
+
 	// enable blending for supporting tranparent rendering
-	glEnable(GL_BLEND);
-	glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+	GLStateCache::Enable(GL_BLEND);
+	GLStateCache::BlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
 
 	m_pWindow = window;
 
@@ -124,29 +294,33 @@ GLFWwindow* ViewManager::CreateDisplayWindow(const char* windowTitle)
  *
  *  This method is automatically called from GLFW whenever
  *  the mouse is moved within the active GLFW display window.
+ *  The position is queued for the simulation, which moves
+ *  the camera on its next tick.
  ***********************************************************/
 void ViewManager::Mouse_Position_Callback(GLFWwindow* window, double xMousePos, double yMousePos)
 {
-	// when the first mouse move event is received, this needs to be recorded so that
-	// all subsequent mouse moves can correctly calculate the X position offset and Y
-	// position offset for proper operation
-	if (gFirstMouse)
+	INPUT_EVENT event;
+	event.type = INPUT_MOUSE_POSITION;
+	event.key = 0;
+	event.action = 0;
+	event.x = xMousePos;
+	event.y = yMousePos;
+	g_InputEvents.Push(event);
+}
+
+/***********************************************************
+ *  Mouse_Button_Callback()
+ *
+ *  This method is automatically called from GLFW whenever
+ *  a mouse button is pressed or released. A press of the
+ *  left button asks for the scene object in sight.
+ ***********************************************************/
+void ViewManager::Mouse_Button_Callback(GLFWwindow* window, int button, int action, int mods)
+{
+	if ((button == GLFW_MOUSE_BUTTON_LEFT) && (action == GLFW_PRESS))
 	{
-		gLastX = xMousePos;
-		gLastY = yMousePos;
-		gFirstMouse = false;
+		g_bPickRequest = true;
 	}
-
-	// calculate the X offset and Y offset values for moving the 3D camera accordingly
-	float xOffset = xMousePos - gLastX;
-	float yOffset = gLastY - yMousePos; // reversed since y-coordinates go from bottom to top
-
-	// set the current positions into the last position variables
-	gLastX = xMousePos;
-	gLastY = yMousePos;
-
-	// move the 3D camera according to the calculated offsets
-	g_pCamera->ProcessMouseMovement(xOffset, yOffset);
 }
 
 /***********************************************************
@@ -157,89 +331,369 @@ void ViewManager::Mouse_Position_Callback(GLFWwindow* window, double xMousePos,
  ***********************************************************/
 void ViewManager::Mouse_Scroll_Wheel_Callback(GLFWwindow* window, double xOffset, double yOffset)
 {
-	// Adjust the camera movement speed based on scroll input
-	g_pCamera->MovementSpeed += static_cast<float>(yOffset);
-	if (g_pCamera->MovementSpeed < 1.0f)
-		g_pCamera->MovementSpeed = 1.0f;
-	if (g_pCamera->MovementSpeed > 100.0f)
-		g_pCamera->MovementSpeed = 100.0f;
+	INPUT_EVENT event;
+	event.type = INPUT_MOUSE_SCROLL;
+	event.key = 0;
+	event.action = 0;
+	event.x = xOffset;
+	event.y = yOffset;
+	g_InputEvents.Push(event);
 }
 
-
 /***********************************************************
- *  ProcessKeyboardEvents()
+ *  Key_Callback()
  *
- *  This method is called to process any keyboard events
- *  that may be waiting in the event queue.
+ *  This method is automatically called from GLFW whenever
+ *  a key is pressed or released. The window is closed and
+ *  the shading switched right away, every other key is
+ *  queued for the simulation.
  ***********************************************************/
-void ViewManager::ProcessKeyboardEvents()
+void ViewManager::Key_Callback(GLFWwindow* window, int key, int scancode, int action, int mods)
 {
 	// close the window if the escape key has been pressed
-	if (glfwGetKey(m_pWindow, GLFW_KEY_ESCAPE) == GLFW_PRESS)
+	if ((key == GLFW_KEY_ESCAPE) && (action == GLFW_PRESS))
 	{
-		glfwSetWindowShouldClose(m_pWindow, true);
+		glfwSetWindowShouldClose(window, true);
+		return;
 	}
 
-	// process camera zooming in and out
-	if (glfwGetKey(m_pWindow, GLFW_KEY_W) == GLFW_PRESS)
+	// switch between forward and deferred shading
+	if ((key == GLFW_KEY_L) && (action == GLFW_PRESS))
 	{
-		// W key to move camera forward
-		g_pCamera->ProcessKeyboard(FORWARD, gDeltaTime);
+		g_bShadingSwitch = true;
+		return;
 	}
-	if (glfwGetKey(m_pWindow, GLFW_KEY_S) == GLFW_PRESS)
+
+	// held keys only matter as pressed and released
+	if (action == GLFW_REPEAT)
 	{
-		// S key to move camera backward
-		g_pCamera->ProcessKeyboard(BACKWARD, gDeltaTime);
+		return;
 	}
 
-	// process camera panning left and right
-	if (glfwGetKey(m_pWindow, GLFW_KEY_A) == GLFW_PRESS)
+	INPUT_EVENT event;
+	event.type = INPUT_KEY;
+	event.key = key;
+	event.action = action;
+	event.x = 0.0;
+	event.y = 0.0;
+	g_InputEvents.Push(event);
+}
+
+/***********************************************************
+ *  Window_Refresh_Callback()
+ *
+ *  This method is automatically called from GLFW whenever
+ *  the contents of the window have to be painted again.
+ ***********************************************************/
+void ViewManager::Window_Refresh_Callback(GLFWwindow* window)
+{
+	g_bWindowRefresh = true;
+}
+
+/***********************************************************
+ *  Framebuffer_Size_Callback()
+ *
+ *  This method is automatically called from GLFW whenever
+ *  the framebuffer of the window changes size, which is
+ *  also when the window is minimized and restored.
+ ***********************************************************/
+void ViewManager::Framebuffer_Size_Callback(GLFWwindow* window, int width, int height)
+{
+	g_FramebufferWidth = width;
+	g_FramebufferHeight = height;
+	g_bWindowRefresh = true;
+}
+
+/***********************************************************
+ *  Window_Content_Scale_Callback()
+ *
+ *  This method is automatically called from GLFW whenever
+ *  the window moves to a monitor with a different DPI.
+ ***********************************************************/
+void ViewManager::Window_Content_Scale_Callback(GLFWwindow* window, float xScale, float yScale)
+{
+	g_ContentScale = xScale;
+	std::cout << "Content scale changed to " << xScale << std::endl;
+}
+
+/***********************************************************
+ *  TakeWindowRefresh()
+ *
+ *  This method is used for checking if the window asked to
+ *  be repainted since the last check.
+ ***********************************************************/
+bool ViewManager::TakeWindowRefresh()
+{
+	bool bRefresh = g_bWindowRefresh;
+	g_bWindowRefresh = false;
+	return(bRefresh);
+}
+
+/***********************************************************
+ *  TakeShadingSwitch()
+ *
+ *  This method is used for checking if the shading was
+ *  switched since the last check.
+ ***********************************************************/
+bool ViewManager::TakeShadingSwitch()
+{
+	bool bSwitch = g_bShadingSwitch;
+	g_bShadingSwitch = false;
+	return(bSwitch);
+}
+
+/***********************************************************
+ *  TakePickRequest()
+ *
+ *  This method is used for checking if an object was asked
+ *  to be picked since the last check. The cursor is captured
+ *  to turn the camera, so the pick is always aimed at the
+ *  middle of the window, given as fractions of its size.
+ ***********************************************************/
+bool ViewManager::TakePickRequest(glm::vec2& position)
+{
+	bool bPick = g_bPickRequest;
+	g_bPickRequest = false;
+	position = glm::vec2(0.5f, 0.5f);
+	return(bPick);
+}
+
+/***********************************************************
+ *  ProcessInputEvents()
+ *
+ *  This method is used for applying the queued input events
+ *  to the camera, in the order they were received.
+ ***********************************************************/
+void ViewManager::ProcessInputEvents()
+{
+	INPUT_EVENT event;
+	while (g_InputEvents.Pop(event))
 	{
-		// A key to move camera left
-		g_pCamera->ProcessKeyboard(LEFT, gDeltaTime);
+		if (event.type == INPUT_MOUSE_POSITION)
+		{
+			// when the first mouse move event is received, this needs to be recorded so that
+			// all subsequent mouse moves can correctly calculate the X position offset and Y
+			// position offset for proper operation
+			if (gFirstMouse)
+			{
+				gLastX = event.x;
+				gLastY = event.y;
+				gFirstMouse = false;
+			}
+
+			// calculate the X offset and Y offset values for moving the 3D camera accordingly
+			float xOffset = event.x - gLastX;
+			float yOffset = gLastY - event.y; // reversed since y-coordinates go from bottom to top
+
+			// set the current positions into the last position variables
+			gLastX = event.x;
+			gLastY = event.y;
+
+			// move the 3D camera according to the calculated offsets
+			g_pCamera->ProcessMouseMovement(xOffset, yOffset);
+		}
+		else if (event.type == INPUT_MOUSE_SCROLL)
+		{
+			// Adjust the camera movement speed based on scroll input
+			g_pCamera->MovementSpeed += static_cast<float>(event.y);
+			if (g_pCamera->MovementSpeed < 1.0f)
+				g_pCamera->MovementSpeed = 1.0f;
+			if (g_pCamera->MovementSpeed > 100.0f)
+				g_pCamera->MovementSpeed = 100.0f;
+		}
+		else if (event.type == INPUT_KEY)
+		{
+			bool bPressed = (event.action == GLFW_PRESS);
+			switch (event.key)
+			{
+			// W and S keys to move the camera forward and backward
+			case GLFW_KEY_W: m_bMovementKeys[FORWARD] = bPressed; break;
+			case GLFW_KEY_S: m_bMovementKeys[BACKWARD] = bPressed; break;
+			// A and D keys to pan the camera left and right
+			case GLFW_KEY_A: m_bMovementKeys[LEFT] = bPressed; break;
+			case GLFW_KEY_D: m_bMovementKeys[RIGHT] = bPressed; break;
+			// Q and E keys to move the camera up and down
+			case GLFW_KEY_Q: m_bMovementKeys[UP] = bPressed; break;
+			case GLFW_KEY_E: m_bMovementKeys[DOWN] = bPressed; break;
+			default: break;
+			}
+
+			// change between different projection views
+			if (bPressed && (event.key == GLFW_KEY_O))
+			{
+				// change to a multi-view orthographic projection
+				bOrthographicProjection = true;
+
+				// Set the camera settings for orthographic view
+				g_pCamera->Position = glm::vec3(0.0f, 5.0f, 10.0f);  // Position the camera in front of the objects
+				g_pCamera->Up = glm::vec3(0.0f, 1.0f, 0.0f);
+				g_pCamera->Front = glm::vec3(0.0f, 0.0f, -1.0f);  // Look directly at the objects
+			}
+			if (bPressed && (event.key == GLFW_KEY_P))
+			{
+				// change to perspective projection
+				bOrthographicProjection = false;
+
+				// Set the camera settings for perspective view
+				g_pCamera->Position = glm::vec3(0.0f, 5.0f, 10.0f);
+				g_pCamera->Front = glm::vec3(0.0f, -0.5f, -2.0f);
+				g_pCamera->Up = glm::vec3(0.0f, 1.0f, 0.0f);
+				g_pCamera->Zoom = 100;
+			}
+		}
 	}
-	if (glfwGetKey(m_pWindow, GLFW_KEY_D) == GLFW_PRESS)
+}
+
+/***********************************************************
+ *  ProcessKeyboardEvents()
+ *
+ *  This method is called to move the camera for every
+ *  movement key that is held down, by one simulation tick.
+ ***********************************************************/
+void ViewManager::ProcessKeyboardEvents()
+{
+	const Camera_Movement movements[6] = { FORWARD, BACKWARD, LEFT, RIGHT, UP, DOWN };
+	for (int i = 0; i < 6; i++)
 	{
-		// D key to move camera right
-		g_pCamera->ProcessKeyboard(RIGHT, gDeltaTime);
+		if (m_bMovementKeys[movements[i]])
+		{
+			g_pCamera->ProcessKeyboard(movements[i], (float)g_SimulationTickLength);
+		}
 	}
+}
+
+/***********************************************************
+ *  CaptureCameraState()
+ *
+ *  This method is used for getting the state of the camera
+ *  the frames are drawn from.
+ ***********************************************************/
+ViewManager::CAMERA_STATE ViewManager::CaptureCameraState() const
+{
+	CAMERA_STATE state;
+	state.position = g_pCamera->Position;
+	state.front = g_pCamera->Front;
+	state.up = g_pCamera->Up;
+	state.zoom = g_pCamera->Zoom;
+	state.bOrthographic = bOrthographicProjection;
+	return(state);
+}
+
+/***********************************************************
+ *  SimulateTick()
+ *
+ *  This method is used for running one fixed length tick of
+ *  the simulation and publishing the camera before and after
+ *  it. A switch of the projection jumps the camera, so the
+ *  frames are not interpolated across it. When the camera
+ *  moved, a render loop waiting for events is woken up.
+ ***********************************************************/
+void ViewManager::SimulateTick(double tickTime)
+{
+	CAMERA_STATE previous = m_cameraState;
 
-	// process camera panning up and down
-	if (glfwGetKey(m_pWindow, GLFW_KEY_Q) == GLFW_PRESS)
+	ProcessInputEvents();
+	ProcessKeyboardEvents();
+	m_cameraState = CaptureCameraState();
+
+	SIMULATION_SNAPSHOT& snapshot = m_snapshots.GetBack();
+	snapshot.previous = (previous.bOrthographic == m_cameraState.bOrthographic) ? previous : m_cameraState;
+	snapshot.current = m_cameraState;
+	snapshot.tickTime = tickTime;
+	m_snapshots.Publish();
+
+	bool bMoved = (previous.position != m_cameraState.position) ||
+		(previous.front != m_cameraState.front) ||
+		(previous.up != m_cameraState.up) ||
+		(previous.zoom != m_cameraState.zoom) ||
+		(previous.bOrthographic != m_cameraState.bOrthographic);
+	if (bMoved && m_bUseSimulationThread)
 	{
-		// Q key to move camera up
-		g_pCamera->ProcessKeyboard(UP, gDeltaTime);
+		glfwPostEmptyEvent();
 	}
-	if (glfwGetKey(m_pWindow, GLFW_KEY_E) == GLFW_PRESS)
+}
+
+/***********************************************************
+ *  SimulationLoop()
+ *
+ *  This method is used for ticking the simulation at its
+ *  fixed rate on its own thread, so the camera keeps moving
+ *  at the same speed however long the frames take.
+ ***********************************************************/
+void ViewManager::SimulationLoop()
+{
+	double nextTickTime = GetSimulationTime();
+	while (m_bSimulating)
 	{
-		// E key to move camera down
-		g_pCamera->ProcessKeyboard(DOWN, gDeltaTime);
+		SimulateTick(nextTickTime);
+		nextTickTime += g_SimulationTickLength;
+
+		double currentTime = GetSimulationTime();
+		if (currentTime - nextTickTime > g_MaxSimulationLag)
+		{
+			nextTickTime = currentTime;
+		}
+		else if (nextTickTime > currentTime)
+		{
+			std::this_thread::sleep_for(std::chrono::duration<double>(nextTickTime - currentTime));
+		}
 	}
+}
 
-	// change between different projection views
-	if (glfwGetKey(m_pWindow, GLFW_KEY_O) == GLFW_PRESS)
-	{
-		// change to a multi-view orthographic projection
-		bOrthographicProjection = true;
+/***********************************************************
+ *  SetSimulationThread()
+ *
+ *  This method is used for choosing if the simulation ticks
+ *  on its own thread or from the render loop. It must be
+ *  called before the simulation is started.
+ ***********************************************************/
+void ViewManager::SetSimulationThread(bool bUseThread)
+{
+	m_bUseSimulationThread = bUseThread;
+}
 
-		// Set the camera settings for orthographic view
-		g_pCamera->Position = glm::vec3(0.0f, 5.0f, 10.0f);  // Position the camera in front of the objects
-		g_pCamera->Up = glm::vec3(0.0f, 1.0f, 0.0f);
-		g_pCamera->Front = glm::vec3(0.0f, 0.0f, -1.0f);  // Look directly at the objects
-	}
-	if (glfwGetKey(m_pWindow, GLFW_KEY_P) == GLFW_PRESS)
+/***********************************************************
+ *  StartSimulation()
+ *
+ *  This method is used for publishing the starting camera
+ *  and starting the fixed rate simulation.
+ ***********************************************************/
+void ViewManager::StartSimulation()
+{
+	if (m_bSimulating)
 	{
-		// change to perspective projection
-		bOrthographicProjection = false;
-
-		// Set the camera settings for perspective view
-		g_pCamera->Position = glm::vec3(0.0f, 5.0f, 10.0f);
-		g_pCamera->Front = glm::vec3(0.0f, -0.5f, -2.0f);
-		g_pCamera->Up = glm::vec3(0.0f, 1.0f, 0.0f);
-		g_pCamera->Zoom = 100;
+		return;
+	}
 
+	m_cameraState = CaptureCameraState();
+	SIMULATION_SNAPSHOT& snapshot = m_snapshots.GetBack();
+	snapshot.previous = m_cameraState;
+	snapshot.current = m_cameraState;
+	snapshot.tickTime = GetSimulationTime();
+	m_snapshots.Publish();
+	m_snapshots.Update();
+
+	m_bSimulating = true;
+	m_nextTickTime = snapshot.tickTime;
+	if (m_bUseSimulationThread)
+	{
+		m_simulationThread = std::thread(&ViewManager::SimulationLoop, this);
 	}
+}
 
+/***********************************************************
+ *  StopSimulation()
+ *
+ *  This method is used for stopping the simulation and
+ *  joining its thread.
+ ***********************************************************/
+void ViewManager::StopSimulation()
+{
+	m_bSimulating = false;
+	if (m_simulationThread.joinable())
+	{
+		m_simulationThread.join();
+	}
 }
 
 /***********************************************************
@@ -247,48 +701,205 @@ void ViewManager::ProcessKeyboardEvents()
  *
  *  This method is used for preparing the 3D scene by loading
  *  the shapes, textures in memory to support the 3D scene 
- *  rendering
+ *  rendering. The camera is interpolated between the last
+ *  two simulation ticks for the time the frame is drawn.
  ***********************************************************/
 void ViewManager::PrepareSceneView()
 {
-	glm::mat4 view;
-	glm::mat4 projection;
+	double currentTime = GetSimulationTime();
 
-	// per-frame timing
-	float currentFrame = glfwGetTime();
-	gDeltaTime = currentFrame - gLastFrame;
-	gLastFrame = currentFrame;
-
-	// process any keyboard events that may be waiting in the 
-	// event queue
-	ProcessKeyboardEvents();
-
-	// get the current view matrix from the camera
-	view = g_pCamera->GetViewMatrix();
-
-	// define the current projection matrix
-	if (bOrthographicProjection)
+	// without its own thread the simulation catches up here
+	if (m_bSimulating && !m_bUseSimulationThread)
 	{
-		// Define the orthographic projection matrix
-		float orthoScale = 10.0f;
-		float aspectRatio = (float)WINDOW_WIDTH / (float)WINDOW_HEIGHT;
-		projection = glm::ortho(-orthoScale * aspectRatio, orthoScale * aspectRatio, -orthoScale, orthoScale, 0.1f, 100.0f);
+		if (currentTime - m_nextTickTime > g_MaxSimulationLag)
+		{
+			m_nextTickTime = currentTime;
+		}
+		while (m_nextTickTime <= currentTime)
+		{
+			SimulateTick(m_nextTickTime);
+			m_nextTickTime += g_SimulationTickLength;
+		}
+	}
 
+	// take the newest snapshot and place the frame between its
+	// previous and current camera
+	m_snapshots.Update();
+	const SIMULATION_SNAPSHOT& snapshot = m_snapshots.GetFront();
+	float alpha = glm::clamp((float)((currentTime - snapshot.tickTime) / g_SimulationTickLength), 0.0f, 1.0f);
+	glm::vec3 position = glm::mix(snapshot.previous.position, snapshot.current.position, alpha);
+	glm::vec3 front = glm::normalize(glm::mix(snapshot.previous.front, snapshot.current.front, alpha));
+	glm::vec3 up = glm::normalize(glm::mix(snapshot.previous.up, snapshot.current.up, alpha));
+	float zoom = glm::mix(snapshot.previous.zoom, snapshot.current.zoom, alpha);
+
+	// the projections follow the shape of the framebuffer, which
+	// keeps the last one while the window is minimized
+	if ((g_FramebufferWidth > 0) && (g_FramebufferHeight > 0))
+	{
+		m_aspectRatio = (float)g_FramebufferWidth / (float)g_FramebufferHeight;
 	}
-	else
+
+	const LAYOUT_DESC& layout = g_ViewLayouts[m_viewLayout];
+	bool bViewChanged = (layout.viewCount != m_viewCount);
+	for (int i = 0; i < layout.viewCount; i++)
 	{
-		// Define the perspective projection matrix
-		projection = glm::perspective(glm::radians(g_pCamera->Zoom), (GLfloat)WINDOW_WIDTH / (GLfloat)WINDOW_HEIGHT, 0.1f, 100.0f);
+		const LAYOUT_VIEW& layoutView = layout.views[i];
+		// width over height of the part of the frame the view fills
+		float aspectRatio = m_aspectRatio * layoutView.viewport.z / layoutView.viewport.w;
+
+		SCENE_VIEW sceneView;
+		sceneView.viewport = layoutView.viewport;
+		if (layoutView.camera < 0)
+		{
+			// get the current view matrix from the camera
+			sceneView.view = glm::lookAt(position, position + front, up);
+			sceneView.position = position;
+
+			// define the current projection matrix
+			if (snapshot.current.bOrthographic)
+			{
+				// Define the orthographic projection matrix
+				float orthoScale = 10.0f;
+				sceneView.projection = glm::ortho(-orthoScale * aspectRatio, orthoScale * aspectRatio, -orthoScale, orthoScale, 0.1f, 100.0f);
+			}
+			else
+			{
+				// Define the perspective projection matrix
+				sceneView.projection = glm::perspective(glm::radians(zoom), aspectRatio, 0.1f, 100.0f);
+			}
+
+			// each eye moves sideways from the camera, and its
+			// frustum is sheared back so the two converge at the
+			// same distance, an orthographic view has no depth to
+			// show and both eyes see it the same
+			if ((layoutView.camera != g_InteractiveCamera) && !snapshot.current.bOrthographic)
+			{
+				float eyeOffset = 0.5f * ((layoutView.camera == g_LeftEyeCamera) ? -g_EyeSeparation : g_EyeSeparation);
+				sceneView.view = glm::translate(glm::vec3(-eyeOffset, 0.0f, 0.0f)) * sceneView.view;
+				sceneView.position += glm::normalize(glm::cross(front, up)) * eyeOffset;
+				sceneView.projection[2][0] -= sceneView.projection[0][0] * eyeOffset / g_ConvergenceDistance;
+			}
+		}
+		else
+		{
+			const FIXED_CAMERA& camera = g_FixedCameras[layoutView.camera];
+			sceneView.view = glm::lookAt(camera.position, camera.target, glm::vec3(0.0f, 1.0f, 0.0f));
+			sceneView.position = camera.position;
+			sceneView.projection = glm::perspective(glm::radians(camera.zoom), aspectRatio, 0.1f, 100.0f);
+		}
+
+		// keep the matrices for the level-of-detail selection and
+		// the culling, and note if the frame has to be drawn again
+		bViewChanged = bViewChanged ||
+			(sceneView.view != m_views[i].view) ||
+			(sceneView.projection != m_views[i].projection) ||
+			(sceneView.viewport != m_views[i].viewport);
+		m_views[i] = sceneView;
 	}
+	m_viewCount = layout.viewCount;
+	m_bViewChanged = bViewChanged;
 
 	// if the shader manager object is valid
 	if (NULL != m_pShaderManager)
 	{
 		// set the view matrix into the shader for proper rendering
-		m_pShaderManager->setMat4Value(g_ViewName, view);
+		GLStateCache::SetMat4(m_pShaderManager, g_ViewName, m_views[0].view);
 		// set the view matrix into the shader for proper rendering
-		m_pShaderManager->setMat4Value(g_ProjectionName, projection);
+		GLStateCache::SetMat4(m_pShaderManager, g_ProjectionName, m_views[0].projection);
 		// set the view position of the camera into the shader for proper rendering
-		m_pShaderManager->setVec3Value("viewPosition", g_pCamera->Position);
+		GLStateCache::SetVec3(m_pShaderManager, "viewPosition", m_views[0].position);
 	}
+}
+
+/***********************************************************
+ *  SetViewLayout()
+ *
+ *  This method is used for choosing how many cameras are
+ *  drawn into the frame and which part of it each fills.
+ *  The views follow the layout from the next frame on.
+ ***********************************************************/
+void ViewManager::SetViewLayout(VIEW_LAYOUT layout)
+{
+	m_viewLayout = layout;
+}
+
+/***********************************************************
+ *  ParseViewLayout()
+ *
+ *  This method is used for getting the layout of a name
+ *  given on the command line.
+ ***********************************************************/
+bool ViewManager::ParseViewLayout(const char* name, VIEW_LAYOUT& layout)
+{
+	for (int i = 0; i < LAYOUT_COUNT; i++)
+	{
+		if (strcmp(name, g_ViewLayouts[i].name) == 0)
+		{
+			layout = (VIEW_LAYOUT)i;
+			return(true);
+		}
+	}
+	return(false);
+}
+
+/***********************************************************
+ *  GetViewportRect()
+ *
+ *  This method is used for getting the left, bottom, width
+ *  and height in pixels of a view in a frame of the passed
+ *  in size. The edges are rounded the same way for every
+ *  view, so views next to each other meet without a gap.
+ ***********************************************************/
+glm::ivec4 ViewManager::GetViewportRect(const glm::vec4& viewport, glm::ivec2 frameSize)
+{
+	int left = (int)(viewport.x * frameSize.x + 0.5f);
+	int bottom = (int)(viewport.y * frameSize.y + 0.5f);
+	int right = (int)((viewport.x + viewport.z) * frameSize.x + 0.5f);
+	int top = (int)((viewport.y + viewport.w) * frameSize.y + 0.5f);
+	return(glm::ivec4(left, bottom, std::max(1, right - left), std::max(1, top - bottom)));
+}
+
+/***********************************************************
+ *  GetViewportHeight()
+ *
+ *  This method is used for getting the height in pixels of
+ *  the viewport the interactive camera is rendered into.
+ ***********************************************************/
+int ViewManager::GetViewportHeight() const
+{
+	return(std::max(1, (int)(g_FramebufferHeight * m_views[0].viewport.w)));
+}
+
+/***********************************************************
+ *  GetFramebufferSize()
+ *
+ *  This method is used for getting the size in pixels of
+ *  the framebuffer of the window.
+ ***********************************************************/
+glm::ivec2 ViewManager::GetFramebufferSize() const
+{
+	return(glm::ivec2(g_FramebufferWidth, g_FramebufferHeight));
+}
+
+/***********************************************************
+ *  GetContentScale()
+ *
+ *  This method is used for getting the content scale of the
+ *  monitor the window is on, 2 on a monitor with twice the
+ *  usual pixel density.
+ ***********************************************************/
+float ViewManager::GetContentScale() const
+{
+	return(g_ContentScale);
+}
+
+/***********************************************************
+ *  GetCameraPosition()
+ *
+ *  This method is used for getting the position of the
+ *  camera in world space, as interpolated for the frame.
+ ***********************************************************/
+glm::vec3 ViewManager::GetCameraPosition() const
+{
+	return(m_views[0].position);
 }
\ No newline at end of file
@@ -11,6 +11,10 @@
 
 #include "ShaderManager.h"
 #include "camera.h"
+#include "TripleBuffer.h"
+
+#include <atomic>
+#include <thread>
 
 // GLFW library
 #include "GLFW/glfw3.h" 
@@ -27,22 +31,166 @@ public:
 	// mouse position callback for mouse interaction with the 3D scene
 	static void Mouse_Position_Callback(GLFWwindow* window, double xMousePos, double yMousePos);
 
+	// mouse button callback for picking the object in sight
+	static void Mouse_Button_Callback(GLFWwindow* window, int button, int action, int mods);
+
 	// mouse scroll wheel callback for adjusting the camera movement speed
 	static void Mouse_Scroll_Wheel_Callback(GLFWwindow* window, double xOffset, double yOffset);
 
+	// keyboard callback for moving the camera and closing the window
+	static void Key_Callback(GLFWwindow* window, int key, int scancode, int action, int mods);
+
+	// window refresh callback for repainting the uncovered window
+	static void Window_Refresh_Callback(GLFWwindow* window);
+
+	// framebuffer size callback for following the resized window
+	static void Framebuffer_Size_Callback(GLFWwindow* window, int width, int height);
+
+	// content scale callback for following the DPI of the monitor
+	static void Window_Content_Scale_Callback(GLFWwindow* window, float xScale, float yScale);
+
+	// most views drawn into one frame
+	static const int MAX_VIEWS = 4;
+
+	// how the frame is shared between the views
+	enum VIEW_LAYOUT
+	{
+		// the interactive camera fills the frame
+		LAYOUT_SINGLE = 0,
+		// the interactive camera and a side camera next to it
+		LAYOUT_SPLIT,
+		// an overhead camera inset into the top right corner
+		LAYOUT_PICTURE_IN_PICTURE,
+		// the interactive camera and three fixed cameras in a grid
+		LAYOUT_WALL,
+		// the left and right eye of the interactive camera side by
+		// side, drawn in one pass
+		LAYOUT_STEREO,
+		LAYOUT_COUNT
+	};
+
+	// one camera of the frame and the part of the frame it fills
+	struct SCENE_VIEW
+	{
+		glm::mat4 view;
+		glm::mat4 projection;
+		glm::vec3 position;
+		// left, bottom, width and height as fractions of the frame
+		glm::vec4 viewport;
+	};
+
 private:
+	// the camera at the end of a simulation tick
+	struct CAMERA_STATE
+	{
+		glm::vec3 position;
+		glm::vec3 front;
+		glm::vec3 up;
+		float zoom;
+		bool bOrthographic;
+	};
+
+	// published after every tick, the frames are drawn between
+	// the previous and the current camera
+	struct SIMULATION_SNAPSHOT
+	{
+		CAMERA_STATE previous;
+		CAMERA_STATE current;
+		double tickTime;
+	};
+
 	// pointer to shader manager object
 	ShaderManager* m_pShaderManager;
 	// active OpenGL display window
 	GLFWwindow* m_pWindow;
 
-	// process keyboard events for interaction with the 3D scene
+	// snapshots passed from the simulation to the rendering
+	TripleBuffer<SIMULATION_SNAPSHOT> m_snapshots;
+	// thread ticking the simulation, or the render loop when off
+	std::thread m_simulationThread;
+	std::atomic<bool> m_bSimulating;
+	bool m_bUseSimulationThread;
+	// time of the next tick run by the render loop
+	double m_nextTickTime;
+	// camera state of the last tick, owned by the simulation
+	CAMERA_STATE m_cameraState;
+	// movement keys held down, indexed by the camera movement
+	bool m_bMovementKeys[6];
+
+	// apply the queued mouse and keyboard events to the camera
+	void ProcessInputEvents();
+	// move the camera for the movement keys held down
 	void ProcessKeyboardEvents();
+	// run one fixed simulation tick and publish its snapshot
+	void SimulateTick(double tickTime);
+	// the loop of the simulation thread
+	void SimulationLoop();
+	// get the state of the simulated camera
+	CAMERA_STATE CaptureCameraState() const;
 
 public:
 	// create the initial OpenGL display window
 	GLFWwindow* CreateDisplayWindow(const char* windowTitle);
 	
+	// choose between ticking the simulation on its own thread and
+	// ticking it from the render loop
+	void SetSimulationThread(bool bUseThread);
+	// start and stop the fixed rate simulation of the camera
+	void StartSimulation();
+	void StopSimulation();
+
 	// prepare the conversion from 3D object display to 2D scene display
 	void PrepareSceneView();
+
+	// choose how many views are drawn and where
+	void SetViewLayout(VIEW_LAYOUT layout);
+	VIEW_LAYOUT GetViewLayout() const { return m_viewLayout; }
+	// true when the two views are the eyes of the interactive
+	// camera, in the left and right half of the frame
+	bool IsStereo() const { return m_viewLayout == LAYOUT_STEREO; }
+	// get the layout of a name given on the command line
+	static bool ParseViewLayout(const char* name, VIEW_LAYOUT& layout);
+	// get the views of the current frame, the first one is
+	// always the interactive camera
+	int GetViewCount() const { return m_viewCount; }
+	const SCENE_VIEW& GetView(int index) const { return m_views[index]; }
+	// get the pixel rectangle of a view in a frame of this size
+	static glm::ivec4 GetViewportRect(const glm::vec4& viewport, glm::ivec2 frameSize);
+
+	// get the view and projection matrices of the interactive
+	// camera in the current frame
+	glm::mat4 GetViewMatrix() const { return m_views[0].view; }
+	glm::mat4 GetProjectionMatrix() const { return m_views[0].projection; }
+	// get the height of the viewport of the interactive camera
+	// in pixels
+	int GetViewportHeight() const;
+	// get the size of the framebuffer of the window in pixels,
+	// zero while the window is minimized
+	glm::ivec2 GetFramebufferSize() const;
+	// get the ratio between the pixels and the screen coordinates
+	// of the monitor the window is on
+	float GetContentScale() const;
+	// get the position of the interactive camera in world space
+	glm::vec3 GetCameraPosition() const;
+	// true when a view or projection moved since the last frame
+	bool HasViewChanged() const { return m_bViewChanged; }
+	// true once after the window asked to be repainted
+	bool TakeWindowRefresh();
+	// true once after the shading was switched with the L key
+	bool TakeShadingSwitch();
+	// true once after an object was asked to be picked with the
+	// left mouse button, with the position to pick at as
+	// fractions of the window from its top left corner
+	bool TakePickRequest(glm::vec2& position);
+
+private:
+	// the views of the current frame, the first one follows the
+	// interpolated camera
+	SCENE_VIEW m_views[MAX_VIEWS];
+	int m_viewCount;
+	VIEW_LAYOUT m_viewLayout;
+	// true when the matrices differ from the previous frame
+	bool m_bViewChanged;
+	// width over height of the framebuffer
+	float m_aspectRatio;
 };
\ No newline at end of file
@@ -0,0 +1,206 @@
+#version 430 core
+
+struct Material 
+{
+    vec4 diffuseColor;   // w holds the shininess
+    vec4 specularColor;
+}; 
+
+struct DrawData
+{
+    vec4 color;
+    vec2 uvScale;
+    int textureSlot;
+    int materialIndex;
+    int bUseTexture;
+    int objectID;
+};
+
+struct LightSource 
+{
+    vec3 position;	
+    vec3 diffuseColor;
+    vec3 specularColor;
+    float focalStrength;
+    float specularIntensity;
+    // distance the light reaches, 0 when it lights everything
+    float range;
+};
+
+#define TOTAL_LIGHTS 32
+#define TOTAL_TEXTURES 16
+
+// the batch is drawn in one forward pass, or with deferred
+// shading as a G-buffer pass of the opaque draws followed by a
+// forward pass of the transparent ones
+#define PASS_FORWARD 0
+#define PASS_GBUFFER 1
+#define PASS_TRANSPARENT 2
+
+in vec3 fragmentPosition;
+in vec3 fragmentVertexNormal;
+in vec2 fragmentTextureCoordinate;
+flat in int fragmentDrawID;
+flat in int fragmentEye;
+
+// the G-buffer pass writes the albedo with the material index in
+// alpha, and the octahedral encoded normal
+layout(location = 0) out vec4 outFragmentColor;
+layout(location = 1) out vec2 outPackedNormal;
+// scene object of the fragment, only kept when the frame has an
+// object ID buffer attached
+layout(location = 2) out uint outObjectID;
+
+layout(std430, binding = 0) readonly buffer DrawDataBuffer
+{
+    DrawData drawData[];
+};
+
+layout(std430, binding = 1) readonly buffer MaterialBuffer
+{
+    Material materials[];
+};
+
+uniform bool bUseLighting=false;
+uniform sampler2D objectTextures[TOTAL_TEXTURES];
+uniform vec3 viewPosition;
+// in stereo the highlights are seen from the eye of the fragment
+uniform bool bStereo = false;
+uniform vec3 eyePositions[2];
+uniform LightSource lightSources[TOTAL_LIGHTS];
+uniform int lightCount = 0;
+uniform vec3 globalAmbientColor;
+uniform int shadingPass = PASS_FORWARD;
+    
+
+// function prototypes
+vec3 CalcLightSource(LightSource light, Material material, vec3 lightNormal, vec3 vertexPosition, vec3 viewDirection);
+float CalcLightFalloff(LightSource light, vec3 vertexPosition);
+vec2 EncodeOctahedral(vec3 normal);
+
+void main()
+{
+   // the draw ID is the same for every fragment of a draw, so
+   // indexing the texture array with it is dynamically uniform
+   DrawData data = drawData[fragmentDrawID];
+   Material material = materials[data.materialIndex];
+   outObjectID = uint(data.objectID);
+
+   vec4 textureColor = vec4(1.0f);
+   if(data.bUseTexture != 0)
+   {
+      textureColor = texture(objectTextures[data.textureSlot], fragmentTextureCoordinate * data.uvScale);
+   }
+
+   // a lit textured draw is always opaque, so only the colored
+   // draws with some alpha are left for the transparent pass
+   bool bTransparent = (data.bUseTexture == 0) && (data.color.w < 1.0f);
+   if(shadingPass == PASS_GBUFFER)
+   {
+      if(bTransparent == true)
+      {
+         discard;
+      }
+      vec3 albedo = (data.bUseTexture != 0) ? textureColor.xyz : data.color.xyz;
+      outFragmentColor = vec4(albedo, float(data.materialIndex) / 255.0f);
+      outPackedNormal = EncodeOctahedral(normalize(fragmentVertexNormal)) * 0.5f + 0.5f;
+      return;
+   }
+   if((shadingPass == PASS_TRANSPARENT) && (bTransparent == false))
+   {
+      discard;
+   }
+
+   if(bUseLighting == true)
+   {
+      // properties
+      vec3 lightNormal = normalize(fragmentVertexNormal);
+      vec3 eyePosition = (bStereo == true) ? eyePositions[fragmentEye] : viewPosition;
+      vec3 viewDirection = normalize(eyePosition - fragmentPosition);
+      vec3 phongResult = vec3(0.0f);
+
+      for(int i = 0; i < lightCount; i++)
+      {
+         phongResult += CalcLightSource(lightSources[i], material, lightNormal, fragmentPosition, viewDirection) *
+            CalcLightFalloff(lightSources[i], fragmentPosition); 
+      }   
+    
+      if(data.bUseTexture != 0)
+      {
+         outFragmentColor = vec4(phongResult * textureColor.xyz, 1.0);
+      }
+      else
+      {
+         outFragmentColor = vec4(phongResult * data.color.xyz, data.color.w);
+      }
+   }
+   else 
+   {
+      if(data.bUseTexture != 0)
+      {
+         outFragmentColor = textureColor;
+      }
+      else
+      {
+         outFragmentColor = data.color;
+      }
+   }
+}
+
+// calculates the color when using a directional light.
+vec3 CalcLightSource(LightSource light, Material material, vec3 lightNormal, vec3 vertexPosition, vec3 viewDirection)
+{
+   vec3 ambient;
+   vec3 diffuse;
+   vec3 specular;
+
+   //**Calculate Ambient lighting**
+
+   ambient = globalAmbientColor;
+
+   //**Calculate Diffuse lighting**
+
+   // Calculate distance (light direction) between light source and fragments/pixels
+   vec3 lightDirection = normalize(light.position - vertexPosition); 
+   // Calculate diffuse impact by generating dot product of normal and light
+   float impact = max(dot(lightNormal, lightDirection), 0.0);
+   // Generate diffuse material color   
+   diffuse = impact * material.diffuseColor.xyz; 
+
+   //**Calculate Specular lighting**
+
+   // Calculate reflection vector
+   vec3 reflectDir = reflect(-lightDirection, lightNormal);
+   // Calculate specular component
+   float specularComponent = pow(max(dot(viewDirection, reflectDir), 0.0), light.focalStrength);
+   specular = (light.specularIntensity * material.diffuseColor.w) * specularComponent * material.specularColor.xyz;
+  
+   return(ambient + diffuse + specular);
+}
+
+// fades a light with a range out to nothing at the end of it,
+// the same as the deferred light pass does
+float CalcLightFalloff(LightSource light, vec3 vertexPosition)
+{
+   if(light.range <= 0.0f)
+   {
+      return 1.0f;
+   }
+   float distanceRatio = length(light.position - vertexPosition) / light.range;
+   float falloff = clamp(1.0f - distanceRatio * distanceRatio, 0.0f, 1.0f);
+   return falloff * falloff;
+}
+
+// folds a unit normal onto the faces of an octahedron, the
+// inverse of DecodeOctahedral in the vertex shader
+vec2 EncodeOctahedral(vec3 normal)
+{
+   normal /= abs(normal.x) + abs(normal.y) + abs(normal.z);
+   vec2 octahedral = normal.xy;
+   if(normal.z < 0.0f)
+   {
+      vec2 signs = vec2(normal.x >= 0.0f ? 1.0f : -1.0f, normal.y >= 0.0f ? 1.0f : -1.0f);
+      octahedral = (1.0f - abs(normal.yx)) * signs;
+   }
+   return octahedral;
+}
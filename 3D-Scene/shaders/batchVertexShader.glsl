@@ -0,0 +1,72 @@
+#version 430 core
+layout (location = 0) in vec3 inVertexPosition;
+layout (location = 1) in vec3 inVertexNormal;
+layout (location = 2) in vec2 inTextureCoordinate;
+// per-instance attribute read at the base instance of the draw
+layout (location = 3) in uint inDrawIndex;
+
+out vec3 fragmentPosition;
+out vec3 fragmentVertexNormal;
+out vec2 fragmentTextureCoordinate;
+flat out int fragmentDrawID;
+flat out int fragmentEye;
+// the occluders are drawn again after the depth pre-pass with the
+// same shader, and have to land on exactly the same depth
+invariant gl_Position;
+
+uniform mat4 view;
+uniform mat4 projection;
+// packed positions are unit values inside the batch bounding box
+uniform bool bPackedVertices = false;
+uniform mat4 positionDecode;
+// in stereo every draw has two instances, the even one for the
+// left eye and the odd one for the right eye, and each eye is
+// squeezed into its half of the frame
+uniform bool bStereo = false;
+uniform mat4 eyeViewProjections[2];
+
+// function prototypes
+vec3 DecodeOctahedral(vec2 octahedral);
+
+void main()
+{
+   // the static geometry has already been moved into world space
+   fragmentPosition = vec3(positionDecode * vec4(inVertexPosition, 1.0f));
+   fragmentEye = 0;
+   if(bStereo == true)
+   {
+      fragmentEye = gl_InstanceID & 1;
+      vec4 clipPosition = eyeViewProjections[fragmentEye] * vec4(fragmentPosition, 1.0f);
+      // the sides of the eye frustum cut off what would reach into
+      // the half of the other eye
+      gl_ClipDistance[0] = clipPosition.w + clipPosition.x;
+      gl_ClipDistance[1] = clipPosition.w - clipPosition.x;
+      clipPosition.x = clipPosition.x * 0.5f + ((fragmentEye == 0) ? -0.5f : 0.5f) * clipPosition.w;
+      gl_Position = clipPosition;
+   }
+   else
+   {
+      gl_Position = projection * view * vec4(fragmentPosition, 1.0f);
+   }
+   fragmentVertexNormal = inVertexNormal;
+   if(bPackedVertices == true)
+   {
+      fragmentVertexNormal = DecodeOctahedral(inVertexNormal.xy);
+   }
+   fragmentTextureCoordinate = inTextureCoordinate;
+   // index of the draw within the static batch, which stays the
+   // same when the draw commands are reordered or compacted
+   fragmentDrawID = int(inDrawIndex);
+}
+
+// unfold a normal stored on the faces of an octahedron
+vec3 DecodeOctahedral(vec2 octahedral)
+{
+   vec3 normal = vec3(octahedral, 1.0f - abs(octahedral.x) - abs(octahedral.y));
+   if(normal.z < 0.0f)
+   {
+      vec2 signs = vec2(normal.x >= 0.0f ? 1.0f : -1.0f, normal.y >= 0.0f ? 1.0f : -1.0f);
+      normal.xy = (1.0f - abs(normal.yx)) * signs;
+   }
+   return normalize(normal);
+}
@@ -0,0 +1,341 @@
+#version 430 core
+layout (local_size_x = 256) in;
+
+// layout read by glMultiDrawElementsIndirect
+struct DrawCommand
+{
+    uint count;
+    uint instanceCount;
+    uint firstIndex;
+    int baseVertex;
+    uint baseInstance;
+};
+
+#define GROUP_SIZE 256
+#define VISIBLE_BIT 0x80000000u
+// the occluded screen area is summed in units of 1/65536 screen
+#define AREA_SCALE 65536.0f
+
+// the passes run as three dispatches with a barrier in between
+#define PASS_CULL 0
+#define PASS_SCAN_GROUPS 1
+#define PASS_COMPACT 2
+// the views are the rows of workgroups of every pass, and each
+// view has its own range in the per draw buffers
+#define MAX_VIEWS 4
+#define FRUSTUM_PLANES 6
+// detail levels a draw can have, each one with its own command
+#define MAX_LOD_LEVELS 4
+
+layout(std430, binding = 0) readonly buffer SourceCommandBuffer
+{
+    DrawCommand sourceCommands[];
+};
+
+// world space bounding sphere of each draw, w holds the radius
+layout(std430, binding = 1) readonly buffer DrawBoundsBuffer
+{
+    vec4 drawBounds[];
+};
+
+layout(std430, binding = 2) writeonly buffer CulledCommandBuffer
+{
+    DrawCommand culledCommands[];
+};
+
+// offset of each visible draw within its workgroup
+layout(std430, binding = 3) buffer LocalOffsetBuffer
+{
+    uint localOffsets[];
+};
+
+// visible draws of each workgroup, turned into the offset of the
+// first visible draw of the workgroup by the scan pass
+layout(std430, binding = 4) buffer GroupOffsetBuffer
+{
+    uint groupOffsets[];
+};
+
+// the counts of one view, the visible draw count is read by
+// the indirect draw
+struct ViewCounts
+{
+    uint visibleDrawCount;
+    uint occludedDrawCount;
+    uint occludedArea;
+};
+
+// the occlusion counters are cleared before every cull
+layout(std430, binding = 5) buffer DrawCountBuffer
+{
+    ViewCounts viewCounts[];
+};
+
+// commands of every detail level of each draw, in groups of
+// lodLevelCount
+layout(std430, binding = 6) readonly buffer LODCommandBuffer
+{
+    DrawCommand lodCommands[];
+};
+
+// level each draw was drawn at in each view, -1 before its first
+layout(std430, binding = 7) buffer LODLevelBuffer
+{
+    int lodLevels[];
+};
+
+uniform int cullPass;
+uniform uint drawCount;
+uniform uint groupCount;
+uniform vec4 frustumPlanes[FRUSTUM_PLANES * MAX_VIEWS];
+// frustums of each view, a draw inside any of them is visible,
+// which lets the two eyes of a stereo view share their draws
+uniform uint viewFrustums = 1u;
+// the pyramid is built from the first view only
+uniform bool bUseHiZ = false;
+// every texel of the pyramid holds the farthest depth it covers
+uniform sampler2D hiZTexture;
+uniform vec2 hiZSize;
+uniform int hiZLevels;
+uniform mat4 viewProjection;
+// the visible draws get the detail level of their projected size
+uniform bool bSelectLOD = false;
+// for every view the last row of the view projection, then the
+// pixels a world unit at depth 1 covers and 1 for a perspective
+uniform vec4 lodViews[MAX_VIEWS * 2];
+uniform int lodLevelCount = 1;
+// projected sizes in pixels below which the next coarser level
+// is drawn, and the fraction a size has to move past one
+uniform vec4 lodPixelThresholds;
+uniform float lodHysteresis;
+
+shared uint groupScan[GROUP_SIZE];
+
+// function prototypes
+bool IsInsideFrustum(vec4 bounds, uint viewIndex);
+bool IsNotOccluded(vec4 bounds, out float screenArea);
+int SelectLODLevel(vec4 bounds, uint viewIndex, int previousLevel);
+uint ScanGroup(uint value);
+
+void main()
+{
+   uint drawIndex = gl_GlobalInvocationID.x;
+   uint viewIndex = gl_WorkGroupID.y;
+   // first entry of the view in the per draw and per group buffers
+   uint drawBase = viewIndex * drawCount;
+   uint groupBase = viewIndex * groupCount;
+
+   if(cullPass == PASS_CULL)
+   {
+      bool bVisible = false;
+      if(drawIndex < drawCount)
+      {
+         vec4 bounds = drawBounds[drawIndex];
+         bVisible = IsInsideFrustum(bounds, viewIndex);
+         if((bVisible == true) && (bUseHiZ == true) && (viewIndex == 0u))
+         {
+            float screenArea;
+            bVisible = IsNotOccluded(bounds, screenArea);
+            if(bVisible == false)
+            {
+               atomicAdd(viewCounts[viewIndex].occludedDrawCount, 1u);
+               atomicAdd(viewCounts[viewIndex].occludedArea, uint(screenArea * AREA_SCALE));
+            }
+         }
+         // a hidden draw keeps its level for when it shows again
+         if((bVisible == true) && (bSelectLOD == true))
+         {
+            uint levelIndex = drawBase + drawIndex;
+            lodLevels[levelIndex] = SelectLODLevel(bounds, viewIndex, lodLevels[levelIndex]);
+         }
+      }
+
+      // stable compaction - the visible draws keep their order
+      uint visibleBefore = ScanGroup(bVisible ? 1u : 0u);
+      if(drawIndex < drawCount)
+      {
+         localOffsets[drawBase + drawIndex] = bVisible ? (visibleBefore | VISIBLE_BIT) : 0u;
+      }
+      if(gl_LocalInvocationID.x == GROUP_SIZE - 1)
+      {
+         groupOffsets[groupBase + gl_WorkGroupID.x] = visibleBefore + (bVisible ? 1u : 0u);
+      }
+   }
+   else if(cullPass == PASS_SCAN_GROUPS)
+   {
+      // a single workgroup per view walks over the group totals
+      // in chunks
+      uint carry = 0u;
+      for(uint first = 0u; first < groupCount; first += GROUP_SIZE)
+      {
+         uint groupIndex = first + gl_LocalInvocationID.x;
+         uint groupTotal = (groupIndex < groupCount) ? groupOffsets[groupBase + groupIndex] : 0u;
+         uint totalBefore = ScanGroup(groupTotal);
+         if(groupIndex < groupCount)
+         {
+            groupOffsets[groupBase + groupIndex] = carry + totalBefore;
+         }
+         // every invocation reads the same last entry of the scan
+         carry += groupScan[GROUP_SIZE - 1];
+         barrier();
+      }
+      if(gl_LocalInvocationID.x == 0u)
+      {
+         viewCounts[viewIndex].visibleDrawCount = carry;
+      }
+   }
+   else if(cullPass == PASS_COMPACT)
+   {
+      if(drawIndex < drawCount)
+      {
+         uint localOffset = localOffsets[drawBase + drawIndex];
+         if((localOffset & VISIBLE_BIT) != 0u)
+         {
+            uint culledIndex = groupOffsets[groupBase + gl_WorkGroupID.x] + (localOffset & ~VISIBLE_BIT);
+            DrawCommand command = sourceCommands[drawIndex];
+            if(bSelectLOD == true)
+            {
+               // the draw index and the instances of the stereo
+               // eyes stay those of the draw
+               DrawCommand level = lodCommands[drawIndex * uint(lodLevelCount) + uint(lodLevels[drawBase + drawIndex])];
+               command.count = level.count;
+               command.firstIndex = level.firstIndex;
+               command.baseVertex = level.baseVertex;
+            }
+            culledCommands[drawBase + culledIndex] = command;
+         }
+         // the commands past the visible ones draw nothing, so the
+         // whole range of the view can be submitted when the draw
+         // count cannot be read from a buffer
+         if(drawIndex >= viewCounts[viewIndex].visibleDrawCount)
+         {
+            culledCommands[drawBase + drawIndex] = DrawCommand(0u, 0u, 0u, 0, 0u);
+         }
+      }
+   }
+}
+
+// test the bounding sphere against the six planes of every
+// frustum of a view
+bool IsInsideFrustum(vec4 bounds, uint viewIndex)
+{
+   for(uint frustum = viewIndex * viewFrustums; frustum < (viewIndex + 1u) * viewFrustums; frustum++)
+   {
+      bool bInside = true;
+      for(uint i = frustum * FRUSTUM_PLANES; i < (frustum + 1u) * FRUSTUM_PLANES; i++)
+      {
+         if(dot(frustumPlanes[i].xyz, bounds.xyz) + frustumPlanes[i].w < -bounds.w)
+         {
+            bInside = false;
+            break;
+         }
+      }
+      if(bInside == true)
+      {
+         return true;
+      }
+   }
+   return false;
+}
+
+// test the nearest depth of the bounding sphere against the
+// farthest depth stored in the pyramid over its screen rectangle,
+// and get the fraction of the screen the rectangle covers
+bool IsNotOccluded(vec4 bounds, out float screenArea)
+{
+   screenArea = 0.0f;
+   vec2 screenMin = vec2(1.0f);
+   vec2 screenMax = vec2(0.0f);
+   float nearestDepth = 1.0f;
+
+   for(int corner = 0; corner < 8; corner++)
+   {
+      vec3 offset = vec3(
+         ((corner & 1) != 0) ? bounds.w : -bounds.w,
+         ((corner & 2) != 0) ? bounds.w : -bounds.w,
+         ((corner & 4) != 0) ? bounds.w : -bounds.w);
+      vec4 clip = viewProjection * vec4(bounds.xyz + offset, 1.0f);
+      // a box reaching behind the camera is always visible
+      if(clip.w <= 0.0f)
+      {
+         return true;
+      }
+      vec3 ndc = clip.xyz / clip.w;
+      vec2 screen = ndc.xy * 0.5f + 0.5f;
+      screenMin = min(screenMin, screen);
+      screenMax = max(screenMax, screen);
+      nearestDepth = min(nearestDepth, ndc.z * 0.5f + 0.5f);
+   }
+
+   screenMin = clamp(screenMin, 0.0f, 1.0f);
+   screenMax = clamp(screenMax, 0.0f, 1.0f);
+   screenArea = (screenMax.x - screenMin.x) * (screenMax.y - screenMin.y);
+
+   // pick the level where the rectangle covers at most 2x2 texels
+   vec2 size = (screenMax - screenMin) * hiZSize;
+   float level = ceil(log2(max(max(size.x, size.y), 1.0f)));
+   level = clamp(level, 0.0f, float(hiZLevels - 1));
+
+   float farthestDepth = max(
+      max(textureLod(hiZTexture, screenMin, level).r,
+          textureLod(hiZTexture, vec2(screenMax.x, screenMin.y), level).r),
+      max(textureLod(hiZTexture, vec2(screenMin.x, screenMax.y), level).r,
+          textureLod(hiZTexture, screenMax, level).r));
+
+   return nearestDepth <= farthestDepth;
+}
+
+// choose the detail level from the projected diameter of the
+// bounding sphere, the same way the draws of the scene choose it
+// on the CPU, keeping the previous level until the size moves
+// clearly past a threshold
+int SelectLODLevel(vec4 bounds, uint viewIndex, int previousLevel)
+{
+   vec4 depthRow = lodViews[viewIndex * 2u];
+   vec4 pixelScale = lodViews[viewIndex * 2u + 1u];
+   float depth = dot(depthRow, vec4(bounds.xyz, 1.0f));
+   // the camera is inside or right next to the bounding sphere
+   if((pixelScale.y != 0.0f) && (depth <= bounds.w))
+   {
+      return 0;
+   }
+
+   float pixelSize = bounds.w * pixelScale.x / depth;
+   int level = 0;
+   for(int i = 0; i < lodLevelCount - 1; i++)
+   {
+      float threshold = lodPixelThresholds[i];
+      if(previousLevel >= 0)
+      {
+         threshold *= (previousLevel <= i) ? (1.0f - lodHysteresis) : (1.0f + lodHysteresis);
+      }
+      if(pixelSize < threshold)
+      {
+         level = i + 1;
+      }
+   }
+   return level;
+}
+
+// exclusive prefix sum over the workgroup, the inclusive sum of
+// the whole workgroup is left in the last shared entry
+uint ScanGroup(uint value)
+{
+   uint index = gl_LocalInvocationID.x;
+   groupScan[index] = value;
+   barrier();
+
+   for(uint stride = 1u; stride < GROUP_SIZE; stride *= 2u)
+   {
+      uint sum = groupScan[index];
+      if(index >= stride)
+      {
+         sum += groupScan[index - stride];
+      }
+      barrier();
+      groupScan[index] = sum;
+      barrier();
+   }
+
+   return groupScan[index] - value;
+}
@@ -0,0 +1,202 @@
+#version 430 core
+layout (local_size_x = 16, local_size_y = 16) in;
+
+#define TILE_SIZE 16
+#define TILE_PIXELS 256
+// lights one tile keeps, any more reaching it are left out
+#define MAX_TILE_LIGHTS 256
+
+struct Material 
+{
+    vec4 diffuseColor;   // w holds the shininess
+    vec4 specularColor;
+}; 
+
+// laid out to match LIGHT_DATA in the deferred shading class
+struct Light
+{
+    vec4 positionRange;  // w holds the range, 0 when it lights everything
+    vec4 diffuseColor;   // w holds the focal strength
+    vec4 specularColor;  // w holds the specular intensity
+};
+
+// the same material buffer the static batch is drawn with
+layout(std430, binding = 1) readonly buffer MaterialBuffer
+{
+    Material materials[];
+};
+
+layout(std430, binding = 2) readonly buffer LightBuffer
+{
+    Light lights[];
+};
+
+// the color of the frame, written where an opaque draw was
+layout(rgba8, binding = 0) writeonly uniform image2D frameImage;
+
+// the G-buffer, with the material index in the albedo alpha
+uniform sampler2D depthTexture;
+uniform sampler2D albedoTexture;
+uniform sampler2D normalTexture;
+uniform ivec2 renderSize;
+// the tiles dispatched start at the first tile, and only the
+// pixels between the min and max corner of the redrawn part of
+// the frame are written
+uniform ivec2 firstTile;
+uniform ivec2 shadeMin;
+uniform ivec2 shadeMax;
+uniform mat4 inverseViewProjection;
+uniform vec3 viewPosition;
+uniform vec3 globalAmbientColor;
+uniform int lightCount;
+
+// depth range of the tile as float bits, which keep their order
+// for the positive depths
+shared uint tileMinDepth;
+shared uint tileMaxDepth;
+shared uint tileLightCount;
+shared uint tileLights[MAX_TILE_LIGHTS];
+
+// function prototypes
+vec3 ReconstructPosition(vec2 ndc, float depth);
+vec3 DecodeOctahedral(vec2 octahedral);
+vec3 CalcLight(Light light, Material material, vec3 lightNormal, vec3 vertexPosition, vec3 viewDirection);
+float CalcLightFalloff(Light light, vec3 vertexPosition);
+
+void main()
+{
+   uvec2 tile = gl_WorkGroupID.xy + uvec2(firstTile);
+   ivec2 pixel = ivec2(tile * TILE_SIZE + gl_LocalInvocationID.xy);
+   bool bInside = all(greaterThanEqual(pixel, shadeMin)) && all(lessThan(pixel, shadeMax));
+   float depth = bInside ? texelFetch(depthTexture, pixel, 0).r : 1.0f;
+   // the pixels without an opaque draw keep the far depth
+   bool bShaded = (depth < 1.0f);
+
+   if(gl_LocalInvocationIndex == 0u)
+   {
+      tileMinDepth = 0xFFFFFFFFu;
+      tileMaxDepth = 0u;
+      tileLightCount = 0u;
+   }
+   barrier();
+
+   if(bShaded == true)
+   {
+      atomicMin(tileMinDepth, floatBitsToUint(depth));
+      atomicMax(tileMaxDepth, floatBitsToUint(depth));
+   }
+   barrier();
+
+   // the same for the whole workgroup, a tile of background
+   // has nothing to light
+   if(tileMaxDepth == 0u)
+   {
+      return;
+   }
+
+   // world space box around the part of the view the tile covers
+   // between its nearest and farthest depth
+   vec2 tileMin = vec2(tile * TILE_SIZE) / vec2(renderSize) * 2.0f - 1.0f;
+   vec2 tileMax = vec2((tile + 1u) * TILE_SIZE) / vec2(renderSize) * 2.0f - 1.0f;
+   float minDepth = uintBitsToFloat(tileMinDepth);
+   float maxDepth = uintBitsToFloat(tileMaxDepth);
+   vec3 boxMin = vec3(3.0e38f);
+   vec3 boxMax = vec3(-3.0e38f);
+   for(int corner = 0; corner < 8; corner++)
+   {
+      vec2 ndc = vec2(
+         ((corner & 1) != 0) ? tileMax.x : tileMin.x,
+         ((corner & 2) != 0) ? tileMax.y : tileMin.y);
+      vec3 position = ReconstructPosition(ndc, ((corner & 4) != 0) ? maxDepth : minDepth);
+      boxMin = min(boxMin, position);
+      boxMax = max(boxMax, position);
+   }
+
+   // every invocation tests a share of the lights, a light with
+   // a range is kept when its sphere touches the box
+   for(uint i = gl_LocalInvocationIndex; i < uint(lightCount); i += TILE_PIXELS)
+   {
+      vec4 positionRange = lights[i].positionRange;
+      vec3 closest = clamp(positionRange.xyz, boxMin, boxMax);
+      if((positionRange.w <= 0.0f) || (distance(closest, positionRange.xyz) < positionRange.w))
+      {
+         uint slot = atomicAdd(tileLightCount, 1u);
+         if(slot < MAX_TILE_LIGHTS)
+         {
+            tileLights[slot] = i;
+         }
+      }
+   }
+   barrier();
+
+   if(bShaded == false)
+   {
+      return;
+   }
+
+   vec4 albedo = texelFetch(albedoTexture, pixel, 0);
+   Material material = materials[int(albedo.w * 255.0f + 0.5f)];
+   vec3 lightNormal = DecodeOctahedral(texelFetch(normalTexture, pixel, 0).xy * 2.0f - 1.0f);
+   vec2 pixelNDC = (vec2(pixel) + 0.5f) / vec2(renderSize) * 2.0f - 1.0f;
+   vec3 position = ReconstructPosition(pixelNDC, depth);
+   vec3 viewDirection = normalize(viewPosition - position);
+
+   vec3 phongResult = vec3(0.0f);
+   uint count = min(tileLightCount, uint(MAX_TILE_LIGHTS));
+   for(uint i = 0u; i < count; i++)
+   {
+      Light light = lights[tileLights[i]];
+      phongResult += CalcLight(light, material, lightNormal, position, viewDirection) *
+         CalcLightFalloff(light, position);
+   }
+
+   imageStore(frameImage, pixel, vec4(phongResult * albedo.xyz, 1.0f));
+}
+
+// get the world space position of a depth buffer value
+vec3 ReconstructPosition(vec2 ndc, float depth)
+{
+   vec4 position = inverseViewProjection * vec4(ndc, depth * 2.0f - 1.0f, 1.0f);
+   return position.xyz / position.w;
+}
+
+// unfold a normal stored on the faces of an octahedron
+vec3 DecodeOctahedral(vec2 octahedral)
+{
+   vec3 normal = vec3(octahedral, 1.0f - abs(octahedral.x) - abs(octahedral.y));
+   if(normal.z < 0.0f)
+   {
+      vec2 signs = vec2(normal.x >= 0.0f ? 1.0f : -1.0f, normal.y >= 0.0f ? 1.0f : -1.0f);
+      normal.xy = (1.0f - abs(normal.yx)) * signs;
+   }
+   return normalize(normal);
+}
+
+// the lighting of the forward batch shader, with the light values
+// read from the light buffer
+vec3 CalcLight(Light light, Material material, vec3 lightNormal, vec3 vertexPosition, vec3 viewDirection)
+{
+   vec3 ambient = globalAmbientColor;
+
+   vec3 lightDirection = normalize(light.positionRange.xyz - vertexPosition);
+   float impact = max(dot(lightNormal, lightDirection), 0.0);
+   vec3 diffuse = impact * material.diffuseColor.xyz;
+
+   vec3 reflectDir = reflect(-lightDirection, lightNormal);
+   float specularComponent = pow(max(dot(viewDirection, reflectDir), 0.0), light.diffuseColor.w);
+   vec3 specular = (light.specularColor.w * material.diffuseColor.w) * specularComponent * material.specularColor.xyz;
+
+   return(ambient + diffuse + specular);
+}
+
+// fades a light with a range out to nothing at the end of it
+float CalcLightFalloff(Light light, vec3 vertexPosition)
+{
+   if(light.positionRange.w <= 0.0f)
+   {
+      return 1.0f;
+   }
+   float distanceRatio = length(light.positionRange.xyz - vertexPosition) / light.positionRange.w;
+   float falloff = clamp(1.0f - distanceRatio * distanceRatio, 0.0f, 1.0f);
+   return falloff * falloff;
+}
@@ -0,0 +1,7 @@
+#version 330 core
+
+// the occluders are drawn into the depth buffer only, so the
+// fragments have nothing to compute
+void main()
+{
+}
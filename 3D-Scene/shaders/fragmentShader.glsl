@@ -1,12 +1,5 @@
 #version 440 core
 
-struct Material 
-{
-    vec3 diffuseColor;
-    vec3 specularColor;
-    float shininess;
-}; 
-
 struct LightSource 
 {
     vec3 position;	
@@ -14,32 +7,52 @@ struct LightSource
     vec3 specularColor;
     float focalStrength;
     float specularIntensity;
+    // distance the light reaches, 0 when it lights everything
+    float range;
 };
 
-#define TOTAL_LIGHTS 4
+#define TOTAL_LIGHTS 32
+#define TOTAL_TEXTURES 16
 
 in vec3 fragmentPosition;
 in vec3 fragmentVertexNormal;
 in vec2 fragmentTextureCoordinate;
 
-out vec4 outFragmentColor;
+layout(location = 0) out vec4 outFragmentColor;
+// scene object of the fragment, only kept when the frame has an
+// object ID buffer attached
+layout(location = 2) out uint outObjectID;
+
+// per-draw values, written by the CPU into a slot of a streamed
+// uniform buffer that is bound for each draw
+layout(std140, binding = 2) uniform DrawConstants
+{
+    mat4 model;
+    vec4 objectColor;
+    vec4 diffuseColor;   // w holds the shininess
+    vec4 specularColor;
+    vec2 UVscale;
+    int bUseTexture;
+    int textureSlot;
+    int objectID;
+};
 
-uniform bool bUseTexture=false;
 uniform bool bUseLighting=false;
-uniform vec4 objectColor = vec4(1.0f);
-uniform sampler2D objectTexture;
+uniform sampler2D objectTextures[TOTAL_TEXTURES];
 uniform vec3 viewPosition;
-uniform vec2 UVscale = vec2(1.0f, 1.0f);
 uniform LightSource lightSources[TOTAL_LIGHTS];
-uniform Material material;
+uniform int lightCount = 0;
 uniform vec3 globalAmbientColor;
     
 
 // function prototypes
 vec3 CalcLightSource(LightSource light, vec3 lightNormal, vec3 vertexPosition, vec3 viewDirection);
+float CalcLightFalloff(LightSource light, vec3 vertexPosition);
 
 void main()
 {
+   outObjectID = uint(objectID);
+
    if(bUseLighting == true)
    {
       // properties
@@ -47,14 +60,17 @@ void main()
       vec3 viewDirection = normalize(viewPosition - fragmentPosition);
       vec3 phongResult = vec3(0.0f);
 
-      for(int i = 0; i < TOTAL_LIGHTS; i++)
+      for(int i = 0; i < lightCount; i++)
       {
-         phongResult += CalcLightSource(lightSources[i], lightNormal, fragmentPosition, viewDirection); 
+         phongResult += CalcLightSource(lightSources[i], lightNormal, fragmentPosition, viewDirection) *
+            CalcLightFalloff(lightSources[i], fragmentPosition); 
       }   
     
-      if(bUseTexture == true)
+      if(bUseTexture != 0)
       {
-         vec4 textureColor = texture(objectTexture, fragmentTextureCoordinate * UVscale);
+         // the slot is the same for the whole draw, so indexing
+         // the texture array with it is dynamically uniform
+         vec4 textureColor = texture(objectTextures[textureSlot], fragmentTextureCoordinate * UVscale);
          outFragmentColor = vec4(phongResult * textureColor.xyz, 1.0);
       }
       else
@@ -64,9 +80,9 @@ void main()
    }
    else 
    {
-      if(bUseTexture == true)
+      if(bUseTexture != 0)
       {
-         outFragmentColor = texture(objectTexture, fragmentTextureCoordinate * UVscale);
+         outFragmentColor = texture(objectTextures[textureSlot], fragmentTextureCoordinate * UVscale);
       }
       else
       {
@@ -93,7 +109,7 @@ vec3 CalcLightSource(LightSource light, vec3 lightNormal, vec3 vertexPosition, v
    // Calculate diffuse impact by generating dot product of normal and light
    float impact = max(dot(lightNormal, lightDirection), 0.0);
    // Generate diffuse material color   
-   diffuse = impact * material.diffuseColor; 
+   diffuse = impact * diffuseColor.xyz; 
 
    //**Calculate Specular lighting**
 
@@ -101,7 +117,20 @@ vec3 CalcLightSource(LightSource light, vec3 lightNormal, vec3 vertexPosition, v
    vec3 reflectDir = reflect(-lightDirection, lightNormal);
    // Calculate specular component
    float specularComponent = pow(max(dot(viewDirection, reflectDir), 0.0), light.focalStrength);
-   specular = (light.specularIntensity * material.shininess) * specularComponent * material.specularColor;
+   specular = (light.specularIntensity * diffuseColor.w) * specularComponent * specularColor.xyz;
   
    return(ambient + diffuse + specular);
-}
\ No newline at end of file
+}
+
+// fades a light with a range out to nothing at the end of it,
+// the same as the deferred light pass does
+float CalcLightFalloff(LightSource light, vec3 vertexPosition)
+{
+   if(light.range <= 0.0f)
+   {
+      return 1.0f;
+   }
+   float distanceRatio = length(light.position - vertexPosition) / light.range;
+   float falloff = clamp(1.0f - distanceRatio * distanceRatio, 0.0f, 1.0f);
+   return falloff * falloff;
+}
@@ -0,0 +1,40 @@
+#version 430 core
+layout (local_size_x = 8, local_size_y = 8) in;
+
+// the level of the pyramid written by this dispatch
+layout(r32f, binding = 0) writeonly uniform image2D destinationLevel;
+
+// the depth buffer for the first level, else the level above
+uniform sampler2D sourceTexture;
+uniform int sourceLevel;
+// size of the part of the source the level covers, the frame can
+// be drawn into a corner of the depth buffer
+uniform vec2 sourceSize;
+
+void main()
+{
+   ivec2 destinationSize = imageSize(destinationLevel);
+   ivec2 texel = ivec2(gl_GlobalInvocationID.xy);
+   if(any(greaterThanEqual(texel, destinationSize)))
+   {
+      return;
+   }
+
+   // every source texel under this one, which is up to three along
+   // each axis when the source is not exactly twice as large, so
+   // no depth is skipped and the result stays conservative
+   vec2 scale = sourceSize / vec2(destinationSize);
+   ivec2 first = ivec2(floor(vec2(texel) * scale));
+   ivec2 last = min(ivec2(ceil(vec2(texel + 1) * scale)) - 1, ivec2(sourceSize) - 1);
+
+   float farthestDepth = 0.0f;
+   for(int y = first.y; y <= last.y; y++)
+   {
+      for(int x = first.x; x <= last.x; x++)
+      {
+         farthestDepth = max(farthestDepth, texelFetch(sourceTexture, ivec2(x, y), sourceLevel).r);
+      }
+   }
+
+   imageStore(destinationLevel, texel, vec4(farthestDepth));
+}
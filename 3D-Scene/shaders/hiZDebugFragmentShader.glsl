@@ -0,0 +1,17 @@
+#version 330 core
+in vec2 fragmentTextureCoordinate;
+
+out vec4 outFragmentColor;
+
+// the depth pyramid and the level of it that is shown
+uniform sampler2D hiZTexture;
+uniform int hiZLevel;
+
+void main()
+{
+   float depth = textureLod(hiZTexture, fragmentTextureCoordinate, float(hiZLevel)).r;
+
+   // a perspective depth is crowded close to 1, so it is spread
+   // out to tell the near occluders from the far ones
+   outFragmentColor = vec4(vec3(pow(depth, 32.0f)), 1.0f);
+}
@@ -0,0 +1,33 @@
+#version 330 core
+in vec2 fragmentTextureCoordinate;
+
+out vec4 outFragmentColor;
+
+// the frame drawn at a lower resolution into the corner of the texture
+uniform sampler2D frameTexture;
+// part of the texture the frame covers, and the size of one texel
+uniform vec2 renderScale;
+uniform vec2 texelSize;
+// how much of the detail lost to the scaling is put back
+uniform float sharpness = 0.0f;
+
+void main()
+{
+   // keep the filtered taps inside the part the frame covers
+   vec2 minimumCoordinate = texelSize * 0.5f;
+   vec2 maximumCoordinate = renderScale - texelSize * 0.5f;
+   vec2 coordinate = clamp(fragmentTextureCoordinate * renderScale, minimumCoordinate, maximumCoordinate);
+
+   vec3 center = texture(frameTexture, coordinate).rgb;
+   vec3 north = texture(frameTexture, clamp(coordinate + vec2(0.0f, texelSize.y), minimumCoordinate, maximumCoordinate)).rgb;
+   vec3 south = texture(frameTexture, clamp(coordinate - vec2(0.0f, texelSize.y), minimumCoordinate, maximumCoordinate)).rgb;
+   vec3 east = texture(frameTexture, clamp(coordinate + vec2(texelSize.x, 0.0f), minimumCoordinate, maximumCoordinate)).rgb;
+   vec3 west = texture(frameTexture, clamp(coordinate - vec2(texelSize.x, 0.0f), minimumCoordinate, maximumCoordinate)).rgb;
+
+   // unsharp mask, limited to the range of the neighbors so edges
+   // get crisper without ringing
+   vec3 sharpened = center + sharpness * (4.0f * center - north - south - east - west);
+   vec3 minimumColor = min(center, min(min(north, south), min(east, west)));
+   vec3 maximumColor = max(center, max(max(north, south), max(east, west)));
+   outFragmentColor = vec4(clamp(sharpened, minimumColor, maximumColor), 1.0f);
+}
@@ -0,0 +1,11 @@
+#version 330 core
+out vec2 fragmentTextureCoordinate;
+
+void main()
+{
+   // one triangle covering the whole window, made from the vertex
+   // index so the pass needs no vertex buffer
+   vec2 position = vec2((gl_VertexID << 1) & 2, gl_VertexID & 2);
+   fragmentTextureCoordinate = position;
+   gl_Position = vec4(position * 2.0f - 1.0f, 0.0f, 1.0f);
+}
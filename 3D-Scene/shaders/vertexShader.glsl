@@ -1,5 +1,6 @@
-#version 330 core
+#version 440 core
 layout (location = 0) in vec3 inVertexPosition;
+// packed vertices hold the octahedral encoded normal in xy
 layout (location = 1) in vec3 inVertexNormal;
 layout (location = 2) in vec2 inTextureCoordinate;
 
@@ -7,14 +8,48 @@ out vec3 fragmentPosition;
 out vec3 fragmentVertexNormal;
 out vec2 fragmentTextureCoordinate;
 
-uniform mat4 model;
+// per-draw values, written by the CPU into a slot of a streamed
+// uniform buffer that is bound for each draw
+layout(std140, binding = 2) uniform DrawConstants
+{
+    mat4 model;
+    vec4 objectColor;
+    vec4 diffuseColor;   // w holds the shininess
+    vec4 specularColor;
+    vec2 UVscale;
+    int bUseTexture;
+    int textureSlot;
+    int objectID;
+};
+
 uniform mat4 view;
 uniform mat4 projection;
+// packed positions are unit values the model matrix scales back
+uniform bool bPackedVertices = false;
+
+// function prototypes
+vec3 DecodeOctahedral(vec2 octahedral);
 
 void main()
 {
    fragmentPosition = vec3(model * vec4(inVertexPosition, 1.0));
    gl_Position = projection * view * model * vec4(inVertexPosition, 1.0f);
    fragmentVertexNormal = inVertexNormal;
+   if(bPackedVertices == true)
+   {
+      fragmentVertexNormal = DecodeOctahedral(inVertexNormal.xy);
+   }
    fragmentTextureCoordinate = inTextureCoordinate;
+}
+
+// unfold a normal stored on the faces of an octahedron
+vec3 DecodeOctahedral(vec2 octahedral)
+{
+   vec3 normal = vec3(octahedral, 1.0f - abs(octahedral.x) - abs(octahedral.y));
+   if(normal.z < 0.0f)
+   {
+      vec2 signs = vec2(normal.x >= 0.0f ? 1.0f : -1.0f, normal.y >= 0.0f ? 1.0f : -1.0f);
+      normal.xy = (1.0f - abs(normal.yx)) * signs;
+   }
+   return normalize(normal);
 }
\ No newline at end of file